@@ -25,6 +25,7 @@
 #include "GooString.h"
 #include "PDFDoc.h"
 
+#include <string>
 #include <vector>
 
 namespace poppler
@@ -47,17 +48,23 @@ public:
 
     static document* check_document(document_private *doc, byte_array *file_data);
 
+    PDFDoc* open_copy() const;
+
     PDFDoc *doc;
     byte_array doc_data;
     const char *raw_doc_data;
     int raw_doc_data_length;
+    std::string owner_password;
+    std::string user_password;
     bool is_locked;
+    unsigned int serial;
     std::vector<embedded_file *> embedded_files;
 
 private:
     void init();
 
     static unsigned int count;
+    static unsigned int next_serial;
 };
 
 }
@@ -38,12 +38,15 @@
 using namespace poppler;
 
 unsigned int poppler::document_private::count = 0U;
+unsigned int poppler::document_private::next_serial = 0U;
 
 document_private::document_private(GooString *file_path, const std::string &owner_password,
                                    const std::string &user_password)
     : doc(0)
     , raw_doc_data(0)
     , raw_doc_data_length(0)
+    , owner_password(owner_password)
+    , user_password(user_password)
     , is_locked(false)
 {
     GooString goo_owner_password(owner_password.c_str());
@@ -58,6 +61,8 @@ document_private::document_private(byte_array *file_data,
     : doc(0)
     , raw_doc_data(0)
     , raw_doc_data_length(0)
+    , owner_password(owner_password)
+    , user_password(user_password)
     , is_locked(false)
 {
     Object obj;
@@ -76,6 +81,8 @@ document_private::document_private(const char *file_data, int file_data_length,
     : doc(0)
     , raw_doc_data(file_data)
     , raw_doc_data_length(file_data_length)
+    , owner_password(owner_password)
+    , user_password(user_password)
     , is_locked(false)
 {
     Object obj;
@@ -109,6 +116,28 @@ void document_private::init()
         setErrorFunction(detail::error_function);
     }
     count++;
+    serial = ++next_serial;
+}
+
+/*
+ Opens the same document once more, for example to render it on another
+ thread; the caller owns the returned PDFDoc.
+ */
+PDFDoc* document_private::open_copy() const
+{
+    GooString goo_owner_password(owner_password.c_str());
+    GooString goo_user_password(user_password.c_str());
+    Object obj;
+    obj.initNull();
+    if (doc_data.size() > 0) {
+        MemStream *memstr = new MemStream(const_cast<char *>(&doc_data[0]), 0, doc_data.size(), &obj);
+        return new PDFDoc(memstr, &goo_owner_password, &goo_user_password);
+    } else if (raw_doc_data) {
+        MemStream *memstr = new MemStream(const_cast<char *>(raw_doc_data), 0, raw_doc_data_length, &obj);
+        return new PDFDoc(memstr, &goo_owner_password, &goo_user_password);
+    }
+    return new PDFDoc(new GooString(doc->getFileName()),
+                      &goo_owner_password, &goo_user_password);
 }
 
 document* document_private::check_document(document_private *doc, byte_array *file_data)
@@ -20,6 +20,7 @@
 
 #include "poppler-document-private.h"
 #include "poppler-page-private.h"
+#include "poppler-private.h"
 
 #include <config.h>
 
@@ -28,9 +29,212 @@
 #include "SplashOutputDev.h"
 #include "splash/SplashBitmap.h"
 #endif
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#include "goo/GooThread.h"
+#endif
 
 using namespace poppler;
 
+#if defined(HAVE_SPLASH)
+namespace
+{
+
+/*
+ A SplashOutputDev kept from one rendering to the next, together with the
+ PDFDoc it renders from: as long as the document and the text hints do not
+ change, its font engine and glyph caches are reused.
+ */
+class render_context
+{
+public:
+    render_context()
+        : pdfdoc(0)
+        , own_doc(false)
+        , doc_serial(0)
+        , out(0)
+        , out_hints(0)
+        , last_width(0)
+        , last_height(0)
+    {
+    }
+
+    ~render_context()
+    {
+        reset();
+    }
+
+    void reset();
+    bool prepare(document_private *docp, bool copy, unsigned int hints);
+    image guess_image() const;
+    bool render(int index, double xres, double yres,
+                int x, int y, int w, int h, rotation_enum rotate,
+                argb paper_color, unsigned int hints, image &target);
+
+    PDFDoc *pdfdoc;
+    bool own_doc;
+    unsigned int doc_serial;
+    SplashOutputDev *out;
+    unsigned int out_hints;
+    int last_width;
+    int last_height;
+};
+
+void render_context::reset()
+{
+    delete out;
+    out = 0;
+    if (own_doc) {
+        delete pdfdoc;
+    }
+    pdfdoc = 0;
+    own_doc = false;
+    doc_serial = 0;
+    last_width = last_height = 0;
+}
+
+/*
+ Sets the context up for rendering pages of the document docp, either from
+ the document itself or from a copy of it opened for this context only.
+ */
+bool render_context::prepare(document_private *docp, bool copy, unsigned int hints)
+{
+    if (!pdfdoc || doc_serial != docp->serial) {
+        reset();
+        if (copy) {
+            pdfdoc = docp->open_copy();
+            own_doc = true;
+            if (!pdfdoc->isOk()) {
+                reset();
+                return false;
+            }
+        } else {
+            pdfdoc = docp->doc;
+        }
+        doc_serial = docp->serial;
+    }
+
+    const unsigned int text_hints = hints & (page_renderer::text_antialiasing
+                                             | page_renderer::text_hinting);
+    if (!out || out_hints != text_hints) {
+        delete out;
+        SplashColor bgColor;
+        splashClearColor(bgColor);
+        const GBool text_AA = hints & page_renderer::text_antialiasing ? gTrue : gFalse;
+        out = new SplashOutputDev(splashModeXBGR8, 4, gFalse, bgColor, gTrue, text_AA);
+        out->setFreeTypeHinting(hints & page_renderer::text_hinting ? gTrue : gFalse, gFalse);
+        out->startDoc(pdfdoc->getXRef());
+        out_hints = text_hints;
+    }
+    return true;
+}
+
+/*
+ An image of the size of the last rendered page, to render the next one into;
+ pages of a document are usually all of the same size.
+ */
+image render_context::guess_image() const
+{
+    if (last_width <= 0 || last_height <= 0) {
+        return image();
+    }
+    return image(last_width, last_height, image::format_argb32);
+}
+
+bool render_context::render(int index, double xres, double yres,
+                            int x, int y, int w, int h, rotation_enum rotate,
+                            argb paper_color, unsigned int hints, image &target)
+{
+    SplashColor bgColor;
+    bgColor[0] = paper_color & 0xff;
+    bgColor[1] = (paper_color >> 8) & 0xff;
+    bgColor[2] = (paper_color >> 16) & 0xff;
+    out->setPaperColor(bgColor);
+    out->setVectorAntialias(hints & page_renderer::antialiasing ? gTrue : gFalse);
+
+    SplashColorPtr target_data = 0;
+    if (target.is_valid() && target.format() == image::format_argb32) {
+        target_data = reinterpret_cast<SplashColorPtr>(target.data());
+        out->setExternalBitmap(target_data, target.width(), target.height(),
+                               target.bytes_per_row());
+    }
+    pdfdoc->displayPageSlice(out, index + 1,
+                             xres, yres, int(rotate) * 90,
+                             gFalse, gTrue, gFalse,
+                             x, y, w, h);
+    out->setExternalBitmap(0, 0, 0, 0);
+
+    SplashBitmap *bitmap = out->getBitmap();
+    last_width = bitmap->getWidth();
+    last_height = bitmap->getHeight();
+    if (target_data && bitmap->getDataPtr() == target_data) {
+        // the page went straight into the buffer of target: do not keep
+        // a bitmap pointing to it
+        delete out->takeBitmap();
+        return true;
+    }
+
+    const image img(reinterpret_cast<char *>(bitmap->getDataPtr()),
+                    last_width, last_height, image::format_argb32);
+    target = img.copy();
+    return target.is_valid();
+}
+
+#if MULTITHREADED
+struct render_batch
+{
+    const std::vector<page *> *pages;
+    std::vector<image> *images;
+    double xres;
+    double yres;
+    rotation_enum rotate;
+    argb paper_color;
+    unsigned int hints;
+    GooMutex mutex;
+    size_t next_page;
+};
+
+struct render_worker
+{
+    render_batch *batch;
+    render_context *context;
+};
+
+void run_render_worker(render_worker *worker)
+{
+    render_batch *batch = worker->batch;
+    for (;;) {
+        gLockMutex(&batch->mutex);
+        const size_t i = batch->next_page++;
+        gUnlockMutex(&batch->mutex);
+        if (i >= batch->pages->size()) {
+            break;
+        }
+        const page *p = (*batch->pages)[i];
+        if (!p) {
+            continue;
+        }
+        image &img = (*batch->images)[i];
+        img = worker->context->guess_image();
+        if (!worker->context->render(page_private::get(p)->index,
+                                     batch->xres, batch->yres, -1, -1, -1, -1,
+                                     batch->rotate, batch->paper_color,
+                                     batch->hints, img)) {
+            img = image();
+        }
+    }
+}
+
+GOO_THREAD_FUNC(render_thread)
+{
+    run_render_worker(static_cast<render_worker *>(arg));
+    GOO_THREAD_RETURN;
+}
+#endif
+
+}
+#endif
+
 class poppler::page_renderer_private
 {
 public:
@@ -38,18 +242,124 @@ public:
         : paper_color(0xffffffff)
         , hints(0)
     {
+#if MULTITHREADED
+        gInitMutex(&mutex);
+#endif
     }
 
+    ~page_renderer_private()
+    {
+#if defined(HAVE_SPLASH)
+        delete_all(contexts);
+#endif
+#if MULTITHREADED
+        gDestroyMutex(&mutex);
+#endif
+    }
+
+#if defined(HAVE_SPLASH)
+    render_context* context(size_t i)
+    {
+        while (contexts.size() <= i) {
+            contexts.push_back(new render_context());
+        }
+        return contexts[i];
+    }
+
+    void release_copies()
+    {
+        while (contexts.size() > 1) {
+            delete contexts.back();
+            contexts.pop_back();
+        }
+    }
+
+    bool render(const page *p, double xres, double yres,
+                int x, int y, int w, int h, rotation_enum rotate,
+                image &target, bool reuse_target);
+#endif
+
     argb paper_color;
     unsigned int hints;
+#if defined(HAVE_SPLASH)
+    // the first one renders from the documents themselves, the others from
+    // copies of them, for the duration of a render_pages() call
+    std::vector<render_context *> contexts;
+#endif
+#if MULTITHREADED
+    // held for the whole of each call, as the calls share the contexts
+    GooMutex mutex;
+#endif
+};
+
+#if defined(HAVE_SPLASH)
+/*
+ Renders the page p with the first context, into target if reuse_target is
+ true, or else into an image of the size of the previous page.
+ */
+bool page_renderer_private::render(const page *p, double xres, double yres,
+                                   int x, int y, int w, int h,
+                                   rotation_enum rotate,
+                                   image &target, bool reuse_target)
+{
+    page_private *pp = page_private::get(p);
+    render_context *ctx = context(0);
+    if (!ctx->prepare(pp->doc, false, hints)) {
+        return false;
+    }
+
+    if (!reuse_target) {
+        // most of the times the page has the size of the previous one, and
+        // then it is rendered directly in the new image
+        target = ctx->guess_image();
+    }
+    return ctx->render(pp->index, xres, yres, x, y, w, h, rotate,
+                       paper_color, hints, target);
+}
+#endif
+
+#if MULTITHREADED
+namespace
+{
+
+class renderer_locker
+{
+public:
+    renderer_locker(page_renderer_private *d)
+        : mutex(&d->mutex)
+    {
+        gLockMutex(mutex);
+    }
+
+    ~renderer_locker()
+    {
+        gUnlockMutex(mutex);
+    }
+
+private:
+    GooMutex *mutex;
 };
 
+}
+
+#define LOCK_RENDERER renderer_locker locker(d)
+#else
+#define LOCK_RENDERER
+#endif
+
 
 /**
  \class poppler::page_renderer poppler-page-renderer.h "poppler/cpp/poppler-renderer.h"
 
  Simple way to render a page of a PDF %document.
 
+ A page_renderer can be shared by several threads: its calls are serialized,
+ as they all use the same rendering state. To render the pages of a
+ %document on several threads, use render_pages(); to render different
+ documents at the same time, use one renderer for each of them. As with the
+ rest of the API, a %document must not be used from two threads at once, so
+ two renderers must not render pages of the same %document at the same time.
+
  \since 0.16
  */
 
@@ -85,6 +395,7 @@ page_renderer::~page_renderer()
  */
 argb page_renderer::paper_color() const
 {
+    LOCK_RENDERER;
     return d->paper_color;
 }
 
@@ -95,6 +406,7 @@ argb page_renderer::paper_color() const
  */
 void page_renderer::set_paper_color(argb c)
 {
+    LOCK_RENDERER;
     d->paper_color = c;
 }
 
@@ -107,6 +419,7 @@ void page_renderer::set_paper_color(argb c)
  */
 unsigned int page_renderer::render_hints() const
 {
+    LOCK_RENDERER;
     return d->hints;
 }
 
@@ -118,6 +431,7 @@ unsigned int page_renderer::render_hints() const
  */
 void page_renderer::set_render_hint(page_renderer::render_hint hint, bool on)
 {
+    LOCK_RENDERER;
     if (on) {
         d->hints |= hint;
     } else {
@@ -132,6 +446,7 @@ void page_renderer::set_render_hint(page_renderer::render_hint hint, bool on)
  */
 void page_renderer::set_render_hints(unsigned int hints)
 {
+    LOCK_RENDERER;
     d->hints = hints;
 }
 
@@ -141,6 +456,10 @@ void page_renderer::set_render_hints(unsigned int hints)
  This functions renders the specified page on an image following the specified
  parameters, returning it.
 
+ The renderer keeps its rendering state (fonts, glyph caches, the page
+ buffer) from one call to the next, so rendering several pages of the same
+ %document with the same hints is faster than using a new renderer for each.
+
  \param p the page to render
  \param xres the X resolution, in dot per inch (DPI)
  \param yres the Y resolution, in dot per inch (DPI)
@@ -164,34 +483,164 @@ image page_renderer::render_page(const page *p,
     }
 
 #if defined(HAVE_SPLASH)
-    page_private *pp = page_private::get(p);
-    PDFDoc *pdfdoc = pp->doc->doc;
+    LOCK_RENDERER;
+    image img;
+    if (!d->render(p, xres, yres, x, y, w, h, rotate, img, false)) {
+        return image();
+    }
+    return img;
+#else
+    return image();
+#endif
+}
 
-    SplashColor bgColor;
-    bgColor[0] = d->paper_color & 0xff;
-    bgColor[1] = (d->paper_color >> 8) & 0xff;
-    bgColor[2] = (d->paper_color >> 16) & 0xff;
-    const GBool text_AA = d->hints & text_antialiasing ? gTrue : gFalse;
-    SplashOutputDev splashOutputDev(splashModeXBGR8, 4, gFalse, bgColor, gTrue, text_AA);
-    splashOutputDev.setVectorAntialias(d->hints & antialiasing ? gTrue : gFalse);
-    splashOutputDev.setFreeTypeHinting(d->hints & text_hinting ? gTrue : gFalse, gFalse);
-    splashOutputDev.startDoc(pdfdoc->getXRef());
-    pdfdoc->displayPageSlice(&splashOutputDev, pp->index + 1,
-                             xres, yres, int(rotate) * 90,
-                             gFalse, gTrue, gFalse,
-                             x, y, w, h);
+/**
+ Render the specified page in the specified image.
 
-    SplashBitmap *bitmap = splashOutputDev.getBitmap();
-    const int bw = bitmap->getWidth();
-    const int bh = bitmap->getHeight();
+ This function is like render_page() above, but if \p target is a valid
+ image with format_argb32 format and the size of the rendered area, the page
+ is rendered directly in its data, with no copy; this way the same image can
+ be used for many pages, or the image can wrap memory provided by the caller.
+ Otherwise \p target is replaced by a new image.
 
-    SplashColorPtr data_ptr = bitmap->getDataPtr();
+ \param p the page to render
+ \param target the image to render into
+ \param xres the X resolution, in dot per inch (DPI)
+ \param yres the Y resolution, in dot per inch (DPI)
+ \param x the X top-right coordinate, in pixels
+ \param y the Y top-right coordinate, in pixels
+ \param w the width in pixels of the area to render
+ \param h the height in pixels of the area to render
+ \param rotate the rotation to apply when rendering the page
 
-    const image img(reinterpret_cast<char *>(data_ptr), bw, bh, image::format_argb32);
-    return img.copy();
+ \returns whether the page was rendered
+
+ \see can_render
+ \since 0.18
+ */
+bool page_renderer::render_page(const page *p, image &target,
+                                double xres, double yres,
+                                int x, int y, int w, int h,
+                                rotation_enum rotate) const
+{
+    if (!p) {
+        return false;
+    }
+
+#if defined(HAVE_SPLASH)
+    LOCK_RENDERER;
+    return d->render(p, xres, yres, x, y, w, h, rotate, target, true);
 #else
-    return image();
+    return false;
+#endif
+}
+
+/**
+ Render many pages at once.
+
+ The whole pages are rendered as by render_page(), using up to \p threads
+ threads; each additional thread renders from its own copy of the %document,
+ opened for this call and closed at its end. Pages of different documents
+ are rendered one after the other, on the calling thread.
+
+ \param pages the pages to render
+ \param xres the X resolution, in dot per inch (DPI)
+ \param yres the Y resolution, in dot per inch (DPI)
+ \param rotate the rotation to apply when rendering the pages
+ \param threads the number of threads to use; 0 uses one per processor
+
+ \returns the rendered images, in the same order as \p pages; the image for
+           a page that could not be rendered is a null one
+
+ \see can_render
+ \since 0.18
+ */
+std::vector<image> page_renderer::render_pages(const std::vector<page *> &pages,
+                                               double xres, double yres,
+                                               rotation_enum rotate,
+                                               int threads) const
+{
+    std::vector<image> images(pages.size());
+
+#if defined(HAVE_SPLASH)
+    LOCK_RENDERER;
+#if MULTITHREADED
+    document_private *docp = 0;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (!pages[i]) {
+            continue;
+        }
+        document_private *page_doc = page_private::get(pages[i])->doc;
+        if (!docp) {
+            docp = page_doc;
+        } else if (page_doc != docp) {
+            docp = 0;
+            break;
+        }
+    }
+
+    if (threads <= 0) {
+        threads = gGetNumCPUs();
+    }
+    if (size_t(threads) > pages.size()) {
+        threads = pages.size();
+    }
+
+    if (docp && threads > 1) {
+        render_batch batch;
+        batch.pages = &pages;
+        batch.images = &images;
+        batch.xres = xres;
+        batch.yres = yres;
+        batch.rotate = rotate;
+        batch.paper_color = d->paper_color;
+        batch.hints = d->hints;
+        batch.next_page = 0;
+        gInitMutex(&batch.mutex);
+
+        // set all the contexts up first, as opening the copies of the
+        // document is not thread safe
+        std::vector<render_worker> workers;
+        for (int i = 0; i < threads; ++i) {
+            render_context *ctx = d->context(i);
+            if (ctx->prepare(docp, i > 0, d->hints)) {
+                render_worker worker;
+                worker.batch = &batch;
+                worker.context = ctx;
+                workers.push_back(worker);
+            }
+        }
+
+        std::vector<GooThread> thread_ids(workers.size());
+        std::vector<bool> started(workers.size(), false);
+        for (size_t i = 1; i < workers.size(); ++i) {
+            started[i] = gCreateThread(&thread_ids[i], render_thread, &workers[i]);
+        }
+        if (!workers.empty()) {
+            run_render_worker(&workers[0]);
+        }
+        for (size_t i = 1; i < workers.size(); ++i) {
+            if (started[i]) {
+                gJoinThread(thread_ids[i]);
+            }
+        }
+        gDestroyMutex(&batch.mutex);
+        d->release_copies();
+        return images;
+    }
+#else
+    (void)threads;
 #endif
+
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (pages[i] && !d->render(pages[i], xres, yres, -1, -1, -1, -1,
+                                   rotate, images[i], false)) {
+            images[i] = image();
+        }
+    }
+#endif
+
+    return images;
 }
 
 /**
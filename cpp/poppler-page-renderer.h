@@ -22,6 +22,8 @@
 #include "poppler-global.h"
 #include "poppler-image.h"
 
+#include <vector>
+
 namespace poppler
 {
 
@@ -53,6 +55,14 @@ public:
                       double xres = 72.0, double yres = 72.0,
                       int x = -1, int y = -1, int w = -1, int h = -1,
                       rotation_enum rotate = rotate_0) const;
+    bool render_page(const page *p, image &target,
+                     double xres = 72.0, double yres = 72.0,
+                     int x = -1, int y = -1, int w = -1, int h = -1,
+                     rotation_enum rotate = rotate_0) const;
+    std::vector<image> render_pages(const std::vector<page *> &pages,
+                                    double xres = 72.0, double yres = 72.0,
+                                    rotation_enum rotate = rotate_0,
+                                    int threads = 0) const;
 
     static bool can_render();
 
@@ -24,6 +24,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <sstream>
 
 #include "parseargs.h"
 
@@ -31,12 +32,18 @@ bool show_help = false;
 bool show_formats = false;
 char out_filename[4096];
 int doc_page = 0;
+bool all_pages = false;
+int threads = 1;
 
 static const ArgDesc the_args[] = {
     { "-f",                    argFlag,  &show_formats,        0,
       "show supported output image formats" },
     { "--page",                argInt,   &doc_page,            0,
       "select page to render" },
+    { "--all-pages",           argFlag,  &all_pages,           0,
+      "render all the pages, as <output filename>-<page>.png" },
+    { "--threads",             argInt,   &threads,             0,
+      "number of threads used with --all-pages (0 = one per processor)" },
     { "-o",                    argString, &out_filename,       sizeof(out_filename),
       "output filename for the resulting PNG image" },
     { "-h",                    argFlag,  &show_help,           0,
@@ -88,6 +95,31 @@ int main(int argc, char *argv[])
         error("encrypted document");
     }
 
+    poppler::page_renderer pr;
+    pr.set_render_hint(poppler::page_renderer::antialiasing, true);
+    pr.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+
+    if (all_pages) {
+        std::vector<poppler::page *> pages;
+        for (int i = 0; i < doc->pages(); ++i) {
+            pages.push_back(doc->create_page(i));
+        }
+        const std::vector<poppler::image> images =
+            pr.render_pages(pages, 72.0, 72.0, poppler::rotate_0, threads);
+        for (size_t i = 0; i < pages.size(); ++i) {
+            delete pages[i];
+            std::ostringstream name;
+            name << out_filename << "-" << (i + 1) << ".png";
+            if (!images[i].is_valid()) {
+                error("rendering failed");
+            }
+            if (!images[i].save(name.str(), "png")) {
+                error("saving to file failed");
+            }
+        }
+        return 0;
+    }
+
     if (doc_page < 0 || doc_page >= doc->pages()) {
         error("specified page number out of page count");
     }
@@ -96,10 +128,6 @@ int main(int argc, char *argv[])
         error("NULL page");
     }
 
-    poppler::page_renderer pr;
-    pr.set_render_hint(poppler::page_renderer::antialiasing, true);
-    pr.set_render_hint(poppler::page_renderer::text_antialiasing, true);
-
     poppler::image img = pr.render_page(p.get());
     if (!img.is_valid()) {
         error("rendering failed");
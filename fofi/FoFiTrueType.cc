@@ -493,7 +493,8 @@ int FoFiTrueType::getEmbeddingRights() {
 void FoFiTrueType::convertToType42(char *psName, char **encoding,
 				   Gushort *codeToGID,
 				   FoFiOutputFunc outputFunc,
-				   void *outputStream) {
+				   void *outputStream,
+				   Guchar *usedGIDs) {
   GooString *buf;
   GBool ok;
 
@@ -524,7 +525,7 @@ void FoFiTrueType::convertToType42(char *psName, char **encoding,
   // write the guts of the dictionary
   cvtEncoding(encoding, outputFunc, outputStream);
   cvtCharStrings(encoding, codeToGID, outputFunc, outputStream);
-  cvtSfnts(outputFunc, outputStream, NULL, gFalse);
+  cvtSfnts(outputFunc, outputStream, NULL, gFalse, usedGIDs);
 
   // end the dictionary and define the font
   (*outputFunc)(outputStream, "FontName currentdict end definefont pop\n", 40);
@@ -555,7 +556,8 @@ void FoFiTrueType::convertToCIDType2(char *psName,
 				     Gushort *cidMap, int nCIDs,
 				     GBool needVerticalMetrics,
 				     FoFiOutputFunc outputFunc,
-				     void *outputStream) {
+				     void *outputStream,
+				     Guchar *usedGIDs) {
   GooString *buf;
   Gushort cid;
   GBool ok;
@@ -673,7 +675,7 @@ void FoFiTrueType::convertToCIDType2(char *psName,
   (*outputFunc)(outputStream, "  end readonly def\n", 19);
 
   // write the guts of the dictionary
-  cvtSfnts(outputFunc, outputStream, NULL, needVerticalMetrics);
+  cvtSfnts(outputFunc, outputStream, NULL, needVerticalMetrics, usedGIDs);
 
   // end the dictionary and define the font
   (*outputFunc)(outputStream,
@@ -705,7 +707,8 @@ void FoFiTrueType::convertToCIDType0(char *psName,
 void FoFiTrueType::convertToType0(char *psName, Gushort *cidMap, int nCIDs,
 				  GBool needVerticalMetrics,
 				  FoFiOutputFunc outputFunc,
-				  void *outputStream) {
+				  void *outputStream,
+				  Guchar *usedGIDs) {
   GooString *buf;
   GooString *sfntsName;
   int n, i, j;
@@ -716,7 +719,8 @@ void FoFiTrueType::convertToType0(char *psName, Gushort *cidMap, int nCIDs,
 
   // write the Type 42 sfnts array
   sfntsName = (new GooString(psName))->append("_sfnts");
-  cvtSfnts(outputFunc, outputStream, sfntsName, needVerticalMetrics);
+  cvtSfnts(outputFunc, outputStream, sfntsName, needVerticalMetrics,
+	   usedGIDs);
   delete sfntsName;
 
   // write the descendant Type 42 fonts
@@ -1504,7 +1508,7 @@ void FoFiTrueType::cvtCharStrings(char **encoding,
 
 void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc,
 			    void *outputStream, GooString *name,
-			    GBool needVerticalMetrics) {
+			    GBool needVerticalMetrics, Guchar *usedGIDs) {
   Guchar headData[54];
   TrueTypeLoca *locaTable;
   Guchar *locaData;
@@ -1576,6 +1580,9 @@ void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc,
   locaTable[nGlyphs].len = 0;
   qsort(locaTable, nGlyphs + 1, sizeof(TrueTypeLoca),
 	&cmpTrueTypeLocaIdx);
+  if (usedGIDs) {
+    subsetGlyphs(locaTable, usedGIDs);
+  }
   pos = 0;
   for (i = 0; i <= nGlyphs; ++i) {
     locaTable[i].newOffset = pos;
@@ -1796,6 +1803,69 @@ void FoFiTrueType::cvtSfnts(FoFiOutputFunc outputFunc,
   gfree(locaTable);
 }
 
+// Drop the outlines of the glyphs that are not marked in <usedGIDs>,
+// a bit array with GID n in bit (n & 7) of byte (n >> 3), by setting
+// their length to zero.  GID 0 (.notdef) and the components of the
+// composite glyphs that are kept are always kept.
+void FoFiTrueType::subsetGlyphs(TrueTypeLoca *locaTable, Guchar *usedGIDs) {
+  Guchar *keep;
+  int *stack;
+  GBool ok;
+  int glyfPos, nStack, gid, pos, end, flags, comp;
+
+  keep = (Guchar *)gmalloc(nGlyphs);
+  stack = (int *)gmallocn(nGlyphs, sizeof(int));
+  nStack = 0;
+  for (gid = 0; gid < nGlyphs; ++gid) {
+    keep[gid] = gid == 0 || (usedGIDs[gid >> 3] & (1 << (gid & 7)));
+    if (keep[gid]) {
+      stack[nStack++] = gid;
+    }
+  }
+
+  // add the components of composite glyphs (numberOfContours < 0)
+  glyfPos = tables[seekTable("glyf")].offset;
+  ok = gTrue;
+  while (nStack > 0) {
+    gid = stack[--nStack];
+    pos = glyfPos + locaTable[gid].origOffset;
+    end = pos + locaTable[gid].len;
+    if (locaTable[gid].len < 10 || !checkRegion(pos, locaTable[gid].len) ||
+	getS16BE(pos, &ok) >= 0) {
+      continue;
+    }
+    pos += 10;
+    do {
+      if (pos + 4 > end) {
+	break;
+      }
+      flags = getU16BE(pos, &ok);
+      comp = getU16BE(pos + 2, &ok);
+      if (comp < nGlyphs && !keep[comp]) {
+	keep[comp] = 1;
+	stack[nStack++] = comp;
+      }
+      // skip the arguments and the transform
+      pos += 4 + ((flags & 0x0001) ? 4 : 2);
+      if (flags & 0x0008) {
+	pos += 2;
+      } else if (flags & 0x0040) {
+	pos += 4;
+      } else if (flags & 0x0080) {
+	pos += 8;
+      }
+    } while (flags & 0x0020);
+  }
+
+  for (gid = 0; gid < nGlyphs; ++gid) {
+    if (!keep[gid]) {
+      locaTable[gid].len = 0;
+    }
+  }
+  gfree(stack);
+  gfree(keep);
+}
+
 void FoFiTrueType::dumpString(Guchar *s, int length,
 			      FoFiOutputFunc outputFunc,
 			      void *outputStream) {
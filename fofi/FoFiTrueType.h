@@ -35,6 +35,7 @@ class GooString;
 class GooHash;
 struct TrueTypeTable;
 struct TrueTypeCmap;
+struct TrueTypeLoca;
 
 //------------------------------------------------------------------------
 // FoFiTrueType
@@ -100,10 +101,13 @@ public:
   // <encoding> array specifies the mapping from char codes to names.
   // If <encoding> is NULL, the encoding is unknown or undefined.  The
   // <codeToGID> array specifies the mapping from char codes to GIDs.
-  // (Not useful for OpenType CFF fonts.)
+  // If <usedGIDs> is non-NULL, only the outlines of the glyphs it
+  // marks are written (see cvtSfnts).  (Not useful for OpenType CFF
+  // fonts.)
   void convertToType42(char *psName, char **encoding,
 		       Gushort *codeToGID,
-		       FoFiOutputFunc outputFunc, void *outputStream);
+		       FoFiOutputFunc outputFunc, void *outputStream,
+		       Guchar *usedGIDs = NULL);
 
   // Convert to a Type 1 font, suitable for embedding in a PostScript
   // file.  This is only useful with 8-bit fonts.  If <newEncoding> is
@@ -119,10 +123,12 @@ public:
   // PostScript file.  <psName> will be used as the PostScript font
   // name (so we don't need to depend on the 'name' table in the
   // font).  The <cidMap> array maps CIDs to GIDs; it has <nCIDs>
-  // entries.  (Not useful for OpenType CFF fonts.)
+  // entries.  <usedGIDs> is as for convertToType42.  (Not useful for
+  // OpenType CFF fonts.)
   void convertToCIDType2(char *psName, Gushort *cidMap, int nCIDs,
 			 GBool needVerticalMetrics,
-			 FoFiOutputFunc outputFunc, void *outputStream);
+			 FoFiOutputFunc outputFunc, void *outputStream,
+			 Guchar *usedGIDs = NULL);
 
   // Convert to a Type 0 CIDFont, suitable for embedding in a
   // PostScript file.  <psName> will be used as the PostScript font
@@ -134,10 +140,12 @@ public:
   // embedding in a PostScript file.  <psName> will be used as the
   // PostScript font name (so we don't need to depend on the 'name'
   // table in the font).  The <cidMap> array maps CIDs to GIDs; it has
-  // <nCIDs> entries.  (Not useful for OpenType CFF fonts.)
+  // <nCIDs> entries.  <usedGIDs> is as for convertToType42.  (Not
+  // useful for OpenType CFF fonts.)
   void convertToType0(char *psName, Gushort *cidMap, int nCIDs,
 		      GBool needVerticalMetrics,
-		      FoFiOutputFunc outputFunc, void *outputStream);
+		      FoFiOutputFunc outputFunc, void *outputStream,
+		      Guchar *usedGIDs = NULL);
 
   // Convert to a Type 0 (but non-CID) composite font, suitable for
   // embedding in a PostScript file.  <psName> will be used as the
@@ -167,7 +175,8 @@ private:
 		      void *outputStream);
   void cvtSfnts(FoFiOutputFunc outputFunc,
 		void *outputStream, GooString *name,
-		GBool needVerticalMetrics);
+		GBool needVerticalMetrics, Guchar *usedGIDs);
+  void subsetGlyphs(TrueTypeLoca *locaTable, Guchar *usedGIDs);
   void dumpString(Guchar *s, int length,
 		  FoFiOutputFunc outputFunc,
 		  void *outputStream);
@@ -474,7 +474,7 @@ find_annot_movie_for_action (PopplerDocument *document,
 
     annot = new AnnotMovie (xref, annotObj.getDict(), document->doc->getCatalog (), &tmp);
     if (!annot->isOk ()) {
-      delete annot;
+      annot->decRefCnt ();
       annot = NULL;
     }
   }
@@ -509,7 +509,7 @@ build_movie (PopplerDocument *document,
 	annot = find_annot_movie_for_action (document, link);
 	if (annot) {
 		action->movie.movie = _poppler_movie_new (annot->getMovie());
-		delete annot;
+		annot->decRefCnt ();
 	}
 }
 
@@ -118,7 +118,10 @@ poppler_annot_finalize (GObject *object)
 {
   PopplerAnnot *poppler_annot = POPPLER_ANNOT (object);
 
-  poppler_annot->annot = NULL;
+  if (poppler_annot->annot) {
+    poppler_annot->annot->decRefCnt ();
+    poppler_annot->annot = NULL;
+  }
 
   G_OBJECT_CLASS (poppler_annot_parent_class)->finalize (object);
 }
@@ -143,6 +146,7 @@ _poppler_annot_new (Annot *annot)
 
   poppler_annot = POPPLER_ANNOT (g_object_new (POPPLER_TYPE_ANNOT, NULL));
   poppler_annot->annot = annot;
+  annot->incRefCnt ();
 
   return poppler_annot;
 }
@@ -174,6 +178,7 @@ _poppler_annot_text_new (Annot *annot)
 
   poppler_annot = POPPLER_ANNOT (g_object_new (POPPLER_TYPE_ANNOT_TEXT, NULL));
   poppler_annot->annot = annot;
+  annot->incRefCnt ();
 
   return poppler_annot;
 }
@@ -196,12 +201,16 @@ poppler_annot_text_new (PopplerDocument  *doc,
 			PopplerRectangle *rect)
 {
   Annot *annot;
+  PopplerAnnot *poppler_annot;
   PDFRectangle pdf_rect(rect->x1, rect->y1,
 			rect->x2, rect->y2);
 
   annot = new AnnotText (doc->doc->getXRef(), &pdf_rect, doc->doc->getCatalog());
+  poppler_annot = _poppler_annot_text_new (annot);
+  // the PopplerAnnot holds the only reference now
+  annot->decRefCnt ();
 
-  return _poppler_annot_text_new (annot);
+  return poppler_annot;
 }
 
 static void
@@ -221,6 +230,7 @@ _poppler_annot_free_text_new (Annot *annot)
 
   poppler_annot = POPPLER_ANNOT (g_object_new (POPPLER_TYPE_ANNOT_FREE_TEXT, NULL));
   poppler_annot->annot = annot;
+  annot->incRefCnt ();
 
   return poppler_annot;
 }
@@ -242,6 +252,7 @@ _poppler_annot_file_attachment_new (Annot *annot)
 
   poppler_annot = POPPLER_ANNOT (g_object_new (POPPLER_TYPE_ANNOT_FILE_ATTACHMENT, NULL));
   poppler_annot->annot = annot;
+  annot->incRefCnt ();
 
   return poppler_annot;
 }
@@ -281,6 +292,7 @@ _poppler_annot_movie_new (Annot *annot)
 
   poppler_annot = POPPLER_ANNOT (g_object_new (POPPLER_TYPE_ANNOT_MOVIE, NULL));
   poppler_annot->annot = annot;
+  annot->incRefCnt ();
 
   annot_movie = static_cast<AnnotMovie *>(poppler_annot->annot);
   POPPLER_ANNOT_MOVIE (poppler_annot)->movie = _poppler_movie_new (annot_movie->getMovie());
@@ -323,6 +335,7 @@ _poppler_annot_screen_new (Annot *annot)
 
   poppler_annot = POPPLER_ANNOT (g_object_new (POPPLER_TYPE_ANNOT_SCREEN, NULL));
   poppler_annot->annot = annot;
+  annot->incRefCnt ();
 
   annot_screen = static_cast<AnnotScreen *>(poppler_annot->annot);
   action = annot_screen->getAction();
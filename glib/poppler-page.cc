@@ -76,11 +76,9 @@ poppler_page_finalize (GObject *object)
   g_object_unref (page->document);
   page->document = NULL;
 
-  if (page->annots != NULL)
-    delete page->annots;
   if (page->text != NULL) 
     page->text->decRefCnt();
-  /* page->page is owned by the document */
+  /* page->page is owned by the document, page->annots by page->page */
 }
 
 /**
@@ -0,0 +1,159 @@
+//========================================================================
+//
+// GooArena.cc
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "gmem.h"
+#include "GooArena.h"
+
+// all allocations are rounded up to a multiple of this
+#define gooArenaAlign 16
+
+static inline size_t gooArenaRound(size_t size) {
+  return (size + gooArenaAlign - 1) & ~(size_t)(gooArenaAlign - 1);
+}
+
+//------------------------------------------------------------------------
+// GooArena
+//------------------------------------------------------------------------
+
+GooArena::GooArena(int blockSizeA) {
+  blockSize = blockSizeA;
+  blocks = NULL;
+  cur = end = last = NULL;
+  bytesUsed = 0;
+}
+
+GooArena::~GooArena() {
+  Block *blk;
+
+  while (blocks) {
+    blk = blocks;
+    blocks = blocks->next;
+    gfree(blk);
+  }
+}
+
+void *GooArena::alloc(size_t size) {
+  void *p;
+
+  size = gooArenaRound(size ? size : 1);
+  if ((size_t)(end - cur) < size) {
+    return allocFromNewBlock(size);
+  }
+  p = last = cur;
+  cur += size;
+  bytesUsed += size;
+  return p;
+}
+
+void *GooArena::allocFromNewBlock(size_t size) {
+  Block *blk;
+  size_t blkSize;
+
+  // oversized requests get a block of their own, which is linked
+  // behind the current one so that it doesn't waste the current
+  // block's free space
+  blkSize = (size_t)blockSize;
+  if (size > blkSize / 4) {
+    blk = (Block *)gmalloc(gooArenaRound(sizeof(Block)) + size);
+    blk->size = size;
+    if (blocks) {
+      blk->next = blocks->next;
+      blocks->next = blk;
+    } else {
+      blk->next = NULL;
+      blocks = blk;
+    }
+    bytesUsed += size;
+    return (char *)blk + gooArenaRound(sizeof(Block));
+  }
+
+  blk = (Block *)gmalloc(gooArenaRound(sizeof(Block)) + blkSize);
+  blk->size = blkSize;
+  blk->next = blocks;
+  blocks = blk;
+  cur = (char *)blk + gooArenaRound(sizeof(Block));
+  end = cur + blkSize;
+  last = cur;
+  cur += size;
+  bytesUsed += size;
+  return last;
+}
+
+void *GooArena::allocn(int nObjs, int objSize) {
+  if (nObjs == 0) {
+    return NULL;
+  }
+  if (objSize <= 0 || nObjs < 0 || nObjs >= INT_MAX / objSize) {
+    fprintf(stderr, "Bogus memory allocation size\n");
+    exit(1);
+  }
+  return alloc((size_t)nObjs * objSize);
+}
+
+void *GooArena::reallocn(void *p, int oldNObjs, int nObjs, int objSize) {
+  size_t oldSize, newSize;
+  void *q;
+
+  if (!p) {
+    return allocn(nObjs, objSize);
+  }
+  if (nObjs <= oldNObjs) {
+    return p;
+  }
+  if (objSize <= 0 || nObjs >= INT_MAX / objSize) {
+    fprintf(stderr, "Bogus memory allocation size\n");
+    exit(1);
+  }
+  oldSize = gooArenaRound((size_t)oldNObjs * objSize);
+  newSize = gooArenaRound((size_t)nObjs * objSize);
+
+  // extend the most recent allocation in place
+  if ((char *)p == last && last + oldSize == cur &&
+      (size_t)(end - last) >= newSize) {
+    cur = last + newSize;
+    bytesUsed += newSize - oldSize;
+    return p;
+  }
+
+  q = alloc(newSize);
+  memcpy(q, p, (size_t)oldNObjs * objSize);
+  return q;
+}
+
+void GooArena::reset() {
+  Block *blk;
+
+  if (!blocks) {
+    return;
+  }
+
+  // keep the most recent standard-sized block, free everything else
+  while (blocks->next) {
+    blk = blocks->next;
+    blocks->next = blk->next;
+    gfree(blk);
+  }
+  if (blocks->size != (size_t)blockSize) {
+    gfree(blocks);
+    blocks = NULL;
+    cur = end = last = NULL;
+  } else {
+    cur = last = (char *)blocks + gooArenaRound(sizeof(Block));
+    end = cur + blockSize;
+  }
+  bytesUsed = 0;
+}
@@ -0,0 +1,84 @@
+//========================================================================
+//
+// GooArena.h
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#ifndef GOOARENA_H
+#define GOOARENA_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "gtypes.h"
+
+//------------------------------------------------------------------------
+// GooArena
+//
+// A simple bump allocator.  Memory is handed out from large blocks and
+// is never freed individually: all of it is released at once by
+// reset() or by the destructor.  Objects placed in an arena with
+// "new (arena) T(...)" must not be deleted; their destructors are not
+// run.
+//------------------------------------------------------------------------
+
+class GooArena {
+public:
+
+  // Create an empty arena which allocates blocks of at least
+  // <blockSizeA> bytes.
+  GooArena(int blockSizeA = 32768);
+
+  // Destructor - frees all blocks.
+  ~GooArena();
+
+  // Allocate <size> bytes, aligned for any basic type.
+  void *alloc(size_t size);
+
+  // Allocate <nObjs> * <objSize> bytes, with the same overflow check
+  // as gmallocn.
+  void *allocn(int nObjs, int objSize);
+
+  // Grow an allocation made by allocn from <oldNObjs> to <nObjs>
+  // objects, copying the old contents.  If <p> is the most recent
+  // allocation it is extended in place when possible.  <p> may be
+  // NULL.
+  void *reallocn(void *p, int oldNObjs, int nObjs, int objSize);
+
+  // Release everything allocated so far.  The first block is kept
+  // for reuse.
+  void reset();
+
+  // Number of bytes handed out since the last reset.
+  size_t getBytesUsed() { return bytesUsed; }
+
+private:
+
+  struct Block {
+    Block *next;
+    size_t size;
+  };
+
+  void *allocFromNewBlock(size_t size);
+
+  int blockSize;		// default block size
+  Block *blocks;		// list of blocks, most recent first
+  char *cur;			// next free byte in the current block
+  char *end;			// end of the current block
+  char *last;			// start of the most recent allocation
+  size_t bytesUsed;
+};
+
+inline void *operator new(size_t size, GooArena *arena) {
+  return arena->alloc(size);
+}
+
+// Only called if a constructor throws.
+inline void operator delete(void *, GooArena *) {
+}
+
+#endif
@@ -0,0 +1,72 @@
+//========================================================================
+//
+// GooThread.h
+//
+// Portable thread macros.
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#ifndef GOOTHREAD_H
+#define GOOTHREAD_H
+
+// Usage:
+//
+// static GOO_THREAD_FUNC(worker) {
+//   ... do something with <arg> ...
+//   GOO_THREAD_RETURN;
+// }
+// ...
+// GooThread t;
+// if (gCreateThread(&t, worker, arg)) {
+//   ...
+//   gJoinThread(t);
+// }
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef HANDLE GooThread;
+
+#define GOO_THREAD_FUNC(name) DWORD WINAPI name(LPVOID arg)
+#define GOO_THREAD_RETURN return 0
+
+#define gCreateThread(t, func, arg) \
+  ((*(t) = CreateThread(NULL, 0, func, arg, 0, NULL)) != NULL)
+#define gJoinThread(t) \
+  (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+
+static inline int gGetNumCPUs() {
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else // assume pthreads
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t GooThread;
+
+#define GOO_THREAD_FUNC(name) void *name(void *arg)
+#define GOO_THREAD_RETURN return NULL
+
+#define gCreateThread(t, func, arg) (pthread_create(t, NULL, func, arg) == 0)
+#define gJoinThread(t) pthread_join(t, NULL)
+
+static inline int gGetNumCPUs() {
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#else
+  return 1;
+#endif
+}
+
+#endif
+
+#endif
@@ -17,18 +17,272 @@
 
 #ifdef ENABLE_LIBPNG
 
+#include <string.h>
 #include <zlib.h>
 
+#include "goo/gmem.h"
 #include "poppler/Error.h"
+#if MULTITHREADED
+#include "goo/GooThread.h"
+#endif
+
+// the parallel encoder compresses blocks of rows of about this size
+#define pngBlockSize (128 * 1024)
+
+// each block is primed with this much of the preceding data
+#define pngDictSize 32768
+
+// max size of an IDAT chunk
+#define pngMaxChunkSize (1024 * 1024)
+
+//------------------------------------------------------------------------
+// parallel encoder
+//------------------------------------------------------------------------
+
+struct PNGBlock {
+	unsigned char **rows;		// all rows of the image
+	int rowBytes;
+	int firstRow, nRows;		// the rows in this block
+	int level;
+	bool last;			// last block of the image
+	unsigned char *out;		// [out] raw deflate data
+	int outLen;
+	uLong adler;			// [out] adler32 of the filtered rows
+	uLong inLen;			// [out] length of the filtered rows
+	bool ok;
+};
+
+struct PNGWorker {
+	PNGBlock *blocks;
+	int first, step, nBlocks;	// blocks first, first+step, ...
+};
+
+// Weight of a filtered byte for the filter selection heuristic, as
+// used by libpng: the distance of the (signed) value from zero.
+static inline int pngFilterCost(unsigned char v)
+{
+	return v < 128 ? v : 256 - v;
+}
+
+static inline unsigned char pngPaeth(int a, int b, int c)
+{
+	int p, pa, pb, pc;
+
+	p = a + b - c;
+	pa = p > a ? p - a : a - p;
+	pb = p > b ? p - b : b - p;
+	pc = p > c ? p - c : c - p;
+	if (pa <= pb && pa <= pc) {
+		return a;
+	}
+	return pb <= pc ? b : c;
+}
+
+// Filter <row> (RGB, 8 bits per component) with each of the five PNG
+// filters and write the one with the smallest cost to <out>, preceded
+// by the filter type.  <prev> is NULL for the first row.  <tmp> has
+// room for 2 rows.  Like libpng, a filter is abandoned as soon as its
+// cost exceeds that of the best one so far.
+static void pngFilterRow(unsigned char *prev, unsigned char *row,
+			 int rowBytes, unsigned char *out, unsigned char *tmp)
+{
+	unsigned char *best, *cur, *t;
+	int bestCost, cost, type, bestType, i;
+
+	// none
+	best = row;
+	bestType = 0;
+	bestCost = 0;
+	for (i = 0; i < rowBytes; ++i) {
+		bestCost += pngFilterCost(row[i]);
+	}
+
+	cur = tmp;
+	for (type = 1; type <= 4; ++type) {
+		if (!prev && (type == 2 || type == 4)) {
+			// without a previous row, up = none and paeth = sub
+			continue;
+		}
+		cost = 0;
+		switch (type) {
+		case 1:		// sub
+			for (i = 0; i < 3 && i < rowBytes; ++i) {
+				cur[i] = row[i];
+				cost += pngFilterCost(cur[i]);
+			}
+			for (; i < rowBytes && cost < bestCost; ++i) {
+				cur[i] = (unsigned char)(row[i] - row[i - 3]);
+				cost += pngFilterCost(cur[i]);
+			}
+			break;
+		case 2:		// up
+			for (i = 0; i < rowBytes && cost < bestCost; ++i) {
+				cur[i] = (unsigned char)(row[i] - prev[i]);
+				cost += pngFilterCost(cur[i]);
+			}
+			break;
+		case 3:		// average
+			for (i = 0; i < 3 && i < rowBytes; ++i) {
+				cur[i] = (unsigned char)(row[i] -
+							 ((prev ? prev[i] : 0) >> 1));
+				cost += pngFilterCost(cur[i]);
+			}
+			for (; i < rowBytes && cost < bestCost; ++i) {
+				cur[i] = (unsigned char)(row[i] -
+					   ((row[i - 3] + (prev ? prev[i] : 0)) >> 1));
+				cost += pngFilterCost(cur[i]);
+			}
+			break;
+		case 4:		// paeth
+			for (i = 0; i < 3 && i < rowBytes; ++i) {
+				cur[i] = (unsigned char)(row[i] - prev[i]);
+				cost += pngFilterCost(cur[i]);
+			}
+			for (; i < rowBytes && cost < bestCost; ++i) {
+				cur[i] = (unsigned char)(row[i] -
+					   pngPaeth(row[i - 3], prev[i], prev[i - 3]));
+				cost += pngFilterCost(cur[i]);
+			}
+			break;
+		}
+		if (i == rowBytes && cost < bestCost) {
+			bestCost = cost;
+			bestType = type;
+			t = best == row ? tmp + rowBytes : best;
+			best = cur;
+			cur = t;
+		}
+	}
+	out[0] = (unsigned char)bestType;
+	memcpy(out + 1, best, rowBytes);
+}
+
+// Filter rows [first, first + n) into <out>.
+static void pngFilterRows(unsigned char **rows, int rowBytes,
+			  int first, int n, unsigned char *out,
+			  unsigned char *tmp)
+{
+	int y;
+
+	for (y = first; y < first + n; ++y) {
+		pngFilterRow(y > 0 ? rows[y - 1] : (unsigned char *)NULL,
+			     rows[y], rowBytes, out, tmp);
+		out += rowBytes + 1;
+	}
+}
+
+static void pngCompressBlock(PNGBlock *blk)
+{
+	unsigned char *filtered, *dict, *tmp;
+	z_stream z;
+	int lineBytes, dictRows, dictLen, outSize, ret;
+
+	blk->ok = false;
+	blk->out = NULL;
+	blk->outLen = 0;
+	lineBytes = blk->rowBytes + 1;
+	tmp = (unsigned char *)gmallocn(2, blk->rowBytes);
+	filtered = (unsigned char *)gmallocn(blk->nRows, lineBytes);
+	pngFilterRows(blk->rows, blk->rowBytes, blk->firstRow, blk->nRows,
+		      filtered, tmp);
+	blk->inLen = (uLong)blk->nRows * lineBytes;
+	blk->adler = adler32(adler32(0L, Z_NULL, 0), filtered, blk->inLen);
+
+	memset(&z, 0, sizeof(z));
+	if (deflateInit2(&z, blk->level, Z_DEFLATED, -15, 8,
+			 Z_DEFAULT_STRATEGY) != Z_OK) {
+		gfree(filtered);
+		gfree(tmp);
+		return;
+	}
+
+	// prime the window with the end of the preceding rows, so that
+	// the block boundaries cost almost nothing
+	if (blk->firstRow > 0) {
+		dictRows = (pngDictSize + lineBytes - 1) / lineBytes;
+		if (dictRows > blk->firstRow) {
+			dictRows = blk->firstRow;
+		}
+		dict = (unsigned char *)gmallocn(dictRows, lineBytes);
+		pngFilterRows(blk->rows, blk->rowBytes,
+			      blk->firstRow - dictRows, dictRows, dict, tmp);
+		dictLen = dictRows * lineBytes;
+		if (dictLen > pngDictSize) {
+			deflateSetDictionary(&z, dict + dictLen - pngDictSize,
+					     pngDictSize);
+		} else {
+			deflateSetDictionary(&z, dict, dictLen);
+		}
+		gfree(dict);
+	}
+
+	// all but the last block end with a sync flush, which leaves the
+	// stream byte aligned, so that the blocks can be concatenated
+	outSize = (int)deflateBound(&z, blk->inLen) + 64;
+	blk->out = (unsigned char *)gmalloc(outSize);
+	z.next_in = filtered;
+	z.avail_in = blk->inLen;
+	while (1) {
+		z.next_out = blk->out + blk->outLen;
+		z.avail_out = outSize - blk->outLen;
+		ret = deflate(&z, blk->last ? Z_FINISH : Z_SYNC_FLUSH);
+		blk->outLen = outSize - z.avail_out;
+		if (ret == Z_STREAM_END ||
+		    (!blk->last && ret == Z_OK && z.avail_out > 0)) {
+			blk->ok = true;
+			break;
+		}
+		if (ret != Z_OK && ret != Z_BUF_ERROR) {
+			break;
+		}
+		outSize *= 2;
+		blk->out = (unsigned char *)grealloc(blk->out, outSize);
+	}
+	deflateEnd(&z);
+	gfree(filtered);
+	gfree(tmp);
+}
+
+static void pngRunWorker(PNGWorker *w)
+{
+	int i;
+
+	for (i = w->first; i < w->nBlocks; i += w->step) {
+		pngCompressBlock(&w->blocks[i]);
+	}
+}
+
+#if MULTITHREADED
+static GOO_THREAD_FUNC(pngWorkerThread)
+{
+	pngRunWorker((PNGWorker *)arg);
+	GOO_THREAD_RETURN;
+}
+#endif
+
+//------------------------------------------------------------------------
+// PNGWriter
+//------------------------------------------------------------------------
 
 PNGWriter::PNGWriter()
 {
+	png_ptr = NULL;
+	info_ptr = NULL;
+	level = Z_BEST_COMPRESSION;
+	nThreads = 1;
+	imgWidth = imgHeight = 0;
+	imgData = NULL;
+	imgRows = NULL;
+	nRows = 0;
+	dataWritten = false;
 }
 
 PNGWriter::~PNGWriter()
 {
 	/* cleanup heap allocation */
 	png_destroy_write_struct(&png_ptr, &info_ptr);
+	gfree(imgData);
+	gfree(imgRows);
 }
 
 bool PNGWriter::init(FILE *f, int width, int height, int hDPI, int vDPI)
@@ -46,20 +300,19 @@ bool PNGWriter::init(FILE *f, int width, int height, int hDPI, int vDPI)
 		return false;
 	}
 
+	// libpng reports errors by jumping back here, so the jump
+	// buffer is set up before each call that can fail, in the
+	// function making the call
 	if (setjmp(png_jmpbuf(png_ptr))) {
-		error(-1, "png_jmpbuf failed");
+		error(-1, "Error during writing header");
 		return false;
 	}
 
 	/* write header */
 	png_init_io(png_ptr, f);
-	if (setjmp(png_jmpbuf(png_ptr))) {
-		error(-1, "Error during writing header");
-		return false;
-	}
 	
 	// Set up the type of PNG image and the compression level
-	png_set_compression_level(png_ptr, Z_BEST_COMPRESSION);
+	png_set_compression_level(png_ptr, level);
 
 	png_byte bit_depth = 8;
 	png_byte color_type = PNG_COLOR_TYPE_RGB;
@@ -71,48 +324,217 @@ bool PNGWriter::init(FILE *f, int width, int height, int hDPI, int vDPI)
 	png_set_pHYs(png_ptr, info_ptr, hDPI, vDPI, PNG_RESOLUTION_UNKNOWN);
 
 	png_write_info(png_ptr, info_ptr);
-	if (setjmp(png_jmpbuf(png_ptr))) {
-		error(-1, "error during writing png info bytes");
-		return false;
-	}
+
+	imgWidth = width;
+	imgHeight = height;
+	nRows = 0;
+	dataWritten = false;
 	
 	return true;
 }
 
 bool PNGWriter::writePointers(unsigned char **rowPointers, int rowCount)
 {
-	png_write_image(png_ptr, rowPointers);
+	int y;
+
+	if (nThreads > 1) {
+		// the whole image at once: encode it in place
+		if (nRows == 0 && rowCount == imgHeight) {
+			nRows = imgHeight;
+			return writeImageData(rowPointers);
+		}
+		for (y = 0; y < rowCount; ++y) {
+			if (!writeRow(&rowPointers[y])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	/* write bytes */
 	if (setjmp(png_jmpbuf(png_ptr))) {
 		error(-1, "Error during writing bytes");
 		return false;
 	}
+	png_write_image(png_ptr, rowPointers);
 	
 	return true;
 }
 
 bool PNGWriter::writeRow(unsigned char **row)
 {
+	int y;
+
+	if (nThreads > 1) {
+		// buffer the rows until close()
+		if (nRows >= imgHeight) {
+			error(-1, "Too many rows for png image");
+			return false;
+		}
+		if (!imgData) {
+			imgData = (unsigned char *)gmallocn(imgHeight, 3 * imgWidth);
+			imgRows = (unsigned char **)gmallocn(imgHeight,
+							     sizeof(unsigned char *));
+			for (y = 0; y < imgHeight; ++y) {
+				imgRows[y] = imgData + y * 3 * imgWidth;
+			}
+		}
+		memcpy(imgRows[nRows], *row, 3 * imgWidth);
+		++nRows;
+		return true;
+	}
+
 	// Write the row to the file
-	png_write_rows(png_ptr, row, 1);
 	if (setjmp(png_jmpbuf(png_ptr))) {
 		error(-1, "error during png row write");
 		return false;
 	}
+	png_write_rows(png_ptr, row, 1);
 	
 	return true;
 }
 
 bool PNGWriter::close()
 {
+	if (nThreads > 1) {
+		if (!dataWritten) {
+			if (nRows < imgHeight) {
+				error(-1, "Missing rows in png image");
+				return false;
+			}
+			if (!writeImageData(imgRows)) {
+				return false;
+			}
+		}
+		if (setjmp(png_jmpbuf(png_ptr))) {
+			error(-1, "Error during end of write");
+			return false;
+		}
+		png_write_chunk(png_ptr, (png_bytep)"IEND", NULL, 0);
+		return true;
+	}
+
 	/* end write */
-	png_write_end(png_ptr, info_ptr);
 	if (setjmp(png_jmpbuf(png_ptr))) {
 		error(-1, "Error during end of write");
 		return false;
 	}
+	png_write_end(png_ptr, info_ptr);
 	
 	return true;
 }
 
+// Encode the whole image with the parallel encoder and write it as a
+// sequence of IDAT chunks.
+bool PNGWriter::writeImageData(unsigned char **rows)
+{
+	PNGBlock *blocks;
+	PNGWorker *workers;
+#if MULTITHREADED
+	GooThread *threads;
+	bool *started;
+#endif
+	unsigned char *data, *p;
+	uLong adler;
+	int rowBytes, blockRows, nBlocks, nWorkers, len, flags, n, i;
+	bool ok;
+
+	dataWritten = true;
+	rowBytes = 3 * imgWidth;
+	blockRows = pngBlockSize / (rowBytes + 1);
+	if (blockRows < 1) {
+		blockRows = 1;
+	}
+	nBlocks = (imgHeight + blockRows - 1) / blockRows;
+	blocks = (PNGBlock *)gmallocn(nBlocks, sizeof(PNGBlock));
+	for (i = 0; i < nBlocks; ++i) {
+		blocks[i].rows = rows;
+		blocks[i].rowBytes = rowBytes;
+		blocks[i].firstRow = i * blockRows;
+		blocks[i].nRows = i == nBlocks - 1 ? imgHeight - i * blockRows
+						   : blockRows;
+		blocks[i].level = level;
+		blocks[i].last = i == nBlocks - 1;
+	}
+
+	nWorkers = nThreads < nBlocks ? nThreads : nBlocks;
+	workers = (PNGWorker *)gmallocn(nWorkers, sizeof(PNGWorker));
+	for (i = 0; i < nWorkers; ++i) {
+		workers[i].blocks = blocks;
+		workers[i].first = i;
+		workers[i].step = nWorkers;
+		workers[i].nBlocks = nBlocks;
+	}
+#if MULTITHREADED
+	threads = (GooThread *)gmallocn(nWorkers, sizeof(GooThread));
+	started = (bool *)gmallocn(nWorkers, sizeof(bool));
+	for (i = 1; i < nWorkers; ++i) {
+		started[i] = gCreateThread(&threads[i], pngWorkerThread,
+					   &workers[i]);
+		if (!started[i]) {
+			pngRunWorker(&workers[i]);
+		}
+	}
+	pngRunWorker(&workers[0]);
+	for (i = 1; i < nWorkers; ++i) {
+		if (started[i]) {
+			gJoinThread(threads[i]);
+		}
+	}
+	gfree(threads);
+	gfree(started);
+#else
+	for (i = 0; i < nWorkers; ++i) {
+		pngRunWorker(&workers[i]);
+	}
+#endif
+	gfree(workers);
+
+	// zlib header + the blocks + adler32 trailer
+	ok = true;
+	len = 2 + 4;
+	adler = adler32(0L, Z_NULL, 0);
+	for (i = 0; i < nBlocks; ++i) {
+		ok = ok && blocks[i].ok;
+		len += blocks[i].outLen;
+		adler = adler32_combine(adler, blocks[i].adler, blocks[i].inLen);
+	}
+	if (!ok) {
+		error(-1, "Error during png compression");
+	} else {
+		data = p = (unsigned char *)gmalloc(len);
+		flags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+		*p++ = 0x78;
+		*p++ = (unsigned char)((flags << 6) +
+				       31 - ((0x78 * 256 + (flags << 6)) % 31));
+		for (i = 0; i < nBlocks; ++i) {
+			memcpy(p, blocks[i].out, blocks[i].outLen);
+			p += blocks[i].outLen;
+		}
+		*p++ = (unsigned char)(adler >> 24);
+		*p++ = (unsigned char)(adler >> 16);
+		*p++ = (unsigned char)(adler >> 8);
+		*p++ = (unsigned char)adler;
+
+		if (setjmp(png_jmpbuf(png_ptr))) {
+			error(-1, "Error during writing bytes");
+			ok = false;
+		} else {
+			for (i = 0; i < len; i += n) {
+				n = len - i < pngMaxChunkSize ? len - i
+							      : pngMaxChunkSize;
+				png_write_chunk(png_ptr, (png_bytep)"IDAT",
+						data + i, n);
+			}
+		}
+		gfree(data);
+	}
+
+	for (i = 0; i < nBlocks; ++i) {
+		gfree(blocks[i].out);
+	}
+	gfree(blocks);
+	return ok;
+}
+
 #endif
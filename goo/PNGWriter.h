@@ -28,6 +28,16 @@ class PNGWriter : public ImgWriter
 	public:
 		PNGWriter();
 		~PNGWriter();
+
+		// Set the zlib compression level, from 0 (fastest) to 9
+		// (smallest, the default).  Must be called before init().
+		void setCompressionLevel(int levelA) { level = levelA; }
+
+		// Compress with up to <nThreadsA> threads.  With more than
+		// one thread, the rows are filtered and deflated in
+		// independent blocks, which are concatenated into a single
+		// zlib stream at close().
+		void setNumThreads(int nThreadsA) { nThreads = nThreadsA; }
 		
 		bool init(FILE *f, int width, int height, int hDPI, int vDPI);
 		
@@ -37,8 +47,17 @@ class PNGWriter : public ImgWriter
 		bool close();
 	
 	private:
+		bool writeImageData(unsigned char **rows);
+
 		png_structp png_ptr;
 		png_infop info_ptr;
+		int level;
+		int nThreads;
+		int imgWidth, imgHeight;
+		unsigned char *imgData;		// rows buffered for the parallel encoder
+		unsigned char **imgRows;
+		int nRows;			// number of rows written so far
+		bool dataWritten;		// IDAT chunks have been written
 };
 
 #endif
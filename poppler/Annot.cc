@@ -60,6 +60,7 @@
 #include "FileSpec.h"
 #include "DateInfo.h"
 #include "Link.h"
+#include "RefHash.h"
 #include <string.h>
 
 #define fieldFlagReadOnly           0x00000001
@@ -870,6 +871,7 @@ Annot::Annot(XRef *xrefA, PDFRectangle *rectA, Catalog *catalog) {
   // obj1 is owned by the dict
 
   ref = xrefA->addIndirectObject (&annotObj);
+  hasRef = gTrue;
 
   initialize (xrefA, annotObj.getDict(), catalog);
 }
@@ -898,6 +900,10 @@ Annot::Annot(XRef *xrefA, Dict *dict, Catalog* catalog, Object *obj) {
 void Annot::initialize(XRef *xrefA, Dict *dict, Catalog *catalog) {
   Object asObj, obj1, obj2, obj3;
 
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   appRef.num = 0;
   appRef.gen = 65535;
   ok = gTrue;
@@ -1128,7 +1134,35 @@ void Annot::readArrayNum(Object *pdfArray, int key, double *value) {
   valueObject.free();
 }
 
+void Annot::incRefCnt() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void Annot::decRefCnt() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    delete this;
+  }
+}
+
 Annot::~Annot() {
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
   annotObj.free();
   
   delete rect;
@@ -2689,6 +2723,7 @@ AnnotWidget::AnnotWidget(XRef *xrefA, Dict *dict, Catalog *catalog, Object *obj)
     Annot(xrefA, dict, catalog, obj) {
   type = typeWidget;
   widget = NULL;
+  addDingbatsResource = gFalse;
   initialize(xrefA, catalog, dict);
 }
 
@@ -3606,6 +3641,7 @@ void AnnotWidget::generateFieldAppearance() {
     return;
   }
 
+  addDingbatsResource = gFalse;
   appearBuf = new GooString ();
   // get the appearance characteristics (MK) dictionary
   if (annot->lookup("MK", &mkObj)->isDict()) {
@@ -3999,6 +4035,10 @@ void AnnotWidget::generateFieldAppearance() {
   }
   ftObj.free();
   mkObj.free();
+
+  // the generated appearance is kept in the annot, so it doesn't need
+  // to be generated again until the widget is modified
+  regen = gFalse;
 }
 
 
@@ -4008,7 +4048,6 @@ void AnnotWidget::draw(Gfx *gfx, GBool printing) {
   if (!isVisible (printing))
     return;
 
-  addDingbatsResource = gFalse;
   generateFieldAppearance ();
 
   // draw the appearance stream
@@ -5241,6 +5280,7 @@ Annots::Annots(XRef *xref, Catalog *catalog, Object *annotsObj) {
   annots = NULL;
   size = 0;
   nAnnots = 0;
+  annotsByRef = new RefHash();
 
   if (annotsObj->isArray()) {
     for (i = 0; i < annotsObj->arrayGetLength(); ++i) {
@@ -5257,8 +5297,9 @@ Annots::Annots(XRef *xref, Catalog *catalog, Object *annotsObj) {
             annots = (Annot **)greallocn(annots, size, sizeof(Annot *));
           }
           annots[nAnnots++] = annot;
-        } else {
-          delete annot;
+          indexAnnot(annot);
+        } else if (annot) {
+          annot->decRefCnt();
         }
       }
       obj2.free();
@@ -5348,15 +5389,36 @@ Annot *Annots::createAnnot(XRef *xref, Dict* dict, Catalog *catalog, Object *obj
   return annot;
 }
 
-Annot *Annots::findAnnot(Ref *ref) {
+void Annots::appendAnnot(Annot *annot) {
+  if (annot && annot->isOk() && !contains(annot)) {
+    annot->incRefCnt();
+    annots = (Annot **)greallocn(annots, nAnnots + 1, sizeof(Annot *));
+    annots[nAnnots++] = annot;
+    indexAnnot(annot);
+  }
+}
+
+// Add <annot> to the Ref index.  If several annotations share a Ref,
+// the first one is kept, as a scan of the list would find it.
+void Annots::indexAnnot(Annot *annot) {
+  if (annot->getHasRef() && !annotsByRef->contains(annot->getRef())) {
+    annotsByRef->add(annot->getRef(), annot);
+  }
+}
+
+GBool Annots::contains(Annot *annot) {
   int i;
 
   for (i = 0; i < nAnnots; ++i) {
-    if (annots[i]->match(ref)) {
-      return annots[i];
+    if (annots[i] == annot) {
+      return gTrue;
     }
   }
-  return NULL;
+  return gFalse;
+}
+
+Annot *Annots::findAnnot(Ref *ref) {
+  return (Annot *)annotsByRef->lookup(*ref);
 }
 
 
@@ -5364,7 +5426,8 @@ Annots::~Annots() {
   int i;
 
   for (i = 0; i < nAnnots; ++i) {
-    delete annots[i];
+    annots[i]->decRefCnt();
   }
   gfree(annots);
+  delete annotsByRef;
 }
@@ -35,6 +35,12 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class XRef;
 class Gfx;
 class Catalog;
@@ -45,6 +51,7 @@ class Form;
 class FormWidget;
 class PDFRectangle;
 class Movie;
+class RefHash;
 class LinkAction;
 class OCGs;
 class Sound;
@@ -486,9 +493,13 @@ public:
   Annot(XRef *xrefA, PDFRectangle *rectA, Catalog *catalog);
   Annot(XRef *xrefA, Dict *dict, Catalog *catalog);
   Annot(XRef *xrefA, Dict *dict, Catalog *catalog, Object *obj);
-  virtual ~Annot();
   GBool isOk() { return ok; }
 
+  // Annots are reference counted: the creator holds the first
+  // reference, and an Annots list holds one for each annot in it.
+  void incRefCnt();
+  void decRefCnt();
+
   virtual void draw(Gfx *gfx, GBool printing);
   // Get appearance object.
   Object *getAppearance(Object *obj) { return appearance.fetch(xref, obj); }
@@ -514,6 +525,7 @@ public:
   // getters
   XRef *getXRef() const { return xref; }
   Ref getRef() const { return ref; }
+  GBool getHasRef() const { return hasRef; }
   AnnotSubtype getType() const { return type; }
   PDFRectangle *getRect() const { return rect; }
   GooString *getContents() const { return contents; }
@@ -550,6 +562,8 @@ protected:
   // and sets M to the current time
   void update(const char *key, Object *value);
 
+  virtual ~Annot();
+
   Object annotObj;
   
   // required data
@@ -580,6 +594,13 @@ protected:
   GBool ok;
 
   bool hasRef;
+
+private:
+
+  int refCnt;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
 };
 
 //------------------------------------------------------------------------
@@ -1268,13 +1289,19 @@ public:
   // Iterate through list of annotations.
   int getNumAnnots() { return nAnnots; }
   Annot *getAnnot(int i) { return annots[i]; }
+  // Add an annotation to the list, which takes a reference to it.
+  void appendAnnot(Annot *annot);
+  // Is <annot> in the list?
+  GBool contains(Annot *annot);
 
 private:
   Annot* createAnnot(XRef *xref, Dict* dict, Catalog *catalog, Object *obj);
+  void indexAnnot(Annot *annot);
   Annot *findAnnot(Ref *ref);
 
   Annot **annots;
   int nAnnots;
+  RefHash *annotsByRef;		// the annots that have a Ref, indexed by it
 };
 
 #endif
@@ -13,6 +13,21 @@
 #include <config.h>
 #include "CachedFile.h"
 
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#  include <sys/utime.h>
+#else
+#  include <utime.h>
+#endif
+#include <algorithm>
+
 //------------------------------------------------------------------------
 // CachedFile
 //------------------------------------------------------------------------
@@ -23,6 +38,8 @@ CachedFile::CachedFile(CachedFileLoader *cachedFileLoaderA, GooString *uriA)
   loader = cachedFileLoaderA;
 
   streamPos = 0;
+  readAhead = 0;
+  lastLoadEnd = 0;
   chunks = new std::vector<Chunk>();
   length = 0;
 
@@ -30,10 +47,21 @@ CachedFile::CachedFile(CachedFileLoader *cachedFileLoaderA, GooString *uriA)
   refCnt = 1;
 
   chunks->resize(length/CachedFileChunkSize + 1);
+
+  store = NULL;
+  GooString *dir, *validator;
+  if (globalParams && length > 0 && (dir = globalParams->getChunkCacheDir())) {
+    if ((validator = loader->getValidator())) {
+      store = CachedFileStore::open(dir, uri, validator, length,
+                                    globalParams->getChunkCacheSize());
+    }
+    delete dir;
+  }
 }
 
 CachedFile::~CachedFile()
 {
+  delete store;
   delete uri;
   delete loader;
   delete chunks;
@@ -102,7 +130,11 @@ int CachedFile::cache(const std::vector<ByteRange> &origRanges)
     endChunk = end / CachedFileChunkSize;
     for (int chunk = startChunk; chunk <= endChunk; chunk++) {
       if ((*chunks)[chunk].state == chunkStateNew) {
-           chunkNeeded[chunk] = true;
+        if (store && store->readChunk(chunk, (*chunks)[chunk].data)) {
+          (*chunks)[chunk].state = chunkStateLoaded;
+        } else {
+          chunkNeeded[chunk] = true;
+        }
       }
     }
   }
@@ -111,13 +143,21 @@ int CachedFile::cache(const std::vector<ByteRange> &origRanges)
   while (chunk < numChunks) {
     while (!chunkNeeded[chunk] && (++chunk != numChunks)) ;
     if (chunk == numChunks) break;
-    startChunk = chunk;
-    loadChunks.push_back(chunk);
-
-    while ((++chunk != numChunks) && chunkNeeded[chunk]) {
+    startChunk = endChunk = chunk;
+
+    // extend the run over the following missing chunks, and over short
+    // gaps of loaded ones: loading those again is cheaper than issuing
+    // another request
+    while (++chunk != numChunks) {
+      if (chunkNeeded[chunk]) {
+        endChunk = chunk;
+      } else if (chunk - endChunk > CachedFileMaxGapChunks) {
+        break;
+      }
+    }
+    for (chunk = startChunk; chunk <= endChunk; chunk++) {
       loadChunks.push_back(chunk);
     }
-    endChunk = chunk - 1;
 
     range.offset = startChunk * CachedFileChunkSize;
     range.length = (endChunk - startChunk + 1) * CachedFileChunkSize;
@@ -128,7 +168,28 @@ int CachedFile::cache(const std::vector<ByteRange> &origRanges)
   if (chunk_ranges.size() > 0) {
     CachedFileWriter writer =
         CachedFileWriter(this, &loadChunks);
-    return loader->load(chunk_ranges, &writer);
+    int ret = loader->load(chunk_ranges, &writer);
+
+    // a range that came back short left some of its chunks unloaded
+    for (size_t i = 0; ret == 0 && i < loadChunks.size(); i++) {
+      if (chunkNeeded[loadChunks[i]] &&
+          (*chunks)[loadChunks[i]].state != chunkStateLoaded) {
+        ret = -1;
+      }
+    }
+
+    if (store && ret == 0) {
+      int lastChunk = length / CachedFileChunkSize;
+      for (size_t i = 0; i < loadChunks.size(); i++) {
+        chunk = loadChunks[i];
+        if ((*chunks)[chunk].state == chunkStateLoaded) {
+          store->writeChunk(chunk, (*chunks)[chunk].data,
+                            chunk == lastChunk ? length % CachedFileChunkSize
+                                               : CachedFileChunkSize);
+        }
+      }
+    }
+    return ret;
   }
 
   return 0;
@@ -169,12 +230,352 @@ int CachedFile::cache(size_t offset, size_t length)
 {
   std::vector<ByteRange> r;
   ByteRange range;
+  size_t startChunk, endChunk, chunk;
+
+  startChunk = offset / CachedFileChunkSize;
+  endChunk = (offset + length - 1) / CachedFileChunkSize;
+  for (chunk = startChunk; chunk <= endChunk; chunk++) {
+    if ((*chunks)[chunk].state == chunkStateNew) break;
+  }
+  if (chunk > endChunk) return 0;
+
+  // the reader is going through the file sequentially: grow the
+  // read-ahead, so that it takes fewer and larger requests
+  if (chunk * CachedFileChunkSize == lastLoadEnd) {
+    readAhead = readAhead ? 2 * readAhead : CachedFileChunkSize;
+    if (readAhead > CachedFileMaxReadAhead) {
+      readAhead = CachedFileMaxReadAhead;
+    }
+  } else {
+    readAhead = 0;
+  }
+
   range.offset = offset;
-  range.length = length;
+  range.length = length + readAhead;
   r.push_back(range);
+  lastLoadEnd = ((offset + range.length - 1) / CachedFileChunkSize + 1) *
+                CachedFileChunkSize;
   return cache(r);
 }
 
+//------------------------------------------------------------------------
+// CachedFileStore
+//------------------------------------------------------------------------
+
+// The file starts with a header that identifies the document, followed
+// by one record per chunk: the chunk number and the data length, as
+// 32-bit big-endian values, then the data, then a 32-bit checksum of
+// all of these.
+
+static Guint storeHash(Guint h, const unsigned char *p, size_t n)
+{
+  for (size_t i = 0; i < n; ++i) {
+    h = (h ^ p[i]) * 16777619U;
+  }
+  return h;
+}
+
+CachedFileStore *CachedFileStore::open(GooString *dir, GooString *uri,
+                                       GooString *validator, size_t length,
+                                       size_t maxSize)
+{
+  CachedFileStore *store;
+  GooString *header, *path;
+  FILE *f;
+  GBool ok, complete;
+  Guint h;
+
+  // the file name is a hash of the URI
+  h = storeHash(2166136261U, (const unsigned char *)uri->getCString(),
+                uri->getLength());
+  GooString *name = GooString::format("{0:08x}.chunks", h);
+  path = appendToPath(dir->copy(), name->getCString());
+  delete name;
+
+  // mark the file as recently used, then make room in the directory
+  utime(path->getCString(), NULL);
+  trim(dir, maxSize, path);
+
+  header = GooString::format("%PopplerChunks 2\n{0:t}\n{1:t}\n{2:ud}\n",
+                             uri, validator, length);
+
+  // if the document changed, the file is new, or it ends with a broken
+  // record (e.g., from a crash), replace it with a fresh copy of its
+  // good part, then try again
+  store = NULL;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    if (!(f = fopen(path->getCString(), "a+b"))) {
+      break;
+    }
+    store = new CachedFileStore(f, length / CachedFileChunkSize + 1,
+                                dir, path, maxSize);
+    ok = store->readIndex(header, &complete);
+    if (ok && complete) {
+      break;
+    }
+    ok = attempt == 0 && replace(path, ok ? f : NULL, store->end, header);
+    delete store;
+    store = NULL;
+    if (!ok) {
+      break;
+    }
+  }
+
+  delete header;
+  delete path;
+  return store;
+}
+
+CachedFileStore::CachedFileStore(FILE *fA, int nChunks, GooString *dirA,
+                                 GooString *pathA, size_t maxSizeA)
+{
+  f = fA;
+  // records are written with a single unbuffered fwrite, so that
+  // appends from several processes don't interleave
+  setvbuf(f, NULL, _IONBF, 0);
+  dir = dirA->copy();
+  path = pathA->copy();
+  maxSize = maxSizeA;
+  end = 0;
+  unchecked = 0;
+  full = gFalse;
+  offsets.resize(nChunks, -1);
+  lengths.resize(nChunks, 0);
+}
+
+CachedFileStore::~CachedFileStore()
+{
+  fclose(f);
+  delete dir;
+  delete path;
+}
+
+// Index the chunks in the file.  Returns false if the header doesn't
+// match.  <complete> is set to false if the records end with a broken
+// one, which is left out, along with everything after it.
+GBool CachedFileStore::readIndex(GooString *header, GBool *complete)
+{
+  std::vector<unsigned char> rec(8 + CachedFileChunkSize + 4);
+  unsigned char *p;
+  size_t chunk, len, n;
+  Guint h;
+
+  // check that the file is for this version of the document
+  std::vector<char> buf(header->getLength());
+  if (fseek(f, 0, SEEK_SET) != 0 ||
+      fread(&buf[0], 1, buf.size(), f) != buf.size() ||
+      memcmp(&buf[0], header->getCString(), buf.size())) {
+    return gFalse;
+  }
+
+  end = header->getLength();
+  *complete = gFalse;
+  while (1) {
+    if ((n = fread(&rec[0], 1, 8, f)) != 8) {
+      *complete = n == 0 && feof(f);
+      break;
+    }
+    chunk = (rec[0] << 24) | (rec[1] << 16) | (rec[2] << 8) | rec[3];
+    len = (rec[4] << 24) | (rec[5] << 16) | (rec[6] << 8) | rec[7];
+    if (chunk >= offsets.size() || len == 0 || len > CachedFileChunkSize ||
+        fread(&rec[8], 1, len + 4, f) != len + 4) {
+      break;
+    }
+    p = &rec[8 + len];
+    h = storeHash(2166136261U, &rec[0], 8 + len);
+    if (h != (((Guint)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3])) {
+      break;
+    }
+    offsets[chunk] = end + 8;
+    lengths[chunk] = len;
+    end += 8 + len + 4;
+  }
+  return gTrue;
+}
+
+// Replace the file at <path> with one that holds the first <len> bytes
+// of <src>, or just <header> if <src> is NULL.  The new file is written
+// next to it and renamed over it, so that other processes see either
+// the old file or the complete new one.
+GBool CachedFileStore::replace(GooString *path, FILE *src, long len,
+                               GooString *header)
+{
+  GooString *tmpPath;
+  FILE *tmp;
+  char buf[CachedFileChunkSize];
+  size_t n;
+  GBool ok;
+
+#if HAVE_MKSTEMP
+  int fd;
+
+  tmpPath = path->copy()->append(".XXXXXX");
+  fd = mkstemp(tmpPath->getCString());
+  tmp = fd < 0 ? NULL : fdopen(fd, "wb");
+#else
+  tmpPath = path->copy()->append(".new");
+  tmp = fopen(tmpPath->getCString(), "wb");
+#endif
+  if (!tmp) {
+    delete tmpPath;
+    return gFalse;
+  }
+
+  if (src) {
+    ok = fseek(src, 0, SEEK_SET) == 0;
+    while (ok && len > 0) {
+      n = len < (long)sizeof(buf) ? len : sizeof(buf);
+      ok = fread(buf, 1, n, src) == n && fwrite(buf, 1, n, tmp) == n;
+      len -= n;
+    }
+  } else {
+    ok = fwrite(header->getCString(), 1, header->getLength(), tmp) ==
+         (size_t)header->getLength();
+  }
+  if (fclose(tmp) != 0) {
+    ok = gFalse;
+  }
+
+#ifdef _WIN32
+  // rename doesn't replace an existing file on Windows
+  if (ok) {
+    remove(path->getCString());
+  }
+#endif
+  if (!ok || rename(tmpPath->getCString(), path->getCString()) != 0) {
+    remove(tmpPath->getCString());
+    ok = gFalse;
+  }
+  delete tmpPath;
+  return ok;
+}
+
+GBool CachedFileStore::readChunk(int chunk, char *data)
+{
+  if (chunk < 0 || (size_t)chunk >= offsets.size() || offsets[chunk] < 0) {
+    return gFalse;
+  }
+  if (fseek(f, offsets[chunk], SEEK_SET) != 0 ||
+      fread(data, 1, lengths[chunk], f) != lengths[chunk]) {
+    offsets[chunk] = -1;
+    return gFalse;
+  }
+  return gTrue;
+}
+
+void CachedFileStore::writeChunk(int chunk, const char *data, size_t len)
+{
+  long pos;
+
+  if (full || chunk < 0 || (size_t)chunk >= offsets.size() ||
+      offsets[chunk] >= 0 || len == 0 || len > CachedFileChunkSize) {
+    return;
+  }
+
+  std::vector<unsigned char> rec(8 + len + 4);
+  rec[0] = (chunk >> 24) & 0xff;
+  rec[1] = (chunk >> 16) & 0xff;
+  rec[2] = (chunk >> 8) & 0xff;
+  rec[3] = chunk & 0xff;
+  rec[4] = (len >> 24) & 0xff;
+  rec[5] = (len >> 16) & 0xff;
+  rec[6] = (len >> 8) & 0xff;
+  rec[7] = len & 0xff;
+  memcpy(&rec[8], data, len);
+  Guint h = storeHash(2166136261U, &rec[0], 8 + len);
+  rec[8 + len] = (h >> 24) & 0xff;
+  rec[8 + len + 1] = (h >> 16) & 0xff;
+  rec[8 + len + 2] = (h >> 8) & 0xff;
+  rec[8 + len + 3] = h & 0xff;
+  if (fwrite(&rec[0], 1, rec.size(), f) == rec.size()) {
+    // the file is in append mode, so the record went to the end of the
+    // file, which may have been moved by other processes, and the file
+    // position is now just after it
+    if ((pos = ftell(f)) >= (long)rec.size()) {
+      offsets[chunk] = pos - (long)rec.size() + 8;
+      lengths[chunk] = len;
+    }
+
+    // keep the directory under its limit while the file grows, and
+    // stop growing it once it is over the limit on its own
+    unchecked += rec.size();
+    if (unchecked >= maxSize / 16) {
+      unchecked = 0;
+      if (trim(dir, maxSize, path) > maxSize) {
+        full = gTrue;
+      }
+    }
+  }
+}
+
+struct CachedFileStoreEntry {
+  GooString *path;
+  time_t modTime;
+  size_t size;
+};
+
+static bool cmpCachedFileStoreEntries(const CachedFileStoreEntry &e1,
+                                      const CachedFileStoreEntry &e2)
+{
+  return e1.modTime < e2.modTime;
+}
+
+// Returns true if <name> ends with <suffix>.
+static GBool hasSuffix(GooString *name, const char *suffix)
+{
+  int n = strlen(suffix);
+
+  return name->getLength() >= n &&
+         !strcmp(name->getCString() + name->getLength() - n, suffix);
+}
+
+// Remove the least recently used files in <dir>, other than <keep>,
+// until the total size is at most <maxSize>.  Returns the total size
+// left.  Temporary files left over by replace() are not counted, and
+// are removed once they are old enough that no process can still be
+// writing them.
+size_t CachedFileStore::trim(GooString *dir, size_t maxSize,
+                             GooString *keep)
+{
+  std::vector<CachedFileStoreEntry> entries;
+  CachedFileStoreEntry e;
+  GDirEntry *ent;
+  struct stat st;
+  size_t total;
+  GooString *name;
+  time_t now;
+
+  GDir gdir(dir->getCString(), gFalse);
+  total = 0;
+  now = time(NULL);
+  while ((ent = gdir.getNextEntry())) {
+    name = ent->getName();
+    if (stat(ent->getFullPath()->getCString(), &st) != 0) {
+      // removed by another process
+    } else if (hasSuffix(name, ".chunks")) {
+      e.path = ent->getFullPath()->copy();
+      e.modTime = st.st_mtime;
+      e.size = st.st_size;
+      entries.push_back(e);
+      total += e.size;
+    } else if (strstr(name->getCString(), ".chunks.") &&
+               now - st.st_mtime > CachedFileStoreTmpAge) {
+      remove(ent->getFullPath()->getCString());
+    }
+    delete ent;
+  }
+
+  std::sort(entries.begin(), entries.end(), cmpCachedFileStoreEntries);
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (total > maxSize && entries[i].path->cmp(keep) &&
+        remove(entries[i].path->getCString()) == 0) {
+      total -= entries[i].size;
+    }
+    delete entries[i].path;
+  }
+  return total;
+}
+
 //------------------------------------------------------------------------
 // CachedFileWriter
 //------------------------------------------------------------------------
@@ -206,9 +607,13 @@ size_t CachedFileWriter::write(const char *ptr, size_t size)
 
   while (len) {
     if (chunks) {
+      if (it == (*chunks).end()) return written;
       if (offset == CachedFileChunkSize) {
+         // don't run into the next range
+         if (it + 1 == (*chunks).end() || *(it + 1) != *it + 1) {
+           return written;
+         }
          it++;
-         if (it == (*chunks).end()) return written;
          offset = 0;
       }
       chunk = *it;
@@ -246,5 +651,16 @@ size_t CachedFileWriter::write(const char *ptr, size_t size)
   return written;
 }
 
+void CachedFileWriter::nextRange()
+{
+  if (!chunks || it == (*chunks).end()) return;
+
+  // skip the rest of the current run of chunks
+  do {
+    it++;
+  } while (it != (*chunks).end() && *it == *(it - 1) + 1);
+  offset = 0;
+}
+
 //------------------------------------------------------------------------
 
@@ -27,8 +27,21 @@
 
 #define CachedFileChunkSize 8192 // This should be a multiple of cachedStreamBufSize
 
+// Largest read-ahead added to the requests of a sequential reader.
+#define CachedFileMaxReadAhead (128 * CachedFileChunkSize)
+
+// Runs of missing chunks separated by at most this many loaded chunks
+// are fetched with a single request.
+#define CachedFileMaxGapChunks 2
+
+// Temporary files that another process is still writing may be in the
+// chunk cache directory; they are only removed once they are this many
+// seconds old.
+#define CachedFileStoreTmpAge (60 * 60)
+
 class GooString;
 class CachedFileLoader;
+class CachedFileStore;
 
 //------------------------------------------------------------------------
 // CachedFile
@@ -76,22 +89,80 @@ private:
 
   CachedFileLoader *loader;
   GooString *uri;
+  CachedFileStore *store;	// on-disk copy of the chunks, or NULL
 
   size_t length;
   size_t streamPos;
 
+  size_t readAhead;		// current read-ahead, in bytes
+  size_t lastLoadEnd;		// end of the last load done by read()
+
   std::vector<Chunk> *chunks;
 
   int refCnt;  // reference count
 
 };
 
+//------------------------------------------------------------------------
+// CachedFileStore
+//
+// CachedFileStore keeps the chunks of a CachedFile in a file on disk,
+// so that they outlive the process and are shared by every process
+// that reads the same document.  There is one file per URI in the
+// cache directory, and it is only reused while the loader's validator
+// (e.g., the ETag) and the document length stay the same.  Chunks are
+// appended to it as they are loaded, each with a checksum.  A file
+// that is out of date or ends with a broken record is replaced, never
+// rewritten in place.  When the directory grows over its size limit,
+// the least recently used files are removed.
+//------------------------------------------------------------------------
+
+class CachedFileStore {
+
+public:
+
+  // Open the store for <uri> in <dir>, creating or resetting it if
+  // needed.  Returns NULL if the file can't be opened.
+  static CachedFileStore *open(GooString *dir, GooString *uri,
+                               GooString *validator, size_t length,
+                               size_t maxSize);
+
+  ~CachedFileStore();
+
+  // Read a chunk into <data>.  Returns false if it isn't stored.
+  GBool readChunk(int chunk, char *data);
+
+  // Store <len> bytes of data for a chunk.
+  void writeChunk(int chunk, const char *data, size_t len);
+
+private:
+
+  CachedFileStore(FILE *fA, int nChunks, GooString *dirA, GooString *pathA,
+                  size_t maxSizeA);
+  GBool readIndex(GooString *header, GBool *complete);
+  static GBool replace(GooString *path, FILE *src, long len,
+                       GooString *header);
+  static size_t trim(GooString *dir, size_t maxSize, GooString *keep);
+
+  FILE *f;
+  GooString *dir;
+  GooString *path;
+  size_t maxSize;
+  long end;			// end of the last good record
+  size_t unchecked;		// bytes written since the last trim
+  GBool full;			// the file alone is over the size limit
+  std::vector<long> offsets;	// position of each chunk in f, or -1
+  std::vector<size_t> lengths;	// number of bytes stored for each chunk
+
+};
+
 //------------------------------------------------------------------------
 // CachedFileWriter
 //
 // CachedFileWriter handles sequential writes to a CachedFile.
 // On construction, you specify the CachedFile and the chunks of it to which data
-// should be written.
+// should be written.  Each run of consecutive chunks is one of the
+// ranges passed to the loader.
 //------------------------------------------------------------------------
 
 class CachedFileWriter {
@@ -105,8 +176,15 @@ public:
   ~CachedFileWriter();
 
   // Writes size bytes from ptr to cachedFile, returns number of bytes written.
+  // Data past the end of the current range is not written.
   size_t write(const char *ptr, size_t size);
 
+  // Start writing the next range of the request.  Loaders that pass
+  // several ranges to the writer must call this between them, so that
+  // a range that comes back short doesn't shift the following ones;
+  // the chunks it didn't fill are left unloaded.
+  void nextRange();
+
 private:
 
   CachedFile *cachedFile;
@@ -139,6 +217,11 @@ public:
   // The caller is responsible for deleting the writer.
   virtual int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) = 0;
 
+  // Returns a string that changes whenever the document does (e.g., an
+  // HTTP ETag), or NULL if there is none.  Chunks are only kept on
+  // disk for documents that have one.  Valid after init().
+  virtual GooString *getValidator() { return NULL; }
+
 };
 
 //------------------------------------------------------------------------
@@ -50,6 +50,27 @@
 #include "Catalog.h"
 #include "Form.h"
 #include "OptionalContent.h"
+#include "RefHash.h"
+
+//------------------------------------------------------------------------
+// PageTreeNode
+//------------------------------------------------------------------------
+
+// A Pages node on the path to the last page loaded by
+// Catalog::loadPage, with the page counts of all its kids, so that
+// nearby pages can be found again without re-reading the siblings.
+struct PageTreeNode {
+  PageTreeNode() { attrs = NULL; }
+  ~PageTreeNode() { delete attrs; }
+
+  int num;			// object number of the node
+  PageAttrs *attrs;		// attributes inherited by the kids
+  int first;			// number of pages before this node
+  int count;			// number of pages below this node
+  std::vector<Ref> kids;	// the kids
+  std::vector<int> kidCounts;	// number of pages below each kid, or
+				//   0 if the kid is a page itself
+};
 
 //------------------------------------------------------------------------
 // Catalog
@@ -64,6 +85,7 @@ Catalog::Catalog(XRef *xrefA) {
   xref = xrefA;
   pages = NULL;
   pageRefs = NULL;
+  pagesByRef = new RefHash();
   numPages = -1;
   pagesSize = 0;
   baseURI = NULL;
@@ -80,6 +102,9 @@ Catalog::Catalog(XRef *xrefA) {
   pagesRefList = NULL;
   attrsList = NULL;
   kidsIdxList = NULL;
+  pageTreePath = NULL;
+  pageCountsOk = gTrue;
+  stalePages = NULL;
   lastCachedPage = 0;
 
   xref->getCatalog(&catDict);
@@ -123,6 +148,13 @@ Catalog::Catalog(XRef *xrefA) {
 
 Catalog::~Catalog() {
   delete kidsIdxList;
+  if (pageTreePath) {
+    std::vector<PageTreeNode *>::iterator it;
+    for (it = pageTreePath->begin() ; it < pageTreePath->end(); it++ ) {
+      delete *it;
+    }
+    delete pageTreePath;
+  }
   if (attrsList) {
     std::vector<PageAttrs *>::iterator it;
     for (it = attrsList->begin() ; it < attrsList->end(); it++ ) {
@@ -149,6 +181,14 @@ Catalog::~Catalog() {
     gfree(pages);
     gfree(pageRefs);
   }
+  if (stalePages) {
+    std::vector<Page *>::iterator it;
+    for (it = stalePages->begin() ; it < stalePages->end(); it++ ) {
+      delete *it;
+    }
+    delete stalePages;
+  }
+  delete pagesByRef;
   names.free();
   dests.free();
   delete destNameTree;
@@ -203,8 +243,11 @@ Page *Catalog::getPage(int i)
 {
   if (i < 1) return NULL;
 
-  if (i > lastCachedPage) {
-     if (cachePageTree(i) == gFalse) return NULL;
+  if (i > lastCachedPage &&
+      !(pageCountsOk && pages && i <= pagesSize && pages[i-1])) {
+     // keep walking the tree for sequential access, jump otherwise
+     if ((i == lastCachedPage + 1 || !pageCountsOk || !loadPage(i)) &&
+         cachePageTree(i) == gFalse) return NULL;
   }
   return pages[i-1];
 }
@@ -213,12 +256,185 @@ Ref *Catalog::getPageRef(int i)
 {
   if (i < 1) return NULL;
 
-  if (i > lastCachedPage) {
-     if (cachePageTree(i) == gFalse) return NULL;
+  if (i > lastCachedPage &&
+      !(pageCountsOk && pages && i <= pagesSize && pages[i-1])) {
+     // keep walking the tree for sequential access, jump otherwise
+     if ((i == lastCachedPage + 1 || !pageCountsOk || !loadPage(i)) &&
+         cachePageTree(i) == gFalse) return NULL;
   }
   return &pageRefs[i-1];
 }
 
+GBool Catalog::allocPages()
+{
+  if (pages) return gTrue;
+
+  pagesSize = getNumPages();
+  if (pagesSize <= 0) return gFalse;
+  pages = (Page **)gmallocn(pagesSize, sizeof(Page *));
+  pageRefs = (Ref *)gmallocn(pagesSize, sizeof(Ref));
+  for (int i = 0; i < pagesSize; ++i) {
+    pages[i] = NULL;
+    pageRefs[i].num = -1;
+    pageRefs[i].gen = -1;
+  }
+  return gTrue;
+}
+
+// Read a Pages node and the page counts of its kids.  Returns NULL if
+// the node does not look sane enough for loadPage.
+PageTreeNode *Catalog::readPageTreeNode(Object *nodeRef, Object *node,
+					PageAttrs *parentAttrs, int first)
+{
+  PageTreeNode *tn;
+  Object kids, kidRef, kid, count;
+  int n, i;
+
+  if (!node->dictLookup("Kids", &kids)->isArray()) {
+    kids.free();
+    return NULL;
+  }
+  tn = new PageTreeNode();
+  tn->num = nodeRef->getRefNum();
+  tn->attrs = new PageAttrs(parentAttrs, node->getDict());
+  tn->first = first;
+  tn->count = 0;
+  for (i = 0; i < kids.arrayGetLength(); ++i) {
+    if (!kids.arrayGetNF(i, &kidRef)->isRef() ||
+        !kids.arrayGet(i, &kid)->isDict()) {
+      kidRef.free();
+      kid.free();
+      kids.free();
+      delete tn;
+      return NULL;
+    }
+    if (kid.isDict("Page") || !kid.getDict()->hasKey("Kids")) {
+      n = 0;
+    } else {
+      // some PDF files actually use real numbers here ("/Count 9.0")
+      if (!kid.dictLookup("Count", &count)->isNum() ||
+          count.getNum() < 0 || count.getNum() > pagesSize) {
+        count.free();
+        kidRef.free();
+        kid.free();
+        kids.free();
+        delete tn;
+        return NULL;
+      }
+      n = (int)count.getNum();
+      count.free();
+    }
+    tn->kids.push_back(kidRef.getRef());
+    tn->kidCounts.push_back(n);
+    tn->count += n ? n : 1;
+    kidRef.free();
+    kid.free();
+  }
+  kids.free();
+  return tn;
+}
+
+// Walk down the page tree to page number <page>, skipping whole
+// subtrees with the help of their /Count entries, so that only the
+// nodes on the path and their kids are read.  The path is kept for the
+// next call.  Returns false if the tree does not look sane enough for
+// that, in which case the caller falls back to cachePageTree.
+GBool Catalog::loadPage(int page)
+{
+  Object catDict, nodeRef, node, kid;
+  PageTreeNode *tn, *child;
+  Page *p;
+  Ref kidRef;
+  GBool loop;
+  int first, k;
+  size_t j;
+
+  if (!allocPages() || page > pagesSize) return gFalse;
+
+  if (!pageTreePath) {
+    pageTreePath = new std::vector<PageTreeNode *>();
+  }
+
+  // keep the part of the last path that leads to the page
+  while (!pageTreePath->empty() &&
+         (page <= pageTreePath->back()->first ||
+          page > pageTreePath->back()->first + pageTreePath->back()->count)) {
+    delete pageTreePath->back();
+    pageTreePath->pop_back();
+  }
+
+  if (pageTreePath->empty()) {
+    xref->getCatalog(&catDict);
+    catDict.dictLookupNF("Pages", &nodeRef);
+    catDict.dictLookup("Pages", &node);
+    catDict.free();
+    tn = NULL;
+    if (nodeRef.isRef() && node.isDict()) {
+      tn = readPageTreeNode(&nodeRef, &node, NULL, 0);
+    }
+    nodeRef.free();
+    node.free();
+    if (!tn) return gFalse;
+    pageTreePath->push_back(tn);
+    if (page > tn->count) return gFalse;
+  }
+
+  while (1) {
+    tn = pageTreePath->back();
+
+    // find the kid holding the page
+    first = tn->first;
+    for (k = 0; k < (int)tn->kids.size(); ++k) {
+      if (page <= first + (tn->kidCounts[k] ? tn->kidCounts[k] : 1)) {
+        break;
+      }
+      first += tn->kidCounts[k] ? tn->kidCounts[k] : 1;
+    }
+    if (k == (int)tn->kids.size()) return gFalse;
+    kidRef = tn->kids[k];
+
+    loop = gFalse;
+    for (j = 0; j < pageTreePath->size(); ++j) {
+      if ((*pageTreePath)[j]->num == kidRef.num) {
+        loop = gTrue;
+        break;
+      }
+    }
+    if (loop) {
+      error(-1, "Loop in Pages tree");
+      return gFalse;
+    }
+
+    if (!xref->fetch(kidRef.num, kidRef.gen, &kid)->isDict()) {
+      kid.free();
+      return gFalse;
+    }
+    if (!tn->kidCounts[k]) {
+      break;
+    }
+
+    // descend into the Pages node
+    nodeRef.initRef(kidRef.num, kidRef.gen);
+    child = readPageTreeNode(&nodeRef, &kid, tn->attrs, first);
+    nodeRef.free();
+    kid.free();
+    if (!child) return gFalse;
+    pageTreePath->push_back(child);
+  }
+
+  p = new Page(xref, page, kid.getDict(), kidRef,
+               new PageAttrs(tn->attrs, kid.getDict()), form);
+  kid.free();
+  if (!p->isOk()) {
+    delete p;
+    return gFalse;
+  }
+  pages[page-1] = p;
+  pageRefs[page-1] = kidRef;
+  indexPageRef(page);
+  return gTrue;
+}
+
 GBool Catalog::cachePageTree(int page)
 {
   Dict *pagesDict;
@@ -258,14 +474,7 @@ GBool Catalog::cachePageTree(int page)
       return gFalse;
     }
 
-    pagesSize = getNumPages();
-    pages = (Page **)gmallocn(pagesSize, sizeof(Page *));
-    pageRefs = (Ref *)gmallocn(pagesSize, sizeof(Ref));
-    for (int i = 0; i < pagesSize; ++i) {
-      pages[i] = NULL;
-      pageRefs[i].num = -1;
-      pageRefs[i].gen = -1;
-    }
+    allocPages();
 
     pagesList = new std::vector<Dict *>();
     pagesList->push_back(pagesDict);
@@ -338,7 +547,31 @@ GBool Catalog::cachePageTree(int page)
     Object kid;
     kids.arrayGet(kidsIdx, &kid);
     kids.free();
-    if (kid.isDict("Page") || (kid.isDict() && !kid.getDict()->hasKey("Kids"))) {
+    if ((kid.isDict("Page") || (kid.isDict() && !kid.getDict()->hasKey("Kids"))) &&
+        lastCachedPage < numPages && pages[lastCachedPage] &&
+        pageRefs[lastCachedPage].num == kidRef.getRefNum() &&
+        pageRefs[lastCachedPage].gen == kidRef.getRefGen()) {
+      // already loaded by loadPage
+      indexPageRef(lastCachedPage+1);
+      lastCachedPage++;
+      kidsIdxList->back()++;
+    } else if (kid.isDict("Page") || (kid.isDict() && !kid.getDict()->hasKey("Kids"))) {
+      if (lastCachedPage < numPages && pages[lastCachedPage]) {
+        // loadPage was misled by a wrong /Count entry: replace its page,
+        // and walk the tree for all the pages from now on
+        error(-1, "Page count in pages object is incorrect (page %d)",
+              lastCachedPage+1);
+        pageCountsOk = gFalse;
+        if (!stalePages) {
+          stalePages = new std::vector<Page *>();
+        }
+        stalePages->push_back(pages[lastCachedPage]);
+        pages[lastCachedPage] = NULL;
+        if (pagesByRef->lookupInt(pageRefs[lastCachedPage]) ==
+            lastCachedPage+1) {
+          pagesByRef->removeInt(pageRefs[lastCachedPage]);
+        }
+      }
       PageAttrs *attrs = new PageAttrs(attrsList->back(), kid.getDict());
       Page *p = new Page(xref, lastCachedPage+1, kid.getDict(),
                      kidRef.getRef(), attrs, form);
@@ -360,6 +593,7 @@ GBool Catalog::cachePageTree(int page)
       pages[lastCachedPage] = p;
       pageRefs[lastCachedPage].num = kidRef.getRefNum();
       pageRefs[lastCachedPage].gen = kidRef.getRefGen();
+      indexPageRef(lastCachedPage+1);
 
       lastCachedPage++;
       kidsIdxList->back()++;
@@ -385,9 +619,29 @@ GBool Catalog::cachePageTree(int page)
   return gFalse;
 }
 
+// Add the Ref of page number <page> to the index used by findPage.  If
+// the same object appears as more than one page, the lowest page
+// number is kept.
+void Catalog::indexPageRef(int page) {
+  int other;
+
+  other = pagesByRef->lookupInt(pageRefs[page-1]);
+  if (other == 0 || page < other) {
+    pagesByRef->replace(pageRefs[page-1], page);
+  }
+}
+
 int Catalog::findPage(int num, int gen) {
+  Ref ref0;
   int i;
 
+  // pages that have already been loaded are found through the index;
+  // otherwise, load pages until it turns up
+  ref0.num = num;
+  ref0.gen = gen;
+  if ((i = pagesByRef->lookupInt(ref0)) > 0) {
+    return i;
+  }
   for (i = 0; i < getNumPages(); ++i) {
     Ref *ref = getPageRef(i+1);
     if (ref != NULL && ref->num == num && ref->gen == gen)
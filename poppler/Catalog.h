@@ -42,8 +42,10 @@ class PageAttrs;
 struct Ref;
 class LinkDest;
 class PageLabelInfo;
+struct PageTreeNode;
 class Form;
 class OCGs;
+class RefHash;
 
 //------------------------------------------------------------------------
 // NameTree
@@ -234,11 +236,20 @@ private:
   XRef *xref;			// the xref table for this PDF file
   Page **pages;			// array of pages
   Ref *pageRefs;		// object ID for each page
+  RefHash *pagesByRef;		// page number for each loaded page's
+				//   object ID
   int lastCachedPage;
   std::vector<Dict *> *pagesList;
   std::vector<Ref> *pagesRefList;
   std::vector<PageAttrs *> *attrsList;
   std::vector<int> *kidsIdxList;
+  std::vector<PageTreeNode *> *pageTreePath; // path to the last page
+				//   loaded by loadPage
+  GBool pageCountsOk;		// false once a /Count entry turned out to
+				//   be wrong, which disables loadPage
+  std::vector<Page *> *stalePages; // pages loadPage got wrong, kept
+				//   until the catalog is deleted, since
+				//   callers may still point to them
   Form *form;
   int numPages;			// number of pages
   int pagesSize;		// size of pages array
@@ -258,7 +269,13 @@ private:
   PageMode pageMode;		// page mode
   PageLayout pageLayout;	// page layout
 
+  GBool allocPages();		// Allocate the pages/pageRefs arrays.
+  void indexPageRef(int page);	// Add a page to pagesByRef.
   GBool cachePageTree(int page); // Cache first <page> pages.
+  GBool loadPage(int page);	// Load a single page, using the
+				//   /Count entries to descend the tree.
+  PageTreeNode *readPageTreeNode(Object *nodeRef, Object *node,
+				 PageAttrs *parentAttrs, int first);
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
 
   Object *getNames();
@@ -18,15 +18,22 @@
 
 //------------------------------------------------------------------------
 
+// Max number of range requests in flight at once.
+#define curlMaxParallelRequests 4
+
+//------------------------------------------------------------------------
+
 CurlCachedFileLoader::CurlCachedFileLoader()
 {
   url = NULL;
+  validator = NULL;
   cachedFile = NULL;
   curl = NULL;
 }
 
 CurlCachedFileLoader::~CurlCachedFileLoader() {
   curl_easy_cleanup(curl);
+  delete validator;
 }
 
 static size_t
@@ -35,6 +42,31 @@ noop_cb(char *ptr, size_t size, size_t nmemb, void *ptr2)
   return size*nmemb;
 }
 
+// Keep the ETag of the document, or else its Last-Modified date.
+static size_t
+header_cb(char *ptr, size_t size, size_t nmemb, void *data)
+{
+  GooString **validator = (GooString **) data;
+  size_t len = size*nmemb;
+  GooString *s = new GooString(ptr, len);
+  GooString *name = s->copy()->lowerCase();
+
+  while (s->getLength() > 0 &&
+         (s->getChar(s->getLength() - 1) == '\r' ||
+          s->getChar(s->getLength() - 1) == '\n')) {
+    s->del(s->getLength() - 1);
+  }
+  if (!name->cmpN("etag:", 5) ||
+      (!*validator && !name->cmpN("last-modified:", 14))) {
+    delete *validator;
+    *validator = s;
+  } else {
+    delete s;
+  }
+  delete name;
+  return len;
+}
+
 size_t
 CurlCachedFileLoader::init(GooString *urlA, CachedFile *cachedFileA)
 {
@@ -50,6 +82,8 @@ CurlCachedFileLoader::init(GooString *urlA, CachedFile *cachedFileA)
   curl_easy_setopt(curl, CURLOPT_HEADER, 1);
   curl_easy_setopt(curl, CURLOPT_NOBODY, 1);
   curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &noop_cb);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &header_cb);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, &validator);
   curl_easy_perform(curl);
   curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
   curl_easy_getinfo(curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength);
@@ -67,14 +101,23 @@ size_t load_cb(const char *ptr, size_t size, size_t nmemb, void *data)
   return (writer->write) (ptr, size*nmemb);
 }
 
+static
+size_t buffer_cb(const char *ptr, size_t size, size_t nmemb, void *data)
+{
+  GooString *buf = (GooString *) data;
+  buf->append(ptr, size*nmemb);
+  return size*nmemb;
+}
+
 int CurlCachedFileLoader::load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer)
 {
   CURLcode r = CURLE_OK;
   size_t fromByte, toByte;
-  for (size_t i = 0; i < ranges.size(); i++) {
 
-     fromByte = ranges[i].offset;
-     toByte = fromByte + ranges[i].length - 1;
+  // a single range is streamed straight into the cache
+  if (ranges.size() == 1) {
+     fromByte = ranges[0].offset;
+     toByte = fromByte + ranges[0].length - 1;
      GooString *range = GooString::format("{0:ud}-{1:ud}", fromByte, toByte);
 
      curl_easy_setopt(curl, CURLOPT_URL, url->getCString());
@@ -85,9 +128,69 @@ int CurlCachedFileLoader::load(const std::vector<ByteRange> &ranges, CachedFileW
      curl_easy_reset(curl);
 
      delete range;
+     return r;
+  }
 
-     if (r != CURLE_OK) break;
+  // otherwise, the ranges are requested in parallel, a few at a time;
+  // they are buffered, since the writer needs them in order
+  CURLM *multi = curl_multi_init();
+  CURL *handles[curlMaxParallelRequests];
+  GooString *bufs[curlMaxParallelRequests];
+  for (size_t first = 0; first < ranges.size() && r == CURLE_OK;
+       first += curlMaxParallelRequests) {
+     size_t n = ranges.size() - first;
+     if (n > curlMaxParallelRequests) n = curlMaxParallelRequests;
+
+     for (size_t i = 0; i < n; i++) {
+        fromByte = ranges[first + i].offset;
+        toByte = fromByte + ranges[first + i].length - 1;
+        GooString *range = GooString::format("{0:ud}-{1:ud}", fromByte, toByte);
+
+        bufs[i] = new GooString();
+        handles[i] = curl_easy_init();
+        curl_easy_setopt(handles[i], CURLOPT_URL, url->getCString());
+        curl_easy_setopt(handles[i], CURLOPT_WRITEFUNCTION, buffer_cb);
+        curl_easy_setopt(handles[i], CURLOPT_WRITEDATA, bufs[i]);
+        curl_easy_setopt(handles[i], CURLOPT_RANGE, range->getCString());
+        curl_multi_add_handle(multi, handles[i]);
+
+        delete range;
+     }
+
+     int running = 0;
+     CURLMcode mr;
+     do {
+        mr = curl_multi_perform(multi, &running);
+        if (mr == CURLM_OK && running) {
+           mr = curl_multi_wait(multi, NULL, 0, 1000, NULL);
+        }
+     } while (mr == CURLM_OK && running);
+     if (mr != CURLM_OK) {
+        r = CURLE_RECV_ERROR;
+     }
+
+     CURLMsg *msg;
+     int msgsLeft;
+     while ((msg = curl_multi_info_read(multi, &msgsLeft))) {
+        if (msg->msg == CURLMSG_DONE && msg->data.result != CURLE_OK) {
+           r = msg->data.result;
+        }
+     }
+
+     for (size_t i = 0; i < n; i++) {
+        if (r == CURLE_OK) {
+           if (first + i > 0) {
+              writer->nextRange();
+           }
+           writer->write(bufs[i]->getCString(), bufs[i]->getLength());
+        }
+        curl_multi_remove_handle(multi, handles[i]);
+        curl_easy_cleanup(handles[i]);
+        delete bufs[i];
+     }
   }
+  curl_multi_cleanup(multi);
+
   return r;
 }
 
@@ -27,10 +27,12 @@ public:
   ~CurlCachedFileLoader();
   size_t init(GooString *url, CachedFile* cachedFile);
   int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer);
+  GooString *getValidator() { return validator; }
 
 private:
 
   GooString *url;
+  GooString *validator;		// ETag or Last-Modified header, or NULL
   CachedFile *cachedFile;
   CURL *curl;
 
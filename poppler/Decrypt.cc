@@ -34,10 +34,27 @@
 #include "Decrypt.h"
 #include "Error.h"
 
+// Use the AES-NI instructions when the compiler can generate them for
+// a single function and the CPU reports them at run time.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || \
+     (defined(__GNUC__) && \
+      (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define DECRYPT_USE_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
+// number of bytes decrypted per pass in DecryptStream::getChars
+#define decryptBulkSize 4096
+
 static void rc4InitKey(Guchar *key, int keyLen, Guchar *state);
 static Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c);
+static void rc4DecryptBuf(DecryptRC4State *s, Guchar *buf, int n);
 static void aesKeyExpansion(DecryptAESState *s,
 			    Guchar *objKey, int objKeyLen);
+static void aesDecryptBlocks(DecryptAESState *s, Guchar *in, Guchar *out,
+			     int nBlocks);
 static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last);
 
 static const Guchar passwordPad[32] = {
@@ -341,6 +358,110 @@ GBool DecryptStream::isBinary(GBool last) {
   return str->isBinary(last);
 }
 
+int DecryptStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  n = 0; // make gcc happy
+  switch (algo) {
+  case cryptRC4:
+    n = getCharsRC4(nChars, buffer);
+    break;
+  case cryptAES:
+    n = getCharsAES(nChars, buffer);
+    break;
+  }
+  charactersRead += n;
+  return n;
+}
+
+int DecryptStream::getCharsRC4(int nChars, Guchar *buffer) {
+  int n, m, chunk;
+
+  n = 0;
+  if (state.rc4.buf != EOF) {
+    buffer[n++] = (Guchar)state.rc4.buf;
+    state.rc4.buf = EOF;
+  }
+  while (n < nChars) {
+    chunk = nChars - n;
+    if (chunk > decryptBulkSize) {
+      chunk = decryptBulkSize;
+    }
+    if ((m = str->doGetChars(chunk, buffer + n)) <= 0) {
+      break;
+    }
+    rc4DecryptBuf(&state.rc4, buffer + n, m);
+    n += m;
+  }
+  return n;
+}
+
+int DecryptStream::getCharsAES(int nChars, Guchar *buffer) {
+  Guchar in[16];
+  int n, m, nBlocks, c, i;
+
+  n = 0;
+  while (n < nChars) {
+
+    // hand out what is left of the current block
+    if (state.aes.bufIdx < 16) {
+      m = 16 - state.aes.bufIdx;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, state.aes.buf + state.aes.bufIdx, m);
+      state.aes.bufIdx += m;
+      n += m;
+      continue;
+    }
+
+    // decrypt whole blocks in place in the caller's buffer; the last
+    // block of the stream carries the padding and goes through
+    // aesDecryptBlock, just like in getChar
+    nBlocks = (nChars - n) / 16;
+    if (nBlocks > decryptBulkSize / 16) {
+      nBlocks = decryptBulkSize / 16;
+    }
+    if (nBlocks > 0) {
+      m = str->doGetChars(nBlocks * 16, buffer + n);
+      if (m <= 0) {
+	break;
+      }
+      nBlocks = m / 16;
+      if (m % 16) {
+	// a trailing partial block is dropped
+	aesDecryptBlocks(&state.aes, buffer + n, buffer + n, nBlocks);
+	n += nBlocks * 16;
+	break;
+      }
+      if (str->lookChar() == EOF) {
+	--nBlocks;
+	memcpy(in, buffer + n + nBlocks * 16, 16);
+	aesDecryptBlocks(&state.aes, buffer + n, buffer + n, nBlocks);
+	n += nBlocks * 16;
+	aesDecryptBlock(&state.aes, in, gTrue);
+      } else {
+	aesDecryptBlocks(&state.aes, buffer + n, buffer + n, nBlocks);
+	n += nBlocks * 16;
+      }
+      continue;
+    }
+
+    // less than a block left to fill
+    for (i = 0; i < 16; ++i) {
+      if ((c = str->getChar()) == EOF) {
+	return n;
+      }
+      in[i] = (Guchar)c;
+    }
+    aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
+  }
+  return n;
+}
+
 //------------------------------------------------------------------------
 // RC4-compatible decryption
 //------------------------------------------------------------------------
@@ -378,6 +499,27 @@ static Guchar rc4DecryptByte(Guchar *state, Guchar *x, Guchar *y, Guchar c) {
   return c ^ state[(tx + ty) % 256];
 }
 
+static void rc4DecryptBuf(DecryptRC4State *s, Guchar *buf, int n) {
+  Guchar *state;
+  Guchar x, y, tx, ty;
+  int i;
+
+  state = s->state;
+  x = s->x;
+  y = s->y;
+  for (i = 0; i < n; ++i) {
+    x = (Guchar)(x + 1);
+    tx = state[x];
+    y = (Guchar)(y + tx);
+    ty = state[y];
+    state[x] = ty;
+    state[y] = tx;
+    buf[i] ^= state[(Guchar)(tx + ty)];
+  }
+  s->x = x;
+  s->y = y;
+}
+
 //------------------------------------------------------------------------
 // AES decryption
 //------------------------------------------------------------------------
@@ -445,37 +587,6 @@ static inline Guint rotWord(Guint x) {
   return ((x << 8) & 0xffffffff) | (x >> 24);
 }
 
-static inline void invSubBytes(Guchar *state) {
-  int i;
-
-  for (i = 0; i < 16; ++i) {
-    state[i] = invSbox[state[i]];
-  }
-}
-
-static inline void invShiftRows(Guchar *state) {
-  Guchar t;
-
-  t = state[7];
-  state[7] = state[6];
-  state[6] = state[5];
-  state[5] = state[4];
-  state[4] = t;
-
-  t = state[8];
-  state[8] = state[10];
-  state[10] = t;
-  t = state[9];
-  state[9] = state[11];
-  state[11] = t;
-
-  t = state[12];
-  state[12] = state[13];
-  state[13] = state[14];
-  state[14] = state[15];
-  state[15] = t;
-}
-
 // {09} \cdot s
 static inline Guchar mul09(Guchar s) {
   Guchar s2, s4, s8;
@@ -516,22 +627,6 @@ static inline Guchar mul0e(Guchar s) {
   return s2 ^ s4 ^ s8;
 }
 
-static inline void invMixColumns(Guchar *state) {
-  int c;
-  Guchar s0, s1, s2, s3;
-
-  for (c = 0; c < 4; ++c) {
-    s0 = state[c];
-    s1 = state[4+c];
-    s2 = state[8+c];
-    s3 = state[12+c];
-    state[c] =    mul0e(s0) ^ mul0b(s1) ^ mul0d(s2) ^ mul09(s3);
-    state[4+c] =  mul09(s0) ^ mul0e(s1) ^ mul0b(s2) ^ mul0d(s3);
-    state[8+c] =  mul0d(s0) ^ mul09(s1) ^ mul0e(s2) ^ mul0b(s3);
-    state[12+c] = mul0b(s0) ^ mul0d(s1) ^ mul09(s2) ^ mul0e(s3);
-  }
-}
-
 static inline void invMixColumnsW(Guint *w) {
   int c;
   Guchar s0, s1, s2, s3;
@@ -548,17 +643,6 @@ static inline void invMixColumnsW(Guint *w) {
   }
 }
 
-static inline void addRoundKey(Guchar *state, Guint *w) {
-  int c;
-
-  for (c = 0; c < 4; ++c) {
-    state[c] ^= w[c] >> 24;
-    state[4+c] ^= w[c] >> 16;
-    state[8+c] ^= w[c] >> 8;
-    state[12+c] ^= w[c];
-  }
-}
-
 static void aesKeyExpansion(DecryptAESState *s,
 			    Guchar *objKey, int /*objKeyLen*/) {
   Guint temp;
@@ -580,47 +664,205 @@ static void aesKeyExpansion(DecryptAESState *s,
   for (round = 1; round <= 9; ++round) {
     invMixColumnsW(&s->w[round * 4]);
   }
+  for (i = 0; i < 44; ++i) {
+    s->rk[4*i] = (Guchar)(s->w[i] >> 24);
+    s->rk[4*i+1] = (Guchar)(s->w[i] >> 16);
+    s->rk[4*i+2] = (Guchar)(s->w[i] >> 8);
+    s->rk[4*i+3] = (Guchar)s->w[i];
+  }
 }
 
-static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last) {
-  int c, round, n, i;
+// Decryption tables for the equivalent inverse cipher: aesTd0[x] is
+// InvMixColumns applied to a column holding invSbox[x] in row 0;
+// aesTd1-3 are the same for rows 1-3 (i.e., byte rotations of aesTd0).
+static Guint aesTd0[256], aesTd1[256], aesTd2[256], aesTd3[256];
+static GBool aesTdInitialized = gFalse;
+
+static void aesInitTables() {
+  Guint t;
+  Guchar is;
+  int x;
+
+  for (x = 0; x < 256; ++x) {
+    is = invSbox[x];
+    t = ((Guint)mul0e(is) << 24) | ((Guint)mul09(is) << 16)
+        | ((Guint)mul0d(is) << 8) | (Guint)mul0b(is);
+    aesTd0[x] = t;
+    aesTd1[x] = (t >> 8) | (t << 24);
+    aesTd2[x] = (t >> 16) | (t << 16);
+    aesTd3[x] = (t >> 24) | (t << 8);
+  }
+  aesTdInitialized = gTrue;
+}
 
-  // initial state
-  for (c = 0; c < 4; ++c) {
-    s->state[c] = in[4*c];
-    s->state[4+c] = in[4*c+1];
-    s->state[8+c] = in[4*c+2];
-    s->state[12+c] = in[4*c+3];
+static inline Guint aesGetWord(Guchar *p) {
+  return ((Guint)p[0] << 24) | ((Guint)p[1] << 16)
+         | ((Guint)p[2] << 8) | (Guint)p[3];
+}
+
+static inline void aesPutWord(Guchar *p, Guint w) {
+  p[0] = (Guchar)(w >> 24);
+  p[1] = (Guchar)(w >> 16);
+  p[2] = (Guchar)(w >> 8);
+  p[3] = (Guchar)w;
+}
+
+// Portable CBC decryption, one column per 32-bit word.  <in> and
+// <out> may point to the same buffer.
+static void aesDecryptBlocksTable(DecryptAESState *s, Guchar *in,
+				  Guchar *out, int nBlocks) {
+  Guchar ct[16];
+  Guint *w;
+  Guint s0, s1, s2, s3, t0, t1, t2, t3;
+  int blk, round, i;
+
+  if (!aesTdInitialized) {
+    aesInitTables();
   }
+  for (blk = 0; blk < nBlocks; ++blk, in += 16, out += 16) {
+    memcpy(ct, in, 16);
+
+    // round 0
+    w = &s->w[10 * 4];
+    s0 = aesGetWord(ct) ^ w[0];
+    s1 = aesGetWord(ct + 4) ^ w[1];
+    s2 = aesGetWord(ct + 8) ^ w[2];
+    s3 = aesGetWord(ct + 12) ^ w[3];
+
+    // rounds 1-9
+    for (round = 9; round >= 1; --round) {
+      w = &s->w[round * 4];
+      t0 = aesTd0[s0 >> 24] ^ aesTd1[(s3 >> 16) & 0xff]
+	   ^ aesTd2[(s2 >> 8) & 0xff] ^ aesTd3[s1 & 0xff] ^ w[0];
+      t1 = aesTd0[s1 >> 24] ^ aesTd1[(s0 >> 16) & 0xff]
+	   ^ aesTd2[(s3 >> 8) & 0xff] ^ aesTd3[s2 & 0xff] ^ w[1];
+      t2 = aesTd0[s2 >> 24] ^ aesTd1[(s1 >> 16) & 0xff]
+	   ^ aesTd2[(s0 >> 8) & 0xff] ^ aesTd3[s3 & 0xff] ^ w[2];
+      t3 = aesTd0[s3 >> 24] ^ aesTd1[(s2 >> 16) & 0xff]
+	   ^ aesTd2[(s1 >> 8) & 0xff] ^ aesTd3[s0 & 0xff] ^ w[3];
+      s0 = t0;
+      s1 = t1;
+      s2 = t2;
+      s3 = t3;
+    }
+
+    // round 10
+    w = &s->w[0];
+    t0 = (((Guint)invSbox[s0 >> 24] << 24)
+	  | ((Guint)invSbox[(s3 >> 16) & 0xff] << 16)
+	  | ((Guint)invSbox[(s2 >> 8) & 0xff] << 8)
+	  | (Guint)invSbox[s1 & 0xff]) ^ w[0];
+    t1 = (((Guint)invSbox[s1 >> 24] << 24)
+	  | ((Guint)invSbox[(s0 >> 16) & 0xff] << 16)
+	  | ((Guint)invSbox[(s3 >> 8) & 0xff] << 8)
+	  | (Guint)invSbox[s2 & 0xff]) ^ w[1];
+    t2 = (((Guint)invSbox[s2 >> 24] << 24)
+	  | ((Guint)invSbox[(s1 >> 16) & 0xff] << 16)
+	  | ((Guint)invSbox[(s0 >> 8) & 0xff] << 8)
+	  | (Guint)invSbox[s3 & 0xff]) ^ w[2];
+    t3 = (((Guint)invSbox[s3 >> 24] << 24)
+	  | ((Guint)invSbox[(s2 >> 16) & 0xff] << 16)
+	  | ((Guint)invSbox[(s1 >> 8) & 0xff] << 8)
+	  | (Guint)invSbox[s0 & 0xff]) ^ w[3];
+
+    // CBC
+    aesPutWord(out, t0);
+    aesPutWord(out + 4, t1);
+    aesPutWord(out + 8, t2);
+    aesPutWord(out + 12, t3);
+    for (i = 0; i < 16; ++i) {
+      out[i] ^= s->cbc[i];
+    }
+    memcpy(s->cbc, ct, 16);
+  }
+}
+
+#ifdef DECRYPT_USE_AESNI
 
-  // round 0
-  addRoundKey(s->state, &s->w[10 * 4]);
+static int aesniAvailable = -1;
 
-  // rounds 1-9
-  for (round = 9; round >= 1; --round) {
-    invSubBytes(s->state);
-    invShiftRows(s->state);
-    invMixColumns(s->state);
-    addRoundKey(s->state, &s->w[round * 4]);
+static GBool aesHasAESNI() {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (aesniAvailable < 0) {
+    aesniAvailable = __get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+                     (ecx & bit_AES) && (edx & bit_SSE2);
   }
+  return aesniAvailable;
+}
 
-  // round 10
-  invSubBytes(s->state);
-  invShiftRows(s->state);
-  addRoundKey(s->state, &s->w[0]);
+// CBC decryption with AES-NI.  The blocks are independent, so four of
+// them are kept in flight to hide the latency of aesdec.
+__attribute__((target("aes,sse2")))
+static void aesDecryptBlocksAESNI(DecryptAESState *s, Guchar *in,
+				  Guchar *out, int nBlocks) {
+  __m128i k[11], iv, c0, c1, c2, c3, b0, b1, b2, b3;
+  int round, i;
 
-  // CBC
-  for (c = 0; c < 4; ++c) {
-    s->buf[4*c] = s->state[c] ^ s->cbc[4*c];
-    s->buf[4*c+1] = s->state[4+c] ^ s->cbc[4*c+1];
-    s->buf[4*c+2] = s->state[8+c] ^ s->cbc[4*c+2];
-    s->buf[4*c+3] = s->state[12+c] ^ s->cbc[4*c+3];
+  for (i = 0; i < 11; ++i) {
+    k[i] = _mm_loadu_si128((const __m128i *)(s->rk + 16 * i));
   }
+  iv = _mm_loadu_si128((const __m128i *)s->cbc);
+  for (; nBlocks >= 4; nBlocks -= 4, in += 64, out += 64) {
+    c0 = _mm_loadu_si128((const __m128i *)in);
+    c1 = _mm_loadu_si128((const __m128i *)(in + 16));
+    c2 = _mm_loadu_si128((const __m128i *)(in + 32));
+    c3 = _mm_loadu_si128((const __m128i *)(in + 48));
+    b0 = _mm_xor_si128(c0, k[10]);
+    b1 = _mm_xor_si128(c1, k[10]);
+    b2 = _mm_xor_si128(c2, k[10]);
+    b3 = _mm_xor_si128(c3, k[10]);
+    for (round = 9; round >= 1; --round) {
+      b0 = _mm_aesdec_si128(b0, k[round]);
+      b1 = _mm_aesdec_si128(b1, k[round]);
+      b2 = _mm_aesdec_si128(b2, k[round]);
+      b3 = _mm_aesdec_si128(b3, k[round]);
+    }
+    b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[0]), iv);
+    b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[0]), c0);
+    b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[0]), c1);
+    b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[0]), c2);
+    _mm_storeu_si128((__m128i *)out, b0);
+    _mm_storeu_si128((__m128i *)(out + 16), b1);
+    _mm_storeu_si128((__m128i *)(out + 32), b2);
+    _mm_storeu_si128((__m128i *)(out + 48), b3);
+    iv = c3;
+  }
+  for (; nBlocks > 0; --nBlocks, in += 16, out += 16) {
+    c0 = _mm_loadu_si128((const __m128i *)in);
+    b0 = _mm_xor_si128(c0, k[10]);
+    for (round = 9; round >= 1; --round) {
+      b0 = _mm_aesdec_si128(b0, k[round]);
+    }
+    b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[0]), iv);
+    _mm_storeu_si128((__m128i *)out, b0);
+    iv = c0;
+  }
+  _mm_storeu_si128((__m128i *)s->cbc, iv);
+}
+
+#endif // DECRYPT_USE_AESNI
 
-  // save the input block for the next CBC
-  for (i = 0; i < 16; ++i) {
-    s->cbc[i] = in[i];
+// CBC-decrypt <nBlocks> 16-byte blocks from <in> to <out> (which may
+// be the same buffer), updating the chaining value in <s>.
+static void aesDecryptBlocks(DecryptAESState *s, Guchar *in, Guchar *out,
+			     int nBlocks) {
+  if (nBlocks <= 0) {
+    return;
+  }
+#ifdef DECRYPT_USE_AESNI
+  if (aesHasAESNI()) {
+    aesDecryptBlocksAESNI(s, in, out, nBlocks);
+    return;
   }
+#endif
+  aesDecryptBlocksTable(s, in, out, nBlocks);
+}
+
+static void aesDecryptBlock(DecryptAESState *s, Guchar *in, GBool last) {
+  int n, i;
+
+  aesDecryptBlocks(s, in, s->buf, 1);
 
   // remove padding
   s->bufIdx = 0;
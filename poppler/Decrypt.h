@@ -74,7 +74,7 @@ struct DecryptRC4State {
 
 struct DecryptAESState {
   Guint w[44];
-  Guchar state[16];
+  Guchar rk[176];		// round keys as bytes, for the AES-NI path
   Guchar cbc[16];
   Guchar buf[16];
   int bufIdx;
@@ -94,9 +94,14 @@ public:
   virtual int getPos();
   virtual GBool isBinary(GBool last);
   virtual Stream *getUndecodedStream() { return this; }
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
 
 private:
 
+  int getCharsRC4(int nChars, Guchar *buffer);
+  int getCharsAES(int nChars, Guchar *buffer);
+
   CryptAlgorithm algo;
   int objKeyLength;
   Guchar objKey[16 + 9];
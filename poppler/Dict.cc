@@ -83,7 +83,7 @@ Dict::Dict(Dict* dictA) {
   sorted = dictA->sorted;
   entries = (DictEntry *)gmallocn(size, sizeof(DictEntry));
   for (int i=0; i<length; i++) {
-    entries[i].key = strdup(dictA->entries[i].key);
+    entries[i].key = NameTable::copyName(dictA->entries[i].key);
     dictA->entries[i].val.copy(&entries[i].val);
   }
 }
@@ -92,7 +92,7 @@ Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
+    NameTable::freeName(entries[i].key);
     entries[i].val.free();
   }
   gfree(entries);
@@ -134,7 +134,7 @@ inline DictEntry *Dict::find(char *key) {
     int i;
 
     for (i = length - 1; i >=0; --i) {
-      if (!strcmp(key, entries[i].key))
+      if (key == entries[i].key || !strcmp(key, entries[i].key))
         return &entries[i];
     }
   }
@@ -182,7 +182,7 @@ void Dict::set(char *key, Object *val) {
     e->val.free();
     e->val = *val;
   } else {
-    add (copyString(key), val);
+    add (NameTable::copyName(key), val);
   }
 }
 
@@ -18,6 +18,7 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns, int colors, i
     pred = NULL;
   }
   out_pos = 0;
+  in_size = str->getBaseStream()->allowsReadAhead() ? sizeof(in_buf) : 1;
   memset(&d_stream, 0, sizeof(d_stream));
   inflateInit(&d_stream);
 }
@@ -48,9 +49,19 @@ int FlateStream::getRawChar() {
   return doGetRawChar();
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars && !fill_buffer()) {
+    m = out_buf_len - out_pos;
+    if (m > nChars - n)
+      m = nChars - n;
+    memcpy(buffer + n, out_buf + out_pos, m);
+    out_pos += m;
+    n += m;
+  }
+  return n;
 }
 
 int FlateStream::getChar() {
@@ -60,6 +71,13 @@ int FlateStream::getChar() {
     return getRawChar();
 }
 
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  if (pred)
+    return pred->getChars(nChars, buffer);
+  else
+    return getRawChars(nChars, buffer);
+}
+
 int FlateStream::lookChar() {
   if (pred)
     return pred->lookChar();
@@ -86,11 +104,8 @@ int FlateStream::fill_buffer() {
     while (1) {
       /* buffer is empty so we need to fill it */
       if (d_stream.avail_in == 0) {
-	int c;
 	/* read from the source stream */
-	while (d_stream.avail_in < sizeof(in_buf) && (c = str->getChar()) != EOF) {
-	  in_buf[d_stream.avail_in++] = c;
-	}
+	d_stream.avail_in = str->doGetChars(in_size, in_buf);
 	d_stream.next_in = in_buf;
       }
 
@@ -113,13 +128,18 @@ int FlateStream::fill_buffer() {
 GooString *FlateStream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
-  if (psLevel < 3 || pred) {
+  if (psLevel < 3) {
     return NULL;
   }
   if (!(s = str->getPSFilter(psLevel, indent))) {
     return NULL;
   }
-  s->append(indent)->append("<< >> /FlateDecode filter\n");
+  s->append(indent)->append("<< ");
+  if (pred && !pred->appendPSParams(s)) {
+    delete s;
+    return NULL;
+  }
+  s->append(">> /FlateDecode filter\n");
   return s;
 }
 
@@ -52,10 +52,13 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
+  // Get the predictor, or NULL if there is none.
+  StreamPredictor *getStreamPredictor() { return pred; }
+
 private:
   inline int doGetRawChar() {
     if (fill_buffer())
@@ -64,13 +67,18 @@ private:
     return out_buf[out_pos++];
   }
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   int fill_buffer(void);
   z_stream d_stream;
   StreamPredictor *pred;
   int status;
-  /* in_buf currently needs to be 1 or we over read from EmbedStreams */
-  unsigned char in_buf[1];
-  unsigned char out_buf[4096];
+  /* only in_buf[0] is used when reading from an EmbedStream, as
+     we must not over read inline image data */
+  unsigned char in_buf[4096];
+  int in_size;
+  unsigned char out_buf[16384];
   int out_pos;
   int out_buf_len;
 };
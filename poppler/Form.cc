@@ -37,6 +37,7 @@
 #include "PDFDocEncoding.h"
 #include "Annot.h"
 #include "Catalog.h"
+#include "RefHash.h"
 
 //return a newly allocated char* containing an UTF16BE string of size length
 char* pdfDocEncodingToUTF16 (GooString* orig, int* length)
@@ -933,6 +934,20 @@ FormWidget* FormField::findWidgetByRef (Ref aref)
   return NULL;
 }
 
+void FormField::indexWidgets (RefHash *index)
+{
+  if (terminal) {
+    for(int i=0; i<numChildren; i++) {
+      if (!index->contains(widgets[i]->getRef()))
+        index->add(widgets[i]->getRef(), widgets[i]);
+    }
+  } else {
+    for(int i=0; i<numChildren; i++) {
+      children[i]->indexWidgets(index);
+    }
+  }
+}
+
 
 //------------------------------------------------------------------------
 // FormFieldButton
@@ -1206,6 +1221,7 @@ Form::Form(XRef *xrefA, Object* acroFormA)
   size = 0;
   numFields = 0;
   rootFields = NULL;
+  widgetsByRef = NULL;
 
   acroForm->dictLookup("NeedAppearances", &obj1);
   needAppearances = (obj1.isBool() && obj1.getBool());
@@ -1256,6 +1272,7 @@ Form::~Form() {
   for(i = 0; i< numFields; ++i)
     delete rootFields[i];
   gfree (rootFields);
+  delete widgetsByRef;
 }
 
 // Look up an inheritable field dictionary entry.
@@ -1329,11 +1346,15 @@ void Form::postWidgetsLoad ()
 
 FormWidget* Form::findWidgetByRef (Ref aref)
 {
-  for(int i=0; i<numFields; i++) {
-    FormWidget *result = rootFields[i]->findWidgetByRef(aref);
-    if(result) return result;
+  // the fields don't change once the form is loaded, so index all the
+  // widgets at once instead of walking the field tree for each lookup
+  if (!widgetsByRef) {
+    widgetsByRef = new RefHash();
+    for(int i=0; i<numFields; i++) {
+      rootFields[i]->indexWidgets(widgetsByRef);
+    }
   }
-  return NULL;
+  return (FormWidget *)widgetsByRef->lookup(aref);
 }
 
 //------------------------------------------------------------------------
@@ -1376,7 +1397,7 @@ FormPageWidgets::FormPageWidgets (XRef *xrefA, Object* annots, unsigned int page
 	  
           ann = new Annot(xref, obj2.getDict(), NULL);
           tmp->setFontSize(ann->getFontSize());
-          delete ann;
+          ann->decRefCnt();
         }
         obj2.free();
       } 
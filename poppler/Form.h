@@ -27,6 +27,7 @@ class Array;
 class Dict;
 class Annot;
 class Catalog;
+class RefHash;
 
 enum FormFieldType {
   formButton,
@@ -271,6 +272,9 @@ public:
   bool isReadOnly () const { return readOnly; }
 
   FormWidget* findWidgetByRef (Ref aref);
+  // Add the widgets of this field and its descendants to <index>,
+  // keeping the first widget found for each Ref.
+  void indexWidgets (RefHash *index);
   // Since while loading their defaults, children may call parents methods, it's better
   // to do that when parents are completly constructed
   void loadChildrenDefaults();
@@ -461,6 +465,8 @@ private:
   FormField** rootFields;
   int numFields;
   int size;
+  RefHash *widgetsByRef;	// all widgets, indexed by their Ref; built
+				//   by the first findWidgetByRef call
   XRef* xref;
   Object *acroForm;
   GBool needAppearances;
@@ -53,6 +53,9 @@
 #include "goo/gmem.h"
 #include "goo/GooTimer.h"
 #include "goo/GooHash.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
 #include "GlobalParams.h"
 #include "CharTypes.h"
 #include "Object.h"
@@ -121,6 +124,13 @@
 // fill.
 #define patchColorDelta (dblToCol((3. / 256.0)))
 
+// Max number of objects (operators plus operands) kept for a compiled
+// content stream; larger streams are just parsed each time.
+#define compiledContentMaxObjs 262144
+
+// Number of compiled content streams kept per page.
+#define contentCacheSize 32
+
 //------------------------------------------------------------------------
 // Operator table
 //------------------------------------------------------------------------
@@ -304,6 +314,68 @@ Operator Gfx::opTab[] = {
 
 #define numOps (sizeof(opTab) / sizeof(Operator))
 
+// Operators indexed by their interned names, so that findOp can
+// usually hash and compare pointers instead of strings.  Operators
+// whose names could not be interned are missing from the table, and
+// are found by the binary search.
+#define opHashSize 256
+
+struct OpHashEntry {
+  char *name;			// interned name
+  Operator *op;
+};
+
+static OpHashEntry opHash[opHashSize];
+static GBool opHashInitialized = gFalse;
+static GBool opHashComplete = gFalse;
+
+#if MULTITHREADED
+
+// Gfx objects on different threads (one per document) may ask for
+// the table at the same time, so it is built under a lock.  Each Gfx
+// takes the lock once, which also makes the finished table visible to
+// its thread, and then reads the table without locking.
+class OpHashLock {
+public:
+  OpHashLock() { gInitMutex(&mutex); }
+  GooMutex mutex;
+};
+
+static OpHashLock opHashLock;
+
+#define lockOpHash   gLockMutex(&opHashLock.mutex)
+#define unlockOpHash gUnlockMutex(&opHashLock.mutex)
+
+#else
+
+#define lockOpHash
+#define unlockOpHash
+
+#endif
+
+static inline int opHashIndex(char *name) {
+  return (int)(((size_t)name >> 2) & (opHashSize - 1));
+}
+
+static void initOpHash(Operator *ops, int n) {
+  char *name;
+  GBool complete;
+  int h, i;
+
+  complete = gTrue;
+  for (i = 0; i < n; ++i) {
+    if ((name = NameTable::intern(ops[i].name))) {
+      for (h = opHashIndex(name); opHash[h].name; h = (h + 1) & (opHashSize - 1)) ;
+      opHash[h].op = &ops[i];
+      opHash[h].name = name;
+    } else {
+      complete = gFalse;
+    }
+  }
+  opHashComplete = complete;
+  opHashInitialized = gTrue;
+}
+
 static inline GBool isSameGfxColor(const GfxColor &colorA, const GfxColor &colorB, Guint nComps, double delta) {
   for (Guint k = 0; k < nComps; ++k) {
     if (abs(colorA.c[k] - colorB.c[k]) > delta) {
@@ -521,6 +593,158 @@ GBool GfxResources::lookupGStateNF(char *name, Object *obj) {
   return gFalse;
 }
 
+//------------------------------------------------------------------------
+// GfxCompiledContent
+//------------------------------------------------------------------------
+
+GfxCompiledContent::GfxCompiledContent() {
+  cmds = NULL;
+  nCmds = cmdsSize = 0;
+  args = NULL;
+  nArgs = argsSize = 0;
+  refCnt = 1;
+  inUse = gFalse;
+}
+
+GfxCompiledContent::~GfxCompiledContent() {
+  int i;
+
+  for (i = 0; i < nCmds; ++i) {
+    cmds[i].cmd.free();
+  }
+  gfree(cmds);
+  for (i = 0; i < nArgs; ++i) {
+    args[i].free();
+  }
+  gfree(args);
+}
+
+void GfxCompiledContent::incRefCnt() {
+  refCnt++;
+}
+
+void GfxCompiledContent::decRefCnt() {
+  if (--refCnt == 0) {
+    delete this;
+  }
+}
+
+GBool GfxCompiledContent::addCmd(Object *cmd, Operator *op,
+				 Object *cmdArgs, int numCmdArgs) {
+  Cmd *c;
+  int i;
+
+  if (nCmds + nArgs + numCmdArgs >= compiledContentMaxObjs) {
+    return gFalse;
+  }
+  if (nCmds == cmdsSize) {
+    cmdsSize = cmdsSize ? 2 * cmdsSize : 256;
+    cmds = (Cmd *)greallocn(cmds, cmdsSize, sizeof(Cmd));
+  }
+  if (nArgs + numCmdArgs > argsSize) {
+    argsSize = argsSize ? 2 * argsSize : 1024;
+    if (argsSize < nArgs + numCmdArgs) {
+      argsSize = nArgs + numCmdArgs;
+    }
+    args = (Object *)greallocn(args, argsSize, sizeof(Object));
+  }
+  c = &cmds[nCmds++];
+  cmd->copy(&c->cmd);
+  c->op = op;
+  c->firstArg = nArgs;
+  c->numArgs = numCmdArgs;
+  for (i = 0; i < numCmdArgs; ++i) {
+    cmdArgs[i].copy(&args[nArgs++]);
+  }
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+// GfxContentCache
+//------------------------------------------------------------------------
+
+class GfxContentKey: public PopplerCacheKey {
+public:
+
+  GfxContentKey(Ref refA): ref(refA) {}
+
+  bool operator==(const PopplerCacheKey &key) const {
+    const GfxContentKey *k = static_cast<const GfxContentKey *>(&key);
+    return k->ref.num == ref.num && k->ref.gen == ref.gen;
+  }
+
+  Ref ref;
+};
+
+class GfxContentItem: public PopplerCacheItem {
+public:
+
+  GfxContentItem(GfxCompiledContent *contentA): content(contentA) {}
+  ~GfxContentItem() { content->decRefCnt(); }
+
+  GfxCompiledContent *content;
+};
+
+#if MULTITHREADED
+#  define lockContentCache   gLockMutex(&mutex)
+#  define unlockContentCache gUnlockMutex(&mutex)
+#else
+#  define lockContentCache
+#  define unlockContentCache
+#endif
+
+GfxContentCache::GfxContentCache():
+  cache(contentCacheSize)
+{
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+GfxContentCache::~GfxContentCache() {
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+GfxCompiledContent *GfxContentCache::lookup(Ref ref) {
+  GfxContentKey key(ref);
+  GfxContentItem *item;
+  GfxCompiledContent *content;
+
+  lockContentCache;
+  item = static_cast<GfxContentItem *>(cache.lookup(key));
+  if (item && !item->content->inUse) {
+    content = item->content;
+    content->inUse = gTrue;
+    content->incRefCnt();
+  } else {
+    content = NULL;
+  }
+  unlockContentCache;
+  return content;
+}
+
+void GfxContentCache::release(GfxCompiledContent *content) {
+  lockContentCache;
+  content->inUse = gFalse;
+  content->decRefCnt();
+  unlockContentCache;
+}
+
+void GfxContentCache::put(Ref ref, GfxCompiledContent *content) {
+  GfxContentKey key(ref);
+
+  lockContentCache;
+  if (cache.lookup(key)) {
+    // compiled concurrently by another Gfx, or by a recursive Form
+    content->decRefCnt();
+  } else {
+    cache.put(new GfxContentKey(ref), new GfxContentItem(content));
+  }
+  unlockContentCache;
+}
+
 //------------------------------------------------------------------------
 // Gfx
 //------------------------------------------------------------------------
@@ -546,6 +770,8 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, Catalog *cata
   maskHaveCSPattern = gFalse;
   mcStack = NULL;
   parser = NULL;
+  contentCache = NULL;
+  opHashReady = gFalse;
 
   // start the resource stack
   res = new GfxResources(xref, resDict, NULL);
@@ -601,6 +827,8 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict, Catalog *catalogA,
   maskHaveCSPattern = gFalse;
   mcStack = NULL;
   parser = NULL;
+  contentCache = NULL;
+  opHashReady = gFalse;
 
   // start the resource stack
   res = new GfxResources(xref, resDict, NULL);
@@ -656,10 +884,21 @@ Gfx::~Gfx() {
   }
 }
 
-void Gfx::display(Object *obj, GBool topLevel) {
+void Gfx::display(Object *obj, GBool topLevel, Ref *ref) {
+  GfxCompiledContent *compiled;
   Object obj2;
   int i;
 
+  // if this stream has already been compiled, just replay it
+  if (contentCache && ref) {
+    if ((compiled = contentCache->lookup(*ref))) {
+      parser = NULL;
+      goCompiled(compiled, topLevel);
+      contentCache->release(compiled);
+      return;
+    }
+  }
+
   if (obj->isArray()) {
     for (i = 0; i < obj->arrayGetLength(); ++i) {
       obj->arrayGet(i, &obj2);
@@ -674,15 +913,21 @@ void Gfx::display(Object *obj, GBool topLevel) {
     error(-1, "Weird page contents");
     return;
   }
+  compiled = (contentCache && ref) ? new GfxCompiledContent() : NULL;
   parser = new Parser(xref, new Lexer(xref, obj), gFalse);
-  go(topLevel);
+  go(topLevel, &compiled);
   delete parser;
   parser = NULL;
+  if (compiled) {
+    contentCache->put(*ref, compiled);
+  }
 }
 
-void Gfx::go(GBool topLevel) {
+void Gfx::go(GBool topLevel, GfxCompiledContent **compiled) {
   Object obj;
   Object args[maxArgs];
+  Operator *op;
+  GBool done;
   int numArgs, i;
   int lastAbortCheck;
 
@@ -690,74 +935,33 @@ void Gfx::go(GBool topLevel) {
   pushStateGuard();
   updateLevel = lastAbortCheck = 0;
   numArgs = 0;
+  done = gFalse;
   parser->getObj(&obj);
   while (!obj.isEOF()) {
-    commandAborted = gFalse;
 
     // got a command - execute it
     if (obj.isCmd()) {
-      if (printCommands) {
-	obj.print(stdout);
-	for (i = 0; i < numArgs; ++i) {
-	  printf(" ");
-	  args[i].print(stdout);
+      op = findOp(obj.getCmd());
+
+      // record it, if we are compiling the stream -- inline image data
+      // is read directly from the stream, so it can't be replayed
+      if (*compiled) {
+	if (obj.isCmd("BI") ||
+	    !(*compiled)->addCmd(&obj, op, args, numArgs)) {
+	  (*compiled)->decRefCnt();
+	  *compiled = NULL;
 	}
-	printf("\n");
-	fflush(stdout);
       }
-      GooTimer timer;
-
-      // Run the operation
-      execOp(&obj, args, numArgs);
-
-      // Update the profile information
-      if (profileCommands) {
-	GooHash *hash;
 
-	hash = out->getProfileHash ();
-	if (hash) {
-	  GooString *cmd_g;
-	  ProfileData *data_p;
-
-	  cmd_g = new GooString (obj.getCmd());
-	  data_p = (ProfileData *)hash->lookup (cmd_g);
-	  if (data_p == NULL) {
-	    data_p = new ProfileData();
-	    hash->add (cmd_g, data_p);
-	  }
-	  
-	  data_p->addElement(timer.getElapsed ());
-	}
-      }
+      done = !execCmd(&obj, op, args, numArgs, &lastAbortCheck);
       obj.free();
       for (i = 0; i < numArgs; ++i)
 	args[i].free();
       numArgs = 0;
-
-      // periodically update display
-      if (++updateLevel >= 20000) {
-	out->dump();
-	updateLevel = 0;
-      }
-
-      // did the command throw an exception
-      if (commandAborted) {
-	// don't propogate; recursive drawing comes from Form XObjects which
-	// should probably be drawn in a separate context anyway for caching
-	commandAborted = gFalse;
+      if (done) {
 	break;
       }
 
-      // check for an abort
-      if (abortCheckCbk) {
-	if (updateLevel - lastAbortCheck > 10) {
-	  if ((*abortCheckCbk)(abortCheckCbkData)) {
-	    break;
-	  }
-	  lastAbortCheck = updateLevel;
-	}
-      }
-
     // got an argument - save it
     } else if (numArgs < maxArgs) {
       args[numArgs++] = obj;
@@ -779,6 +983,12 @@ void Gfx::go(GBool topLevel) {
   }
   obj.free();
 
+  // a partially drawn stream can't be cached
+  if (done && *compiled) {
+    (*compiled)->decRefCnt();
+    *compiled = NULL;
+  }
+
   // args at end with no command
   if (numArgs > 0) {
     error(getPos(), "Leftover args in content stream");
@@ -803,15 +1013,104 @@ void Gfx::go(GBool topLevel) {
   }
 }
 
-void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
-  Operator *op;
+void Gfx::goCompiled(GfxCompiledContent *compiled, GBool topLevel) {
+  GfxCompiledContent::Cmd *cmd;
+  int lastAbortCheck, i;
+
+  pushStateGuard();
+  updateLevel = lastAbortCheck = 0;
+  for (i = 0; i < compiled->nCmds; ++i) {
+    cmd = &compiled->cmds[i];
+    if (!execCmd(&cmd->cmd, cmd->op, &compiled->args[cmd->firstArg],
+		 cmd->numArgs, &lastAbortCheck)) {
+      break;
+    }
+  }
+  popStateGuard();
+
+  // update display
+  if (topLevel && updateLevel > 0) {
+    out->dump();
+  }
+}
+
+// Execute one command, along with the debugging, display update and
+// abort checks.  Returns false if the rest of the stream should be
+// skipped.
+GBool Gfx::execCmd(Object *cmd, Operator *op, Object args[], int numArgs,
+		   int *lastAbortCheck) {
+  int i;
+
+  commandAborted = gFalse;
+  if (printCommands) {
+    cmd->print(stdout);
+    for (i = 0; i < numArgs; ++i) {
+      printf(" ");
+      args[i].print(stdout);
+    }
+    printf("\n");
+    fflush(stdout);
+  }
+  GooTimer timer;
+
+  // Run the operation
+  execOp(cmd, op, args, numArgs);
+
+  // Update the profile information
+  if (profileCommands) {
+    GooHash *hash;
+
+    hash = out->getProfileHash ();
+    if (hash) {
+      GooString *cmd_g;
+      ProfileData *data_p;
+
+      cmd_g = new GooString (cmd->getCmd());
+      data_p = (ProfileData *)hash->lookup (cmd_g);
+      if (data_p == NULL) {
+	data_p = new ProfileData();
+	hash->add (cmd_g, data_p);
+      }
+
+      data_p->addElement(timer.getElapsed ());
+    }
+  }
+
+  // periodically update display
+  if (++updateLevel >= 20000) {
+    out->dump();
+    updateLevel = 0;
+  }
+
+  // did the command throw an exception
+  if (commandAborted) {
+    // don't propogate; recursive drawing comes from Form XObjects which
+    // should probably be drawn in a separate context anyway for caching
+    commandAborted = gFalse;
+    return gFalse;
+  }
+
+  // check for an abort
+  if (abortCheckCbk) {
+    if (updateLevel - *lastAbortCheck > 10) {
+      if ((*abortCheckCbk)(abortCheckCbkData)) {
+	return gFalse;
+      }
+      *lastAbortCheck = updateLevel;
+    }
+  }
+
+  return gTrue;
+}
+
+void Gfx::execOp(Object *cmd, Operator *op, Object args[], int numArgs) {
   char *name;
   Object *argPtr;
   int i;
 
-  // find operator
+  // check operator
   name = cmd->getCmd();
-  if (!(op = findOp(name))) {
+  if (!op) {
     if (ignoreUndef == 0)
       error(getPos(), "Unknown operator '%s'", name);
     return;
@@ -852,7 +1151,26 @@ void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
 }
 
 Operator *Gfx::findOp(char *name) {
-  int a, b, m, cmp;
+  int a, b, m, cmp, h;
+
+  if (NameTable::isInterned(name)) {
+    if (!opHashReady) {
+      lockOpHash;
+      if (!opHashInitialized) {
+	initOpHash(opTab, numOps);
+      }
+      unlockOpHash;
+      opHashReady = gTrue;
+    }
+    for (h = opHashIndex(name); opHash[h].name; h = (h + 1) & (opHashSize - 1)) {
+      if (opHash[h].name == name) {
+	return opHash[h].op;
+      }
+    }
+    if (opHashComplete) {
+      return NULL;
+    }
+  }
 
   a = -1;
   b = numOps;
@@ -3955,6 +4273,9 @@ void Gfx::opXObject(Object args[], int numArgs) {
     res->lookupXObjectNF(name, &refObj);
     if (out->useDrawForm() && refObj.isRef()) {
       out->drawForm(refObj.getRef());
+    } else if (refObj.isRef()) {
+      Ref ref = refObj.getRef();
+      doForm(&obj1, &ref);
     } else {
       doForm(&obj1);
     }
@@ -4362,7 +4683,7 @@ void Gfx::doImage(Object *ref, Stream *str, GBool inlineImg) {
   error(getPos(), "Bad image parameters");
 }
 
-void Gfx::doForm(Object *str) {
+void Gfx::doForm(Object *str, Ref *ref) {
   Dict *dict;
   GBool transpGroup, isolated, knockout;
   GfxColorSpace *blendingColorSpace;
@@ -4454,7 +4775,8 @@ void Gfx::doForm(Object *str) {
   // draw it
   ++formDepth;
   doForm1(str, resDict, m, bbox,
-	  transpGroup, gFalse, blendingColorSpace, isolated, knockout);
+	  transpGroup, gFalse, blendingColorSpace, isolated, knockout,
+	  gFalse, NULL, NULL, ref);
   --formDepth;
 
   if (blendingColorSpace) {
@@ -4468,7 +4790,7 @@ void Gfx::doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
 		  GfxColorSpace *blendingColorSpace,
 		  GBool isolated, GBool knockout,
 		  GBool alpha, Function *transferFunc,
-		  GfxColor *backdropColor) {
+		  GfxColor *backdropColor, Ref *ref) {
   Parser *oldParser;
   double oldBaseMatrix[6];
   int i;
@@ -4528,7 +4850,7 @@ void Gfx::doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
   GfxState *stateBefore = state;
 
   // draw the form
-  display(str, gFalse);
+  display(str, gFalse, ref);
   
   if (stateBefore != state) {
     if (state->isParentState(stateBefore)) {
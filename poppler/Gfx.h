@@ -34,8 +34,12 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "goo/gtypes.h"
 #include "goo/GooList.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
 #include "GfxState.h"
 #include "Object.h"
 #include "PopplerCache.h"
@@ -134,6 +138,91 @@ private:
   GfxResources *next;
 };
 
+//------------------------------------------------------------------------
+// GfxCompiledContent
+//------------------------------------------------------------------------
+
+// A content stream that has already been tokenized, with its operators
+// looked up in the operator table, so that it can be executed again
+// without going through the Lexer and Parser.  Gfx records it while it
+// displays the stream for the first time.
+class GfxCompiledContent {
+public:
+
+  GfxCompiledContent();
+
+  // Number of commands.
+  int getNumCmds() { return nCmds; }
+
+private:
+
+  struct Cmd {
+    Object cmd;			// the operator, as parsed
+    Operator *op;		// entry in the operator table, or NULL
+    int firstArg;		// index of the first operand in args
+    int numArgs;		// number of operands
+  };
+
+  ~GfxCompiledContent();
+
+  // The reference count and the in-use flag are only touched by the
+  // GfxContentCache, with its mutex held.
+  void incRefCnt();
+  void decRefCnt();
+
+  // Append a command and copies of its operands.  Returns false if
+  // the stream is too large to be kept.
+  GBool addCmd(Object *cmd, Operator *op, Object *cmdArgs, int numCmdArgs);
+
+  Cmd *cmds;
+  int nCmds, cmdsSize;
+  Object *args;
+  int nArgs, argsSize;
+  int refCnt;
+  GBool inUse;			// checked out by a Gfx
+
+  friend class Gfx;
+  friend class GfxContentCache;
+  friend class GfxContentItem;
+};
+
+//------------------------------------------------------------------------
+// GfxContentCache
+//------------------------------------------------------------------------
+
+// Compiled content streams, keyed by the Ref of the page or Form
+// XObject they belong to.  Kept by the Page so that re-rendering it
+// (e.g., at a new zoom level) doesn't parse its content again.  The
+// cache can be shared by several Gfx running in different threads:
+// a compiled stream is handed to one Gfx at a time, since replaying it
+// copies the Objects it holds.
+class GfxContentCache {
+public:
+
+  GfxContentCache();
+  ~GfxContentCache();
+
+  // Return the compiled content for <ref>, or NULL if there is none or
+  // it is being replayed by another Gfx.  The caller must give it back
+  // with release() when done.
+  GfxCompiledContent *lookup(Ref ref);
+
+  // Give back content returned by lookup().
+  void release(GfxCompiledContent *content);
+
+  // Add the compiled content for <ref>.  The cache takes over the
+  // caller's reference; <content> is dropped if <ref> is already
+  // cached.
+  void put(Ref ref, GfxCompiledContent *content);
+
+private:
+
+  PopplerCache cache;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
 //------------------------------------------------------------------------
 // Gfx
 //------------------------------------------------------------------------
@@ -156,8 +245,15 @@ public:
 
   ~Gfx();
 
-  // Interpret a stream or array of streams.
-  void display(Object *obj, GBool topLevel = gTrue);
+  // Interpret a stream or array of streams.  If <ref> is given and
+  // there is a content cache, the compiled stream is taken from (or
+  // added to) the cache under that key.
+  void display(Object *obj, GBool topLevel = gTrue, Ref *ref = NULL);
+
+  // Set the cache of compiled content streams used for the page and
+  // its Form XObjects.  The cache is not owned by the Gfx.
+  void setContentCache(GfxContentCache *contentCacheA)
+    { contentCache = contentCacheA; }
 
   // Display an annotation, given its appearance (a Form XObject),
   // border style, and bounding box (in default user space).
@@ -214,6 +310,9 @@ private:
   MarkedContentStack *mcStack;	// current BMC/EMC stack
 
   Parser *parser;		// parser for page content stream(s)
+  GfxContentCache *contentCache; // compiled content streams, or NULL
+  GBool opHashReady;		// set once this Gfx has seen the built
+				//   operator hash table
  
 #ifdef USE_CMS
   PopplerCache iccColorSpaceCache;
@@ -225,8 +324,11 @@ private:
 
   static Operator opTab[];	// table of operators
 
-  void go(GBool topLevel);
-  void execOp(Object *cmd, Object args[], int numArgs);
+  void go(GBool topLevel, GfxCompiledContent **compiled);
+  void goCompiled(GfxCompiledContent *compiled, GBool topLevel);
+  GBool execCmd(Object *cmd, Operator *op, Object args[], int numArgs,
+		int *lastAbortCheck);
+  void execOp(Object *cmd, Operator *op, Object args[], int numArgs);
   Operator *findOp(char *name);
   GBool checkArg(Object *arg, TchkType type);
   int getPos();
@@ -343,13 +445,13 @@ private:
   // XObject operators
   void opXObject(Object args[], int numArgs);
   void doImage(Object *ref, Stream *str, GBool inlineImg);
-  void doForm(Object *str);
+  void doForm(Object *str, Ref *ref = NULL);
   void doForm1(Object *str, Dict *resDict, double *matrix, double *bbox,
 	       GBool transpGroup = gFalse, GBool softMask = gFalse,
 	       GfxColorSpace *blendingColorSpace = NULL,
 	       GBool isolated = gFalse, GBool knockout = gFalse,
 	       GBool alpha = gFalse, Function *transferFunc = NULL,
-	       GfxColor *backdropColor = NULL);
+	       GfxColor *backdropColor = NULL, Ref *ref = NULL);
 
   // in-line image operators
   void opBeginImage(Object args[], int numArgs);
@@ -662,6 +662,7 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   psEmbedCIDPostScript = gTrue;
   psEmbedCIDTrueType = gTrue;
   psSubstFonts = gTrue;
+  psSubsetFonts = gFalse;
   psPreload = gFalse;
   psOPI = gFalse;
   psASCIIHex = gFalse;
@@ -690,6 +691,9 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   mapUnknownCharNames = gFalse;
   printCommands = gFalse;
   profileCommands = gFalse;
+  cacheContentStreams = gFalse;
+  chunkCacheDir = NULL;
+  chunkCacheSize = 256 * 1024 * 1024;
   errQuiet = gFalse;
 
   cidToUnicodeCache = new CharCodeToUnicodeCache(cidToUnicodeCacheSize);
@@ -871,6 +875,7 @@ GlobalParams::~GlobalParams() {
   deleteGooList(psNamedFonts16, PSFontParam);
   deleteGooList(psFonts16, PSFontParam);
   delete textEncoding;
+  delete chunkCacheDir;
   deleteGooList(fontDirs, GooString);
 
   GooHashIter *iter;
@@ -1353,6 +1358,15 @@ GBool GlobalParams::getPSSubstFonts() {
   return e;
 }
 
+GBool GlobalParams::getPSSubsetFonts() {
+  GBool subset;
+
+  lockGlobalParams;
+  subset = psSubsetFonts;
+  unlockGlobalParams;
+  return subset;
+}
+
 GBool GlobalParams::getPSPreload() {
   GBool preload;
 
@@ -1567,6 +1581,33 @@ GBool GlobalParams::getProfileCommands() {
   return p;
 }
 
+GBool GlobalParams::getCacheContentStreams() {
+  GBool c;
+
+  lockGlobalParams;
+  c = cacheContentStreams;
+  unlockGlobalParams;
+  return c;
+}
+
+GooString *GlobalParams::getChunkCacheDir() {
+  GooString *s;
+
+  lockGlobalParams;
+  s = chunkCacheDir ? chunkCacheDir->copy() : (GooString *)NULL;
+  unlockGlobalParams;
+  return s;
+}
+
+Guint GlobalParams::getChunkCacheSize() {
+  Guint size;
+
+  lockGlobalParams;
+  size = chunkCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
 GBool GlobalParams::getErrQuiet() {
   // no locking -- this function may get called from inside a locked
   // section
@@ -1719,6 +1760,12 @@ void GlobalParams::setPSSubstFonts(GBool substFonts) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setPSSubsetFonts(GBool subsetFonts) {
+  lockGlobalParams;
+  psSubsetFonts = subsetFonts;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setPSPreload(GBool preload) {
   lockGlobalParams;
   psPreload = preload;
@@ -1873,6 +1920,34 @@ void GlobalParams::setProfileCommands(GBool profileCommandsA) {
   unlockGlobalParams;
 }
 
+void GlobalParams::setCacheContentStreams(GBool cacheContentStreamsA) {
+  lockGlobalParams;
+  cacheContentStreams = cacheContentStreamsA;
+  unlockGlobalParams;
+}
+
+GBool GlobalParams::setCacheContentStreams(char *s) {
+  GBool ok;
+
+  lockGlobalParams;
+  ok = parseYesNo2(s, &cacheContentStreams);
+  unlockGlobalParams;
+  return ok;
+}
+
+void GlobalParams::setChunkCacheDir(char *dir) {
+  lockGlobalParams;
+  delete chunkCacheDir;
+  chunkCacheDir = dir ? new GooString(dir) : (GooString *)NULL;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setChunkCacheSize(Guint size) {
+  lockGlobalParams;
+  chunkCacheSize = size;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setErrQuiet(GBool errQuietA) {
   lockGlobalParams;
   errQuiet = errQuietA;
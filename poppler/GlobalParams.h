@@ -196,6 +196,7 @@ public:
   GBool getPSEmbedCIDPostScript();
   GBool getPSEmbedCIDTrueType();
   GBool getPSSubstFonts();
+  GBool getPSSubsetFonts();
   GBool getPSPreload();
   GBool getPSOPI();
   GBool getPSASCIIHex();
@@ -218,6 +219,9 @@ public:
   GBool getMapUnknownCharNames();
   GBool getPrintCommands();
   GBool getProfileCommands();
+  GBool getCacheContentStreams();
+  GooString *getChunkCacheDir();
+  Guint getChunkCacheSize();
   GBool getErrQuiet();
 
   CharCodeToUnicode *getCIDToUnicode(GooString *collection);
@@ -241,6 +245,7 @@ public:
   void setPSEmbedCIDPostScript(GBool embed);
   void setPSEmbedCIDTrueType(GBool embed);
   void setPSSubstFonts(GBool substFonts);
+  void setPSSubsetFonts(GBool subsetFonts);
   void setPSPreload(GBool preload);
   void setPSOPI(GBool opi);
   void setPSASCIIHex(GBool hex);
@@ -262,6 +267,10 @@ public:
   void setMapUnknownCharNames(GBool map);
   void setPrintCommands(GBool printCommandsA);
   void setProfileCommands(GBool profileCommandsA);
+  void setCacheContentStreams(GBool cacheContentStreamsA);
+  GBool setCacheContentStreams(char *s);
+  void setChunkCacheDir(char *dir);
+  void setChunkCacheSize(Guint size);
   void setErrQuiet(GBool errQuietA);
 
   //----- security handlers
@@ -321,6 +330,8 @@ private:
   GBool psEmbedCIDPostScript;	// embed CID PostScript fonts?
   GBool psEmbedCIDTrueType;	// embed CID TrueType fonts?
   GBool psSubstFonts;		// substitute missing fonts?
+  GBool psSubsetFonts;		// embed only the TrueType glyphs that are
+				//   used?
   GBool psPreload;		// preload PostScript images and forms into
 				//   memory
   GBool psOPI;			// generate PostScript OPI comments?
@@ -346,6 +357,11 @@ private:
   GBool mapUnknownCharNames;	// map unknown char names?
   GBool printCommands;		// print the drawing commands
   GBool profileCommands;	// profile the drawing commands
+  GBool cacheContentStreams;	// keep compiled content streams for
+				//   re-rendering pages?
+  GooString *chunkCacheDir;	// directory for the on-disk chunk cache
+				//   of remote files, or NULL
+  Guint chunkCacheSize;		// max size of the chunk cache, in bytes
   GBool errQuiet;		// suppress error messages?
 
   CharCodeToUnicodeCache *cidToUnicodeCache;
@@ -264,7 +264,7 @@ void Hints::readSharedObjectsTable(Stream *str)
 
   Guint nSharedGroupsFirst = readBits(32, str);
 
-  Guint nSharedGroups = readBits(32, str);
+  nSharedGroups = readBits(32, str);
 
   Guint nBitsNumObjects = readBits(16, str);
 
@@ -378,6 +378,7 @@ std::vector<ByteRange>* Hints::getPageRanges(int page)
 
   for (Guint j=0; j<numSharedObject[idx]; j++) {
      Guint k = sharedObjectId[idx][j];
+     if (k >= nSharedGroups) continue;
 
      pageRange.offset = groupOffset[k];
      pageRange.length = groupLength[k];
@@ -56,6 +56,9 @@ public:
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
+  // Get the JBIG2Globals stream (may be null).
+  Object *getGlobalsStream() { return &globalsStream; }
+
 private:
 
   void readSegments();
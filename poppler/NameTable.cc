@@ -0,0 +1,178 @@
+//========================================================================
+//
+// NameTable.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "NameTable.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+//------------------------------------------------------------------------
+
+// max bytes of strings in the table
+#define nameTableMaxBytes (4 * 1024 * 1024)
+
+// longer strings are not interned
+#define nameTableMaxLength 1024
+
+// initial number of hash buckets (must be a power of 2)
+#define nameTableInitialBuckets 1024
+
+struct NameTableEntry {
+  Guint hash;
+  char *str;
+};
+
+// The strings are stored in a single static array, so that
+// isInterned() is a range check that doesn't depend on the state of
+// the table.  Only the pages that are actually used take up memory.
+static char nameStore[nameTableMaxBytes];
+static size_t bytesUsed = 0;
+
+// an open addressing hash table, at most half full
+static NameTableEntry *buckets = NULL;
+static int nBuckets = 0;	// number of buckets (a power of 2)
+static int nNames = 0;
+
+#if MULTITHREADED
+
+// the mutex has to exist before any thread can parse anything, so it
+// is set up by a static initializer
+class NameTableLock {
+public:
+  NameTableLock() { gInitMutex(&mutex); }
+  GooMutex mutex;
+};
+
+static NameTableLock nameTableLock;
+
+#define lockNameTable   gLockMutex(&nameTableLock.mutex)
+#define unlockNameTable gUnlockMutex(&nameTableLock.mutex)
+
+#else
+
+#define lockNameTable
+#define unlockNameTable
+
+#endif
+
+static inline Guint hashName(const char *s, int *len) {
+  const char *p;
+  Guint h;
+
+  h = 2166136261U;
+  for (p = s; *p; ++p) {
+    h = (h ^ (Guchar)*p) * 16777619U;
+  }
+  *len = (int)(p - s);
+  return h;
+}
+
+static void growBuckets() {
+  NameTableEntry *oldBuckets;
+  int nOldBuckets, i, j;
+
+  oldBuckets = buckets;
+  nOldBuckets = nBuckets;
+  nBuckets = oldBuckets ? 2 * nOldBuckets : nameTableInitialBuckets;
+  buckets = (NameTableEntry *)gmallocn(nBuckets, sizeof(NameTableEntry));
+  memset(buckets, 0, nBuckets * sizeof(NameTableEntry));
+  for (i = 0; i < nOldBuckets; ++i) {
+    if (oldBuckets[i].str) {
+      j = oldBuckets[i].hash & (nBuckets - 1);
+      while (buckets[j].str) {
+	j = (j + 1) & (nBuckets - 1);
+      }
+      buckets[j] = oldBuckets[i];
+    }
+  }
+  gfree(oldBuckets);
+}
+
+// Look <s> up in the table.  Returns the interned string, or NULL and
+// the index of the first free bucket in <idx>.
+static inline char *findName(const char *s, Guint h, int *idx) {
+  NameTableEntry *e;
+  int i;
+
+  i = h & (nBuckets - 1);
+  while ((e = &buckets[i])->str) {
+    if (e->hash == h && !strcmp(e->str, s)) {
+      return e->str;
+    }
+    i = (i + 1) & (nBuckets - 1);
+  }
+  *idx = i;
+  return NULL;
+}
+
+char *NameTable::intern(const char *s) {
+  char *p;
+  Guint h;
+  int len, i;
+
+  h = hashName(s, &len);
+  if (len > nameTableMaxLength) {
+    return NULL;
+  }
+
+  lockNameTable;
+  if (!buckets) {
+    growBuckets();
+  }
+  if ((p = findName(s, h, &i))) {
+    unlockNameTable;
+    return p;
+  }
+
+  // add a new string
+  if (nameTableMaxBytes - bytesUsed < (size_t)len + 1) {
+    unlockNameTable;
+    return NULL;
+  }
+  p = nameStore + bytesUsed;
+  memcpy(p, s, len + 1);
+  bytesUsed += len + 1;
+  buckets[i].hash = h;
+  buckets[i].str = p;
+  if (++nNames * 2 > nBuckets) {
+    growBuckets();
+  }
+  unlockNameTable;
+  return p;
+}
+
+GBool NameTable::isInterned(const char *s) {
+  return s >= nameStore && s < nameStore + nameTableMaxBytes;
+}
+
+int NameTable::getNumNames() {
+  int n;
+
+  lockNameTable;
+  n = nNames;
+  unlockNameTable;
+  return n;
+}
+
+size_t NameTable::getBytesUsed() {
+  size_t n;
+
+  lockNameTable;
+  n = bytesUsed;
+  unlockNameTable;
+  return n;
+}
@@ -0,0 +1,56 @@
+//========================================================================
+//
+// NameTable.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef NAMETABLE_H
+#define NAMETABLE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "goo/gtypes.h"
+#include "goo/gmem.h"
+
+//------------------------------------------------------------------------
+// NameTable
+//
+// Process-wide table of interned name and command strings.  Each
+// distinct string is stored once and never freed, so interned strings
+// can be shared between objects and compared by pointer.  The table
+// has a fixed maximum size; once it is full, intern() returns NULL and
+// callers fall back to private copies, which copyName() and freeName()
+// handle transparently.
+//------------------------------------------------------------------------
+
+class NameTable {
+public:
+
+  // Return the interned copy of <s>, or NULL if <s> is too long or
+  // the table is full.
+  static char *intern(const char *s);
+
+  // Return true if <s> points to an interned string.
+  static GBool isInterned(const char *s);
+
+  // Return a string equal to <s> that must be released with
+  // freeName(): the interned copy if possible, else a heap copy.
+  static char *copyName(const char *s)
+    { char *p = isInterned(s) ? (char *)s : intern(s);
+      return p ? p : copyString((char *)s); }
+
+  // Release a string returned by copyName().
+  static void freeName(char *s)
+    { if (!isInterned(s)) gfree(s); }
+
+  // Number of interned strings, and bytes used to store them.
+  static int getNumNames();
+  static size_t getBytesUsed();
+};
+
+#endif
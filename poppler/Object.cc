@@ -92,7 +92,7 @@ Object *Object::copy(Object *obj) {
     obj->string = string->copy();
     break;
   case objName:
-    obj->name = copyString(name);
+    obj->name = NameTable::copyName(name);
     break;
   case objArray:
     array->incRef();
@@ -104,7 +104,7 @@ Object *Object::copy(Object *obj) {
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    obj->cmd = NameTable::copyName(cmd);
     break;
   default:
     break;
@@ -126,7 +126,7 @@ void Object::free() {
     delete string;
     break;
   case objName:
-    gfree(name);
+    NameTable::freeName(name);
     break;
   case objArray:
     if (!array->decRef()) {
@@ -144,7 +144,7 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    NameTable::freeName(cmd);
     break;
   default:
     break;
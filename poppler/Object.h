@@ -38,6 +38,7 @@
 #include "goo/GooString.h"
 #include "goo/GooLikely.h"
 #include "Error.h"
+#include "NameTable.h"
 
 #define OBJECT_TYPE_CHECK(wanted_type) \
     if (unlikely(type != wanted_type)) { \
@@ -127,7 +128,7 @@ public:
   Object *initString(GooString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = NameTable::copyName(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
   Object *initArray(XRef *xref);
@@ -137,7 +138,7 @@ public:
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd); cmd = NameTable::copyName(cmdA); return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -180,11 +181,11 @@ public:
 
   // Special type checking.
   GBool isName(char *nameA)
-    { return type == objName && !strcmp(name, nameA); }
+    { return type == objName && (name == nameA || !strcmp(name, nameA)); }
   GBool isDict(char *dictType);
   GBool isStream(char *dictType);
   GBool isCmd(char *cmdA)
-    { return type == objCmd && !strcmp(cmd, cmdA); }
+    { return type == objCmd && (cmd == cmdA || !strcmp(cmd, cmdA)); }
 
   // Accessors.
   GBool getBool() { OBJECT_TYPE_CHECK(objBool); return booln; }
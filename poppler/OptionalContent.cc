@@ -23,6 +23,7 @@
 #include "goo/GooList.h"
 #include "Error.h"
 // #include "PDFDocEncoding.h"
+#include "RefHash.h"
 #include "OptionalContent.h"
 
 //------------------------------------------------------------------------
@@ -33,6 +34,7 @@ OCGs::OCGs(Object *ocgObject, XRef *xref) :
   // we need to parse the dictionary here, and build optionalContentGroups
   ok = gTrue;
   optionalContentGroups = new GooList();
+  ocgsByRef = new RefHash();
 
   Object ocgList;
   ocgObject->dictLookup("OCGs", &ocgList);
@@ -54,8 +56,11 @@ OCGs::OCGs(Object *ocgObject, XRef *xref) :
     OptionalContentGroup *thisOptionalContentGroup = new OptionalContentGroup(ocg.getDict());
     ocg.free();
     ocgList.arrayGetNF(i, &ocg);
-    // TODO: we should create a lookup map from Ref to the OptionalContentGroup
     thisOptionalContentGroup->setRef( ocg.getRef() );
+    // if a group is listed twice, the first one wins
+    if (!ocgsByRef->contains(ocg.getRef())) {
+      ocgsByRef->add(ocg.getRef(), thisOptionalContentGroup);
+    }
     ocg.free();
     // the default is ON - we change state later, depending on BaseState, ON and OFF
     thisOptionalContentGroup->setState(OptionalContentGroup::On);
@@ -140,6 +145,7 @@ OCGs::OCGs(Object *ocgObject, XRef *xref) :
 OCGs::~OCGs()
 {
   deleteGooList(optionalContentGroups, OptionalContentGroup);
+  delete ocgsByRef;
   order.free();
   rbgroups.free();
 }
@@ -152,13 +158,11 @@ bool OCGs::hasOCGs()
 
 OptionalContentGroup* OCGs::findOcgByRef( const Ref &ref)
 {
-  //TODO: make this more efficient
-  OptionalContentGroup *ocg = NULL;
-  for (int i=0; i < optionalContentGroups->getLength(); ++i) {
-    ocg = (OptionalContentGroup*)optionalContentGroups->get(i);
-    if ( (ocg->getRef().num == ref.num) && (ocg->getRef().gen == ref.gen) ) {
-      return ocg;
-    }
+  OptionalContentGroup *ocg;
+
+  ocg = (OptionalContentGroup *)ocgsByRef->lookup(ref);
+  if (ocg) {
+    return ocg;
   }
 
   error(-1, "Could not find a OCG with Ref (%d:%d)", ref.num, ref.gen);
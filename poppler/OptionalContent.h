@@ -22,6 +22,7 @@
 class GooString;
 class GooList;
 class XRef;
+class RefHash;
 
 class OptionalContentGroup; 
 
@@ -57,6 +58,7 @@ private:
   bool anyOff( Array *ocgArray );
 
   GooList *optionalContentGroups;
+  RefHash *ocgsByRef;		// the groups, indexed by their Ref
 
   Object order;
   Object rbgroups;
@@ -72,6 +72,7 @@
 #endif
 #include "PDFDoc.h"
 #include "Hints.h"
+#include "CachedFile.h"
 
 //------------------------------------------------------------------------
 
@@ -107,6 +108,7 @@ void PDFDoc::init()
   startXRefPos = ~(Guint)0;
   secHdlr = NULL;
   pageCache = NULL;
+  prefetchLookahead = 0;
 }
 
 PDFDoc::PDFDoc()
@@ -1184,6 +1186,42 @@ Page *PDFDoc::parsePage(int page)
   return p;
 }
 
+// Load everything the hint tables say <page> (and the next
+// prefetchLookahead pages) will need -- the page objects, their xref
+// entries and the shared object groups they use -- with a single
+// CachedFile::cache() call, instead of letting the parser fetch it
+// one chunk at a time.
+void PDFDoc::prefetchPages(int page)
+{
+  std::vector<ByteRange> ranges;
+  std::vector<ByteRange> *pageRanges;
+  Hints *h;
+  int last;
+
+  if (str->getKind() != strCachedFile || !(h = getHints())) {
+    return;
+  }
+
+  last = page + prefetchLookahead;
+  if (last > getNumPages()) {
+    last = getNumPages();
+  }
+  for (int i = page; i <= last; ++i) {
+    if (i > page && pageCache[i-1]) {
+      continue;
+    }
+    if ((pageRanges = h->getPageRanges(i))) {
+      ranges.insert(ranges.end(), pageRanges->begin(), pageRanges->end());
+      delete pageRanges;
+    }
+  }
+
+  // an empty range list would load the whole file
+  if (!ranges.empty()) {
+    ((CachedFileStream *)str)->getCachedFile()->cache(ranges);
+  }
+}
+
 Page *PDFDoc::getPage(int page)
 {
   if ((page < 1) || page > getNumPages()) return NULL;
@@ -1196,6 +1234,7 @@ Page *PDFDoc::getPage(int page)
       }
     }
     if (!pageCache[page-1]) {
+      prefetchPages(page);
       pageCache[page-1] = parsePage(page);
     }
     if (pageCache[page-1]) {
@@ -133,6 +133,11 @@ public:
   // Get page.
   Page *getPage(int page);
 
+  // Set the number of pages after the requested one whose data is
+  // fetched along with it.  This only applies to linearized documents
+  // read through a CachedFile (e.g., over HTTP).
+  void setPrefetchLookahead(int lookahead) { prefetchLookahead = lookahead; }
+
   // Display a page.
   void displayPage(OutputDev *out, int page,
 		   double hDPI, double vDPI, int rotate,
@@ -243,6 +248,7 @@ private:
   void saveCompleteRewrite (OutStream* outStr);
 
   Page *parsePage(int page);
+  void prefetchPages(int page);
 
   // Get hints.
   Hints *getHints();
@@ -275,6 +281,7 @@ private:
   Outline *outline;
 #endif
   Page **pageCache;
+  int prefetchLookahead;
 
   GBool ok;
   int errCode;
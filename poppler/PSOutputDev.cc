@@ -46,6 +46,11 @@
 #include <limits.h>
 #include "goo/GooString.h"
 #include "goo/GooList.h"
+#include "goo/GooHash.h"
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#include "goo/GooThread.h"
+#endif
 #include "poppler-config.h"
 #include "GlobalParams.h"
 #include "Object.h"
@@ -62,6 +67,8 @@
 #include "Stream.h"
 #include "Annot.h"
 #include "XRef.h"
+#include "Decrypt.h"
+#include "RefHash.h"
 #include "PreScanOutputDev.h"
 #include "FileSpec.h"
 #if HAVE_SPLASH
@@ -964,6 +971,286 @@ GBool DeviceNRecoder::fillBuf() {
   return gTrue;
 }
 
+//------------------------------------------------------------------------
+// PSFontGlyphScanner
+//------------------------------------------------------------------------
+
+// size of a bit array with one bit per TrueType GID
+#define psGlyphMaskSize (65536 / 8)
+
+// Return the MD5 digest of a font program, in hex.
+static GooString *getFontDigest(char *fontBuf, int fontLen) {
+  Guchar digest[16];
+  GooString *s;
+  int i;
+
+  Decrypt::md5((Guchar *)fontBuf, fontLen, digest);
+  s = new GooString();
+  for (i = 0; i < 16; ++i) {
+    s->appendf("{0:02x}", digest[i]);
+  }
+  return s;
+}
+
+// The glyph map of one font, as seen by the scanner.
+struct PSFontGlyphMap {
+  Gushort *toGID;		// char code (8-bit fonts) or CID to GID
+				//   map, or NULL for the identity
+  int toGIDLen;			// number of entries in toGID
+  Guchar *usedGIDs;		// glyphs used in the font program, or
+				//   NULL if the font is not subset
+};
+
+// Collects the glyphs of embedded TrueType and CID TrueType fonts
+// that are drawn on a set of pages.  The glyphs are recorded per font
+// program, indexed by the digest of the program, so fonts that embed
+// identical copies of a program share a glyph set.
+class PSFontGlyphScanner: public OutputDev {
+public:
+
+  PSFontGlyphScanner(XRef *xrefA, Catalog *catalogA, GooHash *fontGlyphsA);
+  virtual ~PSFontGlyphScanner();
+
+  virtual GBool upsideDown() { return gTrue; }
+  virtual GBool useDrawChar() { return gTrue; }
+  virtual GBool interpretType3Chars() { return gTrue; }
+
+  // tiling patterns are scanned once, shadings not at all
+  virtual GBool useTilingPatternFill() { return gTrue; }
+  virtual GBool useShadedFills(int type) { return gTrue; }
+  virtual GBool tilingPatternFill(GfxState *state, Object *str,
+				  int paintType, Dict *resDict,
+				  double *mat, double *bbox,
+				  int x0, int y0, int x1, int y1,
+				  double xStep, double yStep);
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading)
+    { return gTrue; }
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading,
+				double tMin, double tMax)
+    { return gTrue; }
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading,
+				 double sMin, double sMax)
+    { return gTrue; }
+  virtual GBool gouraudTriangleShadedFill(GfxState *state,
+					  GfxGouraudTriangleShading *shading)
+    { return gTrue; }
+  virtual GBool patchMeshShadedFill(GfxState *state,
+				    GfxPatchMeshShading *shading)
+    { return gTrue; }
+
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+
+private:
+
+  PSFontGlyphMap *getGlyphMap(GfxFont *font);
+
+  XRef *xref;
+  Catalog *catalog;
+  GooHash *fontGlyphs;		// glyph sets, indexed by font program
+				//   digest [Guchar *]
+  RefHash *glyphMaps;		// glyph maps, indexed by font ID
+				//   [PSFontGlyphMap *]
+  GooList *glyphMapList;	// all glyph maps, for freeing
+};
+
+PSFontGlyphScanner::PSFontGlyphScanner(XRef *xrefA, Catalog *catalogA,
+				       GooHash *fontGlyphsA) {
+  xref = xrefA;
+  catalog = catalogA;
+  fontGlyphs = fontGlyphsA;
+  glyphMaps = new RefHash();
+  glyphMapList = new GooList();
+}
+
+PSFontGlyphScanner::~PSFontGlyphScanner() {
+  PSFontGlyphMap *map;
+  int i;
+
+  for (i = 0; i < glyphMapList->getLength(); ++i) {
+    map = (PSFontGlyphMap *)glyphMapList->get(i);
+    gfree(map->toGID);
+    delete map;
+  }
+  delete glyphMapList;
+  delete glyphMaps;
+}
+
+GBool PSFontGlyphScanner::tilingPatternFill(GfxState *state, Object *str,
+					    int paintType, Dict *resDict,
+					    double *mat, double *bbox,
+					    int x0, int y0, int x1, int y1,
+					    double xStep, double yStep) {
+  PDFRectangle box;
+  Gfx *gfx;
+
+  box.x1 = bbox[0];
+  box.y1 = bbox[1];
+  box.x2 = bbox[2];
+  box.y2 = bbox[3];
+  gfx = new Gfx(xref, this, resDict, catalog, &box, NULL);
+  gfx->display(str);
+  delete gfx;
+  return gTrue;
+}
+
+void PSFontGlyphScanner::drawChar(GfxState *state, double x, double y,
+				  double dx, double dy,
+				  double originX, double originY,
+				  CharCode code, int nBytes,
+				  Unicode *u, int uLen) {
+  PSFontGlyphMap *map;
+  GfxFont *font;
+  int gid;
+
+  if (!(font = state->getFont()) ||
+      !(map = getGlyphMap(font)) || !map->usedGIDs) {
+    return;
+  }
+  if (!map->toGID) {
+    gid = (int)code;
+  } else if ((int)code < map->toGIDLen) {
+    gid = map->toGID[code];
+  } else {
+    return;
+  }
+  if (gid >= 0 && gid < 65536) {
+    map->usedGIDs[gid >> 3] |= (Guchar)(1 << (gid & 7));
+  }
+}
+
+// Get the glyph map of <font>, building it the first time the font
+// is seen.
+PSFontGlyphMap *PSFontGlyphScanner::getGlyphMap(GfxFont *font) {
+  PSFontGlyphMap *map;
+  FoFiTrueType *ffTT;
+  GooString *digest;
+  Ref fontFileID;
+  char *fontBuf;
+  int fontLen, n;
+
+  if ((map = (PSFontGlyphMap *)glyphMaps->lookup(*font->getID()))) {
+    return map;
+  }
+  map = new PSFontGlyphMap;
+  map->toGID = NULL;
+  map->toGIDLen = 0;
+  map->usedGIDs = NULL;
+  glyphMaps->add(*font->getID(), map);
+  glyphMapList->append(map);
+
+  if (!(font->getType() == fontTrueType ||
+	font->getType() == fontTrueTypeOT ||
+	font->getType() == fontCIDType2 ||
+	font->getType() == fontCIDType2OT) ||
+      !font->getEmbeddedFontID(&fontFileID) ||
+      !(fontBuf = font->readEmbFontFile(xref, &fontLen))) {
+    return map;
+  }
+  if (font->isCIDFont()) {
+    if ((n = ((GfxCIDFont *)font)->getCIDToGIDLen()) > 0) {
+      map->toGID = (Gushort *)gmallocn(n, sizeof(Gushort));
+      memcpy(map->toGID, ((GfxCIDFont *)font)->getCIDToGID(),
+	     n * sizeof(Gushort));
+      map->toGIDLen = n;
+    }
+  } else {
+    if (!(ffTT = FoFiTrueType::make(fontBuf, fontLen))) {
+      gfree(fontBuf);
+      return map;
+    }
+    map->toGID = ((Gfx8BitFont *)font)->getCodeToGIDMap(ffTT);
+    map->toGIDLen = 256;
+    delete ffTT;
+    if (!map->toGID) {
+      gfree(fontBuf);
+      return map;
+    }
+  }
+  digest = getFontDigest(fontBuf, fontLen);
+  gfree(fontBuf);
+  if (!(map->usedGIDs = (Guchar *)fontGlyphs->lookup(digest))) {
+    map->usedGIDs = (Guchar *)gmalloc(psGlyphMaskSize);
+    memset(map->usedGIDs, 0, psGlyphMaskSize);
+    fontGlyphs->add(digest, map->usedGIDs);
+  } else {
+    delete digest;
+  }
+  return map;
+}
+
+//------------------------------------------------------------------------
+// PSPageWorker
+//------------------------------------------------------------------------
+
+#if MULTITHREADED
+
+// number of pages per thread that are generated before the buffers
+// are written out
+#define psPagesPerThread 4
+
+static void outputToGooString(void *stream, char *data, int len) {
+  ((GooString *)stream)->append(data, len);
+}
+
+// Pages being generated by PSOutputDev::displayPagesParallel.
+struct PSPageBatch {
+  PSOutputDev *parent;
+  int firstPage;		// first page of the document, for
+				//   sequential page numbers
+  int batchFirst, batchLast;	// pages in this batch
+  int nextPage;			// next page to be taken by a thread
+  GooString **bufs;		// [batchLast - batchFirst + 1]
+  PSOutputDev **pageOuts;	// [batchLast - batchFirst + 1]
+  double hDPI, vDPI;
+  int rotate;
+  GBool useMediaBox, crop, printing;
+  GooMutex mutex;
+};
+
+struct PSPageWorker {
+  PSPageBatch *batch;
+  PDFDoc *doc;			// this thread's copy of the document
+};
+
+// Take pages from the batch and generate each one into its buffer,
+// until there are none left.
+static void runPageWorker(PSPageWorker *worker) {
+  PSPageBatch *batch;
+  PDFDoc *doc;
+  int pg, i;
+
+  batch = worker->batch;
+  doc = worker->doc;
+  while (1) {
+    gLockMutex(&batch->mutex);
+    pg = batch->nextPage++;
+    gUnlockMutex(&batch->mutex);
+    if (pg > batch->batchLast) {
+      break;
+    }
+    i = pg - batch->batchFirst;
+    batch->bufs[i] = new GooString();
+    batch->pageOuts[i] = new PSOutputDev(outputToGooString, batch->bufs[i],
+					 batch->parent, doc,
+					 doc->getXRef(), doc->getCatalog());
+    batch->pageOuts[i]->setSeqPage(pg - batch->firstPage + 1);
+    doc->displayPage(batch->pageOuts[i], pg, batch->hDPI, batch->vDPI,
+		     batch->rotate, batch->useMediaBox, batch->crop,
+		     batch->printing);
+  }
+}
+
+static GOO_THREAD_FUNC(pageWorkerThread) {
+  runPageWorker((PSPageWorker *)arg);
+  GOO_THREAD_RETURN;
+}
+
+#endif // MULTITHREADED
+
 //------------------------------------------------------------------------
 // PSOutputDev
 //------------------------------------------------------------------------
@@ -994,6 +1281,8 @@ PSOutputDev::PSOutputDev(const char *fileName, PDFDoc *doc, XRef *xrefA, Catalog
   fontIDs = NULL;
   fontFileIDs = NULL;
   fontFileNames = NULL;
+  fontPrograms = NULL;
+  fontGlyphs = NULL;
   font8Info = NULL;
   font16Enc = NULL;
   imgIDs = NULL;
@@ -1006,6 +1295,7 @@ PSOutputDev::PSOutputDev(const char *fileName, PDFDoc *doc, XRef *xrefA, Catalog
   t3String = NULL;
 
   forceRasterize = forceRasterizeA;
+  pageWorker = gFalse;
 
   // open file or pipe
   if (!strcmp(fileName, "-")) {
@@ -1059,6 +1349,8 @@ PSOutputDev::PSOutputDev(PSOutputFunc outputFuncA, void *outputStreamA,
   fontIDs = NULL;
   fontFileIDs = NULL;
   fontFileNames = NULL;
+  fontPrograms = NULL;
+  fontGlyphs = NULL;
   font8Info = NULL;
   font16Enc = NULL;
   imgIDs = NULL;
@@ -1071,6 +1363,7 @@ PSOutputDev::PSOutputDev(PSOutputFunc outputFuncA, void *outputStreamA,
   t3String = NULL;
 
   forceRasterize = forceRasterizeA;
+  pageWorker = gFalse;
 
   init(outputFuncA, outputStreamA, psGeneric, psTitle,
        doc, xrefA, catalog, firstPage, lastPage, modeA,
@@ -1078,6 +1371,94 @@ PSOutputDev::PSOutputDev(PSOutputFunc outputFuncA, void *outputStreamA,
        paperWidthA, paperHeightA, duplexA);
 }
 
+PSOutputDev::PSOutputDev(PSOutputFunc outputFuncA, void *outputStreamA,
+			 PSOutputDev *parent,
+			 PDFDoc *doc, XRef *xrefA, Catalog *catalog) {
+  int i;
+
+  underlayCbk = NULL;
+  underlayCbkData = NULL;
+  overlayCbk = NULL;
+  overlayCbkData = NULL;
+
+  fontIDs = NULL;
+  fontFileIDs = NULL;
+  fontFileNames = NULL;
+  fontPrograms = NULL;
+  fontGlyphs = NULL;
+  font8Info = NULL;
+  font16Enc = NULL;
+  imgIDs = NULL;
+  formIDs = NULL;
+  xobjStack = NULL;
+  embFontList = NULL;
+  customColors = NULL;
+  haveTextClip = gFalse;
+  haveCSPattern = gFalse;
+  t3String = NULL;
+
+  forceRasterize = parent->forceRasterize;
+  pageWorker = gTrue;
+
+  init(outputFuncA, outputStreamA, psGeneric, NULL,
+       doc, xrefA, catalog, 1, 1, parent->mode,
+       parent->imgLLX, parent->imgLLY, parent->imgURX, parent->imgURY,
+       parent->manualCtrl, parent->paperWidth, parent->paperHeight, gFalse);
+
+  level = parent->level;
+  substFonts = parent->substFonts;
+  preload = parent->preload;
+  displayText = parent->displayText;
+  tx0 = parent->tx0;
+  ty0 = parent->ty0;
+  xScale0 = parent->xScale0;
+  yScale0 = parent->yScale0;
+  rotate0 = parent->rotate0;
+  clipLLX0 = parent->clipLLX0;
+  clipLLY0 = parent->clipLLY0;
+  clipURX0 = parent->clipURX0;
+  clipURY0 = parent->clipURY0;
+  epsX1 = parent->epsX1;
+  epsY1 = parent->epsY1;
+  epsX2 = parent->epsX2;
+  epsY2 = parent->epsY2;
+  prevWidth = parent->prevWidth;
+  prevHeight = parent->prevHeight;
+  // functions converted in the setup may still be used by forms and
+  // patterns, so their names must not be reused
+  nextFunc = parent->nextFunc;
+
+  // the tables the page content refers to
+  font8InfoLen = font8InfoSize = parent->font8InfoLen;
+  if (font8InfoSize > 0) {
+    font8Info = (PSFont8Info *)gmallocn(font8InfoSize, sizeof(PSFont8Info));
+    for (i = 0; i < font8InfoLen; ++i) {
+      font8Info[i].fontID = parent->font8Info[i].fontID;
+      font8Info[i].codeToGID = (Gushort *)gmallocn(256, sizeof(Gushort));
+      memcpy(font8Info[i].codeToGID, parent->font8Info[i].codeToGID,
+	     256 * sizeof(Gushort));
+    }
+  }
+  font16EncLen = font16EncSize = parent->font16EncLen;
+  if (font16EncSize > 0) {
+    font16Enc = (PSFont16Enc *)gmallocn(font16EncSize, sizeof(PSFont16Enc));
+    for (i = 0; i < font16EncLen; ++i) {
+      font16Enc[i].fontID = parent->font16Enc[i].fontID;
+      font16Enc[i].enc = parent->font16Enc[i].enc->copy();
+    }
+  }
+  imgIDLen = imgIDSize = parent->imgIDLen;
+  if (imgIDSize > 0) {
+    imgIDs = (Ref *)gmallocn(imgIDSize, sizeof(Ref));
+    memcpy(imgIDs, parent->imgIDs, imgIDLen * sizeof(Ref));
+  }
+  formIDLen = formIDSize = parent->formIDLen;
+  if (formIDSize > 0) {
+    formIDs = (Ref *)gmallocn(formIDSize, sizeof(Ref));
+    memcpy(formIDs, parent->formIDs, formIDLen * sizeof(Ref));
+  }
+}
+
 void PSOutputDev::init(PSOutputFunc outputFuncA, void *outputStreamA,
 		       PSFileType fileTypeA, char *pstitle, PDFDoc *doc, XRef *xrefA, Catalog *catalog,
 		       int firstPage, int lastPage, PSOutMode modeA,
@@ -1156,6 +1537,8 @@ void PSOutputDev::init(PSOutputFunc outputFuncA, void *outputStreamA,
   fontFileNames = (GooString **)gmallocn(fontFileNameSize, sizeof(GooString *));
   psFileNames = (GooString **)gmallocn(fontFileNameSize, sizeof(GooString *));
   nextTrueTypeNum = 0;
+  fontPrograms = new GooHash(gTrue);
+  fontGlyphs = new GooHash(gTrue);
   font8InfoLen = 0;
   font8InfoSize = 0;
   font16EncLen = 0;
@@ -1173,7 +1556,7 @@ void PSOutputDev::init(PSOutputFunc outputFuncA, void *outputStreamA,
   // initialize embedded font resource comment list
   embFontList = new GooString();
 
-  if (!manualCtrl) {
+  if (!manualCtrl && !pageWorker) {
     Page *page;
     // this check is needed in case the document has zero pages
     if ((page = doc->getPage(firstPage))) {
@@ -1208,10 +1591,13 @@ void PSOutputDev::init(PSOutputFunc outputFuncA, void *outputStreamA,
 
 PSOutputDev::~PSOutputDev() {
   PSOutCustomColor *cc;
+  GooHashIter *iter;
+  GooString *key;
+  void *glyphs;
   int i;
 
   if (ok) {
-    if (!manualCtrl) {
+    if (!manualCtrl && !pageWorker) {
       writePS("%%Trailer\n");
       writeTrailer();
       if (mode != psModeForm) {
@@ -1261,6 +1647,16 @@ PSOutputDev::~PSOutputDev() {
     }
     gfree(psFileNames);
   }
+  if (fontPrograms) {
+    deleteGooHash(fontPrograms, GooString);
+  }
+  if (fontGlyphs) {
+    fontGlyphs->startIter(&iter);
+    while (fontGlyphs->getNext(&iter, &key, &glyphs)) {
+      gfree(glyphs);
+    }
+    delete fontGlyphs;
+  }
   if (font16Enc) {
     for (i = 0; i < font16EncLen; ++i) {
       delete font16Enc[i].enc;
@@ -1421,6 +1817,9 @@ void PSOutputDev::writeDocSetup(PDFDoc *doc, Catalog *catalog,
   } else {
     writePS("xpdf begin\n");
   }
+  if (globalParams->getPSSubsetFonts() && !forceRasterize) {
+    scanFontGlyphs(doc, catalog, firstPage, lastPage);
+  }
   for (pg = firstPage; pg <= lastPage; ++pg) {
     page = doc->getPage(pg);
     if (!page) {
@@ -1430,8 +1829,7 @@ void PSOutputDev::writeDocSetup(PDFDoc *doc, Catalog *catalog,
     if ((resDict = page->getResourceDict())) {
       setupResources(resDict);
     }
-    annots = new Annots(xref, catalog, page->getAnnots(&obj1));
-    obj1.free();
+    annots = page->getAnnots(catalog);
     for (i = 0; i < annots->getNumAnnots(); ++i) {
       if (annots->getAnnot(i)->getAppearance(&obj1)->isStream()) {
 	obj1.streamGetDict()->lookup("Resources", &obj2);
@@ -1442,7 +1840,6 @@ void PSOutputDev::writeDocSetup(PDFDoc *doc, Catalog *catalog,
       }
       obj1.free();
     }
-    delete annots;
   }
   if (mode != psModeForm) {
     if (mode != psModeEPS && !manualCtrl) {
@@ -1457,6 +1854,220 @@ void PSOutputDev::writeDocSetup(PDFDoc *doc, Catalog *catalog,
   }
 }
 
+// Find the glyphs that the pages use in each embedded TrueType font,
+// so that only those are embedded.  This has to be done before any
+// fonts are set up, since a font program shared by several fonts is
+// embedded only once.  Only the pages whose resources include an
+// embedded TrueType font are run through the scanner; for the others,
+// and for documents without such fonts, the scan costs a walk of the
+// resource dictionaries, like the one setupResources() does anyway.
+void PSOutputDev::scanFontGlyphs(PDFDoc *doc, Catalog *catalog,
+				 int firstPage, int lastPage) {
+  PSFontGlyphScanner *scanner;
+  RefHash *visited;
+  Page *page;
+  Dict *resDict;
+  Annots *annots;
+  Object obj1, obj2;
+  GBool scan;
+  int pg, i;
+
+  scanner = NULL;
+  for (pg = firstPage; pg <= lastPage; ++pg) {
+    if (!(page = doc->getPage(pg))) {
+      continue;
+    }
+    visited = new RefHash();
+    scan = (resDict = page->getResourceDict()) &&
+           usesEmbeddedTrueType(resDict, visited);
+    annots = page->getAnnots(catalog);
+    for (i = 0; !scan && i < annots->getNumAnnots(); ++i) {
+      if (annots->getAnnot(i)->getAppearance(&obj1)->isStream()) {
+	obj1.streamGetDict()->lookup("Resources", &obj2);
+	scan = obj2.isDict() && usesEmbeddedTrueType(obj2.getDict(), visited);
+	obj2.free();
+      }
+      obj1.free();
+    }
+    delete visited;
+    if (scan) {
+      if (!scanner) {
+	scanner = new PSFontGlyphScanner(xref, catalog, fontGlyphs);
+      }
+      page->display(scanner, 72, 72, 0, gTrue, gFalse, gTrue, catalog);
+    }
+  }
+  delete scanner;
+}
+
+// Check if the resources in <resDict>, or those of the forms,
+// patterns and Type 3 fonts they use, include an embedded TrueType
+// font.  Objects already in <visited> are skipped.
+GBool PSOutputDev::usesEmbeddedTrueType(Dict *resDict, RefHash *visited) {
+  const char *keys[3] = { "Font", "XObject", "Pattern" };
+  Object dict, ref, obj, resObj;
+  GBool found;
+  int k, i;
+
+  found = gFalse;
+  for (k = 0; !found && k < 3; ++k) {
+    resDict->lookup((char *)keys[k], &dict);
+    for (i = 0; !found && dict.isDict() && i < dict.dictGetLength(); ++i) {
+      if (dict.dictGetValNF(i, &ref)->isRef()) {
+	if (visited->contains(ref.getRef())) {
+	  ref.free();
+	  continue;
+	}
+	visited->add(ref.getRef(), 1);
+      }
+      ref.free();
+      dict.dictGetVal(i, &obj);
+      if (k == 0) {
+	found = obj.isDict() && isEmbeddedTrueType(obj.getDict(), visited);
+      } else if (obj.isStream()) {
+	obj.streamGetDict()->lookup("Resources", &resObj);
+	found = resObj.isDict() &&
+	        usesEmbeddedTrueType(resObj.getDict(), visited);
+	resObj.free();
+      }
+      obj.free();
+    }
+    dict.free();
+  }
+  return found;
+}
+
+// Check if <fontDict> is a font that the scanner collects glyphs for,
+// i.e., one with an embedded TrueType or OpenType program, or a Type 3
+// font whose glyphs use one.
+GBool PSOutputDev::isEmbeddedTrueType(Dict *fontDict, RefHash *visited) {
+  Object obj1, obj2, obj3;
+  GBool found;
+
+  found = gFalse;
+  fontDict->lookup("Subtype", &obj1);
+  if (obj1.isName("Type3")) {
+    fontDict->lookup("Resources", &obj2);
+    found = obj2.isDict() && usesEmbeddedTrueType(obj2.getDict(), visited);
+    obj2.free();
+    obj1.free();
+    return found;
+  }
+  if (obj1.isName("Type0")) {
+    fontDict->lookup("DescendantFonts", &obj2);
+    if (obj2.isArray() && obj2.arrayGetLength() > 0) {
+      obj2.arrayGet(0, &obj3);
+      if (obj3.isDict()) {
+	found = isEmbeddedTrueType(obj3.getDict(), visited);
+      }
+      obj3.free();
+    }
+    obj2.free();
+    obj1.free();
+    return found;
+  }
+  obj1.free();
+
+  // GfxFont goes by the embedded program, not by the font subtype
+  fontDict->lookup("FontDescriptor", &obj1);
+  if (obj1.isDict()) {
+    found = obj1.dictLookupNF("FontFile2", &obj2)->isRef();
+    obj2.free();
+    if (!found && obj1.dictLookup("FontFile3", &obj2)->isStream()) {
+      obj2.streamGetDict()->lookup("Subtype", &obj3);
+      found = obj3.isName("OpenType");
+      obj3.free();
+    }
+    obj2.free();
+  }
+  obj1.free();
+  return found;
+}
+
+void PSOutputDev::displayPagesParallel(PDFDoc **docs, int nDocs,
+				       int firstPage, int lastPage,
+				       double hDPI, double vDPI, int rotate,
+				       GBool useMediaBox, GBool crop,
+				       GBool printing) {
+#if MULTITHREADED
+  PSPageBatch batch;
+  PSPageWorker *workers;
+  GooThread *threads;
+  GBool *started;
+  int batchSize, i;
+
+  if (nDocs < 2 || mode != psModePS || underlayCbk || overlayCbk ||
+      firstPage >= lastPage) {
+    docs[0]->displayPages(this, firstPage, lastPage, hDPI, vDPI, rotate,
+			  useMediaBox, crop, printing);
+    return;
+  }
+
+  batchSize = nDocs * psPagesPerThread;
+  batch.parent = this;
+  batch.firstPage = firstPage;
+  batch.bufs = (GooString **)gmallocn(batchSize, sizeof(GooString *));
+  batch.pageOuts = (PSOutputDev **)gmallocn(batchSize, sizeof(PSOutputDev *));
+  batch.hDPI = hDPI;
+  batch.vDPI = vDPI;
+  batch.rotate = rotate;
+  batch.useMediaBox = useMediaBox;
+  batch.crop = crop;
+  batch.printing = printing;
+  gInitMutex(&batch.mutex);
+  workers = (PSPageWorker *)gmallocn(nDocs, sizeof(PSPageWorker));
+  threads = (GooThread *)gmallocn(nDocs, sizeof(GooThread));
+  started = (GBool *)gmallocn(nDocs, sizeof(GBool));
+  for (i = 0; i < nDocs; ++i) {
+    workers[i].batch = &batch;
+    workers[i].doc = docs[i];
+  }
+
+  for (batch.batchFirst = firstPage;
+       batch.batchFirst <= lastPage;
+       batch.batchFirst += batchSize) {
+    batch.batchLast = batch.batchFirst + batchSize - 1;
+    if (batch.batchLast > lastPage) {
+      batch.batchLast = lastPage;
+    }
+    batch.nextPage = batch.batchFirst;
+    for (i = 0; i <= batch.batchLast - batch.batchFirst; ++i) {
+      batch.bufs[i] = NULL;
+      batch.pageOuts[i] = NULL;
+    }
+
+    // worker 0 runs on this thread
+    for (i = 1; i < nDocs; ++i) {
+      started[i] = gCreateThread(&threads[i], pageWorkerThread, &workers[i]);
+    }
+    runPageWorker(&workers[0]);
+    for (i = 1; i < nDocs; ++i) {
+      if (started[i]) {
+	gJoinThread(threads[i]);
+      }
+    }
+
+    // write the pages in order
+    for (i = 0; i <= batch.batchLast - batch.batchFirst; ++i) {
+      writePSBuf(batch.bufs[i]->getCString(), batch.bufs[i]->getLength());
+      addPageColors(batch.pageOuts[i]);
+      delete batch.pageOuts[i];
+      delete batch.bufs[i];
+    }
+  }
+
+  gfree(started);
+  gfree(threads);
+  gfree(workers);
+  gDestroyMutex(&batch.mutex);
+  gfree(batch.bufs);
+  gfree(batch.pageOuts);
+#else
+  docs[0]->displayPages(this, firstPage, lastPage, hDPI, vDPI, rotate,
+			useMediaBox, crop, printing);
+#endif
+}
+
 void PSOutputDev::writePageTrailer() {
   if (mode != psModeForm) {
     writePS("pdfEndPage\n");
@@ -1676,7 +2287,7 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict) {
 	     font->getEmbeddedFontID(&fontFileID) &&
 	     font->getEmbeddedFontName()) {
     psName = font->getEmbeddedFontName()->sanitizedName(gTrue /* ps mode */);
-    setupEmbeddedType1Font(&fontFileID, psName);
+    setupEmbeddedType1Font(font, &fontFileID, psName);
 
   // check for embedded Type 1C font
   } else if (globalParams->getPSEmbedType1() &&
@@ -1910,7 +2521,64 @@ void PSOutputDev::setupFont(GfxFont *font, Dict *parentResDict) {
   delete psName;
 }
 
-void PSOutputDev::setupEmbeddedType1Font(Ref *id, GooString *psName) {
+// Build the key under which a font program is recorded in
+// fontPrograms: <kind>, which identifies the conversion, and the
+// digest of the program.  The digest alone is returned in <digest>
+// if it is non-NULL.  Returns NULL if the program couldn't be read.
+GooString *PSOutputDev::makeFontProgramKey(const char *kind,
+					   char *fontBuf, int fontLen,
+					   GooString **digest) {
+  GooString *key, *d;
+
+  if (digest) {
+    *digest = NULL;
+  }
+  if (!fontBuf) {
+    return NULL;
+  }
+  d = getFontDigest(fontBuf, fontLen);
+  key = new GooString(kind);
+  key->append(':')->append(d);
+  if (digest) {
+    *digest = d;
+  } else {
+    delete d;
+  }
+  return key;
+}
+
+// If a font program with the key <key> has already been embedded,
+// set <psName> to the name it was embedded under and return true.
+GBool PSOutputDev::findFontProgram(GooString *key, GooString *psName) {
+  GooString *name;
+
+  if (!(name = (GooString *)fontPrograms->lookup(key))) {
+    return gFalse;
+  }
+  psName->clear()->append(name);
+  return gTrue;
+}
+
+// Record that the font program with the key <key> has been embedded
+// as <psName>.  Takes ownership of <key>.
+void PSOutputDev::addFontProgram(GooString *key, GooString *psName) {
+  fontPrograms->add(key, psName->copy());
+}
+
+void PSOutputDev::addFont8Info(GfxFont *font, Gushort *codeToGID) {
+  if (font8InfoLen >= font8InfoSize) {
+    font8InfoSize += 16;
+    font8Info = (PSFont8Info *)greallocn(font8Info,
+					 font8InfoSize,
+					 sizeof(PSFont8Info));
+  }
+  font8Info[font8InfoLen].fontID = *font->getID();
+  font8Info[font8InfoLen].codeToGID = codeToGID;
+  ++font8InfoLen;
+}
+
+void PSOutputDev::setupEmbeddedType1Font(GfxFont *font, Ref *id,
+					 GooString *psName) {
   static const char hexChar[17] = "0123456789abcdef";
   Object refObj, strObj, obj1, obj2, obj3;
   Dict *dict;
@@ -1919,6 +2587,9 @@ void PSOutputDev::setupEmbeddedType1Font(Ref *id, GooString *psName) {
   int start[4];
   GBool binMode;
   GBool writePadding = gTrue;
+  GooString *key;
+  char *fontBuf;
+  int fontLen;
   int i;
 
   // check if font is already embedded
@@ -1928,12 +2599,24 @@ void PSOutputDev::setupEmbeddedType1Font(Ref *id, GooString *psName) {
       return;
   }
 
+  // check if an identical copy of the font has been embedded
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  key = makeFontProgramKey("Type1", fontBuf, fontLen, NULL);
+  gfree(fontBuf);
+  if (key && findFontProgram(key, psName)) {
+    delete key;
+    return;
+  }
+
   // add entry to fontFileIDs list
   if (fontFileIDLen >= fontFileIDSize) {
     fontFileIDSize += 64;
     fontFileIDs = (Ref *)greallocn(fontFileIDs, fontFileIDSize, sizeof(Ref));
   }
   fontFileIDs[fontFileIDLen++] = *id;
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // get the font stream and info
   refObj.initRef(id->num, id->gen);
@@ -2114,6 +2797,7 @@ void PSOutputDev::setupEmbeddedType1CFont(GfxFont *font, Ref *id,
 					  GooString *psName) {
   char *fontBuf;
   int fontLen;
+  GooString *key;
   FoFiType1C *ffT1C;
   int i;
 
@@ -2124,12 +2808,24 @@ void PSOutputDev::setupEmbeddedType1CFont(GfxFont *font, Ref *id,
       return;
   }
 
+  // check if an identical copy of the font has been embedded
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  key = makeFontProgramKey("Type1C", fontBuf, fontLen, NULL);
+  if (key && findFontProgram(key, psName)) {
+    delete key;
+    gfree(fontBuf);
+    return;
+  }
+
   // add entry to fontFileIDs list
   if (fontFileIDLen >= fontFileIDSize) {
     fontFileIDSize += 64;
     fontFileIDs = (Ref *)greallocn(fontFileIDs, fontFileIDSize, sizeof(Ref));
   }
   fontFileIDs[fontFileIDLen++] = *id;
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // beginning comment
   writePSFmt("%%BeginResource: font {0:t}\n", psName);
@@ -2138,7 +2834,6 @@ void PSOutputDev::setupEmbeddedType1CFont(GfxFont *font, Ref *id,
   embFontList->append("\n");
 
   // convert it to a Type 1 font
-  fontBuf = font->readEmbFontFile(xref, &fontLen);
   if ((ffT1C = FoFiType1C::make(fontBuf, fontLen))) {
     ffT1C->convertToType1(psName->getCString(), NULL, gTrue,
 			  outputFunc, outputStream);
@@ -2154,6 +2849,7 @@ void PSOutputDev::setupEmbeddedOpenTypeT1CFont(GfxFont *font, Ref *id,
 					       GooString *psName) {
   char *fontBuf;
   int fontLen;
+  GooString *key;
   FoFiTrueType *ffTT;
   int i;
 
@@ -2164,12 +2860,24 @@ void PSOutputDev::setupEmbeddedOpenTypeT1CFont(GfxFont *font, Ref *id,
       return;
   }
 
+  // check if an identical copy of the font has been embedded
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  key = makeFontProgramKey("OpenTypeType1C", fontBuf, fontLen, NULL);
+  if (key && findFontProgram(key, psName)) {
+    delete key;
+    gfree(fontBuf);
+    return;
+  }
+
   // add entry to fontFileIDs list
   if (fontFileIDLen >= fontFileIDSize) {
     fontFileIDSize += 64;
     fontFileIDs = (Ref *)greallocn(fontFileIDs, fontFileIDSize, sizeof(Ref));
   }
   fontFileIDs[fontFileIDLen++] = *id;
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // beginning comment
   writePSFmt("%%BeginResource: font {0:t}\n", psName);
@@ -2178,7 +2886,6 @@ void PSOutputDev::setupEmbeddedOpenTypeT1CFont(GfxFont *font, Ref *id,
   embFontList->append("\n");
 
   // convert it to a Type 1 font
-  fontBuf = font->readEmbFontFile(xref, &fontLen);
   if ((ffTT = FoFiTrueType::make(fontBuf, fontLen))) {
     if (ffTT->isOpenTypeCFF()) {
       ffTT->convertToType1(psName->getCString(), NULL, gTrue,
@@ -2196,10 +2903,40 @@ void PSOutputDev::setupEmbeddedTrueTypeFont(GfxFont *font, Ref *id,
 					    GooString *psName) {
   char *fontBuf;
   int fontLen;
+  GooString *key, *digest;
   FoFiTrueType *ffTT;
   Gushort *codeToGID;
+  char **encoding;
+  char *name;
   int i;
 
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  ffTT = FoFiTrueType::make(fontBuf, fontLen);
+  codeToGID = ffTT ? ((Gfx8BitFont *)font)->getCodeToGIDMap(ffTT) : NULL;
+  encoding = ((Gfx8BitFont *)font)->getHasEncoding()
+               ? ((Gfx8BitFont *)font)->getEncoding()
+               : (char **)NULL;
+
+  // check if an identical copy of the font, with the same encoding,
+  // has been embedded
+  key = NULL;
+  digest = NULL;
+  if (codeToGID) {
+    key = makeFontProgramKey("TrueType", fontBuf, fontLen, &digest);
+    for (i = 0; i < 256; ++i) {
+      name = encoding && encoding[i] ? encoding[i] : (char *)"";
+      key->appendf(" {0:d}/{1:s}", codeToGID[i], name);
+    }
+    if (findFontProgram(key, psName)) {
+      addFont8Info(font, codeToGID);
+      delete key;
+      delete digest;
+      delete ffTT;
+      gfree(fontBuf);
+      return;
+    }
+  }
+
   // check if font is already embedded
   for (i = 0; i < fontFileIDLen; ++i) {
     if (fontFileIDs[i].num == id->num &&
@@ -2217,6 +2954,9 @@ void PSOutputDev::setupEmbeddedTrueTypeFont(GfxFont *font, Ref *id,
     }
     fontFileIDs[fontFileIDLen++] = *id;
   }
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // beginning comment
   writePSFmt("%%BeginResource: font {0:t}\n", psName);
@@ -2225,27 +2965,17 @@ void PSOutputDev::setupEmbeddedTrueTypeFont(GfxFont *font, Ref *id,
   embFontList->append("\n");
 
   // convert it to a Type 42 font
-  fontBuf = font->readEmbFontFile(xref, &fontLen);
-  if ((ffTT = FoFiTrueType::make(fontBuf, fontLen))) {
-    codeToGID = ((Gfx8BitFont *)font)->getCodeToGIDMap(ffTT);
-    ffTT->convertToType42(psName->getCString(),
-			  ((Gfx8BitFont *)font)->getHasEncoding()
-			    ? ((Gfx8BitFont *)font)->getEncoding()
-			    : (char **)NULL,
-			  codeToGID, outputFunc, outputStream);
+  if (ffTT) {
+    ffTT->convertToType42(psName->getCString(), encoding,
+			  codeToGID, outputFunc, outputStream,
+			  digest ? (Guchar *)fontGlyphs->lookup(digest)
+			         : (Guchar *)NULL);
     if (codeToGID) {
-      if (font8InfoLen >= font8InfoSize) {
-	font8InfoSize += 16;
-	font8Info = (PSFont8Info *)greallocn(font8Info,
-					     font8InfoSize,
-					     sizeof(PSFont8Info));
-      }
-      font8Info[font8InfoLen].fontID = *font->getID();
-      font8Info[font8InfoLen].codeToGID = codeToGID;
-      ++font8InfoLen;
+      addFont8Info(font, codeToGID);
     }
     delete ffTT;
   }
+  delete digest;
   gfree(fontBuf);
 
   // ending comment
@@ -2398,6 +3128,7 @@ void PSOutputDev::setupEmbeddedCIDType0Font(GfxFont *font, Ref *id,
 					    GooString *psName) {
   char *fontBuf;
   int fontLen;
+  GooString *key;
   FoFiType1C *ffT1C;
   int i;
 
@@ -2408,12 +3139,24 @@ void PSOutputDev::setupEmbeddedCIDType0Font(GfxFont *font, Ref *id,
       return;
   }
 
+  // check if an identical copy of the font has been embedded
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  key = makeFontProgramKey("CIDType0", fontBuf, fontLen, NULL);
+  if (key && findFontProgram(key, psName)) {
+    delete key;
+    gfree(fontBuf);
+    return;
+  }
+
   // add entry to fontFileIDs list
   if (fontFileIDLen >= fontFileIDSize) {
     fontFileIDSize += 64;
     fontFileIDs = (Ref *)greallocn(fontFileIDs, fontFileIDSize, sizeof(Ref));
   }
   fontFileIDs[fontFileIDLen++] = *id;
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // beginning comment
   writePSFmt("%%BeginResource: font {0:t}\n", psName);
@@ -2422,7 +3165,6 @@ void PSOutputDev::setupEmbeddedCIDType0Font(GfxFont *font, Ref *id,
   embFontList->append("\n");
 
   // convert it to a Type 0 font
-  fontBuf = font->readEmbFontFile(xref, &fontLen);
   if ((ffT1C = FoFiType1C::make(fontBuf, fontLen))) {
     if (globalParams->getPSLevel() >= psLevel3) {
       // Level 3: use a CID font
@@ -2444,9 +3186,37 @@ void PSOutputDev::setupEmbeddedCIDTrueTypeFont(GfxFont *font, Ref *id,
 					       GBool needVerticalMetrics) {
   char *fontBuf;
   int fontLen;
+  GooString *key, *digest, *mapDigest;
   FoFiTrueType *ffTT;
+  Gushort *cidToGID;
+  Guchar *usedGIDs;
+  int cidToGIDLen;
   int i;
 
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  cidToGID = ((GfxCIDFont *)font)->getCIDToGID();
+  cidToGIDLen = ((GfxCIDFont *)font)->getCIDToGIDLen();
+
+  // check if an identical copy of the font, with the same CID to GID
+  // map, has been embedded
+  key = makeFontProgramKey(needVerticalMetrics ? "CIDTrueTypeV"
+			                       : "CIDTrueType",
+			   fontBuf, fontLen, &digest);
+  if (key) {
+    if (cidToGID) {
+      mapDigest = getFontDigest((char *)cidToGID,
+				cidToGIDLen * sizeof(Gushort));
+      key->append(':')->append(mapDigest);
+      delete mapDigest;
+    }
+    if (findFontProgram(key, psName)) {
+      delete key;
+      delete digest;
+      gfree(fontBuf);
+      return;
+    }
+  }
+
   // check if font is already embedded
   for (i = 0; i < fontFileIDLen; ++i) {
     if (fontFileIDs[i].num == id->num &&
@@ -2462,6 +3232,9 @@ void PSOutputDev::setupEmbeddedCIDTrueTypeFont(GfxFont *font, Ref *id,
     fontFileIDs = (Ref *)greallocn(fontFileIDs, fontFileIDSize, sizeof(Ref));
   }
   fontFileIDs[fontFileIDLen++] = *id;
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // beginning comment
   writePSFmt("%%BeginResource: font {0:t}\n", psName);
@@ -2470,25 +3243,24 @@ void PSOutputDev::setupEmbeddedCIDTrueTypeFont(GfxFont *font, Ref *id,
   embFontList->append("\n");
 
   // convert it to a Type 0 font
-  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  usedGIDs = digest ? (Guchar *)fontGlyphs->lookup(digest) : (Guchar *)NULL;
   if ((ffTT = FoFiTrueType::make(fontBuf, fontLen))) {
     if (globalParams->getPSLevel() >= psLevel3) {
       // Level 3: use a CID font
       ffTT->convertToCIDType2(psName->getCString(),
-			      ((GfxCIDFont *)font)->getCIDToGID(),
-			      ((GfxCIDFont *)font)->getCIDToGIDLen(),
+			      cidToGID, cidToGIDLen,
 			      needVerticalMetrics,
-			      outputFunc, outputStream);
+			      outputFunc, outputStream, usedGIDs);
     } else {
       // otherwise: use a non-CID composite font
       ffTT->convertToType0(psName->getCString(),
-			   ((GfxCIDFont *)font)->getCIDToGID(),
-			   ((GfxCIDFont *)font)->getCIDToGIDLen(),
+			   cidToGID, cidToGIDLen,
 			   needVerticalMetrics,
-			   outputFunc, outputStream);
+			   outputFunc, outputStream, usedGIDs);
     }
     delete ffTT;
   }
+  delete digest;
   gfree(fontBuf);
 
   // ending comment
@@ -2499,6 +3271,7 @@ void PSOutputDev::setupEmbeddedOpenTypeCFFFont(GfxFont *font, Ref *id,
 					       GooString *psName) {
   char *fontBuf;
   int fontLen;
+  GooString *key;
   FoFiTrueType *ffTT;
   int i;
 
@@ -2509,12 +3282,24 @@ void PSOutputDev::setupEmbeddedOpenTypeCFFFont(GfxFont *font, Ref *id,
       return;
   }
 
+  // check if an identical copy of the font has been embedded
+  fontBuf = font->readEmbFontFile(xref, &fontLen);
+  key = makeFontProgramKey("OpenTypeCFF", fontBuf, fontLen, NULL);
+  if (key && findFontProgram(key, psName)) {
+    delete key;
+    gfree(fontBuf);
+    return;
+  }
+
   // add entry to fontFileIDs list
   if (fontFileIDLen >= fontFileIDSize) {
     fontFileIDSize += 64;
     fontFileIDs = (Ref *)greallocn(fontFileIDs, fontFileIDSize, sizeof(Ref));
   }
   fontFileIDs[fontFileIDLen++] = *id;
+  if (key) {
+    addFontProgram(key, psName);
+  }
 
   // beginning comment
   writePSFmt("%%BeginResource: font {0:t}\n", psName);
@@ -2523,7 +3308,6 @@ void PSOutputDev::setupEmbeddedOpenTypeCFFFont(GfxFont *font, Ref *id,
   embFontList->append("\n");
 
   // convert it to a Type 0 font
-  fontBuf = font->readEmbFontFile(xref, &fontLen);
   if ((ffTT = FoFiTrueType::make(fontBuf, fontLen))) {
     if (ffTT->isOpenTypeCFF()) {
       if (globalParams->getPSLevel() >= psLevel3) {
@@ -3684,6 +4468,35 @@ void PSOutputDev::addCustomColor(GfxSeparationColorSpace *sepCS) {
   customColors = cc;
 }
 
+void PSOutputDev::addPageColors(PSOutputDev *pageOut) {
+  PSOutCustomColor *cc, *cc2, *list;
+
+  processColors |= pageOut->processColors;
+
+  // pageOut's list is newest first -- reverse it, so the colors are
+  // added in the order in which they were first used
+  list = NULL;
+  while ((cc = pageOut->customColors)) {
+    pageOut->customColors = cc->next;
+    cc->next = list;
+    list = cc;
+  }
+  while ((cc = list)) {
+    list = cc->next;
+    for (cc2 = customColors; cc2; cc2 = cc2->next) {
+      if (!cc2->name->cmp(cc->name)) {
+	break;
+      }
+    }
+    if (cc2) {
+      delete cc;
+    } else {
+      cc->next = customColors;
+      customColors = cc;
+    }
+  }
+}
+
 void PSOutputDev::updateFillOverprint(GfxState *state) {
   if (level >= psLevel2) {
     writePSFmt("{0:s} op\n", state->getFillOverprint() ? "true" : "false");
@@ -4900,8 +5713,7 @@ void PSOutputDev::doImageL2(Object *ref, GfxImageColorMap *colorMap,
   GfxCMYK cmyk;
   int c;
   int col, i, j, x0, x1, y;
-  char dataBuf[4096];
-  
+
   rectsOutLen = 0;
 
   // color key masking
@@ -5299,17 +6111,7 @@ void PSOutputDev::doImageL2(Object *ref, GfxImageColorMap *colorMap,
 
     // copy the stream data
     str->reset();
-    i = 0;
-    while ((c = str->getChar()) != EOF) {
-      dataBuf[i++] = c;
-      if (i >= (int)sizeof(dataBuf)) {
-	writePSBuf(dataBuf, i);
-	i = 0;
-      }
-    }
-    if (i > 0) {
-      writePSBuf(dataBuf, i);
-    }
+    copyStream(str);
     str->close();
 
     // add newline and trailer to the end
@@ -5619,9 +6421,7 @@ void PSOutputDev::doImageL3(Object *ref, GfxImageColorMap *colorMap,
 
     // copy the stream data
     maskStr->reset();
-    while ((c = maskStr->getChar()) != EOF) {
-      writePSChar(c);
-    }
+    copyStream(maskStr);
     maskStr->close();
     writePSChar('\n');
 
@@ -5665,9 +6465,7 @@ void PSOutputDev::doImageL3(Object *ref, GfxImageColorMap *colorMap,
 
     // copy the stream data
     str->reset();
-    while ((c = str->getChar()) != EOF) {
-      writePSChar(c);
-    }
+    copyStream(str);
     str->close();
 
     // add newline and trailer to the end
@@ -6570,6 +7368,16 @@ void PSOutputDev::writePSFmt(const char *fmt, ...) {
   va_end(args);
 }
 
+// Write the rest of <str>, which has been reset, as it is.
+void PSOutputDev::copyStream(Stream *str) {
+  Guchar buf[4096];
+  int n;
+
+  while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+    writePSBuf((char *)buf, n);
+  }
+}
+
 void PSOutputDev::writePSString(GooString *s) {
   Guchar *p;
   int n, line;
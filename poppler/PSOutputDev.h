@@ -52,6 +52,8 @@ struct PSFont16Enc;
 class PSOutCustomColor;
 class Function;
 class PDFDoc;
+class GooHash;
+class RefHash;
 
 //------------------------------------------------------------------------
 // PSOutputDev
@@ -100,12 +102,36 @@ public:
 	      GBool forceRasterizeA = gFalse,
 	      GBool manualCtrlA = gFalse);
 
+  // Open a PSOutputDev that writes only pages, to a generic stream,
+  // for a document whose prolog and setup were written by <parent>.
+  // This is used to generate pages on several threads: <doc>,
+  // <xrefA>, and <catalog> belong to a separate copy of the parent's
+  // document, and the page bodies are written out in order by the
+  // caller.  No header or trailer is written.
+  PSOutputDev(PSOutputFunc outputFuncA, void *outputStreamA,
+	      PSOutputDev *parent,
+	      PDFDoc *doc, XRef *xrefA, Catalog *catalog);
+
   // Destructor -- writes the trailer and closes the file.
   virtual ~PSOutputDev();
 
   // Check if file was successfully created.
   virtual GBool isOk() { return ok; }
 
+  // Write pages <firstPage> .. <lastPage>, like
+  // PDFDoc::displayPages(), with one thread for each of the <nDocs>
+  // documents in <docs>, which are separately opened copies of the
+  // document this device was created for (docs[0] may be that
+  // document itself).  Each page is
+  // generated into a buffer by a page device (see above) and the
+  // buffers are written in page order.  Only psModePS output is
+  // generated in parallel; with other modes, or without thread
+  // support, the pages are written by this device from docs[0].
+  void displayPagesParallel(PDFDoc **docs, int nDocs,
+			    int firstPage, int lastPage,
+			    double hDPI, double vDPI, int rotate,
+			    GBool useMediaBox, GBool crop, GBool printing);
+
   //---- get info about output device
 
   // Does this device use upside-down coordinates?
@@ -276,6 +302,8 @@ public:
     { rotate0 = rotateA; }
   void setClip(double llx, double lly, double urx, double ury)
     { clipLLX0 = llx; clipLLY0 = lly; clipURX0 = urx; clipURY0 = ury; }
+  void setSeqPage(int seqPageA)
+    { seqPage = seqPageA; }
   void setUnderlayCbk(void (*cbk)(PSOutputDev *psOut, void *data),
 		      void *data)
     { underlayCbk = cbk; underlayCbkData = data; }
@@ -292,10 +320,11 @@ private:
 	    int imgLLXA, int imgLLYA, int imgURXA, int imgURYA,
 	    GBool manualCtrlA, int paperWidthA, int paperHeightA,
             GBool duplexA);
+  void addPageColors(PSOutputDev *pageOut);
   void setupResources(Dict *resDict);
   void setupFonts(Dict *resDict);
   void setupFont(GfxFont *font, Dict *parentResDict);
-  void setupEmbeddedType1Font(Ref *id, GooString *psName);
+  void setupEmbeddedType1Font(GfxFont *font, Ref *id, GooString *psName);
   void setupExternalType1Font(GooString *fileName, GooString *psName);
   void setupEmbeddedType1CFont(GfxFont *font, Ref *id, GooString *psName);
   void setupEmbeddedOpenTypeT1CFont(GfxFont *font, Ref *id, GooString *psName);
@@ -307,6 +336,11 @@ private:
   void setupEmbeddedOpenTypeCFFFont(GfxFont *font, Ref *id, GooString *psName);
   GooString *setupExternalCIDTrueTypeFont(GfxFont *font, GooString *fileName, int faceIndex = 0);
   void setupType3Font(GfxFont *font, GooString *psName, Dict *parentResDict);
+  GooString *makeFontProgramKey(const char *kind, char *fontBuf, int fontLen,
+				GooString **digest);
+  GBool findFontProgram(GooString *key, GooString *psName);
+  void addFontProgram(GooString *key, GooString *psName);
+  void addFont8Info(GfxFont *font, Gushort *codeToGID);
   void setupImages(Dict *resDict);
   void setupImage(Ref id, Stream *str);
   void setupForms(Dict *resDict);
@@ -348,10 +382,15 @@ private:
 
   // Write the document-level setup.
   void writeDocSetup(PDFDoc *doc, Catalog *catalog, int firstPage, int lastPage, GBool duplexA);
+  void scanFontGlyphs(PDFDoc *doc, Catalog *catalog,
+		      int firstPage, int lastPage);
+  GBool usesEmbeddedTrueType(Dict *resDict, RefHash *visited);
+  GBool isEmbeddedTrueType(Dict *fontDict, RefHash *visited);
 
   void writePSChar(char c);
   void writePS(char *s);
   void writePSBuf(char *s, int len);
+  void copyStream(Stream *str);
   void writePSFmt(const char *fmt, ...);
   void writePSString(GooString *s);
   void writePSName(char *s);
@@ -376,6 +415,7 @@ private:
   void *outputStream;
   PSFileType fileType;		// file / pipe / stdout
   GBool manualCtrl;
+  GBool pageWorker;		// only writes pages, see the constructor
   int seqPage;			// current sequential page number
   void (*underlayCbk)(PSOutputDev *psOut, void *data);
   void *underlayCbkData;
@@ -397,6 +437,12 @@ private:
   int fontFileNameSize;		// size of fontFileNames array
   int nextTrueTypeNum;		// next unique number to append to a TrueType
 				//   font name
+  GooHash *fontPrograms;	// names of all embedded font programs,
+				//   indexed by kind and content digest
+				//   [GooString]
+  GooHash *fontGlyphs;		// glyphs used in each TrueType font
+				//   program, indexed by content digest;
+				//   empty unless fonts are subset [Guchar *]
   PSFont8Info *font8Info;	// info for 8-bit fonts
   int font8InfoLen;		// number of entries in font8Info array
   int font8InfoSize;		// size of font8Info array
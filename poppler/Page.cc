@@ -255,6 +255,14 @@ GBool PageAttrs::readBox(Dict *dict, char *key, PDFRectangle *box) {
 // Page
 //------------------------------------------------------------------------
 
+#if MULTITHREADED
+#  define lockPage   gLockMutex(&mutex)
+#  define unlockPage gUnlockMutex(&mutex)
+#else
+#  define lockPage
+#  define unlockPage
+#endif
+
 Page::Page(XRef *xrefA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attrsA, Form *form) {
   Object tmp;
 	
@@ -263,6 +271,11 @@ Page::Page(XRef *xrefA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attrs
   num = numA;
   duration = -1;
   pageWidgets = NULL;
+  annotList = NULL;
+  contentCache = NULL;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 
   pageObj.initDict(pageDict);
   pageRef = pageRefA;
@@ -338,7 +351,12 @@ Page::Page(XRef *xrefA, int numA, Dict *pageDict, Ref pageRefA, PageAttrs *attrs
 }
 
 Page::~Page() {
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
   delete pageWidgets;
+  delete annotList;
+  delete contentCache;
   delete attrs;
   pageObj.free();
   annots.free();
@@ -349,18 +367,28 @@ Page::~Page() {
 }
 
 Annots *Page::getAnnots(Catalog *catalog) {
-  Annots *annots;
   Object obj;
 
-  annots = new Annots(xref, catalog, getAnnots(&obj));
-  obj.free();
-  return annots;
+  lockPage;
+  if (!annotList) {
+    annotList = new Annots(xref, catalog, getAnnots(&obj));
+    obj.free();
+  }
+  unlockPage;
+  return annotList;
 }
 
 void Page::addAnnot(Annot *annot) {
   Object obj1;
   Object tmp;
   Ref annotRef = annot->getRef ();
+  int i;
+
+  lockPage;
+  if (annotList && annotList->contains(annot)) {
+    unlockPage;
+    return;
+  }
 
   if (annots.isNull()) {
     Ref annotsRef;
@@ -372,12 +400,25 @@ void Page::addAnnot(Annot *annot) {
     tmp.free();
 
     annotsRef = xref->addIndirectObject (&obj1);
+    obj1.free();
     annots.initRef(annotsRef.num, annotsRef.gen);
     pageObj.dictSet ("Annots", &annots);
     xref->setModifiedObject (&pageObj, pageRef);
   } else {
     getAnnots(&obj1);
     if (obj1.isArray()) {
+      for (i = 0; i < obj1.arrayGetLength(); ++i) {
+	if (obj1.arrayGetNF(i, &tmp)->isRef() &&
+	    tmp.getRefNum() == annotRef.num &&
+	    tmp.getRefGen() == annotRef.gen) {
+	  // already on the page
+	  tmp.free();
+	  obj1.free();
+	  unlockPage;
+	  return;
+	}
+	tmp.free();
+      }
       obj1.arrayAdd (tmp.initRef (annotRef.num, annotRef.gen));
       if (annots.isRef())
         xref->setModifiedObject (&obj1, annots.getRef());
@@ -388,6 +429,13 @@ void Page::addAnnot(Annot *annot) {
   }
 
   annot->setPage(&pageRef, num);
+
+  // keep the cached list in sync; otherwise the new annot will be
+  // picked up from the Annots array when the list is first built
+  if (annotList) {
+    annotList->appendAnnot(annot);
+  }
+  unlockPage;
 }
 
 Links *Page::getLinks(Catalog *catalog) {
@@ -447,6 +495,16 @@ Gfx *Page::createGfx(OutputDev *out, double hDPI, double vDPI,
 		hDPI, vDPI, &box, crop ? cropBox : (PDFRectangle *)NULL,
 		rotate, abortCheckCbk, abortCheckCbkData);
 
+  // keep the parsed content around for the next time the page is drawn
+  if (globalParams->getCacheContentStreams()) {
+    lockPage;
+    if (!contentCache) {
+      contentCache = new GfxContentCache();
+    }
+    unlockPage;
+    gfx->setContentCache(contentCache);
+  }
+
   return gfx;
 }
 
@@ -460,9 +518,9 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
                         void *annotDisplayDecideCbkData) {
   Gfx *gfx;
   Object obj;
-  Annots *annotList;
+  Annots *annotsList;
   int i;
-  
+
   if (!out->checkPageSlice(this, hDPI, vDPI, rotate, useMediaBox, crop,
 			   sliceX, sliceY, sliceW, sliceH,
 			   printing, catalog,
@@ -479,30 +537,28 @@ void Page::displaySlice(OutputDev *out, double hDPI, double vDPI,
   contents.fetch(xref, &obj);
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&obj);
+    gfx->display(&obj, gTrue, &pageRef);
     gfx->restoreState();
   }
   obj.free();
 
   // draw annotations
-  annotList = new Annots(xref, catalog, getAnnots(&obj));
-  obj.free();
-  
-  if (annotList->getNumAnnots() > 0) {
+  annotsList = getAnnots(catalog);
+
+  if (annotsList->getNumAnnots() > 0) {
     if (globalParams->getPrintCommands()) {
       printf("***** Annotations\n");
     }
-    for (i = 0; i < annotList->getNumAnnots(); ++i) {
-        Annot *annot = annotList->getAnnot(i);
+    for (i = 0; i < annotsList->getNumAnnots(); ++i) {
+        Annot *annot = annotsList->getAnnot(i);
         if ((annotDisplayDecideCbk &&
              (*annotDisplayDecideCbk)(annot, annotDisplayDecideCbkData)) || 
             !annotDisplayDecideCbk) {
-             annotList->getAnnot(i)->draw(gfx, printing);
+             annotsList->getAnnot(i)->draw(gfx, printing);
 	}
     }
     out->dump();
   }
-  delete annotList;
 
   delete gfx;
 }
@@ -513,7 +569,7 @@ void Page::display(Gfx *gfx) {
   contents.fetch(xref, &obj);
   if (!obj.isNull()) {
     gfx->saveState();
-    gfx->display(&obj);
+    gfx->display(&obj, gTrue, &pageRef);
     gfx->restoreState();
   }
   obj.free();
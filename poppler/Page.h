@@ -32,8 +32,13 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class Dict;
 class XRef;
 class OutputDev;
@@ -42,6 +47,7 @@ class Catalog;
 class Annots;
 class Annot;
 class Gfx;
+class GfxContentCache;
 class FormPageWidgets;
 class Form;
 
@@ -163,13 +169,19 @@ public:
 
   // Get annotations array.
   Object *getAnnots(Object *obj) { return annots.fetch(xref, obj); }
-  // Add a new annotation to the page
+  // Add a new annotation to the page.  The page takes its own
+  // reference to <annot>; the caller keeps the one it had.  An annot
+  // that is already on the page is not added again.
   void addAnnot(Annot *annot);
 
   // Return a list of links.
   Links *getLinks(Catalog *catalog);
 
-  // Return a list of annots. Ownership is transferred to the caller.
+  // Return the list of annots.  The list is built on the first call
+  // and cached, so that appearance streams are parsed (and generated
+  // for form fields) only once per page; it is owned by the Page, and
+  // callers that keep an annot beyond the life of the Page must take
+  // a reference to it (Annot::incRefCnt).
   Annots *getAnnots(Catalog *catalog);
 
   // Get contents.
@@ -242,6 +254,8 @@ private:
   int num;			// page number
   PageAttrs *attrs;		// page attributes
   Object annots;		// annotations array
+  Annots *annotList;		// cached list of annotations, or NULL
+  GfxContentCache *contentCache; // compiled content streams, or NULL
   Object contents;		// page contents
   FormPageWidgets *pageWidgets; 			// the form for that page
   Object thumb;			// page thumbnail
@@ -249,6 +263,9 @@ private:
   Object actions;		// page addiction actions
   double duration;              // page duration
   GBool ok;			// true if page is valid
+#if MULTITHREADED
+  GooMutex mutex;		// guards annotList and contentCache
+#endif
 };
 
 #endif
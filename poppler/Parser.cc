@@ -105,10 +105,10 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
 	shift();
       } else {
 	// buf1 might go away in shift(), so construct the key
-	key = copyString(buf1.getName());
+	key = NameTable::copyName(buf1.getName());
 	shift();
 	if (buf1.isEOF() || buf1.isError()) {
-	  gfree(key);
+	  NameTable::freeName(key);
 	  break;
 	}
 	obj->dictAdd(key, getObj(&obj2, fileKey, encAlgorithm, keyLength, objNum, objGen, fetchOriginatorNums));
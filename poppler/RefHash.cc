@@ -0,0 +1,194 @@
+//========================================================================
+//
+// RefHash.cc
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "goo/gmem.h"
+#include "RefHash.h"
+
+//------------------------------------------------------------------------
+
+struct RefHashBucket {
+  Ref ref;
+  union {
+    void *p;
+    int i;
+  } val;
+  RefHashBucket *next;
+};
+
+//------------------------------------------------------------------------
+
+RefHash::RefHash() {
+  int h;
+
+  size = 7;
+  tab = (RefHashBucket **)gmallocn(size, sizeof(RefHashBucket *));
+  for (h = 0; h < size; ++h) {
+    tab[h] = NULL;
+  }
+  len = 0;
+}
+
+RefHash::~RefHash() {
+  RefHashBucket *p;
+  int h;
+
+  for (h = 0; h < size; ++h) {
+    while (tab[h]) {
+      p = tab[h];
+      tab[h] = p->next;
+      delete p;
+    }
+  }
+  gfree(tab);
+}
+
+void RefHash::add(Ref ref, void *val) {
+  RefHashBucket *p;
+  int h;
+
+  // expand the table if necessary
+  if (len >= size) {
+    expand();
+  }
+
+  p = new RefHashBucket;
+  p->ref = ref;
+  p->val.p = val;
+  h = hash(ref);
+  p->next = tab[h];
+  tab[h] = p;
+  ++len;
+}
+
+void RefHash::add(Ref ref, int val) {
+  RefHashBucket *p;
+  int h;
+
+  // expand the table if necessary
+  if (len >= size) {
+    expand();
+  }
+
+  p = new RefHashBucket;
+  p->ref = ref;
+  p->val.i = val;
+  h = hash(ref);
+  p->next = tab[h];
+  tab[h] = p;
+  ++len;
+}
+
+void RefHash::replace(Ref ref, void *val) {
+  RefHashBucket *p;
+
+  if ((p = find(ref, NULL))) {
+    p->val.p = val;
+  } else {
+    add(ref, val);
+  }
+}
+
+void RefHash::replace(Ref ref, int val) {
+  RefHashBucket *p;
+
+  if ((p = find(ref, NULL))) {
+    p->val.i = val;
+  } else {
+    add(ref, val);
+  }
+}
+
+void *RefHash::lookup(Ref ref) {
+  RefHashBucket *p;
+
+  if (!(p = find(ref, NULL))) {
+    return NULL;
+  }
+  return p->val.p;
+}
+
+int RefHash::lookupInt(Ref ref) {
+  RefHashBucket *p;
+
+  if (!(p = find(ref, NULL))) {
+    return 0;
+  }
+  return p->val.i;
+}
+
+int RefHash::removeInt(Ref ref) {
+  RefHashBucket *p;
+  RefHashBucket **q;
+  int h, val;
+
+  if (!(p = find(ref, &h))) {
+    return 0;
+  }
+  q = &tab[h];
+  while (*q != p) {
+    q = &((*q)->next);
+  }
+  *q = p->next;
+  --len;
+  val = p->val.i;
+  delete p;
+  return val;
+}
+
+void RefHash::expand() {
+  RefHashBucket **oldTab;
+  RefHashBucket *p;
+  int oldSize, h, i;
+
+  oldSize = size;
+  oldTab = tab;
+  size = 2*size + 1;
+  tab = (RefHashBucket **)gmallocn(size, sizeof(RefHashBucket *));
+  for (h = 0; h < size; ++h) {
+    tab[h] = NULL;
+  }
+  for (i = 0; i < oldSize; ++i) {
+    while (oldTab[i]) {
+      p = oldTab[i];
+      oldTab[i] = oldTab[i]->next;
+      h = hash(p->ref);
+      p->next = tab[h];
+      tab[h] = p;
+    }
+  }
+  gfree(oldTab);
+}
+
+RefHashBucket *RefHash::find(Ref ref, int *h) {
+  RefHashBucket *p;
+  int h1;
+
+  h1 = hash(ref);
+  if (h) {
+    *h = h1;
+  }
+  for (p = tab[h1]; p; p = p->next) {
+    if (p->ref.num == ref.num && p->ref.gen == ref.gen) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+int RefHash::hash(Ref ref) {
+  Guint h;
+
+  h = (Guint)ref.num * 31 + (Guint)ref.gen;
+  return (int)(h % size);
+}
@@ -0,0 +1,56 @@
+//========================================================================
+//
+// RefHash.h
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#ifndef REFHASH_H
+#define REFHASH_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "Object.h"
+
+struct RefHashBucket;
+
+//------------------------------------------------------------------------
+// RefHash
+//
+// A hash table keyed by object references, for finding the form
+// widget, optional content group, annotation or page that belongs to
+// a Ref without scanning a list.  Like GooHash, values are pointers
+// or ints, and add() does not check for an existing entry.
+//------------------------------------------------------------------------
+
+class RefHash {
+public:
+
+  RefHash();
+  ~RefHash();
+  void add(Ref ref, void *val);
+  void add(Ref ref, int val);
+  void replace(Ref ref, void *val);
+  void replace(Ref ref, int val);
+  void *lookup(Ref ref);
+  int lookupInt(Ref ref);
+  GBool contains(Ref ref) { return find(ref, NULL) != NULL; }
+  int removeInt(Ref ref);
+  int getLength() { return len; }
+
+private:
+
+  void expand();
+  RefHashBucket *find(Ref ref, int *h);
+  int hash(Ref ref);
+
+  int size;			// number of buckets
+  int len;			// number of entries
+  RefHashBucket **tab;
+};
+
+#endif
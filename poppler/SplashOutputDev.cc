@@ -40,6 +40,7 @@
 #pragma implementation
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include "goo/gfile.h"
@@ -52,6 +53,9 @@
 #include "FontEncodingTables.h"
 #include "fofi/FoFiTrueType.h"
 #include "splash/SplashBitmap.h"
+#include "splash/SplashBitmapPool.h"
+#include "splash/SplashHalftone.h"
+#include "splash/SplashClip.h"
 #include "splash/SplashGlyphBitmap.h"
 #include "splash/SplashPattern.h"
 #include "splash/SplashScreen.h"
@@ -979,8 +983,15 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
 
   bitmap = new SplashBitmap(1, 1, bitmapRowPad, colorMode,
 			    colorMode != splashModeMono1, bitmapTopDown);
+  extData = NULL;
+  extWidth = extHeight = extRowSize = 0;
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
   splash->clear(paperColor, 0);
+  bitmapPool = new SplashBitmapPool(0);
+  halftoneMethod = splashHalftoneNone;
+  halftoneThreads = 1;
+  halftone = NULL;
+  halftoneBitmap = NULL;
 
   fontEngine = NULL;
 
@@ -994,6 +1005,16 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
   transpGroupStack = NULL;
 }
 
+static GBool sameScreenParams(SplashScreenParams *p1,
+			      SplashScreenParams *p2) {
+  return p1->type == p2->type &&
+         p1->size == p2->size &&
+         p1->dotRadius == p2->dotRadius &&
+         p1->gamma == p2->gamma &&
+         p1->blackThreshold == p2->blackThreshold &&
+         p1->whiteThreshold == p2->whiteThreshold;
+}
+
 void SplashOutputDev::setupScreenParams(double hDPI, double vDPI) {
   screenParams.size = globalParams->getScreenSize();
   screenParams.dotRadius = globalParams->getScreenDotRadius();
@@ -1060,6 +1081,14 @@ SplashOutputDev::~SplashOutputDev() {
   if (bitmap) {
     delete bitmap;
   }
+  if (halftone) {
+    delete halftone;
+  }
+  if (halftoneBitmap) {
+    delete halftoneBitmap;
+  }
+  // after the bitmaps, which may have come from the pool
+  delete bitmapPool;
 }
 
 void SplashOutputDev::startDoc(XRef *xrefA) {
@@ -1109,13 +1138,29 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
   if (splash) {
     delete splash;
   }
-  if (!bitmap || w != bitmap->getWidth() || h != bitmap->getHeight()) {
+  if (halftoneBitmap) {
+    delete halftoneBitmap;
+    halftoneBitmap = NULL;
+  }
+  if (extData && w == extWidth && h == extHeight) {
+    if (!bitmap || bitmap->getDataPtr() != extData) {
+      if (bitmap) {
+	delete bitmap;
+      }
+      bitmap = new SplashBitmap(w, h, extRowSize, colorMode,
+				colorMode != splashModeMono1, extData);
+    }
+  } else if (!bitmap || !bitmap->ownsData() ||
+	     w != bitmap->getWidth() || h != bitmap->getHeight()) {
     if (bitmap) {
       delete bitmap;
     }
     bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode,
 			      colorMode != splashModeMono1, bitmapTopDown);
   }
+  // keep up to two page-sized sets of group and soft mask buffers
+  bitmapPool->setMaxCached(2 * ((size_t)abs(bitmap->getRowSize()) * h +
+				(size_t)w * h));
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
   if (state) {
     ctm = state->getCTM();
@@ -1161,6 +1206,34 @@ void SplashOutputDev::endPage() {
   if (colorMode != splashModeMono1 && !keepAlphaChannel) {
     splash->compositeBackground(paperColor);
   }
+  if (colorMode == splashModeMono8 && halftoneMethod != splashHalftoneNone) {
+    if (halftoneBitmap) {
+      delete halftoneBitmap;
+    }
+    halftoneBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
+				      bitmapRowPad, splashModeMono1, gFalse,
+				      bitmapTopDown);
+    if (halftone && !sameScreenParams(&halftoneParams, &screenParams)) {
+      delete halftone;
+      halftone = NULL;
+    }
+    if (!halftone) {
+      halftone = new SplashHalftone(halftoneMethod, &screenParams,
+				    halftoneThreads);
+      halftoneParams = screenParams;
+    }
+    halftone->halftone(bitmap, halftoneBitmap);
+  }
+}
+
+void SplashOutputDev::setMonoHalftone(SplashHalftoneMethod method,
+				      int nThreads) {
+  halftoneMethod = method;
+  halftoneThreads = nThreads;
+  if (halftone) {
+    delete halftone;
+    halftone = NULL;
+  }
 }
 
 void SplashOutputDev::saveState(GfxState *state) {
@@ -2172,14 +2245,15 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
     //~ this ignores the blendingColorSpace arg
     // create the temporary bitmap
     bitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(), bitmapRowPad, colorMode, gTrue,
-                              bitmapTopDown);
+                              bitmapTopDown, bitmapPool);
     splash = new Splash(bitmap, vectorAntialias,
                         transpGroup->origSplash->getScreen());
     splash->blitTransparent(transpGroup->origBitmap, 0, 0, 0, 0, bitmap->getWidth(), bitmap->getHeight());
     splash->setInNonIsolatedGroup(transpGroup->origBitmap, 0, 0);
     transpGroup->tBitmap = bitmap;
 
-    maskBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(), 1, splashModeMono8, gFalse);
+    maskBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(), 1, splashModeMono8, gFalse,
+                                  gTrue, bitmapPool);
     maskSplash = new Splash(maskBitmap, vectorAntialias);
     maskColor[0] = 0;
     maskSplash->clear(maskColor);
@@ -2874,7 +2948,7 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
     imgMaskData.lookup[i] = colToByte(gray);
   }
   maskBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
-				1, splashModeMono8, gFalse);
+				1, splashModeMono8, gFalse, gTrue, bitmapPool);
   maskSplash = new Splash(maskBitmap, vectorAntialias);
   maskColor[0] = 0;
   maskSplash->clear(maskColor);
@@ -2968,11 +3042,12 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
 					     GfxColorSpace *blendingColorSpace,
 					     GBool isolated, GBool /*knockout*/,
-					     GBool /*forSoftMask*/) {
+					     GBool forSoftMask) {
   SplashTransparencyGroup *transpGroup;
+  SplashClip *clip;
   SplashColor color;
   double xMin, yMin, xMax, yMax, x, y;
-  int tx, ty, w, h;
+  int tx, ty, w, h, t;
 
   // transform the bbox
   state->transform(bbox[0], bbox[1], &x, &y);
@@ -3038,6 +3113,38 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
     h = 1;
   }
 
+  // The group is composited through the clip region that was in
+  // effect before the bbox was clipped, so only the part inside the
+  // current clip rectangle (widened by a pixel for the rounding of the
+  // bbox) can ever show.  Soft masks use the whole group, and in mono
+  // mode the position of the group affects the halftone pattern, so
+  // those groups are left alone.
+  clip = splash->getClip();
+  if (!forSoftMask && colorMode != splashModeMono1 &&
+      clip->getXMinI() <= clip->getXMaxI() &&
+      clip->getYMinI() <= clip->getYMaxI()) {
+    if ((t = clip->getXMinI() - 1) > tx) {
+      w -= t - tx;
+      tx = t;
+    }
+    if ((t = clip->getXMaxI() + 1) < tx + w - 1) {
+      w = t - tx + 1;
+    }
+    if (w < 1) {
+      w = 1;
+    }
+    if ((t = clip->getYMinI() - 1) > ty) {
+      h -= t - ty;
+      ty = t;
+    }
+    if ((t = clip->getYMaxI() + 1) < ty + h - 1) {
+      h = t - ty + 1;
+    }
+    if (h < 1) {
+      h = 1;
+    }
+  }
+
   // push a new stack entry
   transpGroup = new SplashTransparencyGroup();
   transpGroup->tx = tx;
@@ -3055,7 +3162,7 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
 
   // create the temporary bitmap
   bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, gTrue,
-			    bitmapTopDown);
+			    bitmapTopDown, bitmapPool);
   splash = new Splash(bitmap, vectorAntialias,
 		      transpGroup->origSplash->getScreen());
   if (isolated) {
@@ -3188,19 +3295,27 @@ void SplashOutputDev::setSoftMask(GfxState * /*state*/, double * /*bbox*/,
   }
 
   softMask = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
-			      1, splashModeMono8, gFalse);
+			      1, splashModeMono8, gFalse, gTrue, bitmapPool);
   unsigned char fill = 0;
   if (transpGroupStack->blendingColorSpace) {
 	transpGroupStack->blendingColorSpace->getGray(backdropColor, &gray);
 	fill = colToByte(gray);
   }
-  memset(softMask->getDataPtr(), fill,
-	 softMask->getRowSize() * softMask->getHeight());
-  p = softMask->getDataPtr() + ty * softMask->getRowSize() + tx;
   int xMax = tBitmap->getWidth();
   int yMax = tBitmap->getHeight();
   if (xMax + tx > bitmap->getWidth()) xMax = bitmap->getWidth() - tx;
   if (yMax + ty > bitmap->getHeight()) yMax = bitmap->getHeight() - ty;
+  // fill the area outside the group, which is set below
+  p = softMask->getDataPtr();
+  memset(p, fill, ty * softMask->getRowSize());
+  for (y = 0; y < yMax; ++y) {
+    p = softMask->getDataPtr() + (ty + y) * softMask->getRowSize();
+    memset(p, fill, tx);
+    memset(p + tx + xMax, fill, softMask->getRowSize() - tx - xMax);
+  }
+  memset(softMask->getDataPtr() + (ty + yMax) * softMask->getRowSize(), fill,
+	 (softMask->getHeight() - ty - yMax) * softMask->getRowSize());
+  p = softMask->getDataPtr() + ty * softMask->getRowSize() + tx;
   for (y = 0; y < yMax; ++y) {
     for (x = 0; x < xMax; ++x) {
       if (alpha) {
@@ -3271,12 +3386,28 @@ int SplashOutputDev::getBitmapHeight() {
 SplashBitmap *SplashOutputDev::takeBitmap() {
   SplashBitmap *ret;
 
+  if (halftoneBitmap) {
+    ret = halftoneBitmap;
+    halftoneBitmap = NULL;
+    return ret;
+  }
   ret = bitmap;
   bitmap = new SplashBitmap(1, 1, bitmapRowPad, colorMode,
 			    colorMode != splashModeMono1, bitmapTopDown);
   return ret;
 }
 
+void SplashOutputDev::setExternalBitmap(SplashColorPtr dataA, int w, int h,
+					int rowSize) {
+  if (!bitmapTopDown || w <= 0 || h <= 0) {
+    dataA = NULL;
+  }
+  extData = dataA;
+  extWidth = w;
+  extHeight = h;
+  extRowSize = rowSize;
+}
+
 void SplashOutputDev::getModRegion(int *xMin, int *yMin,
 				   int *xMax, int *yMax) {
   splash->getModRegion(xMin, yMin, xMax, yMax);
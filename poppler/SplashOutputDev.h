@@ -40,6 +40,8 @@
 
 class Gfx8BitFont;
 class SplashBitmap;
+class SplashBitmapPool;
+class SplashHalftone;
 class Splash;
 class SplashPath;
 class SplashFontEngine;
@@ -261,8 +263,14 @@ public:
   GBool isReverseVideo() { return reverseVideo; }
   void setReverseVideo(GBool reverseVideoA) { reverseVideo = reverseVideoA; }
 
+  // Halftone each page to 1 bit per pixel in endPage, with
+  // <nThreads> threads; getBitmap and takeBitmap then return the
+  // splashModeMono1 result.  Only has an effect in splashModeMono8.
+  void setMonoHalftone(SplashHalftoneMethod method, int nThreads);
+
   // Get the bitmap and its size.
-  SplashBitmap *getBitmap() { return bitmap; }
+  SplashBitmap *getBitmap()
+    { return halftoneBitmap ? halftoneBitmap : bitmap; }
   int getBitmapWidth();
   int getBitmapHeight();
 
@@ -270,6 +278,13 @@ public:
   // caller.
   SplashBitmap *takeBitmap();
 
+  // Render pages that are <w> x <h> pixels directly into <dataA>,
+  // which holds <h> top-down rows of <rowSize> bytes and belongs to
+  // the caller; pages of another size still get their own bitmap.
+  // Pass NULL to go back to internal bitmaps.  Only has an effect
+  // with bitmapTopDown set.
+  void setExternalBitmap(SplashColorPtr dataA, int w, int h, int rowSize);
+
   // Get the Splash object.
   Splash *getSplash() { return splash; }
 
@@ -329,8 +344,20 @@ private:
   XRef *xref;			// xref table for current document
 
   SplashBitmap *bitmap;
+  SplashColorPtr extData;	// caller's buffer set by setExternalBitmap,
+  int extWidth, extHeight;	//   or NULL
+  int extRowSize;
   Splash *splash;
   SplashFontEngine *fontEngine;
+  SplashBitmapPool *bitmapPool;	// buffers for transparency groups and
+				//   soft masks
+  SplashHalftoneMethod halftoneMethod;
+  int halftoneThreads;
+  SplashHalftone *halftone;	// kept from page to page, as long as
+  SplashScreenParams		//   the screen parameters don't change
+    halftoneParams;
+  SplashBitmap *halftoneBitmap;	// 1-bit version of the last page, if
+				//   halftoneMethod is set
 
   T3FontCache *			// Type 3 font cache
     t3FontCache[splashOutT3FontCacheSize];
@@ -43,6 +43,9 @@
 #endif
 #include <string.h>
 #include <ctype.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "goo/gmem.h"
 #include "goo/gfile.h"
 #include "poppler-config.h"
@@ -105,8 +108,9 @@ int Stream::getChars(int nChars, Guchar *buffer) {
   return 0;
 }
 
-void Stream::getRawChars(int nChars, int *buffer) {
+int Stream::getRawChars(int nChars, Guchar *buffer) {
   error(-1, "Internal: called getRawChars() on non-predictor stream");
+  return 0;
 }
 
 char *Stream::getLine(char *buf, int size) {
@@ -512,6 +516,163 @@ void ImageStream::skipLine() {
 // StreamPredictor
 //------------------------------------------------------------------------
 
+// The row filters below decode the <n> bytes of a line from <raw>
+// into <cur>.  <cur> and <up> (the previous line) are preceded by
+// <bpp> zero bytes.  The SSE2 versions load and store 8 bytes per
+// pixel, so all three buffers need 8 bytes of slack after the line.
+
+static void predictSub(Guchar *cur, Guchar *raw, int n, int bpp) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    cur[i] = cur[i - bpp] + raw[i];
+  }
+}
+
+static void predictUp(Guchar *cur, Guchar *up, Guchar *raw, int n) {
+  int i;
+
+#if defined(__SSE2__)
+  for (i = 0; i + 16 <= n; i += 16) {
+    _mm_storeu_si128((__m128i *)(cur + i),
+		     _mm_add_epi8(_mm_loadu_si128((__m128i *)(up + i)),
+				  _mm_loadu_si128((__m128i *)(raw + i))));
+  }
+#else
+  i = 0;
+#endif
+  for (; i < n; ++i) {
+    cur[i] = up[i] + raw[i];
+  }
+}
+
+static void predictAvg(Guchar *cur, Guchar *up, Guchar *raw, int n, int bpp) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    cur[i] = ((cur[i - bpp] + up[i]) >> 1) + raw[i];
+  }
+}
+
+static void predictPaeth(Guchar *cur, Guchar *up, Guchar *raw,
+			 int n, int bpp) {
+  int left, above, upLeft, pa, pb, pc, i;
+
+  for (i = 0; i < n; ++i) {
+    left = cur[i - bpp];
+    above = up[i];
+    upLeft = up[i - bpp];
+    // p = left + above - upLeft; pa = |p - left|, etc.
+    pa = above - upLeft;
+    pb = left - upLeft;
+    pc = pa + pb;
+    if (pa < 0)
+      pa = -pa;
+    if (pb < 0)
+      pb = -pb;
+    if (pc < 0)
+      pc = -pc;
+    if (pa <= pb && pa <= pc)
+      cur[i] = left + raw[i];
+    else if (pb <= pc)
+      cur[i] = above + raw[i];
+    else
+      cur[i] = upLeft + raw[i];
+  }
+}
+
+// TIFF predictor 2 with 16-bit (big-endian) components.
+static void predictTIFF16(Guchar *cur, Guchar *raw, int n, int bpp) {
+  int v, i;
+
+  for (i = 0; i + 1 < n; i += 2) {
+    v = ((cur[i - bpp] << 8) | cur[i - bpp + 1]) + ((raw[i] << 8) | raw[i + 1]);
+    cur[i] = (Guchar)(v >> 8);
+    cur[i + 1] = (Guchar)v;
+  }
+}
+
+#if defined(__SSE2__)
+
+// These work on one pixel of up to 8 bytes at a time, keeping the
+// previous pixel in a register; the bytes past the end of the pixel
+// are computed too, and overwritten by the next pixel.
+
+static void predictSubSSE2(Guchar *cur, Guchar *raw, int n, int bpp) {
+  __m128i a;
+  int i;
+
+  a = _mm_setzero_si128();
+  for (i = 0; i < n; i += bpp) {
+    a = _mm_add_epi8(a, _mm_loadl_epi64((__m128i *)(raw + i)));
+    _mm_storel_epi64((__m128i *)(cur + i), a);
+  }
+}
+
+static void predictAvgSSE2(Guchar *cur, Guchar *up, Guchar *raw,
+			   int n, int bpp) {
+  __m128i a, b, one;
+  int i;
+
+  one = _mm_set1_epi8(1);
+  a = _mm_setzero_si128();
+  for (i = 0; i < n; i += bpp) {
+    b = _mm_loadl_epi64((__m128i *)(up + i));
+    // pavgb rounds up: subtract the carry to get (a + b) >> 1
+    a = _mm_sub_epi8(_mm_avg_epu8(a, b),
+		     _mm_and_si128(_mm_xor_si128(a, b), one));
+    a = _mm_add_epi8(a, _mm_loadl_epi64((__m128i *)(raw + i)));
+    _mm_storel_epi64((__m128i *)(cur + i), a);
+  }
+}
+
+static void predictPaethSSE2(Guchar *cur, Guchar *up, Guchar *raw,
+			     int n, int bpp) {
+  __m128i zero, a, b, c, pa, pb, pc, useA, useB, p;
+  int i;
+
+  zero = _mm_setzero_si128();
+  a = c = zero;
+  for (i = 0; i < n; i += bpp) {
+    // a, b and c hold left, above and upLeft as 16-bit values
+    b = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)(up + i)), zero);
+    pa = _mm_sub_epi16(b, c);
+    pb = _mm_sub_epi16(a, c);
+    pc = _mm_add_epi16(pa, pb);
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    useA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    useB = _mm_cmpgt_epi16(pb, pc);
+    // useA/useB are inverted: set where left/above is not chosen
+    p = _mm_or_si128(_mm_and_si128(useB, c), _mm_andnot_si128(useB, b));
+    p = _mm_or_si128(_mm_and_si128(useA, p), _mm_andnot_si128(useA, a));
+    p = _mm_add_epi8(_mm_packus_epi16(p, p),
+		     _mm_loadl_epi64((__m128i *)(raw + i)));
+    _mm_storel_epi64((__m128i *)(cur + i), p);
+    a = _mm_unpacklo_epi8(p, zero);
+    c = b;
+  }
+}
+
+static void predictTIFF16SSE2(Guchar *cur, Guchar *raw, int n, int bpp) {
+  __m128i a, x;
+  int i;
+
+  // a holds the previous pixel with the bytes of each component
+  // swapped, i.e., as native 16-bit values
+  a = _mm_setzero_si128();
+  for (i = 0; i < n; i += bpp) {
+    x = _mm_loadl_epi64((__m128i *)(raw + i));
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    a = _mm_add_epi16(a, x);
+    _mm_storel_epi64((__m128i *)(cur + i),
+		     _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8)));
+  }
+}
+
+#endif
+
 StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 				 int widthA, int nCompsA, int nBitsA) {
   str = strA;
@@ -519,7 +680,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   width = widthA;
   nComps = nCompsA;
   nBits = nBitsA;
-  predLine = NULL;
+  predLine = prevLine = rawLine = NULL;
   ok = gFalse;
 
   nVals = width * nComps;
@@ -529,11 +690,17 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
       nComps > gfxColorMaxComps ||
       nBits > 16 ||
       width >= INT_MAX / nComps ||      // check for overflow in nVals
-      nVals >= (INT_MAX - 7) / nBits) { // check for overflow in rowBytes
+      nVals >= (INT_MAX - 7) / nBits || // check for overflow in rowBytes
+      rowBytes > INT_MAX - 8) {
     return;
   }
-  predLine = (Guchar *)gmalloc(rowBytes);
-  memset(predLine, 0, rowBytes);
+  // 8 bytes of slack for the SSE2 row filters
+  predLine = (Guchar *)gmalloc(rowBytes + 8);
+  memset(predLine, 0, rowBytes + 8);
+  prevLine = (Guchar *)gmalloc(rowBytes + 8);
+  memset(prevLine, 0, rowBytes + 8);
+  rawLine = (Guchar *)gmalloc(rowBytes + 8);
+  memset(rawLine, 0, rowBytes + 8);
   predIdx = rowBytes;
 
   ok = gTrue;
@@ -541,6 +708,8 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(prevLine);
+  gfree(rawLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -552,28 +721,48 @@ int StreamPredictor::lookChar() {
   return predLine[predIdx];
 }
 
+GBool StreamPredictor::appendPSParams(GooString *s) {
+  if (!ok || (nBits != 1 && nBits != 2 && nBits != 4 && nBits != 8)) {
+    return gFalse;
+  }
+  s->appendf("/Predictor {0:d} /Columns {1:d} /Colors {2:d} "
+	     "/BitsPerComponent {3:d} ", predictor, width, nComps, nBits);
+  return gTrue;
+}
+
 int StreamPredictor::getChar() {
   return doGetChar();
 }
 
 int StreamPredictor::getChars(int nChars, Guchar *buffer)
 {
-  for (int i = 0; i < nChars; ++i) {
-    const int c = doGetChar();
-    if (likely(c != EOF)) buffer[i] = c;
-    else return i;
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
   }
-  return nChars;
+  return n;
 }
 
 GBool StreamPredictor::getNextLine() {
   int curPred;
-  Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  Guchar *cur, *up, *line;
   Gulong inBuf, outBuf, bitMask;
+  Guchar compBuf[gfxColorMaxComps];
   int inBits, outBits;
-  int i, j, k, kk;
+  int n, nRaw, i, j, k, kk;
 
   // get PNG optimum predictor number
   if (predictor >= 10) {
@@ -585,64 +774,93 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  int *rawCharLine = new int[rowBytes - pixBytes];
-  str->getRawChars(rowBytes - pixBytes, rawCharLine);
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = rawCharLine[i - pixBytes]) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      delete[] rawCharLine;
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
+  // read the raw line
+  nRaw = rowBytes - pixBytes;
+  if ((n = str->getRawChars(nRaw, rawLine)) == 0) {
+    return gFalse;
+  }
+
+  // the previous line becomes the 'up' line, and the new line is
+  // decoded into the other buffer
+  line = prevLine;
+  prevLine = predLine;
+  predLine = line;
+  cur = predLine + pixBytes;
+  up = prevLine + pixBytes;
+
+  // a truncated line ought to be an error, but some (broken) PDF
+  // files contain truncated image data, and Adobe apparently reads the
+  // last partial line; the rest of it is taken from the previous line
+  if (n < nRaw && predictor == 2) {
+    memcpy(rawLine + n, up + n, nRaw - n);
+    n = nRaw;
+  }
+
+  // apply PNG (byte) predictor
+  switch (curPred) {
+  case 11:			// PNG sub
+#if defined(__SSE2__)
+    if (pixBytes <= 8) {
+      predictSubSSE2(cur, rawLine, n, pixBytes);
       break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
+    }
+#endif
+    predictSub(cur, rawLine, n, pixBytes);
+    break;
+  case 12:			// PNG up
+    predictUp(cur, up, rawLine, n);
+    break;
+  case 13:			// PNG average
+#if defined(__SSE2__)
+    if (pixBytes <= 8) {
+      predictAvgSSE2(cur, up, rawLine, n, pixBytes);
       break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
+    }
+#endif
+    predictAvg(cur, up, rawLine, n, pixBytes);
+    break;
+  case 14:			// PNG Paeth
+#if defined(__SSE2__)
+    if (pixBytes >= 2 && pixBytes <= 8) {
+      predictPaethSSE2(cur, up, rawLine, n, pixBytes);
       break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
+    }
+#endif
+    predictPaeth(cur, up, rawLine, n, pixBytes);
+    break;
+  case 2:			// TIFF predictor
+    if (nBits == 8) {
+#if defined(__SSE2__)
+      if (pixBytes <= 8) {
+	predictSubSSE2(cur, rawLine, n, pixBytes);
+	break;
+      }
+#endif
+      predictSub(cur, rawLine, n, pixBytes);
       break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
+    } else if (nBits == 16) {
+#if defined(__SSE2__)
+      if (pixBytes <= 8) {
+	predictTIFF16SSE2(cur, rawLine, n, pixBytes);
+	break;
+      }
+#endif
+      predictTIFF16(cur, rawLine, n, pixBytes);
       break;
     }
+    memcpy(cur, rawLine, n);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor
+    memcpy(cur, rawLine, n);
+    break;
+  }
+  if (n < nRaw) {
+    memcpy(cur + n, up + n, nRaw - n);
   }
-  delete[] rawCharLine;
 
-  // apply TIFF (component) predictor
-  if (predictor == 2) {
+  // apply TIFF (component) predictor to 1-, 2- and 4-bit components
+  if (predictor == 2 && nBits != 8 && nBits != 16) {
     if (nBits == 1) {
       inBuf = predLine[pixBytes - 1];
       for (i = pixBytes; i < rowBytes; i += 8) {
@@ -650,12 +868,8 @@ GBool StreamPredictor::getNextLine() {
 	inBuf = (inBuf << 8) | predLine[i];
 	predLine[i] ^= inBuf >> nComps;
       }
-    } else if (nBits == 8) {
-      for (i = pixBytes; i < rowBytes; ++i) {
-	predLine[i] += predLine[i - nComps];
-      }
     } else {
-      memset(upLeftBuf, 0, nComps + 1);
+      memset(compBuf, 0, nComps);
       bitMask = (1 << nBits) - 1;
       inBuf = outBuf = 0;
       inBits = outBits = 0;
@@ -666,10 +880,10 @@ GBool StreamPredictor::getNextLine() {
 	    inBuf = (inBuf << 8) | (predLine[j++] & 0xff);
 	    inBits += 8;
 	  }
-	  upLeftBuf[kk] = (Guchar)((upLeftBuf[kk] +
-				    (inBuf >> (inBits - nBits))) & bitMask);
+	  compBuf[kk] = (Guchar)((compBuf[kk] +
+				  (inBuf >> (inBits - nBits))) & bitMask);
 	  inBits -= nBits;
-	  outBuf = (outBuf << nBits) | upLeftBuf[kk];
+	  outBuf = (outBuf << nBits) | compBuf[kk];
 	  outBits += nBits;
 	  if (outBits >= 8) {
 	    predLine[k++] = (Guchar)(outBuf >> (outBits - 8));
@@ -766,6 +980,47 @@ GBool FileStream::fillBuf() {
   return gTrue;
 }
 
+int FileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd) {
+
+      // large reads bypass the buffer
+      if (nChars - n > fileStreamBufSize) {
+	bufPos += bufEnd - buf;
+	bufPtr = bufEnd = buf;
+	if (limited && bufPos >= start + length) {
+	  break;
+	}
+	m = nChars - n;
+	if (limited && bufPos + m > start + length) {
+	  m = start + length - bufPos;
+	}
+	m = (int)fread(buffer + n, 1, m, f);
+	if (m <= 0) {
+	  break;
+	}
+	bufPos += m;
+	n += m;
+	continue;
+      }
+      if (!fillBuf()) {
+	break;
+      }
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void FileStream::setPos(Guint pos, int dir) {
   Guint size;
 
@@ -977,6 +1232,22 @@ void MemStream::moveStart(int delta) {
   bufPtr = buf + start;
 }
 
+int MemStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 //------------------------------------------------------------------------
 // EmbedStream
 //------------------------------------------------------------------------
@@ -1256,9 +1527,29 @@ int LZWStream::lookChar() {
   return seqBuf[seqIndex];
 }
 
-void LZWStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
+int LZWStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (eof) {
+      break;
+    }
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+      continue;
+    }
+    m = seqLength - seqIndex;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, seqBuf + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
 }
 
 int LZWStream::getRawChar() {
@@ -1366,7 +1657,7 @@ int LZWStream::getCode() {
 GooString *LZWStream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
-  if (psLevel < 2 || pred) {
+  if (psLevel < 2 || (pred && psLevel < 3)) {
     return NULL;
   }
   if (!(s = str->getPSFilter(psLevel, indent))) {
@@ -1376,6 +1667,10 @@ GooString *LZWStream::getPSFilter(int psLevel, char *indent) {
   if (!early) {
     s->append("/EarlyChange 0 ");
   }
+  if (pred && !pred->appendPSParams(s)) {
+    delete s;
+    return NULL;
+  }
   s->append(">> /LZWDecode filter\n");
   return s;
 }
@@ -3620,563 +3915,74 @@ FlateDecode FlateStream::distDecode[flateMaxDistCodes] = {
   {13, 24577}
 };
 
-static FlateCode flateFixedLitCodeTabCodes[512] = {
-  {7, 0x0100},
-  {8, 0x0050},
-  {8, 0x0010},
-  {8, 0x0118},
-  {7, 0x0110},
-  {8, 0x0070},
-  {8, 0x0030},
-  {9, 0x00c0},
-  {7, 0x0108},
-  {8, 0x0060},
-  {8, 0x0020},
-  {9, 0x00a0},
-  {8, 0x0000},
-  {8, 0x0080},
-  {8, 0x0040},
-  {9, 0x00e0},
-  {7, 0x0104},
-  {8, 0x0058},
-  {8, 0x0018},
-  {9, 0x0090},
-  {7, 0x0114},
-  {8, 0x0078},
-  {8, 0x0038},
-  {9, 0x00d0},
-  {7, 0x010c},
-  {8, 0x0068},
-  {8, 0x0028},
-  {9, 0x00b0},
-  {8, 0x0008},
-  {8, 0x0088},
-  {8, 0x0048},
-  {9, 0x00f0},
-  {7, 0x0102},
-  {8, 0x0054},
-  {8, 0x0014},
-  {8, 0x011c},
-  {7, 0x0112},
-  {8, 0x0074},
-  {8, 0x0034},
-  {9, 0x00c8},
-  {7, 0x010a},
-  {8, 0x0064},
-  {8, 0x0024},
-  {9, 0x00a8},
-  {8, 0x0004},
-  {8, 0x0084},
-  {8, 0x0044},
-  {9, 0x00e8},
-  {7, 0x0106},
-  {8, 0x005c},
-  {8, 0x001c},
-  {9, 0x0098},
-  {7, 0x0116},
-  {8, 0x007c},
-  {8, 0x003c},
-  {9, 0x00d8},
-  {7, 0x010e},
-  {8, 0x006c},
-  {8, 0x002c},
-  {9, 0x00b8},
-  {8, 0x000c},
-  {8, 0x008c},
-  {8, 0x004c},
-  {9, 0x00f8},
-  {7, 0x0101},
-  {8, 0x0052},
-  {8, 0x0012},
-  {8, 0x011a},
-  {7, 0x0111},
-  {8, 0x0072},
-  {8, 0x0032},
-  {9, 0x00c4},
-  {7, 0x0109},
-  {8, 0x0062},
-  {8, 0x0022},
-  {9, 0x00a4},
-  {8, 0x0002},
-  {8, 0x0082},
-  {8, 0x0042},
-  {9, 0x00e4},
-  {7, 0x0105},
-  {8, 0x005a},
-  {8, 0x001a},
-  {9, 0x0094},
-  {7, 0x0115},
-  {8, 0x007a},
-  {8, 0x003a},
-  {9, 0x00d4},
-  {7, 0x010d},
-  {8, 0x006a},
-  {8, 0x002a},
-  {9, 0x00b4},
-  {8, 0x000a},
-  {8, 0x008a},
-  {8, 0x004a},
-  {9, 0x00f4},
-  {7, 0x0103},
-  {8, 0x0056},
-  {8, 0x0016},
-  {8, 0x011e},
-  {7, 0x0113},
-  {8, 0x0076},
-  {8, 0x0036},
-  {9, 0x00cc},
-  {7, 0x010b},
-  {8, 0x0066},
-  {8, 0x0026},
-  {9, 0x00ac},
-  {8, 0x0006},
-  {8, 0x0086},
-  {8, 0x0046},
-  {9, 0x00ec},
-  {7, 0x0107},
-  {8, 0x005e},
-  {8, 0x001e},
-  {9, 0x009c},
-  {7, 0x0117},
-  {8, 0x007e},
-  {8, 0x003e},
-  {9, 0x00dc},
-  {7, 0x010f},
-  {8, 0x006e},
-  {8, 0x002e},
-  {9, 0x00bc},
-  {8, 0x000e},
-  {8, 0x008e},
-  {8, 0x004e},
-  {9, 0x00fc},
-  {7, 0x0100},
-  {8, 0x0051},
-  {8, 0x0011},
-  {8, 0x0119},
-  {7, 0x0110},
-  {8, 0x0071},
-  {8, 0x0031},
-  {9, 0x00c2},
-  {7, 0x0108},
-  {8, 0x0061},
-  {8, 0x0021},
-  {9, 0x00a2},
-  {8, 0x0001},
-  {8, 0x0081},
-  {8, 0x0041},
-  {9, 0x00e2},
-  {7, 0x0104},
-  {8, 0x0059},
-  {8, 0x0019},
-  {9, 0x0092},
-  {7, 0x0114},
-  {8, 0x0079},
-  {8, 0x0039},
-  {9, 0x00d2},
-  {7, 0x010c},
-  {8, 0x0069},
-  {8, 0x0029},
-  {9, 0x00b2},
-  {8, 0x0009},
-  {8, 0x0089},
-  {8, 0x0049},
-  {9, 0x00f2},
-  {7, 0x0102},
-  {8, 0x0055},
-  {8, 0x0015},
-  {8, 0x011d},
-  {7, 0x0112},
-  {8, 0x0075},
-  {8, 0x0035},
-  {9, 0x00ca},
-  {7, 0x010a},
-  {8, 0x0065},
-  {8, 0x0025},
-  {9, 0x00aa},
-  {8, 0x0005},
-  {8, 0x0085},
-  {8, 0x0045},
-  {9, 0x00ea},
-  {7, 0x0106},
-  {8, 0x005d},
-  {8, 0x001d},
-  {9, 0x009a},
-  {7, 0x0116},
-  {8, 0x007d},
-  {8, 0x003d},
-  {9, 0x00da},
-  {7, 0x010e},
-  {8, 0x006d},
-  {8, 0x002d},
-  {9, 0x00ba},
-  {8, 0x000d},
-  {8, 0x008d},
-  {8, 0x004d},
-  {9, 0x00fa},
-  {7, 0x0101},
-  {8, 0x0053},
-  {8, 0x0013},
-  {8, 0x011b},
-  {7, 0x0111},
-  {8, 0x0073},
-  {8, 0x0033},
-  {9, 0x00c6},
-  {7, 0x0109},
-  {8, 0x0063},
-  {8, 0x0023},
-  {9, 0x00a6},
-  {8, 0x0003},
-  {8, 0x0083},
-  {8, 0x0043},
-  {9, 0x00e6},
-  {7, 0x0105},
-  {8, 0x005b},
-  {8, 0x001b},
-  {9, 0x0096},
-  {7, 0x0115},
-  {8, 0x007b},
-  {8, 0x003b},
-  {9, 0x00d6},
-  {7, 0x010d},
-  {8, 0x006b},
-  {8, 0x002b},
-  {9, 0x00b6},
-  {8, 0x000b},
-  {8, 0x008b},
-  {8, 0x004b},
-  {9, 0x00f6},
-  {7, 0x0103},
-  {8, 0x0057},
-  {8, 0x0017},
-  {8, 0x011f},
-  {7, 0x0113},
-  {8, 0x0077},
-  {8, 0x0037},
-  {9, 0x00ce},
-  {7, 0x010b},
-  {8, 0x0067},
-  {8, 0x0027},
-  {9, 0x00ae},
-  {8, 0x0007},
-  {8, 0x0087},
-  {8, 0x0047},
-  {9, 0x00ee},
-  {7, 0x0107},
-  {8, 0x005f},
-  {8, 0x001f},
-  {9, 0x009e},
-  {7, 0x0117},
-  {8, 0x007f},
-  {8, 0x003f},
-  {9, 0x00de},
-  {7, 0x010f},
-  {8, 0x006f},
-  {8, 0x002f},
-  {9, 0x00be},
-  {8, 0x000f},
-  {8, 0x008f},
-  {8, 0x004f},
-  {9, 0x00fe},
-  {7, 0x0100},
-  {8, 0x0050},
-  {8, 0x0010},
-  {8, 0x0118},
-  {7, 0x0110},
-  {8, 0x0070},
-  {8, 0x0030},
-  {9, 0x00c1},
-  {7, 0x0108},
-  {8, 0x0060},
-  {8, 0x0020},
-  {9, 0x00a1},
-  {8, 0x0000},
-  {8, 0x0080},
-  {8, 0x0040},
-  {9, 0x00e1},
-  {7, 0x0104},
-  {8, 0x0058},
-  {8, 0x0018},
-  {9, 0x0091},
-  {7, 0x0114},
-  {8, 0x0078},
-  {8, 0x0038},
-  {9, 0x00d1},
-  {7, 0x010c},
-  {8, 0x0068},
-  {8, 0x0028},
-  {9, 0x00b1},
-  {8, 0x0008},
-  {8, 0x0088},
-  {8, 0x0048},
-  {9, 0x00f1},
-  {7, 0x0102},
-  {8, 0x0054},
-  {8, 0x0014},
-  {8, 0x011c},
-  {7, 0x0112},
-  {8, 0x0074},
-  {8, 0x0034},
-  {9, 0x00c9},
-  {7, 0x010a},
-  {8, 0x0064},
-  {8, 0x0024},
-  {9, 0x00a9},
-  {8, 0x0004},
-  {8, 0x0084},
-  {8, 0x0044},
-  {9, 0x00e9},
-  {7, 0x0106},
-  {8, 0x005c},
-  {8, 0x001c},
-  {9, 0x0099},
-  {7, 0x0116},
-  {8, 0x007c},
-  {8, 0x003c},
-  {9, 0x00d9},
-  {7, 0x010e},
-  {8, 0x006c},
-  {8, 0x002c},
-  {9, 0x00b9},
-  {8, 0x000c},
-  {8, 0x008c},
-  {8, 0x004c},
-  {9, 0x00f9},
-  {7, 0x0101},
-  {8, 0x0052},
-  {8, 0x0012},
-  {8, 0x011a},
-  {7, 0x0111},
-  {8, 0x0072},
-  {8, 0x0032},
-  {9, 0x00c5},
-  {7, 0x0109},
-  {8, 0x0062},
-  {8, 0x0022},
-  {9, 0x00a5},
-  {8, 0x0002},
-  {8, 0x0082},
-  {8, 0x0042},
-  {9, 0x00e5},
-  {7, 0x0105},
-  {8, 0x005a},
-  {8, 0x001a},
-  {9, 0x0095},
-  {7, 0x0115},
-  {8, 0x007a},
-  {8, 0x003a},
-  {9, 0x00d5},
-  {7, 0x010d},
-  {8, 0x006a},
-  {8, 0x002a},
-  {9, 0x00b5},
-  {8, 0x000a},
-  {8, 0x008a},
-  {8, 0x004a},
-  {9, 0x00f5},
-  {7, 0x0103},
-  {8, 0x0056},
-  {8, 0x0016},
-  {8, 0x011e},
-  {7, 0x0113},
-  {8, 0x0076},
-  {8, 0x0036},
-  {9, 0x00cd},
-  {7, 0x010b},
-  {8, 0x0066},
-  {8, 0x0026},
-  {9, 0x00ad},
-  {8, 0x0006},
-  {8, 0x0086},
-  {8, 0x0046},
-  {9, 0x00ed},
-  {7, 0x0107},
-  {8, 0x005e},
-  {8, 0x001e},
-  {9, 0x009d},
-  {7, 0x0117},
-  {8, 0x007e},
-  {8, 0x003e},
-  {9, 0x00dd},
-  {7, 0x010f},
-  {8, 0x006e},
-  {8, 0x002e},
-  {9, 0x00bd},
-  {8, 0x000e},
-  {8, 0x008e},
-  {8, 0x004e},
-  {9, 0x00fd},
-  {7, 0x0100},
-  {8, 0x0051},
-  {8, 0x0011},
-  {8, 0x0119},
-  {7, 0x0110},
-  {8, 0x0071},
-  {8, 0x0031},
-  {9, 0x00c3},
-  {7, 0x0108},
-  {8, 0x0061},
-  {8, 0x0021},
-  {9, 0x00a3},
-  {8, 0x0001},
-  {8, 0x0081},
-  {8, 0x0041},
-  {9, 0x00e3},
-  {7, 0x0104},
-  {8, 0x0059},
-  {8, 0x0019},
-  {9, 0x0093},
-  {7, 0x0114},
-  {8, 0x0079},
-  {8, 0x0039},
-  {9, 0x00d3},
-  {7, 0x010c},
-  {8, 0x0069},
-  {8, 0x0029},
-  {9, 0x00b3},
-  {8, 0x0009},
-  {8, 0x0089},
-  {8, 0x0049},
-  {9, 0x00f3},
-  {7, 0x0102},
-  {8, 0x0055},
-  {8, 0x0015},
-  {8, 0x011d},
-  {7, 0x0112},
-  {8, 0x0075},
-  {8, 0x0035},
-  {9, 0x00cb},
-  {7, 0x010a},
-  {8, 0x0065},
-  {8, 0x0025},
-  {9, 0x00ab},
-  {8, 0x0005},
-  {8, 0x0085},
-  {8, 0x0045},
-  {9, 0x00eb},
-  {7, 0x0106},
-  {8, 0x005d},
-  {8, 0x001d},
-  {9, 0x009b},
-  {7, 0x0116},
-  {8, 0x007d},
-  {8, 0x003d},
-  {9, 0x00db},
-  {7, 0x010e},
-  {8, 0x006d},
-  {8, 0x002d},
-  {9, 0x00bb},
-  {8, 0x000d},
-  {8, 0x008d},
-  {8, 0x004d},
-  {9, 0x00fb},
-  {7, 0x0101},
-  {8, 0x0053},
-  {8, 0x0013},
-  {8, 0x011b},
-  {7, 0x0111},
-  {8, 0x0073},
-  {8, 0x0033},
-  {9, 0x00c7},
-  {7, 0x0109},
-  {8, 0x0063},
-  {8, 0x0023},
-  {9, 0x00a7},
-  {8, 0x0003},
-  {8, 0x0083},
-  {8, 0x0043},
-  {9, 0x00e7},
-  {7, 0x0105},
-  {8, 0x005b},
-  {8, 0x001b},
-  {9, 0x0097},
-  {7, 0x0115},
-  {8, 0x007b},
-  {8, 0x003b},
-  {9, 0x00d7},
-  {7, 0x010d},
-  {8, 0x006b},
-  {8, 0x002b},
-  {9, 0x00b7},
-  {8, 0x000b},
-  {8, 0x008b},
-  {8, 0x004b},
-  {9, 0x00f7},
-  {7, 0x0103},
-  {8, 0x0057},
-  {8, 0x0017},
-  {8, 0x011f},
-  {7, 0x0113},
-  {8, 0x0077},
-  {8, 0x0037},
-  {9, 0x00cf},
-  {7, 0x010b},
-  {8, 0x0067},
-  {8, 0x0027},
-  {9, 0x00af},
-  {8, 0x0007},
-  {8, 0x0087},
-  {8, 0x0047},
-  {9, 0x00ef},
-  {7, 0x0107},
-  {8, 0x005f},
-  {8, 0x001f},
-  {9, 0x009f},
-  {7, 0x0117},
-  {8, 0x007f},
-  {8, 0x003f},
-  {9, 0x00df},
-  {7, 0x010f},
-  {8, 0x006f},
-  {8, 0x002f},
-  {9, 0x00bf},
-  {8, 0x000f},
-  {8, 0x008f},
-  {8, 0x004f},
-  {9, 0x00ff}
+// size of the output buffer: the window, the bytes decoded per
+// readSome() call, and room for one match (plus the 8-byte copy
+// overrun) past the end of that
+#define flateBufSize (flateWindow + flateOutSize + 258 + 16)
+
+// Huffman table entry flags
+#define flateEntryLit    0x0100	// literal
+#define flateEntryLen    0x0200	// length or distance, with extra bits
+#define flateEntryEOB    0x0400	// end of block
+#define flateEntrySub    0x0800	// pointer to a second-level table
+#define flateEntryLit2   0x1000	// two literals
+
+// kinds of Huffman tables, for compHuffmanCodes
+#define flateCodeLenCodes  0
+#define flateLitCodes      1
+#define flateDistCodes     2
+
+FlateHuffmanTab FlateStream::fixedLitCodeTab = { NULL, 0, 0, 0 };
+FlateHuffmanTab FlateStream::fixedDistCodeTab = { NULL, 0, 0, 0 };
+
+// The fixed code tables are built once, by a static initializer.
+class FlateFixedCodes {
+public:
+  FlateFixedCodes();
 };
 
-FlateHuffmanTab FlateStream::fixedLitCodeTab = {
-  flateFixedLitCodeTabCodes, 9
-};
+FlateFixedCodes::FlateFixedCodes() {
+  int lengths[flateMaxLitCodes];
+  int i;
 
-static FlateCode flateFixedDistCodeTabCodes[32] = {
-  {5, 0x0000},
-  {5, 0x0010},
-  {5, 0x0008},
-  {5, 0x0018},
-  {5, 0x0004},
-  {5, 0x0014},
-  {5, 0x000c},
-  {5, 0x001c},
-  {5, 0x0002},
-  {5, 0x0012},
-  {5, 0x000a},
-  {5, 0x001a},
-  {5, 0x0006},
-  {5, 0x0016},
-  {5, 0x000e},
-  {0, 0x0000},
-  {5, 0x0001},
-  {5, 0x0011},
-  {5, 0x0009},
-  {5, 0x0019},
-  {5, 0x0005},
-  {5, 0x0015},
-  {5, 0x000d},
-  {5, 0x001d},
-  {5, 0x0003},
-  {5, 0x0013},
-  {5, 0x000b},
-  {5, 0x001b},
-  {5, 0x0007},
-  {5, 0x0017},
-  {5, 0x000f},
-  {0, 0x0000}
-};
+  for (i = 0; i < 144; ++i) {
+    lengths[i] = 8;
+  }
+  for (i = 144; i < 256; ++i) {
+    lengths[i] = 9;
+  }
+  for (i = 256; i < 280; ++i) {
+    lengths[i] = 7;
+  }
+  for (i = 280; i < 288; ++i) {
+    lengths[i] = 8;
+  }
+  FlateStream::compHuffmanCodes(lengths, flateMaxLitCodes, flateLitCodes,
+				flateLitTableBits,
+				&FlateStream::fixedLitCodeTab);
+  // distance codes 30 and 31 take part in the code, but are invalid
+  for (i = 0; i < 32; ++i) {
+    lengths[i] = 5;
+  }
+  FlateStream::compHuffmanCodes(lengths, 32, flateDistCodes,
+				flateDistTableBits,
+				&FlateStream::fixedDistCodeTab);
+}
 
-FlateHuffmanTab FlateStream::fixedDistCodeTab = {
-  flateFixedDistCodeTabCodes, 5
-};
+static FlateFixedCodes flateFixedCodes;
+
+// Read 8 bytes as a little-endian number (compilers turn this into a
+// single load where possible).
+static inline FlateCodeBuf flateLoad64(const Guchar *p) {
+  return (FlateCodeBuf)p[0]
+         | ((FlateCodeBuf)p[1] << 8)
+         | ((FlateCodeBuf)p[2] << 16)
+         | ((FlateCodeBuf)p[3] << 24)
+         | ((FlateCodeBuf)p[4] << 32)
+         | ((FlateCodeBuf)p[5] << 40)
+         | ((FlateCodeBuf)p[6] << 48)
+         | ((FlateCodeBuf)p[7] << 56);
+}
 
 FlateStream::FlateStream(Stream *strA, int predictor, int columns,
 			 int colors, int bits):
@@ -4190,18 +3996,26 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns,
   } else {
     pred = NULL;
   }
-  litCodeTab.codes = NULL;
-  distCodeTab.codes = NULL;
+  buf = (Guchar *)gmalloc(flateBufSize);
   memset(buf, 0, flateWindow);
+  index = outEnd = flateWindow;
+  remain = 0;
+  inPos = inLen = 0;
+  readAhead = str->getBaseStream()->allowsReadAhead();
+  litCodeTab.entries = NULL;
+  litCodeTab.size = 0;
+  distCodeTab.entries = NULL;
+  distCodeTab.size = 0;
+  codeLenCodeTab.entries = NULL;
+  codeLenCodeTab.size = 0;
+  litTab = distTab = NULL;
 }
 
 FlateStream::~FlateStream() {
-  if (litCodeTab.codes != fixedLitCodeTab.codes) {
-    gfree(litCodeTab.codes);
-  }
-  if (distCodeTab.codes != fixedDistCodeTab.codes) {
-    gfree(distCodeTab.codes);
-  }
+  gfree(litCodeTab.entries);
+  gfree(distCodeTab.entries);
+  gfree(codeLenCodeTab.entries);
+  gfree(buf);
   if (pred) {
     delete pred;
   }
@@ -4209,10 +4023,13 @@ FlateStream::~FlateStream() {
 }
 
 void FlateStream::unfilteredReset() {
-  index = 0;
+  index = outEnd = flateWindow;
   remain = 0;
+  inPos = inLen = 0;
+  inEOF = gFalse;
   codeBuf = 0;
   codeSize = 0;
+  litTab = distTab = NULL;
   compressedBlock = gFalse;
   endOfBlock = gTrue;
   eof = gTrue;
@@ -4255,14 +4072,29 @@ int FlateStream::getChar() {
 int FlateStream::getChars(int nChars, Guchar *buffer) {
   if (pred) {
     return pred->getChars(nChars, buffer);
-  } else {
-    for (int i = 0; i < nChars; ++i) {
-      const int c = doGetChar();
-      if (likely(c != EOF)) buffer[i] = c;
-      else return i;
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (remain == 0) {
+      if (endOfBlock && eof) {
+	break;
+      }
+      readSome();
+      continue;
     }
-    return nChars;
+    m = nChars - n < remain ? nChars - n : remain;
+    memcpy(buffer + n, buf + index, m);
+    index += m;
+    remain -= m;
+    n += m;
   }
+  return n;
 }
 
 int FlateStream::lookChar() {
@@ -4280,11 +4112,6 @@ int FlateStream::lookChar() {
   return c;
 }
 
-void FlateStream::getRawChars(int nChars, int *buffer) {
-  for (int i = 0; i < nChars; ++i)
-    buffer[i] = doGetRawChar();
-}
-
 int FlateStream::getRawChar() {
   return doGetRawChar();
 }
@@ -4292,13 +4119,18 @@ int FlateStream::getRawChar() {
 GooString *FlateStream::getPSFilter(int psLevel, char *indent) {
   GooString *s;
 
-  if (psLevel < 3 || pred) {
+  if (psLevel < 3) {
     return NULL;
   }
   if (!(s = str->getPSFilter(psLevel, indent))) {
     return NULL;
   }
-  s->append(indent)->append("<< >> /FlateDecode filter\n");
+  s->append(indent)->append("<< ");
+  if (pred && !pred->appendPSParams(s)) {
+    delete s;
+    return NULL;
+  }
+  s->append(">> /FlateDecode filter\n");
   return s;
 }
 
@@ -4306,85 +4138,253 @@ GBool FlateStream::isBinary(GBool last) {
   return str->isBinary(gTrue);
 }
 
+// Decode up to flateOutSize bytes, across block boundaries, and make
+// them available in buf[index .. index + remain - 1].
 void FlateStream::readSome() {
-  int code1, code2;
-  int len, dist;
-  int i, j, k;
-  int c;
-
-  if (endOfBlock) {
-    if (!startBlock())
-      return;
+  // slide the window down once the buffer is full
+  if (outEnd >= flateWindow + flateOutSize) {
+    memmove(buf, buf + outEnd - flateWindow, flateWindow);
+    outEnd = flateWindow;
   }
+  index = outEnd;
 
-  if (compressedBlock) {
-    if ((code1 = getHuffmanCodeWord(&litCodeTab)) == EOF)
-      goto err;
-    if (code1 < 256) {
-      buf[index] = code1;
-      remain = 1;
-    } else if (code1 == 256) {
-      endOfBlock = gTrue;
-      remain = 0;
+  while (outEnd < flateWindow + flateOutSize) {
+    if (endOfBlock) {
+      if (eof || !startBlock()) {
+	break;
+      }
+    }
+    if (compressedBlock) {
+      if (!decodeBlock()) {
+	break;
+      }
     } else {
-      code1 -= 257;
-      code2 = lengthDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
-	goto err;
-      len = lengthDecode[code1].first + code2;
-      if ((code1 = getHuffmanCodeWord(&distCodeTab)) == EOF)
-	goto err;
-      code2 = distDecode[code1].bits;
-      if (code2 > 0 && (code2 = getCodeWord(code2)) == EOF)
-	goto err;
-      dist = distDecode[code1].first + code2;
-      i = index;
-      j = (index - dist) & flateMask;
-      for (k = 0; k < len; ++k) {
-	buf[i] = buf[j];
-	i = (i + 1) & flateMask;
-	j = (j + 1) & flateMask;
+      if (!readStored()) {
+	break;
       }
-      remain = len;
     }
+  }
 
-  } else {
-    len = (blockLen < flateWindow) ? blockLen : flateWindow;
-    for (i = 0, j = index; i < len; ++i, j = (j + 1) & flateMask) {
-      if ((c = str->getChar()) == EOF) {
-	endOfBlock = eof = gTrue;
-	break;
+  remain = outEnd - index;
+}
+
+// Decode a compressed block until it ends or the output buffer is
+// full.  While there are at least 8 bytes of input and room for a
+// maximal match, symbols are decoded by an inner loop that refills
+// the bit buffer once per symbol without checking for the end of the
+// input; the remaining symbols are decoded one at a time.
+GBool FlateStream::decodeBlock() {
+  FlateCodeBuf bits;
+  Guint *litEntries, *distEntries;
+  Guchar *out, *outLimit, *src, *end;
+  const Guchar *in, *inLimit;
+  Guint e, d;
+  int litBits, distBits, litMask, distMask;
+  int nBits, status, len, dist, n, c;
+
+  litEntries = litTab->entries;
+  litBits = litTab->tableBits;
+  litMask = (1 << litBits) - 1;
+  distEntries = distTab->entries;
+  distBits = distTab->tableBits;
+  distMask = (1 << distBits) - 1;
+  outLimit = buf + flateWindow + flateOutSize;
+
+  while (outEnd < flateWindow + flateOutSize) {
+
+    // fast path
+    if (readAhead && !inEOF && inLen - inPos < 8) {
+      fillInput();
+    }
+    if (inLen - inPos >= 8) {
+      out = buf + outEnd;
+      in = inBuf + inPos;
+      inLimit = inBuf + inLen - 8;
+      bits = codeBuf;
+      nBits = codeSize;
+      status = 0;
+      do {
+	// this leaves 56 to 63 valid bits in the buffer; bits above
+	// that are copies of the following input bytes, which the
+	// next refill ORs in again
+	bits |= flateLoad64(in) << nBits;
+	in += (63 - nBits) >> 3;
+	nBits |= 56;
+
+	e = litEntries[bits & litMask];
+	if (e & flateEntrySub) {
+	  bits >>= litBits;
+	  nBits -= litBits;
+	  e = litEntries[(e >> 16) + (bits & ((1 << ((e >> 4) & 15)) - 1))];
+	}
+	n = e & 15;
+	bits >>= n;
+	nBits -= n;
+
+	if (e & flateEntryLit2) {
+	  out[0] = (Guchar)(e >> 16);
+	  out[1] = (Guchar)(e >> 24);
+	  out += 2;
+	} else if (e & flateEntryLit) {
+	  *out++ = (Guchar)(e >> 16);
+	} else if (e & flateEntryLen) {
+	  n = (e >> 4) & 15;
+	  len = (int)(e >> 16) + (int)(bits & ((1 << n) - 1));
+	  bits >>= n;
+	  nBits -= n;
+	  d = distEntries[bits & distMask];
+	  if (d & flateEntrySub) {
+	    bits >>= distBits;
+	    nBits -= distBits;
+	    d = distEntries[(d >> 16) + (bits & ((1 << ((d >> 4) & 15)) - 1))];
+	  }
+	  if (!(d & flateEntryLen)) {
+	    status = -1;
+	    break;
+	  }
+	  n = d & 15;
+	  bits >>= n;
+	  nBits -= n;
+	  n = (d >> 4) & 15;
+	  dist = (int)(d >> 16) + (int)(bits & ((1 << n) - 1));
+	  bits >>= n;
+	  nBits -= n;
+
+	  // there are always flateWindow bytes before out, so the
+	  // source is inside the buffer; copies of 8 bytes may run up to
+	  // 7 bytes past the end of the match
+	  src = out - dist;
+	  end = out + len;
+	  if (dist >= 8) {
+	    do {
+	      memcpy(out, src, 8);
+	      out += 8;
+	      src += 8;
+	    } while (out < end);
+	  } else if (dist == 1) {
+	    memset(out, *src, len);
+	  } else {
+	    do {
+	      *out++ = *src++;
+	    } while (out < end);
+	  }
+	  out = end;
+	} else if (e & flateEntryEOB) {
+	  status = 1;
+	  break;
+	} else {
+	  status = -1;
+	  break;
+	}
+      } while (in <= inLimit && out < outLimit);
+      outEnd = (int)(out - buf);
+      inPos = (int)(in - inBuf);
+      codeBuf = bits & (((FlateCodeBuf)1 << nBits) - 1);
+      codeSize = nBits;
+      if (status > 0) {
+	endOfBlock = gTrue;
+	return gTrue;
       }
-      buf[j] = c & 0xff;
+      if (status < 0) {
+	goto err;
+      }
+      continue;
     }
-    remain = i;
-    blockLen -= len;
-    if (blockLen == 0)
+
+    // slow path: decode one symbol
+    if (!(e = getHuffmanCodeWord(litTab))) {
+      goto err;
+    }
+    if (e & flateEntryLit2) {
+      buf[outEnd++] = (Guchar)(e >> 16);
+      buf[outEnd++] = (Guchar)(e >> 24);
+    } else if (e & flateEntryLit) {
+      buf[outEnd++] = (Guchar)(e >> 16);
+    } else if (e & flateEntryLen) {
+      len = (int)(e >> 16);
+      if ((n = (e >> 4) & 15) > 0) {
+	if ((c = getCodeWord(n)) == EOF) {
+	  goto err;
+	}
+	len += c;
+      }
+      if (!(d = getHuffmanCodeWord(distTab)) || !(d & flateEntryLen)) {
+	goto err;
+      }
+      dist = (int)(d >> 16);
+      if ((n = (d >> 4) & 15) > 0) {
+	if ((c = getCodeWord(n)) == EOF) {
+	  goto err;
+	}
+	dist += c;
+      }
+      src = buf + outEnd - dist;
+      for (; len > 0; --len) {
+	buf[outEnd++] = *src++;
+      }
+    } else {
       endOfBlock = gTrue;
+      return gTrue;
+    }
   }
-
-  return;
+  return gTrue;
 
 err:
   error(getPos(), "Unexpected end of file in flate stream");
   endOfBlock = eof = gTrue;
-  remain = 0;
+  return gFalse;
+}
+
+// Copy data from an uncompressed block.
+GBool FlateStream::readStored() {
+  int n, m;
+
+  n = flateWindow + flateOutSize - outEnd;
+  if (n > blockLen) {
+    n = blockLen;
+  }
+
+  // whole bytes left in the bit buffer
+  while (n > 0 && codeSize >= 8) {
+    buf[outEnd++] = (Guchar)codeBuf;
+    codeBuf >>= 8;
+    codeSize -= 8;
+    --n;
+    --blockLen;
+  }
+
+  // the input buffer
+  m = inLen - inPos < n ? inLen - inPos : n;
+  if (m > 0) {
+    memcpy(buf + outEnd, inBuf + inPos, m);
+    inPos += m;
+    outEnd += m;
+    n -= m;
+    blockLen -= m;
+  }
+
+  // the rest straight from the underlying stream
+  if (n > 0) {
+    m = str->doGetChars(n, buf + outEnd);
+    outEnd += m;
+    blockLen -= m;
+    if (m < n) {
+      endOfBlock = eof = gTrue;
+      return gFalse;
+    }
+  }
+
+  if (blockLen == 0) {
+    endOfBlock = gTrue;
+  }
+  return gTrue;
 }
 
 GBool FlateStream::startBlock() {
   int blockHdr;
-  int c;
   int check;
 
-  // free the code tables from the previous block
-  if (litCodeTab.codes != fixedLitCodeTab.codes) {
-    gfree(litCodeTab.codes);
-  }
-  litCodeTab.codes = NULL;
-  if (distCodeTab.codes != fixedDistCodeTab.codes) {
-    gfree(distCodeTab.codes);
-  }
-  distCodeTab.codes = NULL;
+  litTab = distTab = NULL;
 
   // read block header
   blockHdr = getCodeWord(3);
@@ -4395,27 +4395,20 @@ GBool FlateStream::startBlock() {
   // uncompressed block
   if (blockHdr == 0) {
     compressedBlock = gFalse;
-    if ((c = str->getChar()) == EOF)
+    codeBuf >>= codeSize & 7;
+    codeSize &= ~7;
+    if ((blockLen = getCodeWord(16)) == EOF)
       goto err;
-    blockLen = c & 0xff;
-    if ((c = str->getChar()) == EOF)
+    if ((check = getCodeWord(16)) == EOF)
       goto err;
-    blockLen |= (c & 0xff) << 8;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    check = c & 0xff;
-    if ((c = str->getChar()) == EOF)
-      goto err;
-    check |= (c & 0xff) << 8;
     if (check != (~blockLen & 0xffff))
       error(getPos(), "Bad uncompressed block length in flate stream");
-    codeBuf = 0;
-    codeSize = 0;
 
   // compressed block with fixed codes
   } else if (blockHdr == 1) {
     compressedBlock = gTrue;
-    loadFixedCodes();
+    litTab = &fixedLitCodeTab;
+    distTab = &fixedDistCodeTab;
 
   // compressed block with dynamic codes
   } else if (blockHdr == 2) {
@@ -4438,24 +4431,15 @@ err:
   return gFalse;
 }
 
-void FlateStream::loadFixedCodes() {
-  litCodeTab.codes = fixedLitCodeTab.codes;
-  litCodeTab.maxLen = fixedLitCodeTab.maxLen;
-  distCodeTab.codes = fixedDistCodeTab.codes;
-  distCodeTab.maxLen = fixedDistCodeTab.maxLen;
-}
-
 GBool FlateStream::readDynamicCodes() {
   int numCodeLenCodes;
   int numLitCodes;
   int numDistCodes;
   int codeLenCodeLengths[flateMaxCodeLenCodes];
-  FlateHuffmanTab codeLenCodeTab;
   int len, repeat, code;
+  Guint e;
   int i;
 
-  codeLenCodeTab.codes = NULL;
-
   // read lengths
   if ((numLitCodes = getCodeWord(5)) == EOF) {
     goto err;
@@ -4484,16 +4468,21 @@ GBool FlateStream::readDynamicCodes() {
       goto err;
     }
   }
-  compHuffmanCodes(codeLenCodeLengths, flateMaxCodeLenCodes, &codeLenCodeTab);
+  if (!compHuffmanCodes(codeLenCodeLengths, flateMaxCodeLenCodes,
+			flateCodeLenCodes, flateCodeLenTableBits,
+			&codeLenCodeTab)) {
+    goto err;
+  }
 
   // build the literal and distance code tables
   len = 0;
   repeat = 0;
   i = 0;
   while (i < numLitCodes + numDistCodes) {
-    if ((code = getHuffmanCodeWord(&codeLenCodeTab)) == EOF) {
+    if (!(e = getHuffmanCodeWord(&codeLenCodeTab))) {
       goto err;
     }
+    code = (int)(e >> 16);
     if (code == 16) {
       if ((repeat = getCodeWord(2)) == EOF) {
 	goto err;
@@ -4533,98 +4522,251 @@ GBool FlateStream::readDynamicCodes() {
       codeLengths[i++] = len = code;
     }
   }
-  compHuffmanCodes(codeLengths, numLitCodes, &litCodeTab);
-  compHuffmanCodes(codeLengths + numLitCodes, numDistCodes, &distCodeTab);
+  if (!compHuffmanCodes(codeLengths, numLitCodes, flateLitCodes,
+			flateLitTableBits, &litCodeTab) ||
+      !compHuffmanCodes(codeLengths + numLitCodes, numDistCodes,
+			flateDistCodes, flateDistTableBits, &distCodeTab)) {
+    goto err;
+  }
+  litTab = &litCodeTab;
+  distTab = &distCodeTab;
 
-  gfree(codeLenCodeTab.codes);
   return gTrue;
 
 err:
   error(getPos(), "Bad dynamic code table in flate stream");
-  gfree(codeLenCodeTab.codes);
   return gFalse;
 }
 
 // Convert an array <lengths> of <n> lengths, in value order, into a
-// Huffman code lookup table.
-void FlateStream::compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab) {
-  int tabSize, len, code, code2, skip, val, i, t;
-
-  // find max code length
+// two-level Huffman code lookup table with a <tableBits>-bit first
+// level.  Returns false if the lengths are over-subscribed.
+GBool FlateStream::compHuffmanCodes(int *lengths, int n, int kind,
+				    int tableBits, FlateHuffmanTab *tab) {
+  int count[flateMaxHuffman + 1], nextCode[flateMaxHuffman + 1];
+  int codes[flateMaxLitCodes + 4];
+  Guchar subBits[1 << flateLitTableBits];
+  int subOffset[1 << flateLitTableBits];
+  Guint first[1 << flateLitTableBits];
+  int tableSize, tableMask, size, left, len, code, val, sub, i, t;
+  Guint e, e2;
+
+  tableSize = 1 << tableBits;
+  tableMask = tableSize - 1;
+
+  // count the codes of each length, and find the first code of each
+  // length
+  for (len = 0; len <= flateMaxHuffman; ++len) {
+    count[len] = 0;
+  }
   tab->maxLen = 0;
   for (val = 0; val < n; ++val) {
+    ++count[lengths[val]];
     if (lengths[val] > tab->maxLen) {
       tab->maxLen = lengths[val];
     }
   }
+  count[0] = 0;
+  left = 1;
+  code = 0;
+  for (len = 1; len <= flateMaxHuffman; ++len) {
+    left = (left << 1) - count[len];
+    if (left < 0) {
+      return gFalse;
+    }
+    code = (code + count[len - 1]) << 1;
+    nextCode[len] = code;
+  }
 
-  // allocate the table
-  tabSize = 1 << tab->maxLen;
-  tab->codes = (FlateCode *)gmallocn(tabSize, sizeof(FlateCode));
+  // assign the codes, bit-reversed, and find the size of the
+  // second-level table below each first-level entry
+  for (i = 0; i < tableSize; ++i) {
+    subBits[i] = 0;
+  }
+  for (val = 0; val < n; ++val) {
+    if ((len = lengths[val])) {
+      code = 0;
+      t = nextCode[len]++;
+      for (i = 0; i < len; ++i) {
+	code = (code << 1) | (t & 1);
+	t >>= 1;
+      }
+      codes[val] = code;
+      if (len > tableBits && len - tableBits > subBits[code & tableMask]) {
+	subBits[code & tableMask] = (Guchar)(len - tableBits);
+      }
+    }
+  }
+  size = tableSize;
+  for (i = 0; i < tableSize; ++i) {
+    if (subBits[i]) {
+      subOffset[i] = size;
+      size += 1 << subBits[i];
+    }
+  }
 
-  // clear the table
-  for (i = 0; i < tabSize; ++i) {
-    tab->codes[i].len = 0;
-    tab->codes[i].val = 0;
+  // allocate and clear the table
+  if (tab->size < size) {
+    tab->entries = (Guint *)greallocn(tab->entries, size, sizeof(Guint));
+    tab->size = size;
+  }
+  tab->tableBits = tableBits;
+  memset(tab->entries, 0, size * sizeof(Guint));
+  for (i = 0; i < tableSize; ++i) {
+    if (subBits[i]) {
+      tab->entries[i] = flateEntrySub | ((Guint)subOffset[i] << 16)
+	                | (subBits[i] << 4) | tableBits;
+    }
   }
 
-  // build the table
-  for (len = 1, code = 0, skip = 2;
-       len <= tab->maxLen;
-       ++len, code <<= 1, skip <<= 1) {
-    for (val = 0; val < n; ++val) {
-      if (lengths[val] == len) {
+  // fill in the entries
+  for (val = 0; val < n; ++val) {
+    if (!(len = lengths[val])) {
+      continue;
+    }
+    if (kind == flateCodeLenCodes) {
+      e = flateEntryLit | ((Guint)val << 16);
+    } else if (kind == flateLitCodes) {
+      if (val < 256) {
+	e = flateEntryLit | ((Guint)val << 16);
+      } else if (val == 256) {
+	e = flateEntryEOB;
+      } else {
+	e = flateEntryLen | ((Guint)lengthDecode[val - 257].first << 16)
+	    | (lengthDecode[val - 257].bits << 4);
+      }
+    } else {
+      if (val < flateMaxDistCodes) {
+	e = flateEntryLen | ((Guint)distDecode[val].first << 16)
+	    | (distDecode[val].bits << 4);
+      } else {
+	e = 0;
+      }
+    }
+    code = codes[val];
+    if (len <= tableBits) {
+      if (e) {
+	e |= len;
+      }
+      for (i = code; i < tableSize; i += 1 << len) {
+	tab->entries[i] = e;
+      }
+    } else {
+      sub = len - tableBits;
+      if (e) {
+	e |= sub;
+      }
+      t = code & tableMask;
+      for (i = code >> tableBits; i < (1 << subBits[t]); i += 1 << sub) {
+	tab->entries[subOffset[t] + i] = e;
+      }
+    }
+  }
 
-	// bit-reverse the code
-	code2 = 0;
-	t = code;
-	for (i = 0; i < len; ++i) {
-	  code2 = (code2 << 1) | (t & 1);
-	  t >>= 1;
-	}
+  // a literal code shorter than the first-level index is followed by
+  // enough bits to look up the next code; if that is a short literal
+  // too, store both in the entry
+  if (kind == flateLitCodes) {
+    memcpy(first, tab->entries, tableSize * sizeof(Guint));
+    for (i = 0; i < tableSize; ++i) {
+      e = first[i];
+      if (!(e & flateEntryLit) || (len = e & 15) >= tableBits) {
+	continue;
+      }
+      e2 = first[i >> len];
+      if (!(e2 & flateEntryLit) || len + (int)(e2 & 15) > tableBits) {
+	continue;
+      }
+      tab->entries[i] = flateEntryLit2
+	                | ((e >> 16) << 16) | ((e2 >> 16) << 24)
+	                | (len << 4) | (len + (e2 & 15));
+    }
+  }
 
-	// fill in the table entries
-	for (i = code2; i < tabSize; i += skip) {
-	  tab->codes[i].len = (Gushort)len;
-	  tab->codes[i].val = (Gushort)val;
-	}
+  return gTrue;
+}
 
-	++code;
-      }
+// Get the next byte of input, or EOF.
+int FlateStream::getInputByte() {
+  if (inPos < inLen) {
+    return inBuf[inPos++];
+  }
+  if (!readAhead) {
+    return str->getChar();
+  }
+  if (!inEOF) {
+    fillInput();
+    if (inPos < inLen) {
+      return inBuf[inPos++];
     }
   }
+  return EOF;
 }
 
-int FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
-  FlateCode *code;
-  int c;
+// Move the unread input to the start of the buffer and fill the rest
+// of it from the underlying stream.
+void FlateStream::fillInput() {
+  int n, m;
+
+  n = inLen - inPos;
+  if (n > 0 && inPos > 0) {
+    memmove(inBuf, inBuf + inPos, n);
+  }
+  inPos = 0;
+  inLen = n;
+  if ((m = str->doGetChars(flateInSize - n, inBuf + n)) > 0) {
+    inLen += m;
+  } else {
+    inEOF = gTrue;
+  }
+}
+
+// Returns the table entry of the next code, or 0 at end of file or
+// on an invalid code.
+Guint FlateStream::getHuffmanCodeWord(FlateHuffmanTab *tab) {
+  Guint e;
+  int n, c;
 
   while (codeSize < tab->maxLen) {
-    if ((c = str->getChar()) == EOF) {
+    if ((c = getInputByte()) == EOF) {
       break;
     }
-    codeBuf |= (c & 0xff) << codeSize;
+    codeBuf |= (FlateCodeBuf)c << codeSize;
     codeSize += 8;
   }
-  code = &tab->codes[codeBuf & ((1 << tab->maxLen) - 1)];
-  if (codeSize == 0 || codeSize < code->len || code->len == 0) {
-    return EOF;
+  e = tab->entries[codeBuf & ((1 << tab->tableBits) - 1)];
+  if (e & flateEntrySub) {
+    e = tab->entries[(e >> 16) +
+		     ((codeBuf >> tab->tableBits) &
+		      ((1 << ((e >> 4) & 15)) - 1))];
+    n = tab->tableBits + (e & 15);
+  } else {
+    n = e & 15;
+    // near the end of the input, the second literal may be made up
+    // of padding bits
+    if ((e & flateEntryLit2) && n > codeSize) {
+      n = (e >> 4) & 15;
+      e = flateEntryLit | (e & 0x00ff0000) | n;
+    }
   }
-  codeBuf >>= code->len;
-  codeSize -= code->len;
-  return (int)code->val;
+  if (!e || n > codeSize) {
+    return 0;
+  }
+  codeBuf >>= n;
+  codeSize -= n;
+  return e;
 }
 
 int FlateStream::getCodeWord(int bits) {
   int c;
 
   while (codeSize < bits) {
-    if ((c = str->getChar()) == EOF)
+    if ((c = getInputByte()) == EOF)
       return EOF;
-    codeBuf |= (c & 0xff) << codeSize;
+    codeBuf |= (FlateCodeBuf)c << codeSize;
     codeSize += 8;
   }
-  c = codeBuf & ((1 << bits) - 1);
+  c = (int)(codeBuf & ((1 << bits) - 1));
   codeBuf >>= bits;
   codeSize -= bits;
   return c;
@@ -164,7 +164,11 @@ public:
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+
+  // Get up to <nChars> chars without using the predictor.  Returns
+  // the number of chars read, which is less than <nChars> only at
+  // the end of the stream.  This is only used by StreamPredictor.
+  virtual int getRawChars(int nChars, Guchar *buffer);
 
   // Get next char directly from stream source, without filtering it
   virtual int getUnfilteredChar () = 0;
@@ -308,6 +312,11 @@ public:
   virtual Guint getStart() = 0;
   virtual void moveStart(int delta) = 0;
 
+  // Returns false if filters must not read past the end of their
+  // encoded data, because the bytes that follow it belong to someone
+  // else (unlimited inline image data).
+  virtual GBool allowsReadAhead() { return gTrue; }
+
 protected:
 
   Guint length;
@@ -406,6 +415,17 @@ public:
   int getChar();
   int getChars(int nChars, Guchar *buffer);
 
+  int getPredictor() { return predictor; }
+  int getWidth() { return width; }
+  int getNComps() { return nComps; }
+  int getNBits() { return nBits; }
+
+  // Append the entries that select this predictor in the parameter
+  // dictionary of a PostScript LZWDecode or FlateDecode filter
+  // (LanguageLevel 3) to <s>.  Returns false, without appending
+  // anything, if PostScript does not support the parameters.
+  GBool appendPSParams(GooString *s);
+
 private:
 
   GBool getNextLine();
@@ -428,6 +448,8 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *prevLine;		// previous line
+  Guchar *rawLine;		// undecoded line
   int predIdx;			// current index in predLine
   GBool ok;
 };
@@ -469,15 +491,7 @@ private:
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
 
   virtual GBool hasGetChars() { return true; }
-  virtual int getChars(int nChars, Guchar *buffer)
-    {
-      for (int i = 0; i < nChars; ++i) {
-        const int c = doGetChar();
-        if (likely(c != EOF)) buffer[i] = c;
-        else return i;
-      }
-      return nChars;
-    }
+  virtual int getChars(int nChars, Guchar *buffer);
 
   FILE *f;
   Guint start;
@@ -519,6 +533,8 @@ public:
   virtual int getUnfilteredChar () { return getChar(); }
   virtual void unfilteredReset () { reset(); }
 
+  CachedFile *getCachedFile() { return cc; }
+
 private:
 
   GBool fillBuf();
@@ -567,6 +583,9 @@ public:
 
 private:
 
+  virtual GBool hasGetChars() { return true; }
+  virtual int getChars(int nChars, Guchar *buffer);
+
   char *buf;
   Guint start;
   char *bufEnd;
@@ -599,6 +618,7 @@ public:
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart();
   virtual void moveStart(int delta);
+  virtual GBool allowsReadAhead() { return limited; }
 
   virtual int getUnfilteredChar () { return str->getUnfilteredChar(); }
   virtual void unfilteredReset () { str->unfilteredReset(); }
@@ -673,7 +693,7 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -766,6 +786,13 @@ public:
 
   virtual void unfilteredReset ();
 
+  int getEncoding() { return encoding; }
+  GBool getEndOfLine() { return endOfLine; }
+  GBool getEncodedByteAlign() { return byteAlign; }
+  GBool getEndOfBlock() { return endOfBlock; }
+  int getColumns() { return columns; }
+  GBool getBlackIs1() { return black; }
+
 private:
 
   int encoding;			// 'K' parameter
@@ -910,22 +937,38 @@ private:
 // FlateStream
 //------------------------------------------------------------------------
 
-#define flateWindow          32768    // buffer size
-#define flateMask            (flateWindow-1)
+#define flateWindow          32768    // LZ77 window size
+#define flateOutSize         32768    // bytes decoded per readSome() call
+#define flateInSize           4096    // input buffer size
 #define flateMaxHuffman         15    // max Huffman code length
 #define flateMaxCodeLenCodes    19    // max # code length codes
 #define flateMaxLitCodes       288    // max # literal codes
 #define flateMaxDistCodes       30    // max # distance codes
-
-// Huffman code table entry
-struct FlateCode {
-  Gushort len;			// code length, in bits
-  Gushort val;			// value represented by this code
-};
-
+#define flateLitTableBits       10    // index bits of the literal table
+#define flateDistTableBits       8    // index bits of the distance table
+#define flateCodeLenTableBits    7    // index bits of the code length table
+
+// The bit buffer holds at least 56 bits after a refill in the fast
+// decoding loop, which is enough for a complete length/distance pair
+// (15 + 5 + 15 + 13 bits).
+typedef unsigned long long FlateCodeBuf;
+
+// Huffman decoding table.  The first 1 << tableBits entries are
+// indexed by the next tableBits input bits; codes longer than that
+// go through a second-level table.  Each entry is a Guint:
+//   bits 0-3   number of bits to consume
+//   bits 4-7   number of extra bits (length/distance entries), size
+//              index of the second-level table (flateEntrySub), or
+//              length of the first code (flateEntryLit2)
+//   bits 8-15  flags
+//   bits 16-31 literal value, two literal values (flateEntryLit2),
+//              first length/distance, or second-level table offset
+// A zero entry is an invalid code.
 struct FlateHuffmanTab {
-  FlateCode *codes;
-  int maxLen;
+  Guint *entries;
+  int size;			// allocated entries
+  int tableBits;		// index bits of the first-level table
+  int maxLen;			// max code length
 };
 
 // Decoding info for length and distance code words
@@ -945,11 +988,14 @@ public:
   virtual int getChar();
   virtual int lookChar();
   virtual int getRawChar();
-  virtual void getRawChars(int nChars, int *buffer);
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
   virtual void unfilteredReset ();
 
+  // Get the predictor, or NULL if there is none.
+  StreamPredictor *getStreamPredictor() { return pred; }
+
 private:
   inline int doGetRawChar() {
     int c;
@@ -959,8 +1005,7 @@ private:
         return EOF;
       readSome();
     }
-    c = buf[index];
-    index = (index + 1) & flateMask;
+    c = buf[index++];
     --remain;
     return c;
   }
@@ -976,15 +1021,26 @@ private:
   virtual int getChars(int nChars, Guchar *buffer);
 
   StreamPredictor *pred;	// predictor
-  Guchar buf[flateWindow];	// output data buffer
+  Guchar *buf;			// output data buffer: the previous
+				//   flateWindow bytes, followed by the
+				//   newly decoded data
   int index;			// current index into output buffer
   int remain;			// number valid bytes in output buffer
-  int codeBuf;			// input buffer
-  int codeSize;			// number of bits in input buffer
+  int outEnd;			// end of the decoded data in buf
+  Guchar inBuf[flateInSize];	// input buffer
+  int inPos;			// current index into input buffer
+  int inLen;			// number of valid bytes in input buffer
+  GBool readAhead;		// set if the input may be read in blocks
+  GBool inEOF;			// set when the input is exhausted
+  FlateCodeBuf codeBuf;		// bit buffer
+  int codeSize;			// number of bits in bit buffer
   int				// literal and distance code lengths
     codeLengths[flateMaxLitCodes + flateMaxDistCodes];
-  FlateHuffmanTab litCodeTab;	// literal code table
-  FlateHuffmanTab distCodeTab;	// distance code table
+  FlateHuffmanTab litCodeTab;	// dynamic literal code table
+  FlateHuffmanTab distCodeTab;	// dynamic distance code table
+  FlateHuffmanTab codeLenCodeTab; // code length code table
+  FlateHuffmanTab *litTab;	// literal code table for this block
+  FlateHuffmanTab *distTab;	// distance code table for this block
   GBool compressedBlock;	// set if reading a compressed block
   int blockLen;			// remaining length of uncompressed block
   GBool endOfBlock;		// set when end of block is reached
@@ -1001,13 +1057,19 @@ private:
   static FlateHuffmanTab	// fixed distance code table
     fixedDistCodeTab;
 
+  friend class FlateFixedCodes;
+
   void readSome();
   GBool startBlock();
-  void loadFixedCodes();
+  GBool decodeBlock();
+  GBool readStored();
   GBool readDynamicCodes();
-  void compHuffmanCodes(int *lengths, int n, FlateHuffmanTab *tab);
-  int getHuffmanCodeWord(FlateHuffmanTab *tab);
+  static GBool compHuffmanCodes(int *lengths, int n, int kind,
+				int tableBits, FlateHuffmanTab *tab);
+  Guint getHuffmanCodeWord(FlateHuffmanTab *tab);
   int getCodeWord(int bits);
+  int getInputByte();
+  void fillInput();
 };
 #endif
 
@@ -225,11 +225,13 @@ GBool TextFontInfo::matches(GfxState *state) {
 // TextWord
 //------------------------------------------------------------------------
 
-TextWord::TextWord(GfxState *state, int rotA, double x0, double y0,
+TextWord::TextWord(GooArena *arenaA, GfxState *state, int rotA,
+		   double x0, double y0,
 		   int charPosA, TextFontInfo *fontA, double fontSizeA) {
   GfxFont *gfxFont;
   double x, y, ascent, descent;
 
+  arena = arenaA;
   rot = rotA;
   charPos = charPosA;
   charLen = 0;
@@ -315,19 +317,22 @@ TextWord::TextWord(GfxState *state, int rotA, double x0, double y0,
   link = NULL;
 }
 
-TextWord::~TextWord() {
-  gfree(text);
-  gfree(charcode);
-  gfree(edge);
+// Make room for <newSize> chars.  The arrays live in the page arena,
+// which can't free the old copies, so they grow geometrically to keep
+// the abandoned space proportional to the final size.
+void TextWord::grow(int newSize) {
+  text = (Unicode *)arena->reallocn(text, size, newSize, sizeof(Unicode));
+  charcode = (CharCode *)arena->reallocn(charcode, size, newSize,
+					 sizeof(CharCode));
+  edge = (double *)arena->reallocn(edge, size ? size + 1 : 0, newSize + 1,
+				   sizeof(double));
+  size = newSize;
 }
 
 void TextWord::addChar(GfxState *state, double x, double y,
 		       double dx, double dy, CharCode c, Unicode u) {
   if (len == size) {
-    size += 16;
-    text = (Unicode *)greallocn(text, size, sizeof(Unicode));
-    charcode = (Unicode *)greallocn(charcode, size, sizeof(CharCode));
-    edge = (double *)greallocn(edge, (size + 1), sizeof(double));
+    grow(size ? 2 * size : 16);
   }
   text[len] = u;
   charcode[len] = c;
@@ -380,10 +385,7 @@ void TextWord::merge(TextWord *word) {
     yMax = word->yMax;
   }
   if (len + word->len > size) {
-    size = len + word->len;
-    text = (Unicode *)greallocn(text, size, sizeof(Unicode));
-    charcode = (CharCode *)greallocn(charcode, (size + 1), sizeof(CharCode));
-    edge = (double *)greallocn(edge, (size + 1), sizeof(double));
+    grow(len + word->len > 2 * size ? len + word->len : 2 * size);
   }
   for (i = 0; i < word->len; ++i) {
     text[len + i] = word->text[i];
@@ -508,7 +510,8 @@ void TextWord::getCharBBox(int charIdx, double *xMinA, double *yMinA,
 // TextPool
 //------------------------------------------------------------------------
 
-TextPool::TextPool() {
+TextPool::TextPool(GooArena *arenaA) {
+  arena = arenaA;
   minBaseIdx = 0;
   maxBaseIdx = -1;
   pool = NULL;
@@ -516,19 +519,6 @@ TextPool::TextPool() {
   cursorBaseIdx = -1;
 }
 
-TextPool::~TextPool() {
-  int baseIdx;
-  TextWord *word, *word2;
-
-  for (baseIdx = minBaseIdx; baseIdx <= maxBaseIdx; ++baseIdx) {
-    for (word = pool[baseIdx - minBaseIdx]; word; word = word2) {
-      word2 = word->next;
-      delete word;
-    }
-  }
-  gfree(pool);
-}
-
 int TextPool::getBaseIdx(double base) {
   int baseIdx;
 
@@ -552,27 +542,27 @@ void TextPool::addWord(TextWord *word) {
   if (minBaseIdx > maxBaseIdx) {
     minBaseIdx = wordBaseIdx - 128;
     maxBaseIdx = wordBaseIdx + 128;
-    pool = (TextWord **)gmallocn(maxBaseIdx - minBaseIdx + 1,
-				 sizeof(TextWord *));
+    pool = (TextWord **)arena->allocn(maxBaseIdx - minBaseIdx + 1,
+				      sizeof(TextWord *));
     for (baseIdx = minBaseIdx; baseIdx <= maxBaseIdx; ++baseIdx) {
       pool[baseIdx - minBaseIdx] = NULL;
     }
   } else if (wordBaseIdx < minBaseIdx) {
     newMinBaseIdx = wordBaseIdx - 128;
-    newPool = (TextWord **)gmallocn(maxBaseIdx - newMinBaseIdx + 1,
-				    sizeof(TextWord *));
+    newPool = (TextWord **)arena->allocn(maxBaseIdx - newMinBaseIdx + 1,
+					 sizeof(TextWord *));
     for (baseIdx = newMinBaseIdx; baseIdx < minBaseIdx; ++baseIdx) {
       newPool[baseIdx - newMinBaseIdx] = NULL;
     }
     memcpy(&newPool[minBaseIdx - newMinBaseIdx], pool,
 	   (maxBaseIdx - minBaseIdx + 1) * sizeof(TextWord *));
-    gfree(pool);
     pool = newPool;
     minBaseIdx = newMinBaseIdx;
   } else if (wordBaseIdx > maxBaseIdx) {
     newMaxBaseIdx = wordBaseIdx + 128;
-    pool = (TextWord **)greallocn(pool, newMaxBaseIdx - minBaseIdx + 1,
-				  sizeof(TextWord *));
+    pool = (TextWord **)arena->reallocn(pool, maxBaseIdx - minBaseIdx + 1,
+					newMaxBaseIdx - minBaseIdx + 1,
+					sizeof(TextWord *));
     for (baseIdx = maxBaseIdx + 1; baseIdx <= newMaxBaseIdx; ++baseIdx) {
       pool[baseIdx - minBaseIdx] = NULL;
     }
@@ -622,23 +612,6 @@ TextLine::TextLine(TextBlock *blkA, int rotA, double baseA) {
   normalized_idx = NULL;
 }
 
-TextLine::~TextLine() {
-  TextWord *word;
-
-  while (words) {
-    word = words;
-    words = words->next;
-    delete word;
-  }
-  gfree(text);
-  gfree(edge);
-  gfree(col);
-  if (normalized) {
-    gfree(normalized);
-    gfree(normalized_idx);
-  }
-}
-
 void TextLine::addWord(TextWord *word) {
   if (lastWord) {
     lastWord->next = word;
@@ -787,7 +760,6 @@ void TextLine::coalesce(UnicodeMap *uMap) {
 		 word1->charPos == word0->charPos + word0->charLen) {
 	word0->merge(word1);
 	word0->next = word1->next;
-	delete word1;
 	word1 = word0->next;
       } else {
 	word0 = word1;
@@ -805,8 +777,8 @@ void TextLine::coalesce(UnicodeMap *uMap) {
       ++len;
     }
   }
-  text = (Unicode *)gmallocn(len, sizeof(Unicode));
-  edge = (double *)gmallocn(len + 1, sizeof(double));
+  text = (Unicode *)blk->page->arena->allocn(len, sizeof(Unicode));
+  edge = (double *)blk->page->arena->allocn(len + 1, sizeof(double));
   i = 0;
   for (word1 = words; word1; word1 = word1->next) {
     for (j = 0; j < word1->len; ++j) {
@@ -822,7 +794,7 @@ void TextLine::coalesce(UnicodeMap *uMap) {
   }
 
   // compute convertedLen and set up the col array
-  col = (int *)gmallocn(len + 1, sizeof(int));
+  col = (int *)blk->page->arena->allocn(len + 1, sizeof(int));
   convertedLen = 0;
   for (i = 0; i < len; ++i) {
     col[i] = convertedLen;
@@ -1152,7 +1124,7 @@ TextBlock::TextBlock(TextPage *pageA, int rotA) {
   xMax = yMax = -1;
   priMin = 0;
   priMax = page->pageWidth;
-  pool = new TextPool();
+  pool = new (page->arena) TextPool(page->arena);
   lines = NULL;
   curLine = NULL;
   next = NULL;
@@ -1161,17 +1133,6 @@ TextBlock::TextBlock(TextPage *pageA, int rotA) {
   tableEnd = gFalse;
 }
 
-TextBlock::~TextBlock() {
-  TextLine *line;
-
-  delete pool;
-  while (lines) {
-    line = lines;
-    lines = lines->next;
-    delete line;
-  }
-}
-
 void TextBlock::addWord(TextWord *word) {
   pool->addWord(word);
   if (xMin > xMax) {
@@ -1263,7 +1224,6 @@ void TextBlock::coalesce(UnicodeMap *uMap) {
 	} else {
 	  pool->setPool(idx1, word2->next);
 	}
-	delete word2;
       } else {
 	word0 = word0->next;
       }
@@ -1304,7 +1264,7 @@ void TextBlock::coalesce(UnicodeMap *uMap) {
     word0 = pool->getPool(startBaseIdx);
     pool->setPool(startBaseIdx, word0->next);
     word0->next = NULL;
-    line = new TextLine(this, word0->rot, word0->base);
+    line = new (page->arena) TextLine(this, word0->rot, word0->base);
     line->addWord(word0);
     lastWord = word0;
 
@@ -1793,16 +1753,6 @@ TextFlow::TextFlow(TextPage *pageA, TextBlock *blk) {
   next = NULL;
 }
 
-TextFlow::~TextFlow() {
-  TextBlock *blk;
-
-  while (blocks) {
-    blk = blocks;
-    blocks = blocks->next;
-    delete blk;
-  }
-}
-
 void TextFlow::addBlock(TextBlock *blk) {
   if (lastBlk) {
     lastBlk->next = blk;
@@ -1947,9 +1897,10 @@ TextPage::TextPage(GBool rawOrderA) {
   nest = 0;
   nTinyChars = 0;
   lastCharOverlap = gFalse;
+  arena = new GooArena();
   if (!rawOrder) {
     for (rot = 0; rot < 4; ++rot) {
-      pools[rot] = new TextPool();
+      pools[rot] = new (arena) TextPool(arena);
     }
   }
   flows = NULL;
@@ -1964,14 +1915,8 @@ TextPage::TextPage(GBool rawOrderA) {
 }
 
 TextPage::~TextPage() {
-  int rot;
-
   clear();
-  if (!rawOrder) {
-    for (rot = 0; rot < 4; ++rot) {
-      delete pools[rot];
-    }
-  }
+  delete arena;
   delete fonts;
   deleteGooList(underlines, TextUnderline);
   deleteGooList(links, TextLink);
@@ -2004,30 +1949,10 @@ void TextPage::endPage() {
 
 void TextPage::clear() {
   int rot;
-  TextFlow *flow;
-  TextWord *word;
 
-  if (curWord) {
-    delete curWord;
-    curWord = NULL;
-  }
-  if (rawOrder) {
-    while (rawWords) {
-      word = rawWords;
-      rawWords = rawWords->next;
-      delete word;
-    }
-  } else {
-    for (rot = 0; rot < 4; ++rot) {
-      delete pools[rot];
-    }
-    while (flows) {
-      flow = flows;
-      flows = flows->next;
-      delete flow;
-    }
-    gfree(blocks);
-  }
+  // all words, lines, blocks, and flows (and the blocks array) live in
+  // the arena
+  arena->reset();
   deleteGooList(fonts, TextFontInfo);
 
   curWord = NULL;
@@ -2038,7 +1963,7 @@ void TextPage::clear() {
   nTinyChars = 0;
   if (!rawOrder) {
     for (rot = 0; rot < 4; ++rot) {
-      pools[rot] = new TextPool();
+      pools[rot] = new (arena) TextPool(arena);
     }
   }
   flows = NULL;
@@ -2150,7 +2075,8 @@ void TextPage::beginWord(GfxState *state, double x0, double y0) {
     rot = (m[2] > 0) ? 1 : 3;
   }
 
-  curWord = new TextWord(state, rot, x0, y0, charPos, curFont, curFontSize);
+  curWord = new (arena) TextWord(arena, state, rot, x0, y0, charPos,
+				curFont, curFontSize);
 }
 
 void TextPage::addChar(GfxState *state, double x, double y,
@@ -2316,7 +2242,6 @@ void TextPage::addWord(TextWord *word) {
   // throw away zero-length words -- they don't have valid xMin/xMax
   // values, and they're useless anyway
   if (word->len == 0) {
-    delete word;
     return;
   }
 
@@ -2574,7 +2499,7 @@ void TextPage::coalesce(GBool physLayout, GBool doHTML) {
       word0 = pool->getPool(startBaseIdx);
       pool->setPool(startBaseIdx, word0->next);
       word0->next = NULL;
-      blk = new TextBlock(this, rot);
+      blk = new (arena) TextBlock(this, rot);
       blk->addWord(word0);
 
       fontSize = word0->fontSize;
@@ -2904,9 +2829,7 @@ void TextPage::coalesce(GBool physLayout, GBool doHTML) {
   //----- column assignment
 
   // sort blocks into xy order for column assignment
-  if (blocks)
-    gfree (blocks);
-  blocks = (TextBlock **)gmallocn(nBlocks, sizeof(TextBlock *));
+  blocks = (TextBlock **)arena->allocn(nBlocks, sizeof(TextBlock *));
   for (blk = blkList, i = 0; blk; blk = blk->next, ++i) {
     blocks[i] = blk;
   }
@@ -3318,11 +3241,6 @@ void TextPage::coalesce(GBool physLayout, GBool doHTML) {
   //~ this needs to be adjusted for writing mode (vertical text)
   //~ this also needs to account for right-to-left column ordering
   flow = NULL;
-  while (flows) {
-    flow = flows;
-    flows = flows->next;
-    delete flow;
-  }
   flows = lastFlow = NULL;
   // assume blocks are already in reading order,
   // and construct flows accordingly.
@@ -3339,7 +3257,7 @@ void TextPage::coalesce(GBool physLayout, GBool doHTML) {
 	continue;
       }
     }
-    flow = new TextFlow(this, blk);
+    flow = new (arena) TextFlow(this, blk);
     if (lastFlow) {
       lastFlow->next = flow;
     } else {
@@ -3388,8 +3306,9 @@ GBool TextPage::findText(Unicode *s, int len,
 			 double *xMax, double *yMax) {
   TextBlock *blk;
   TextLine *line;
-  Unicode *s2, *txt;
+  Unicode *s2, *txt, *norm;
   Unicode *p;
+  int *normIdx;
   int txtSize, m, i, j, k;
   double xStart, yStart, xStop, yStop;
   double xMin0, yMin0, xMax0, yMax0;
@@ -3464,10 +3383,21 @@ GBool TextPage::findText(Unicode *s, int len,
 	continue;
       }
 
-      if (!line->normalized)
-	line->normalized = unicodeNormalizeNFKC(line->text, line->len, 
-						&line->normalized_len, 
-						&line->normalized_idx);
+      if (!line->normalized) {
+	// the normalized text is kept in the page arena, along with the
+	// rest of the line
+	norm = unicodeNormalizeNFKC(line->text, line->len,
+				    &line->normalized_len, &normIdx);
+	line->normalized =
+	    (Unicode *)arena->allocn(line->normalized_len, sizeof(Unicode));
+	memcpy(line->normalized, norm, line->normalized_len * sizeof(Unicode));
+	line->normalized_idx =
+	    (int *)arena->allocn(line->normalized_len + 1, sizeof(int));
+	memcpy(line->normalized_idx, normIdx,
+	       (line->normalized_len + 1) * sizeof(int));
+	gfree(norm);
+	gfree(normIdx);
+      }
       // convert the line to uppercase
       m = line->normalized_len;
       if (!caseSensitive) {
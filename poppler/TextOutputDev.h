@@ -32,6 +32,7 @@
 #include "poppler-config.h"
 #include <stdio.h>
 #include "goo/gtypes.h"
+#include "goo/GooArena.h"
 #include "GfxFont.h"
 #include "GfxState.h"
 #include "OutputDev.h"
@@ -108,13 +109,11 @@ private:
 class TextWord {
 public:
 
-  // Constructor.
-  TextWord(GfxState *state, int rotA, double x0, double y0,
+  // Constructor.  The word and its arrays live in <arenaA>, which is
+  // owned by the TextPage.
+  TextWord(GooArena *arenaA, GfxState *state, int rotA, double x0, double y0,
 	   int charPosA, TextFontInfo *fontA, double fontSize);
 
-  // Destructor.
-  ~TextWord();
-
   // Add a character to the word.
   void addChar(GfxState *state, double x, double y,
 	       double dx, double dy, CharCode c, Unicode u);
@@ -167,6 +166,9 @@ public:
   TextWord* nextWord () { return next; };
 private:
 
+  void grow(int newSize);
+
+  GooArena *arena;		// arena holding this word's arrays
   int rot;			// rotation, multiple of 90 degrees
 				//   (0, 1, 2, or 3)
   double xMin, xMax;		// bounding box x coordinates
@@ -214,8 +216,7 @@ private:
 class TextPool {
 public:
 
-  TextPool();
-  ~TextPool();
+  TextPool(GooArena *arenaA);
 
   TextWord *getPool(int baseIdx) { return pool[baseIdx - minBaseIdx]; }
   void setPool(int baseIdx, TextWord *p) { pool[baseIdx - minBaseIdx] = p; }
@@ -226,6 +227,7 @@ public:
 
 private:
 
+  GooArena *arena;		// arena holding the pool array
   int minBaseIdx;		// min baseline bucket index
   int maxBaseIdx;		// max baseline bucket index
   TextWord **pool;		// array of linked lists, one for each
@@ -247,7 +249,6 @@ class TextLine {
 public:
 
   TextLine(TextBlock *blkA, int rotA, double baseA);
-  ~TextLine();
 
   void addWord(TextWord *word);
 
@@ -324,7 +325,6 @@ class TextBlock {
 public:
 
   TextBlock(TextPage *pageA, int rotA);
-  ~TextBlock();
 
   void addWord(TextWord *word);
 
@@ -409,7 +409,6 @@ class TextFlow {
 public:
 
   TextFlow(TextPage *pageA, TextBlock *blk);
-  ~TextFlow();
 
   // Add a block to the end of this flow.
   void addBlock(TextBlock *blk);
@@ -595,6 +594,9 @@ private:
   GBool lastCharOverlap;	// set if the last added char overlapped the
 				//   previous char
 
+  GooArena *arena;		// owns all TextWords, TextPools, TextLines,
+				//   TextBlocks and TextFlows of the
+				//   current page (and their arrays)
   TextPool *pools[4];		// a "pool" of TextWords for each rotation
   TextFlow *flows;		// linked list of flows
   TextBlock **blocks;		// array of blocks, in yx order
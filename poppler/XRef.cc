@@ -37,7 +37,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <map>
 #include "goo/gmem.h"
+#if MULTITHREADED
+#include "goo/GooThread.h"
+#endif
 #include "Object.h"
 #include "Stream.h"
 #include "Lexer.h"
@@ -46,7 +50,6 @@
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "XRef.h"
-#include "PopplerCache.h"
 
 //------------------------------------------------------------------------
 // Permission bits
@@ -63,6 +66,16 @@
 #define permHighResPrint  (1<<11) // bit 12
 #define defPermFlags 0xfffc
 
+//------------------------------------------------------------------------
+
+// max number of cached object streams, and max memory they may use;
+// the memory limit is the one that normally applies
+#define objStrCacheSize 1024
+#define objStrCacheMaxCost (8 * 1024 * 1024)
+
+// size of the buffer used to read xref stream entries
+#define xrefStreamBufSize 4096
+
 //------------------------------------------------------------------------
 // ObjectStream
 //------------------------------------------------------------------------
@@ -71,7 +84,8 @@ class ObjectStream {
 public:
 
   // Create an object stream, using object number <objStrNum>,
-  // generation 0.
+  // generation 0.  Only the header is parsed here; the objects are
+  // parsed on demand by getObject.
   ObjectStream(XRef *xref, int objStrNumA);
 
   GBool isOk() { return ok; }
@@ -85,57 +99,186 @@ public:
   // object number <objNum>, generation 0.
   Object *getObject(int objIdx, int objNum, Object *obj);
 
+  // Return the approximate memory used by this object stream.
+  int getCost() { return cost; }
+
 private:
 
+  XRef *xref;
   int objStrNum;		// object number of the object stream
   int nObjects;			// number of objects in the stream
-  Object *objs;			// the objects (length = nObjects)
+  Object *objs;			// the objects (length = nObjects), objNone
+				//   until parsed
   int *objNums;			// the object numbers (length = nObjects)
+  int *offsets;			// the object offsets in <buf>
+				//   (length = nObjects + 1)
+  Guchar *buf;			// the decoded stream data
+  int bufLen;			// length of <buf>
+  int cost;			// approximate memory used
   GBool ok;
 };
 
-class ObjectStreamKey : public PopplerCacheKey
-{
-  public:
-    ObjectStreamKey(int num) : objStrNum(num)
-    {
-    }
+//------------------------------------------------------------------------
+// ObjectStreamCache
+//------------------------------------------------------------------------
 
-    bool operator==(const PopplerCacheKey &key) const
-    {
-      const ObjectStreamKey *k = static_cast<const ObjectStreamKey*>(&key);
-      return objStrNum == k->objStrNum;
-    }
+// The object streams of a document, by object number, with the least
+// recently used ones evicted when there are too many or they use too
+// much memory.  Documents written with object streams can have
+// hundreds of them, so they are found through a map rather than a
+// linear search.
+class ObjectStreamCache {
+public:
 
-    const int objStrNum;
-};
+  ObjectStreamCache(int maxItemsA, int maxCostA);
+  ~ObjectStreamCache();
 
-class ObjectStreamItem : public PopplerCacheItem
-{
-  public:
-    ObjectStreamItem(ObjectStream *objStr) : objStream(objStr)
-    {
-    }
+  // Return object stream <objStrNum>, or NULL if it isn't cached.
+  // The stream stays owned by the cache.
+  ObjectStream *lookup(int objStrNum);
 
-    ~ObjectStreamItem()
-    {
-      delete objStream;
-    }
+  // Add an object stream; the cache takes ownership of it.  The most
+  // recently added one is always kept.
+  void put(ObjectStream *objStr);
+
+private:
 
-    ObjectStream *objStream;
+  struct Entry {
+    ObjectStream *objStr;
+    Entry *prev, *next;		// in the LRU list, most recent first
+  };
+
+  void unlink(Entry *e);
+  void pushFront(Entry *e);
+
+  std::map<int, Entry *> entries;
+  Entry *head, *tail;
+  int maxItems, maxCost;
+  int totalCost;
 };
 
-ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
-  Stream *str;
-  Parser *parser;
-  int *offsets;
-  Object objStr, obj1, obj2;
-  int first, i;
+ObjectStreamCache::ObjectStreamCache(int maxItemsA, int maxCostA) {
+  maxItems = maxItemsA;
+  maxCost = maxCostA;
+  totalCost = 0;
+  head = tail = NULL;
+}
+
+ObjectStreamCache::~ObjectStreamCache() {
+  Entry *e, *next;
+
+  for (e = head; e; e = next) {
+    next = e->next;
+    delete e->objStr;
+    delete e;
+  }
+}
+
+void ObjectStreamCache::unlink(Entry *e) {
+  if (e->prev) {
+    e->prev->next = e->next;
+  } else {
+    head = e->next;
+  }
+  if (e->next) {
+    e->next->prev = e->prev;
+  } else {
+    tail = e->prev;
+  }
+}
+
+void ObjectStreamCache::pushFront(Entry *e) {
+  e->prev = NULL;
+  e->next = head;
+  if (head) {
+    head->prev = e;
+  } else {
+    tail = e;
+  }
+  head = e;
+}
+
+ObjectStream *ObjectStreamCache::lookup(int objStrNum) {
+  std::map<int, Entry *>::iterator it;
+  Entry *e;
+
+  if ((it = entries.find(objStrNum)) == entries.end()) {
+    return NULL;
+  }
+  e = it->second;
+  if (e != head) {
+    unlink(e);
+    pushFront(e);
+  }
+  return e->objStr;
+}
+
+void ObjectStreamCache::put(ObjectStream *objStr) {
+  Entry *e;
+
+  e = new Entry;
+  e->objStr = objStr;
+  pushFront(e);
+  entries[objStr->getObjStrNum()] = e;
+  totalCost += objStr->getCost();
+  while (tail != head &&
+	 ((int)entries.size() > maxItems || totalCost > maxCost)) {
+    e = tail;
+    unlink(e);
+    entries.erase(e->objStr->getObjStrNum());
+    totalCost -= e->objStr->getCost();
+    delete e->objStr;
+    delete e;
+  }
+}
+
+// Read a non-negative integer from the object stream header,
+// skipping white space and comments.  Returns -1 if the next token is
+// not an integer.
+static int objStrReadInt(Guchar *buf, int len, int *pos) {
+  int i, x;
+
+  i = *pos;
+  while (i < len) {
+    if (buf[i] == '%') {
+      while (i < len && buf[i] != '\r' && buf[i] != '\n') {
+	++i;
+      }
+    } else if (buf[i] == ' ' || buf[i] == '\t' || buf[i] == '\r' ||
+	       buf[i] == '\n' || buf[i] == '\f' || buf[i] == '\0') {
+      ++i;
+    } else {
+      break;
+    }
+  }
+  if (i >= len || buf[i] < '0' || buf[i] > '9') {
+    return -1;
+  }
+  x = 0;
+  while (i < len && buf[i] >= '0' && buf[i] <= '9') {
+    if (x > (INT_MAX - 9) / 10) {
+      return -1;
+    }
+    x = x * 10 + (buf[i] - '0');
+    ++i;
+  }
+  *pos = i;
+  return x;
+}
+
+ObjectStream::ObjectStream(XRef *xrefA, int objStrNumA) {
+  Object objStr, obj1;
+  int first, pos, offset, prevOffset, i;
 
+  xref = xrefA;
   objStrNum = objStrNumA;
   nObjects = 0;
   objs = NULL;
   objNums = NULL;
+  offsets = NULL;
+  buf = NULL;
+  bufLen = 0;
+  cost = 0;
   ok = gFalse;
 
   if (!xref->fetch(objStrNum, 0, &objStr)->isStream()) {
@@ -169,62 +312,36 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
     error(-1, "Too many objects in an object stream");
     goto err1;
   }
+
+  // decode the whole stream in one go
+  buf = objStr.getStream()->toUnsignedChars(&bufLen);
+  objStr.streamClose();
+  if (first > bufLen) {
+    goto err1;
+  }
+
   objs = new Object[nObjects];
   objNums = (int *)gmallocn(nObjects, sizeof(int));
-  offsets = (int *)gmallocn(nObjects, sizeof(int));
+  offsets = (int *)gmallocn(nObjects + 1, sizeof(int));
 
   // parse the header: object numbers and offsets
-  objStr.streamReset();
-  obj1.initNull();
-  str = new EmbedStream(objStr.getStream(), &obj1, gTrue, first);
-  parser = new Parser(xref, new Lexer(xref, str), gFalse);
+  pos = 0;
+  prevOffset = 0;
   for (i = 0; i < nObjects; ++i) {
-    parser->getObj(&obj1);
-    parser->getObj(&obj2);
-    if (!obj1.isInt() || !obj2.isInt()) {
-      obj1.free();
-      obj2.free();
-      delete parser;
-      gfree(offsets);
-      goto err1;
-    }
-    objNums[i] = obj1.getInt();
-    offsets[i] = obj2.getInt();
-    obj1.free();
-    obj2.free();
-    if (objNums[i] < 0 || offsets[i] < 0 ||
-	(i > 0 && offsets[i] < offsets[i-1])) {
-      delete parser;
-      gfree(offsets);
+    objNums[i] = objStrReadInt(buf, first, &pos);
+    offset = objStrReadInt(buf, first, &pos);
+    if (objNums[i] < 0 || offset < 0 || offset < prevOffset) {
       goto err1;
     }
-  }
-  while (str->getChar() != EOF) ;
-  delete parser;
-
-  // skip to the first object - this shouldn't be necessary because
-  // the First key is supposed to be equal to offsets[0], but just in
-  // case...
-  for (i = first; i < offsets[0]; ++i) {
-    objStr.getStream()->getChar();
-  }
-
-  // parse the objects
-  for (i = 0; i < nObjects; ++i) {
-    obj1.initNull();
-    if (i == nObjects - 1) {
-      str = new EmbedStream(objStr.getStream(), &obj1, gFalse, 0);
-    } else {
-      str = new EmbedStream(objStr.getStream(), &obj1, gTrue,
-			    offsets[i+1] - offsets[i]);
+    prevOffset = offset;
+    if (offset > bufLen - first) {
+      offset = bufLen - first;
     }
-    parser = new Parser(xref, new Lexer(xref, str), gFalse);
-    parser->getObj(&objs[i]);
-    while (str->getChar() != EOF) ;
-    delete parser;
+    offsets[i] = first + offset;
   }
+  offsets[nObjects] = bufLen;
 
-  gfree(offsets);
+  cost = bufLen + nObjects * (int)(sizeof(Object) + 2 * sizeof(int));
   ok = gTrue;
 
  err1:
@@ -241,12 +358,26 @@ ObjectStream::~ObjectStream() {
     delete[] objs;
   }
   gfree(objNums);
+  gfree(offsets);
+  gfree(buf);
 }
 
 Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
+  Parser *parser;
+  Stream *str;
+  Object obj1;
+
   if (objIdx < 0 || objIdx >= nObjects || objNum != objNums[objIdx]) {
     return obj->initNull();
   }
+  if (objs[objIdx].isNone()) {
+    obj1.initNull();
+    str = new MemStream((char *)buf, offsets[objIdx],
+			offsets[objIdx + 1] - offsets[objIdx], &obj1);
+    parser = new Parser(xref, new Lexer(xref, str), gFalse);
+    parser->getObj(&objs[objIdx]);
+    delete parser;
+  }
   return objs[objIdx].copy(obj);
 }
 
@@ -262,7 +393,7 @@ void XRef::init() {
   size = 0;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStrs = new PopplerCache(5);
+  objStrs = new ObjectStreamCache(objStrCacheSize, objStrCacheMaxCost);
   mainXRefEntriesOffset = 0;
   xRefStream = gFalse;
 }
@@ -688,8 +819,10 @@ GBool XRef::readXRefStream(Stream *xrefStr, Guint *pos) {
 }
 
 GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
+  Guchar buf[xrefStreamBufSize];
+  Guchar *p;
   Guint offset;
-  int type, gen, c, i, j;
+  int entrySize, nRows, nRead, m, type, gen, i, j, k;
 
   if (first + n < 0) {
     return gFalse;
@@ -700,69 +833,257 @@ GBool XRef::readXRefStreamSection(Stream *xrefStr, int *w, int first, int n) {
       return gFalse;
     }
   }
-  for (i = first; i < first + n; ++i) {
-    if (w[0] == 0) {
-      type = 1;
+  entrySize = w[0] + w[1] + w[2];
+  i = first;
+  while (i < first + n) {
+
+    // read as many whole entries as fit in the buffer
+    nRows = first + n - i;
+    if (entrySize > 0) {
+      if (nRows > xrefStreamBufSize / entrySize) {
+	nRows = xrefStreamBufSize / entrySize;
+      }
+      nRead = 0;
+      while (nRead < nRows * entrySize &&
+	     (m = xrefStr->doGetChars(nRows * entrySize - nRead,
+				      buf + nRead)) > 0) {
+	nRead += m;
+      }
     } else {
-      for (type = 0, j = 0; j < w[0]; ++j) {
-	if ((c = xrefStr->getChar()) == EOF) {
+      nRead = 0;
+    }
+
+    p = buf;
+    for (k = 0; k < nRows; ++k, ++i) {
+      if ((k + 1) * entrySize > nRead) {
+	return gFalse;
+      }
+      if (w[0] == 0) {
+	type = 1;
+      } else {
+	for (type = 0, j = 0; j < w[0]; ++j) {
+	  type = (type << 8) + *p++;
+	}
+      }
+      for (offset = 0, j = 0; j < w[1]; ++j) {
+	offset = (offset << 8) + *p++;
+      }
+      for (gen = 0, j = 0; j < w[2]; ++j) {
+	gen = (gen << 8) + *p++;
+      }
+      if (entries[i].offset == 0xffffffff) {
+	switch (type) {
+	case 0:
+	  entries[i].offset = offset;
+	  entries[i].gen = gen;
+	  entries[i].type = xrefEntryFree;
+	  break;
+	case 1:
+	  entries[i].offset = offset;
+	  entries[i].gen = gen;
+	  entries[i].type = xrefEntryUncompressed;
+	  break;
+	case 2:
+	  entries[i].offset = offset;
+	  entries[i].gen = gen;
+	  entries[i].type = xrefEntryCompressed;
+	  break;
+	default:
 	  return gFalse;
 	}
-	type = (type << 8) + c;
       }
     }
-    for (offset = 0, j = 0; j < w[1]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
+  }
+
+  return gTrue;
+}
+
+// Attempt to construct an xref table for a damaged file.
+//------------------------------------------------------------------------
+// xref reconstruction
+//------------------------------------------------------------------------
+
+// The file is read in sections of this size per thread.
+#define xrefScanChunkSize (4 * 1024 * 1024)
+
+// Sections smaller than this are not worth a thread of their own.
+#define xrefScanMinChunkSize (1024 * 1024)
+
+#define xrefScanMaxThreads 8
+
+// Lines are split into pieces of at most this size minus one, as
+// Stream::getLine() does with a buffer of this size.
+#define xrefScanLineSize 256
+
+enum XRefScanHitKind {
+  xrefScanObj,			// "<num> <gen> obj"
+  xrefScanTrailer,		// "trailer"
+  xrefScanEndstream		// "endstream"
+};
+
+struct XRefScanHit {
+  XRefScanHitKind kind;
+  int num, gen;			// only for xrefScanObj
+  Guint pos;			// file position of the marker
+};
+
+// A section of the read buffer, scanned by one thread.
+struct XRefScanPart {
+  char *data;			// the read buffer
+  int begin, end;		// section of <data> to scan
+  Guint basePos;		// file position of data[0]
+  GBool atEOF;			// true if <end> is the end of the file
+  int consumed;			// [out] end of the last complete line
+  std::vector<XRefScanHit> hits; // [out] markers, in file order
+};
+
+// Look for object headers, trailers and stream ends in a line that
+// starts at file position <pos>.
+static void xrefScanLine(char *p, Guint pos, std::vector<XRefScanHit> *hits) {
+  XRefScanHit hit;
+  char *token;
+  bool oneCycle;
+  int offset, num, gen;
+
+  // skip whitespace
+  while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+
+  oneCycle = true;
+  offset = 0;
+
+  while( ( token = strstr( p, "endobj" ) ) || oneCycle ) {
+    oneCycle = false;
+
+    if( token ) {
+      oneCycle = true;
+      token[0] = '\0';
+      offset = token - p;
+    }
+
+    // got trailer dictionary
+    if (!strncmp(p, "trailer", 7)) {
+      hit.kind = xrefScanTrailer;
+      hit.num = hit.gen = 0;
+      hit.pos = pos;
+      hits->push_back(hit);
+
+    // look for object
+    } else if (isdigit(*p)) {
+      num = atoi(p);
+      if (num > 0) {
+	do {
+	  ++p;
+	} while (*p && isdigit(*p));
+	if (isspace(*p)) {
+	  do {
+	    ++p;
+	  } while (*p && isspace(*p));
+	  if (isdigit(*p)) {
+	    gen = atoi(p);
+	    do {
+	      ++p;
+	    } while (*p && isdigit(*p));
+	    if (isspace(*p)) {
+	      do {
+		++p;
+	      } while (*p && isspace(*p));
+	      if (!strncmp(p, "obj", 3)) {
+		hit.kind = xrefScanObj;
+		hit.num = num;
+		hit.gen = gen;
+		hit.pos = pos;
+		hits->push_back(hit);
+	      }
+	    }
+	  }
+	}
       }
-      offset = (offset << 8) + c;
+
+    } else if (!strncmp(p, "endstream", 9)) {
+      hit.kind = xrefScanEndstream;
+      hit.num = hit.gen = 0;
+      hit.pos = pos;
+      hits->push_back(hit);
     }
-    for (gen = 0, j = 0; j < w[2]; ++j) {
-      if ((c = xrefStr->getChar()) == EOF) {
-	return gFalse;
+    if( token ) {
+      p = token + 6;// strlen( "endobj" ) = 6
+      pos += offset + 6;// strlen( "endobj" ) = 6
+      while (*p && Lexer::isSpace(*p & 0xff)) {
+	++p;
+	++pos;
       }
-      gen = (gen << 8) + c;
     }
-    if (entries[i].offset == 0xffffffff) {
-      switch (type) {
-      case 0:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryFree;
-	break;
-      case 1:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryUncompressed;
-	break;
-      case 2:
-	entries[i].offset = offset;
-	entries[i].gen = gen;
-	entries[i].type = xrefEntryCompressed;
+  }
+}
+
+// Split a section of the buffer into lines, exactly like repeated
+// calls to Stream::getLine() would, and scan them.  Stops at the first
+// line that isn't complete unless the section ends at EOF.
+static void xrefScanPart(XRefScanPart *part) {
+  char line[xrefScanLineSize];
+  char *s, *end, *nl, *cr, *lineEnd, *next;
+  int n;
+
+  part->hits.clear();
+  s = part->data + part->begin;
+  end = part->data + part->end;
+  while (s < end) {
+    n = (int)(end - s);
+    if (n > xrefScanLineSize - 1) {
+      n = xrefScanLineSize - 1;
+    }
+    nl = (char *)memchr(s, '\n', n);
+    cr = (char *)memchr(s, '\r', nl ? (int)(nl - s) : n);
+    if (cr) {
+      // "\r\n" counts as one line end
+      lineEnd = cr;
+      if (cr + 1 < end) {
+	next = cr[1] == '\n' ? cr + 2 : cr + 1;
+      } else if (part->atEOF) {
+	next = cr + 1;
+      } else {
 	break;
-      default:
-	return gFalse;
       }
+    } else if (nl) {
+      lineEnd = nl;
+      next = nl + 1;
+    } else if (n == xrefScanLineSize - 1) {
+      lineEnd = next = s + n;
+    } else if (part->atEOF) {
+      lineEnd = next = end;
+    } else {
+      break;
     }
+    memcpy(line, s, lineEnd - s);
+    line[lineEnd - s] = '\0';
+    xrefScanLine(line, part->basePos + (Guint)(s - part->data), &part->hits);
+    s = next;
   }
+  part->consumed = (int)(s - part->data);
+}
 
-  return gTrue;
+#if MULTITHREADED
+static GOO_THREAD_FUNC(xrefScanThread) {
+  xrefScanPart((XRefScanPart *)arg);
+  GOO_THREAD_RETURN;
 }
+#endif
 
-// Attempt to construct an xref table for a damaged file.
 GBool XRef::constructXRef(GBool *wasReconstructed) {
   Parser *parser;
   Object newTrailerDict, obj;
-  char buf[256];
-  Guint pos;
-  int num, gen;
+  XRefScanPart parts[xrefScanMaxThreads];
+#if MULTITHREADED
+  GooThread threads[xrefScanMaxThreads];
+  GBool started[xrefScanMaxThreads];
+#endif
+  XRefScanHit *hit;
+  char *buf, *nl;
+  Guint bufPos, fileEnd, fileLen;
+  int bufSize, len, carry, n, nThreads, nParts, b, i, j;
   int newSize;
   int streamEndsSize;
-  char *p;
-  GBool gotRoot;
-  char* token = NULL;
-  bool oneCycle = true;
-  int offset = 0;
+  GBool gotRoot, atEOF;
 
   gfree(entries);
   capacity = 0;
@@ -778,119 +1099,163 @@ GBool XRef::constructXRef(GBool *wasReconstructed) {
     *wasReconstructed = true;
   }
 
+  // The file is read in large blocks; each block is split at line
+  // boundaries into sections that are scanned in parallel, and the
+  // markers found are then applied in file order, so the result is
+  // the same as that of a single sequential scan.
+  str->setPos(0, -1);
+  fileEnd = str->getPos();
   str->reset();
-  while (1) {
-    pos = str->getPos();
-    if (!str->getLine(buf, 256)) {
-      break;
+  bufPos = str->getPos();
+  fileLen = fileEnd > bufPos ? fileEnd - bufPos : 0;
+#if MULTITHREADED
+  nThreads = gGetNumCPUs();
+  if (nThreads > xrefScanMaxThreads) {
+    nThreads = xrefScanMaxThreads;
+  }
+  if (fileLen < xrefScanMinChunkSize) {
+    nThreads = 1;
+  }
+#else
+  nThreads = 1;
+#endif
+  // the buffer doesn't need to be larger than the file; the extra
+  // byte lets the first read see the end of the file
+  bufSize = nThreads * xrefScanChunkSize;
+  if (fileLen > 0 && fileLen < (Guint)bufSize) {
+    bufSize = (int)fileLen + 1;
+  }
+  if (bufSize < 2 * xrefScanLineSize) {
+    bufSize = 2 * xrefScanLineSize;
+  }
+  buf = (char *)gmalloc(bufSize);
+  carry = 0;
+  atEOF = gFalse;
+  while (!atEOF) {
+    n = str->doGetChars(bufSize - carry, (Guchar *)buf + carry);
+    len = carry + n;
+    atEOF = n < bufSize - carry;
+
+    // split the block after newlines, which always end a line
+    nParts = len / xrefScanMinChunkSize;
+    if (nParts > nThreads) {
+      nParts = nThreads;
+    } else if (nParts < 1) {
+      nParts = 1;
+    }
+    b = 0;
+    for (i = 0; i < nParts; ++i) {
+      parts[i].data = buf;
+      parts[i].basePos = bufPos;
+      parts[i].begin = b;
+      if (i == nParts - 1) {
+	b = len;
+      } else {
+	j = (int)(((double)len * (i + 1)) / nParts);
+	if (j < b) {
+	  j = b;
+	}
+	nl = (char *)memchr(buf + j, '\n', len - j);
+	b = nl ? (int)(nl - buf) + 1 : len;
+      }
+      parts[i].end = b;
+      parts[i].atEOF = b < len || atEOF;
+      if (b == len) {
+	nParts = i + 1;
+      }
     }
-    p = buf;
-
-    // skip whitespace
-    while (*p && Lexer::isSpace(*p & 0xff)) ++p;
-
-    oneCycle = true;
-    offset = 0;
-
-    while( ( token = strstr( p, "endobj" ) ) || oneCycle ) {
-      oneCycle = false;
 
-      if( token ) {
-        oneCycle = true;
-        token[0] = '\0'; 
-        offset = token - p;
+#if MULTITHREADED
+    for (i = 1; i < nParts; ++i) {
+      started[i] = gCreateThread(&threads[i], xrefScanThread, &parts[i]);
+      if (!started[i]) {
+	xrefScanPart(&parts[i]);
       }
+    }
+    xrefScanPart(&parts[0]);
+    for (i = 1; i < nParts; ++i) {
+      if (started[i]) {
+	gJoinThread(threads[i]);
+      }
+    }
+#else
+    xrefScanPart(&parts[0]);
+#endif
 
-      // got trailer dictionary
-      if (!strncmp(p, "trailer", 7)) {
-        obj.initNull();
-        parser = new Parser(NULL,
-		 new Lexer(NULL,
-		   str->makeSubStream(pos + 7, gFalse, 0, &obj)),
-		 gFalse);
-        parser->getObj(&newTrailerDict);
-        if (newTrailerDict.isDict()) {
-	  newTrailerDict.dictLookupNF("Root", &obj);
-	  if (obj.isRef()) {
-	    rootNum = obj.getRefNum();
-	    rootGen = obj.getRefGen();
-	    if (!trailerDict.isNone()) {
-	      trailerDict.free();
+    for (i = 0; i < nParts; ++i) {
+      for (j = 0; j < (int)parts[i].hits.size(); ++j) {
+	hit = &parts[i].hits[j];
+	switch (hit->kind) {
+
+	case xrefScanTrailer:
+	  obj.initNull();
+	  parser = new Parser(NULL,
+		     new Lexer(NULL,
+		       str->makeSubStream(hit->pos + 7, gFalse, 0, &obj)),
+		     gFalse);
+	  parser->getObj(&newTrailerDict);
+	  if (newTrailerDict.isDict()) {
+	    newTrailerDict.dictLookupNF("Root", &obj);
+	    if (obj.isRef()) {
+	      rootNum = obj.getRefNum();
+	      rootGen = obj.getRefGen();
+	      if (!trailerDict.isNone()) {
+		trailerDict.free();
+	      }
+	      newTrailerDict.copy(&trailerDict);
+	      gotRoot = gTrue;
 	    }
-	    newTrailerDict.copy(&trailerDict);
-	    gotRoot = gTrue;
+	    obj.free();
 	  }
-	  obj.free();
-        }
-        newTrailerDict.free();
-        delete parser;
-
-      // look for object
-      } else if (isdigit(*p)) {
-        num = atoi(p);
-        if (num > 0) {
-	  do {
-	    ++p;
-	  } while (*p && isdigit(*p));
-	  if (isspace(*p)) {
-	    do {
-	      ++p;
-	    } while (*p && isspace(*p));
-	    if (isdigit(*p)) {
-	      gen = atoi(p);
-	      do {
-	        ++p;
-	      } while (*p && isdigit(*p));
-	      if (isspace(*p)) {
-	        do {
-		  ++p;
-	        } while (*p && isspace(*p));
-	        if (!strncmp(p, "obj", 3)) {
-		  if (num >= size) {
-		    newSize = (num + 1 + 255) & ~255;
-		    if (newSize < 0) {
-		      error(-1, "Bad object number");
-		      return gFalse;
-		    }
-		    if (resize(newSize) != newSize) {
-		      error(-1, "Invalid 'obj' parameters");
-		      return gFalse;
-		    }
-		  }
-		  if (entries[num].type == xrefEntryFree ||
-		      gen >= entries[num].gen) {
-		    entries[num].offset = pos - start;
-		    entries[num].gen = gen;
-		    entries[num].type = xrefEntryUncompressed;
-		  }
-	        }
-	      }
+	  newTrailerDict.free();
+	  delete parser;
+	  break;
+
+	case xrefScanObj:
+	  if (hit->num >= size) {
+	    newSize = (hit->num + 1 + 255) & ~255;
+	    if (newSize < 0) {
+	      error(-1, "Bad object number");
+	      gfree(buf);
+	      return gFalse;
+	    }
+	    if (resize(newSize) != newSize) {
+	      error(-1, "Invalid 'obj' parameters");
+	      gfree(buf);
+	      return gFalse;
 	    }
 	  }
-        }
-
-      } else if (!strncmp(p, "endstream", 9)) {
-        if (streamEndsLen == streamEndsSize) {
-	  streamEndsSize += 64;
-          if (streamEndsSize >= INT_MAX / (int)sizeof(int)) {
-            error(-1, "Invalid 'endstream' parameter.");
-            return gFalse;
-          }
-	  streamEnds = (Guint *)greallocn(streamEnds,
-					streamEndsSize, sizeof(int));
-        }
-        streamEnds[streamEndsLen++] = pos;
-      }
-      if( token ) {
-        p = token + 6;// strlen( "endobj" ) = 6
-        pos += offset + 6;// strlen( "endobj" ) = 6
-        while (*p && Lexer::isSpace(*p & 0xff)) {
-          ++p;
-          ++pos;
-        }
+	  if (entries[hit->num].type == xrefEntryFree ||
+	      hit->gen >= entries[hit->num].gen) {
+	    entries[hit->num].offset = hit->pos - start;
+	    entries[hit->num].gen = hit->gen;
+	    entries[hit->num].type = xrefEntryUncompressed;
+	  }
+	  break;
+
+	case xrefScanEndstream:
+	  if (streamEndsLen == streamEndsSize) {
+	    streamEndsSize += 64;
+	    if (streamEndsSize >= INT_MAX / (int)sizeof(int)) {
+	      error(-1, "Invalid 'endstream' parameter.");
+	      gfree(buf);
+	      return gFalse;
+	    }
+	    streamEnds = (Guint *)greallocn(streamEnds,
+					  streamEndsSize, sizeof(int));
+	  }
+	  streamEnds[streamEndsLen++] = hit->pos;
+	  break;
+	}
       }
     }
+
+    // keep the incomplete line at the end for the next block
+    carry = len - parts[nParts - 1].consumed;
+    memmove(buf, buf + parts[nParts - 1].consumed, carry);
+    bufPos += parts[nParts - 1].consumed;
   }
+  gfree(buf);
 
   if (gotRoot)
     return gTrue;
@@ -1052,14 +1417,7 @@ Object *XRef::fetch(int num, int gen, Object *obj, std::set<int> *fetchOriginato
       goto err;
     }
 
-    ObjectStream *objStr = NULL;
-    ObjectStreamKey key(e->offset);
-    PopplerCacheItem *item = objStrs->lookup(key);
-    if (item) {
-      ObjectStreamItem *it = static_cast<ObjectStreamItem *>(item);
-      objStr = it->objStream;
-    }
-
+    ObjectStream *objStr = objStrs->lookup(e->offset);
     if (!objStr) {
       objStr = new ObjectStream(this, e->offset);
       if (!objStr->isOk()) {
@@ -1067,9 +1425,7 @@ Object *XRef::fetch(int num, int gen, Object *obj, std::set<int> *fetchOriginato
 	objStr = NULL;
 	goto err;
       } else {
-	ObjectStreamKey *newkey = new ObjectStreamKey(e->offset);
-	ObjectStreamItem *newitem = new ObjectStreamItem(objStr);
-	objStrs->put(newkey, newitem);
+	objStrs->put(objStr);
       }
     }
     objStr->getObject(e->gen, num, obj);
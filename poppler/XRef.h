@@ -40,7 +40,7 @@
 class Dict;
 class Stream;
 class Parser;
-class PopplerCache;
+class ObjectStreamCache;
 
 //------------------------------------------------------------------------
 // XRef
@@ -147,7 +147,7 @@ private:
   Guint *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
-  PopplerCache *objStrs;	// cached object streams
+  ObjectStreamCache *objStrs;	// cached object streams
   GBool encrypted;		// true if file is encrypted
   int encRevision;		
   int encVersion;		// encryption algorithm
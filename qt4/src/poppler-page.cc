@@ -558,7 +558,6 @@ QList<Annotation*> Page::annotations() const
     const uint numAnnotations = annots->getNumAnnots();
     if ( numAnnotations == 0 )
     {
-        delete annots;
         return QList<Annotation*>();
     }
 
@@ -1301,7 +1300,6 @@ QList<Annotation*> Page::annotations() const
         }
     }
 
-    delete annots;
     /** 5 - finally RETURN ANNOTATIONS */
     return annotationsMap.values();
 }
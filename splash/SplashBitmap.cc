@@ -37,6 +37,7 @@
 #include "goo/gmem.h"
 #include "SplashErrorCodes.h"
 #include "SplashBitmap.h"
+#include "SplashBitmapPool.h"
 #include "poppler/Error.h"
 #include "goo/JpegWriter.h"
 #include "goo/PNGWriter.h"
@@ -49,7 +50,7 @@
 
 SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPadA,
 			   SplashColorMode modeA, GBool alphaA,
-			   GBool topDown) {
+			   GBool topDown, SplashBitmapPool *poolA) {
   width = widthA;
   height = heightA;
   mode = modeA;
@@ -98,20 +99,60 @@ SplashBitmap::SplashBitmap(int widthA, int heightA, int rowPadA,
     rowSize += rowPad - 1;
     rowSize -= rowSize % rowPad;
   }
-  data = (SplashColorPtr)gmallocn(rowSize, height);
+  pool = poolA;
+  ownData = gTrue;
+  if (pool) {
+    data = (SplashColorPtr)pool->allocn(rowSize, height);
+  } else {
+    data = (SplashColorPtr)gmallocn(rowSize, height);
+  }
   if (!topDown) {
     data += (height - 1) * rowSize;
     rowSize = -rowSize;
   }
   if (alphaA) {
-    alpha = (Guchar *)gmallocn(width, height);
+    if (pool) {
+      alpha = (Guchar *)pool->allocn(width, height);
+    } else {
+      alpha = (Guchar *)gmallocn(width, height);
+    }
   } else {
     alpha = NULL;
   }
 }
 
+SplashBitmap::SplashBitmap(int widthA, int heightA, int rowSizeA,
+			   SplashColorMode modeA, GBool alphaA,
+			   SplashColorPtr dataA) {
+  width = widthA;
+  height = heightA;
+  mode = modeA;
+  rowPad = 1;
+  rowSize = rowSizeA;
+  pool = NULL;
+  ownData = gFalse;
+  data = dataA;
+  if (alphaA) {
+    alpha = (Guchar *)gmallocn(width, height);
+  } else {
+    alpha = NULL;
+  }
+}
 
 SplashBitmap::~SplashBitmap() {
+  if (!ownData) {
+    gfree(alpha);
+    return;
+  }
+  if (pool) {
+    if (rowSize < 0) {
+      pool->freen(data + (height - 1) * rowSize, -rowSize, height);
+    } else {
+      pool->freen(data, rowSize, height);
+    }
+    pool->freen(alpha, width, height);
+    return;
+  }
   if (rowSize < 0) {
     gfree(data + (height - 1) * rowSize);
   } else {
@@ -423,7 +464,7 @@ SplashError SplashBitmap::writeImgFile(ImgWriter *writer, FILE *f, int hDPI, int
     break;
   }
   
-  if (writer->close()) {
+  if (!writer->close()) {
     return splashErrGeneric;
   }
 
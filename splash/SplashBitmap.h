@@ -36,6 +36,7 @@
 #include <stdio.h>
 
 class ImgWriter;
+class SplashBitmapPool;
 
 //------------------------------------------------------------------------
 // SplashBitmap
@@ -47,10 +48,20 @@ public:
   // Create a new bitmap.  It will have <widthA> x <heightA> pixels in
   // color mode <modeA>.  Rows will be padded out to a multiple of
   // <rowPad> bytes.  If <topDown> is false, the bitmap will be stored
-  // upside-down, i.e., with the last row first in memory.
+  // upside-down, i.e., with the last row first in memory.  If <poolA>
+  // is non-NULL, the pixel buffers are taken from (and returned to)
+  // that pool, which must outlive the bitmap.
   SplashBitmap(int widthA, int heightA, int rowPad,
 	       SplashColorMode modeA, GBool alphaA,
-	       GBool topDown = gTrue);
+	       GBool topDown = gTrue, SplashBitmapPool *poolA = NULL);
+
+  // Create a top-down bitmap that uses <dataA>, which holds <heightA>
+  // rows of <rowSizeA> bytes, for its color data.  The buffer belongs
+  // to the caller and must outlive the bitmap; only the alpha
+  // channel, if any, is allocated.
+  SplashBitmap(int widthA, int heightA, int rowSizeA,
+	       SplashColorMode modeA, GBool alphaA,
+	       SplashColorPtr dataA);
 
   ~SplashBitmap();
 
@@ -61,6 +72,7 @@ public:
   int getRowPad() { return rowPad; }
   SplashColorMode getMode() { return mode; }
   SplashColorPtr getDataPtr() { return data; }
+  GBool ownsData() { return ownData; }
   Guchar *getAlphaPtr() { return alpha; }
 
   SplashError writePNMFile(char *fileName);
@@ -83,6 +95,9 @@ private:
   SplashColorPtr data;		// pointer to row zero of the color data
   Guchar *alpha;		// pointer to row zero of the alpha data
 				//   (always top-down)
+  SplashBitmapPool *pool;	// pool the buffers came from, or NULL
+  GBool ownData;		// set unless the color data belongs to
+				//   the caller
 
   friend class Splash;
 };
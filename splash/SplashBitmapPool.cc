@@ -0,0 +1,127 @@
+//========================================================================
+//
+// SplashBitmapPool.cc
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include <limits.h>
+#include "goo/gmem.h"
+#include "SplashBitmapPool.h"
+
+// smallest buffer handled by the pool
+#define splashBitmapPoolMinSize 4096
+
+// number of size classes: 4 KB * 2^(i/2), times 1.5 for odd i, which
+// covers everything up to INT_MAX bytes
+#define splashBitmapPoolNumClasses 40
+
+static inline size_t classSize(int cls) {
+  size_t size;
+
+  size = (size_t)splashBitmapPoolMinSize << (cls >> 1);
+  if (cls & 1) {
+    size = (size / 2) * 3;
+  }
+  return size;
+}
+
+static inline int sizeClass(size_t size) {
+  int cls;
+
+  for (cls = 0; classSize(cls) < size; ++cls) ;
+  return cls;
+}
+
+//------------------------------------------------------------------------
+// SplashBitmapPool
+//------------------------------------------------------------------------
+
+SplashBitmapPool::SplashBitmapPool(size_t maxCachedA) {
+  freeLists = (FreeBuf **)gmallocn(splashBitmapPoolNumClasses,
+				   sizeof(FreeBuf *));
+  memset(freeLists, 0, splashBitmapPoolNumClasses * sizeof(FreeBuf *));
+  cachedBytes = 0;
+  maxCached = maxCachedA;
+}
+
+SplashBitmapPool::~SplashBitmapPool() {
+  maxCached = 0;
+  trim();
+  gfree(freeLists);
+}
+
+void SplashBitmapPool::setMaxCached(size_t maxCachedA) {
+  maxCached = maxCachedA;
+  trim();
+}
+
+// Free cached buffers, largest first, until the cache is under the
+// limit.
+void SplashBitmapPool::trim() {
+  FreeBuf *buf;
+  int cls;
+
+  for (cls = splashBitmapPoolNumClasses - 1;
+       cls >= 0 && cachedBytes > maxCached;
+       --cls) {
+    while (freeLists[cls] && cachedBytes > maxCached) {
+      buf = freeLists[cls];
+      freeLists[cls] = buf->next;
+      cachedBytes -= classSize(cls);
+      gfree(buf);
+    }
+  }
+}
+
+void *SplashBitmapPool::allocn(int nObjs, int objSize) {
+  FreeBuf *buf;
+  size_t size;
+  int cls;
+
+  // let gmallocn deal with bogus sizes (and small buffers)
+  if (nObjs <= 0 || objSize <= 0 || nObjs >= INT_MAX / objSize ||
+      nObjs * objSize < splashBitmapPoolMinSize) {
+    return gmallocn(nObjs, objSize);
+  }
+  size = (size_t)nObjs * objSize;
+  cls = sizeClass(size);
+  if ((buf = freeLists[cls])) {
+    freeLists[cls] = buf->next;
+    cachedBytes -= classSize(cls);
+    return buf;
+  }
+  return gmalloc(classSize(cls));
+}
+
+void SplashBitmapPool::freen(void *p, int nObjs, int objSize) {
+  FreeBuf *buf;
+  size_t size;
+  int cls;
+
+  if (!p) {
+    return;
+  }
+  if (nObjs * objSize < splashBitmapPoolMinSize) {
+    gfree(p);
+    return;
+  }
+  cls = sizeClass((size_t)nObjs * objSize);
+  size = classSize(cls);
+  if (cachedBytes + size > maxCached) {
+    gfree(p);
+    return;
+  }
+  buf = (FreeBuf *)p;
+  buf->next = freeLists[cls];
+  freeLists[cls] = buf;
+  cachedBytes += size;
+}
@@ -0,0 +1,70 @@
+//========================================================================
+//
+// SplashBitmapPool.h
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHBITMAPPOOL_H
+#define SPLASHBITMAPPOOL_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <stddef.h>
+#include "goo/gtypes.h"
+
+//------------------------------------------------------------------------
+// SplashBitmapPool
+//
+// A cache of large pixel buffers, for bitmaps that are created and
+// deleted over and over while rendering a page (transparency groups
+// and soft masks).  Requests are rounded up to a size class (powers of
+// two and 1.5 times powers of two, from 4 KB); freed buffers are kept
+// on per-class free lists, up to a limit on the total number of
+// cached bytes, and reused by later requests of the same class.
+// Smaller requests go straight to gmalloc.  The buffers are not
+// cleared.
+//
+// Bitmaps that take their buffers from a pool must be deleted before
+// the pool.  The pool does no locking.
+//------------------------------------------------------------------------
+
+class SplashBitmapPool {
+public:
+
+  // Create an empty pool, which caches up to <maxCachedA> bytes of
+  // free buffers.
+  SplashBitmapPool(size_t maxCachedA);
+
+  // Destructor - frees all cached buffers.
+  ~SplashBitmapPool();
+
+  // Change the limit on cached bytes.  Buffers over the new limit are
+  // freed.
+  void setMaxCached(size_t maxCachedA);
+
+  // Allocate <nObjs> * <objSize> bytes, with the same checks as
+  // gmallocn.
+  void *allocn(int nObjs, int objSize);
+
+  // Return a buffer allocated by allocn(<nObjs>, <objSize>) to the
+  // pool.  <p> may be NULL.
+  void freen(void *p, int nObjs, int objSize);
+
+private:
+
+  struct FreeBuf {
+    FreeBuf *next;
+  };
+
+  void trim();
+
+  FreeBuf **freeLists;		// one list per size class
+  size_t cachedBytes;		// total size of the buffers on the lists
+  size_t maxCached;
+};
+
+#endif
@@ -35,10 +35,212 @@
 #include "SplashClip.h"
 
 //------------------------------------------------------------------------
-// SplashClip.flags
+// SplashClipMask
 //------------------------------------------------------------------------
 
-#define splashClipEO       0x01	// use even-odd rule
+#define splashClipBandRows (1 << splashClipBandShift)
+
+SplashClipMask::SplashClipMask(SplashClipMask *parentA, SplashXPath *xPathA,
+			       GBool eoA, int yMinA, int yMaxA) {
+  int xMinA, xMaxA;
+
+  refCnt = 1;
+  parent = parentA;
+  xPath = xPathA;
+  scanner = new SplashXPathScanner(xPath, eoA);
+  scanner->getBBox(&xMinA, &yMin, &xMaxA, &yMax);
+  if (yMin < yMinA) {
+    yMin = yMinA;
+  }
+  if (yMax > yMaxA) {
+    yMax = yMaxA;
+  }
+  if (parent) {
+    if (yMin < parent->yMin) {
+      yMin = parent->yMin;
+    }
+    if (yMax > parent->yMax) {
+      yMax = parent->yMax;
+    }
+  }
+  if (yMin <= yMax) {
+    bandOffset = yMin >> splashClipBandShift;
+    nBands = (yMax >> splashClipBandShift) - bandOffset + 1;
+    bands = (SplashClipBand **)gmallocn(nBands, sizeof(SplashClipBand *));
+    memset(bands, 0, nBands * sizeof(SplashClipBand *));
+  } else {
+    bands = NULL;
+    bandOffset = nBands = 0;
+  }
+}
+
+SplashClipMask::~SplashClipMask() {
+  int i;
+
+  for (i = 0; i < nBands; ++i) {
+    if (bands[i]) {
+      gfree(bands[i]->spans);
+      gfree(bands[i]);
+    }
+  }
+  gfree(bands);
+  delete scanner;
+  delete xPath;
+}
+
+void SplashClipMask::decRef(SplashClipMask *m) {
+  SplashClipMask *p;
+
+  // release the chain iteratively -- clips can be nested very deeply
+  while (m && --m->refCnt == 0) {
+    p = m->parent;
+    delete m;
+    m = p;
+  }
+}
+
+// Build the band containing row <y> in this mask, after building it
+// in any parents that need it.  This walks up the chain instead of
+// recursing, since clips can be nested very deeply.
+SplashClipBand *SplashClipMask::buildBands(int y) {
+  SplashClipMask *m;
+
+  while (!getBand(y)) {
+    for (m = this;
+	 m->parent && !m->parent->getBand(y);
+	 m = m->parent) ;
+    m->buildBand(y);
+  }
+  return getBand(y);
+}
+
+// Build the band containing row <y>, from the parent's spans (which
+// must already be available) and this path's spans.
+void SplashClipMask::buildBand(int y) {
+  SplashClipBand *band;
+  int *pathSpans, *parentSpans, *spans;
+  int pathLen, pathSize, parentLen, len, size;
+  int y0, yy, x0, x1, i, j, n;
+
+  band = (SplashClipBand *)gmalloc(sizeof(SplashClipBand));
+  y0 = y & ~(splashClipBandRows - 1);
+  pathSpans = parentSpans = NULL;
+  pathLen = pathSize = 0;
+  spans = NULL;
+  len = size = 0;
+  for (yy = 0; yy < splashClipBandRows; ++yy) {
+    band->rowStart[yy] = len >> 1;
+    if (y0 + yy < yMin || y0 + yy > yMax) {
+      continue;
+    }
+
+    // get this path's spans, merging adjacent ones
+    pathLen = 0;
+    while (scanner->getNextSpan(y0 + yy, &x0, &x1)) {
+      if (pathLen > 0 && x0 <= pathSpans[pathLen - 1] + 1) {
+	if (x1 > pathSpans[pathLen - 1]) {
+	  pathSpans[pathLen - 1] = x1;
+	}
+	continue;
+      }
+      if (pathLen + 2 > pathSize) {
+	pathSize = pathSize ? 2 * pathSize : 32;
+	pathSpans = (int *)greallocn(pathSpans, pathSize, sizeof(int));
+      }
+      pathSpans[pathLen++] = x0;
+      pathSpans[pathLen++] = x1;
+    }
+
+    // intersect them with the parent's spans
+    if (parent) {
+      parentLen = 2 * parent->getSpans(y0 + yy, &parentSpans);
+    } else {
+      parentLen = 0;
+    }
+    n = pathLen + parentLen;
+    if (len + n > size) {
+      size = len + n > 2 * size ? len + n : 2 * size;
+      spans = (int *)greallocn(spans, size, sizeof(int));
+    }
+    if (!parent) {
+      memcpy(spans + len, pathSpans, pathLen * sizeof(int));
+      len += pathLen;
+      continue;
+    }
+    i = j = 0;
+    while (i < pathLen && j < parentLen) {
+      x0 = pathSpans[i] > parentSpans[j] ? pathSpans[i] : parentSpans[j];
+      if (pathSpans[i + 1] < parentSpans[j + 1]) {
+	x1 = pathSpans[i + 1];
+	i += 2;
+      } else {
+	x1 = parentSpans[j + 1];
+	j += 2;
+      }
+      if (x0 > x1) {
+	continue;
+      }
+      if (len > 2 * band->rowStart[yy] && x0 <= spans[len - 1] + 1) {
+	spans[len - 1] = x1;
+      } else {
+	spans[len++] = x0;
+	spans[len++] = x1;
+      }
+    }
+  }
+  band->rowStart[splashClipBandRows] = len >> 1;
+  band->spans = (int *)greallocn(spans, len ? len : 1, sizeof(int));
+  gfree(pathSpans);
+  bands[(y >> splashClipBandShift) - bandOffset] = band;
+}
+
+// Set the pixels [x0, x1) in row <yy> of <aaBuf> to zero.
+static inline void clearAASpan(SplashBitmap *aaBuf, int yy, int x0, int x1) {
+  SplashColorPtr p;
+  Guchar m;
+
+  p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + (x0 >> 3);
+  if (x0 & 7) {
+    m = (Guchar)(0xff00 >> (x0 & 7));
+    if ((x0 & ~7) == (x1 & ~7)) {
+      *p &= m | (0xff >> (x1 & 7));
+      return;
+    }
+    *p++ &= m;
+    x0 = (x0 & ~7) + 8;
+  }
+  for (; x0 + 7 < x1; x0 += 8) {
+    *p++ = 0x00;
+  }
+  if (x0 < x1) {
+    *p &= 0xff >> (x1 & 7);
+  }
+}
+
+void SplashClipMask::clipAALine(SplashBitmap *aaBuf, int x0, int x1, int y) {
+  int *spans;
+  int xx, xxMax, yy, n, i;
+
+  xxMax = (x1 + 1) * splashAASize;
+  if (xxMax > aaBuf->getWidth()) {
+    xxMax = aaBuf->getWidth();
+  }
+  for (yy = 0; yy < splashAASize; ++yy) {
+    n = getSpans(splashAASize * y + yy, &spans);
+    xx = x0 * splashAASize;
+    for (i = 0; i < n && xx < xxMax; ++i, spans += 2) {
+      if (xx < spans[0]) {
+	clearAASpan(aaBuf, yy, xx, spans[0] < xxMax ? spans[0] : xxMax);
+      }
+      if (spans[1] >= xx) {
+	xx = spans[1] + 1;
+      }
+    }
+    if (xx < xxMax) {
+      clearAASpan(aaBuf, yy, xx, xxMax);
+    }
+  }
+}
 
 //------------------------------------------------------------------------
 // SplashClip
@@ -66,15 +268,11 @@ SplashClip::SplashClip(SplashCoord x0, SplashCoord y0,
   yMinI = splashFloor(yMin);
   xMaxI = splashFloor(xMax);
   yMaxI = splashFloor(yMax);
-  paths = NULL;
-  flags = NULL;
-  scanners = NULL;
-  length = size = 0;
+  mask = NULL;
+  length = 0;
 }
 
 SplashClip::SplashClip(SplashClip *clip) {
-  int i;
-
   antialias = clip->antialias;
   xMin = clip->xMin;
   yMin = clip->yMin;
@@ -84,61 +282,22 @@ SplashClip::SplashClip(SplashClip *clip) {
   yMinI = clip->yMinI;
   xMaxI = clip->xMaxI;
   yMaxI = clip->yMaxI;
-  length = clip->length;
-  size = clip->size;
-  paths = (SplashXPath **)gmallocn(size, sizeof(SplashXPath *));
-  flags = (Guchar *)gmallocn(size, sizeof(Guchar));
-  scanners = (SplashXPathScanner **)
-                 gmallocn(size, sizeof(SplashXPathScanner *));
-  for (i = 0; i < length; ++i) {
-    paths[i] = clip->paths[i]->copy();
-    flags[i] = clip->flags[i];
-    scanners[i] = new SplashXPathScanner(paths[i], flags[i] & splashClipEO);
+  mask = clip->mask;
+  if (mask) {
+    mask->incRef();
   }
+  length = clip->length;
 }
 
 SplashClip::~SplashClip() {
-  int i;
-
-  for (i = 0; i < length; ++i) {
-    delete paths[i];
-    delete scanners[i];
-  }
-  gfree(paths);
-  gfree(flags);
-  gfree(scanners);
-}
-
-void SplashClip::grow(int nPaths) {
-  if (length + nPaths > size) {
-    if (size == 0) {
-      size = 32;
-    }
-    while (size < length + nPaths) {
-      size *= 2;
-    }
-    paths = (SplashXPath **)greallocn(paths, size, sizeof(SplashXPath *));
-    flags = (Guchar *)greallocn(flags, size, sizeof(Guchar));
-    scanners = (SplashXPathScanner **)
-                   greallocn(scanners, size, sizeof(SplashXPathScanner *));
-  }
+  SplashClipMask::decRef(mask);
 }
 
 void SplashClip::resetToRect(SplashCoord x0, SplashCoord y0,
 			     SplashCoord x1, SplashCoord y1) {
-  int i;
-
-  for (i = 0; i < length; ++i) {
-    delete paths[i];
-    delete scanners[i];
-  }
-  gfree(paths);
-  gfree(flags);
-  gfree(scanners);
-  paths = NULL;
-  flags = NULL;
-  scanners = NULL;
-  length = size = 0;
+  SplashClipMask::decRef(mask);
+  mask = NULL;
+  length = 0;
 
   if (x0 < x1) {
     xMin = x0;
@@ -248,14 +407,18 @@ SplashError SplashClip::clipToPath(SplashPath *path, SplashCoord *matrix,
     delete xPath;
 
   } else {
-    grow(1);
     if (antialias) {
       xPath->aaScale();
     }
     xPath->sort();
-    paths[length] = xPath;
-    flags[length] = eo ? splashClipEO : 0;
-    scanners[length] = new SplashXPathScanner(xPath, eo);
+    // the clip rectangle can only shrink until the mask is dropped,
+    // and nothing outside it is ever tested
+    if (antialias) {
+      mask = new SplashClipMask(mask, xPath, eo, yMinI * splashAASize,
+				(yMaxI + 1) * splashAASize - 1);
+    } else {
+      mask = new SplashClipMask(mask, xPath, eo, yMinI, yMaxI);
+    }
     ++length;
   }
 
@@ -283,8 +446,6 @@ SplashClipResult SplashClip::testRect(int rectXMin, int rectYMin,
 }
 
 SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
-  int i;
-
   // This tests the rectangle:
   //     x = [spanXMin, spanXMax + 1)    (note: span coords are ints)
   //     y = [spanY, spanY + 1)
@@ -299,17 +460,15 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
 	(SplashCoord)spanY >= yMin && (SplashCoord)(spanY + 1) <= yMax)) {
     return splashClipPartial;
   }
-  if (antialias) {
-    for (i = 0; i < length; ++i) {
-      if (!scanners[i]->testSpan(spanXMin * splashAASize,
-				 spanXMax * splashAASize + (splashAASize - 1),
-				 spanY * splashAASize)) {
+  if (mask) {
+    if (antialias) {
+      if (!mask->testSpan(spanXMin * splashAASize,
+			  spanXMax * splashAASize + (splashAASize - 1),
+			  spanY * splashAASize)) {
 	return splashClipPartial;
       }
-    }
-  } else {
-    for (i = 0; i < length; ++i) {
-      if (!scanners[i]->testSpan(spanXMin, spanXMax, spanY)) {
+    } else {
+      if (!mask->testSpan(spanXMin, spanXMax, spanY)) {
 	return splashClipPartial;
       }
     }
@@ -318,7 +477,7 @@ SplashClipResult SplashClip::testSpan(int spanXMin, int spanXMax, int spanY) {
 }
 
 void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y) {
-  int xx0, xx1, xx, yy, i;
+  int xx0, xx1, xx, yy;
   SplashColorPtr p;
 
   // zero out pixels with x < xMin
@@ -364,7 +523,7 @@ void SplashClip::clipAALine(SplashBitmap *aaBuf, int *x0, int *x1, int y) {
   }
 
   // check the paths
-  for (i = 0; i < length; ++i) {
-    scanners[i]->clipAALine(aaBuf, x0, x1, y);
+  if (mask) {
+    mask->clipAALine(aaBuf, *x0, *x1, y);
   }
 }
@@ -41,6 +41,122 @@ enum SplashClipResult {
   splashClipPartial
 };
 
+//------------------------------------------------------------------------
+// SplashClipMask
+//------------------------------------------------------------------------
+
+#define splashClipBandShift 5	// log2 of the number of rows per band
+
+// One band of a SplashClipMask: the spans inside the clip region for
+// each of the 1 << splashClipBandShift rows.
+struct SplashClipBand {
+  int rowStart[(1 << splashClipBandShift) + 1];	// index of the first
+						//   span of each row
+  int *spans;			// x0, x1 pairs, sorted, non-overlapping
+};
+
+// The intersection of a clip path with all of the clip paths that
+// were set before it.  The region is stored as a list of spans per
+// row (in the scanner's coordinate system, i.e., scaled by
+// splashAASize when anti-aliasing).  The spans are computed lazily, a
+// band of rows at a time, from the parent's spans and this path's
+// scanner, so testing a point or a span costs the same no matter how
+// many clip paths are in effect.  Masks are reference counted and
+// shared between copies of a SplashClip, so saving and restoring the
+// state don't copy any paths.
+class SplashClipMask {
+public:
+
+  // Create a new mask for the intersection of <parentA> (which may be
+  // NULL) and <xPathA>.  Takes ownership of the reference to
+  // <parentA> and of <xPathA>, which must be sorted.  Only rows
+  // <yMinA> through <yMaxA> will be tested; the mask is empty
+  // everywhere else.
+  SplashClipMask(SplashClipMask *parentA, SplashXPath *xPathA, GBool eoA,
+		 int yMinA, int yMaxA);
+
+  void incRef() { ++refCnt; }
+
+  // Drop a reference to <m> (and to its parents, as they become
+  // unused).
+  static void decRef(SplashClipMask *m);
+
+  // Returns true if (<x>,<y>) is inside the mask.
+  GBool test(int x, int y)
+  {
+    int *spans;
+    int n, i;
+
+    n = getSpans(y, &spans);
+    for (i = 0; i < n; ++i, spans += 2) {
+      if (x < spans[0]) {
+	return gFalse;
+      }
+      if (x <= spans[1]) {
+	return gTrue;
+      }
+    }
+    return gFalse;
+  }
+
+  // Returns true if the entire span ([<x0>,<x1>], <y>) is inside the
+  // mask.
+  GBool testSpan(int x0, int x1, int y)
+  {
+    int *spans;
+    int n, i;
+
+    n = getSpans(y, &spans);
+    for (i = 0; i < n; ++i, spans += 2) {
+      if (x0 <= spans[1]) {
+	return x0 >= spans[0] && x1 <= spans[1];
+      }
+    }
+    return gFalse;
+  }
+
+  // Clips an anti-aliased line ([<x0>,<x1>] in pixels) by setting
+  // pixels outside the mask to zero.
+  void clipAALine(SplashBitmap *aaBuf, int x0, int x1, int y);
+
+private:
+
+  ~SplashClipMask();
+
+  // Get the spans at <y>.  Returns the number of spans.
+  int getSpans(int y, int **spans)
+  {
+    SplashClipBand *band;
+    int row;
+
+    if (y < yMin || y > yMax) {
+      return 0;
+    }
+    if (!(band = getBand(y))) {
+      band = buildBands(y);
+    }
+    row = y & ((1 << splashClipBandShift) - 1);
+    *spans = band->spans + 2 * band->rowStart[row];
+    return band->rowStart[row + 1] - band->rowStart[row];
+  }
+
+  SplashClipBand *getBand(int y)
+    { return bands[(y >> splashClipBandShift) - bandOffset]; }
+  SplashClipBand *buildBands(int y);
+  void buildBand(int y);
+
+  int refCnt;
+  SplashClipMask *parent;
+  SplashXPath *xPath;
+  SplashXPathScanner *scanner;
+  int yMin, yMax;		// rows which may have spans
+  SplashClipBand **bands;	// band i covers the rows with
+				//   (y >> splashClipBandShift) ==
+				//   i + bandOffset; NULL until built
+  int bandOffset;
+  int nBands;
+};
+
 //------------------------------------------------------------------------
 // SplashClip
 //------------------------------------------------------------------------
@@ -73,26 +189,17 @@ public:
   // Returns true if (<x>,<y>) is inside the clip.
   GBool test(int x, int y)
   {
-    int i;
-
     // check the rectangle
     if (x < xMinI || x > xMaxI || y < yMinI || y > yMaxI) {
       return gFalse;
     }
 
     // check the paths
-    if (antialias) {
-      for (i = 0; i < length; ++i) {
-        if (!scanners[i]->test(x * splashAASize, y * splashAASize)) {
-	  return gFalse;
-        }
-      }
-    } else {
-      for (i = 0; i < length; ++i) {
-        if (!scanners[i]->test(x, y)) {
-	  return gFalse;
-        }
+    if (mask) {
+      if (antialias) {
+	return mask->test(x * splashAASize, y * splashAASize);
       }
+      return mask->test(x, y);
     }
 
     return gTrue;
@@ -130,15 +237,13 @@ public:
 protected:
 
   SplashClip(SplashClip *clip);
-  void grow(int nPaths);
 
   GBool antialias;
   SplashCoord xMin, yMin, xMax, yMax;
   int xMinI, yMinI, xMaxI, yMaxI;
-  SplashXPath **paths;
-  Guchar *flags;
-  SplashXPathScanner **scanners;
-  int length, size;
+  SplashClipMask *mask;		// intersection of the clip paths, or
+				//   NULL if there are none
+  int length;			// number of clip paths
 };
 
 #endif
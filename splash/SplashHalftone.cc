@@ -0,0 +1,223 @@
+//========================================================================
+//
+// SplashHalftone.cc
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#if MULTITHREADED
+#include "goo/GooThread.h"
+#endif
+#include "SplashBitmap.h"
+#include "SplashScreen.h"
+#include "SplashHalftone.h"
+
+// height of the bands the page is split into
+#define splashHalftoneBandHeight 256
+
+// number of rows error diffusion runs before the first row of a band
+#define splashHalftoneDiffusionLeadIn 16
+
+//------------------------------------------------------------------------
+
+struct SplashHalftoneWorker {
+  SplashHalftoneMethod method;
+  SplashScreen *screen;
+  SplashBitmap *src;
+  SplashBitmap *dest;
+  int firstBand;		// this worker does bands firstBand,
+  int bandStep;			//   firstBand + bandStep, ...
+};
+
+static void screenBand(SplashScreen *screen, SplashBitmap *src,
+		       SplashBitmap *dest, int y0, int y1) {
+  int y;
+
+  for (y = y0; y < y1; ++y) {
+    screen->testRow(y, src->getDataPtr() + y * src->getRowSize(),
+		    dest->getDataPtr() + y * dest->getRowSize(),
+		    src->getWidth());
+  }
+}
+
+// Floyd-Steinberg error diffusion of one row, with a 50% threshold,
+// going left to right (<dx> = 1) or right to left (<dx> = -1).
+// <errIn> holds the error diffused into this row, and <errOut>[-1 ..
+// <w>] is set to the error diffused into the next row, both in 1/16
+// units.  If <out> is NULL, only the error is computed.
+static void diffuseRow(Guchar *in, Guchar *out, int *errIn, int *errOut,
+		       int w, int dx) {
+  int x, v, e, right, below0, below1;
+
+  // right: error for the next pixel in this row; below0, below1:
+  // error collected so far for the pixel below the previous pixel and
+  // for the pixel below this one
+  right = below0 = below1 = 0;
+  for (x = dx > 0 ? 0 : w - 1; x >= 0 && x < w; x += dx) {
+    v = in[x] + ((errIn[x] + right + 8) >> 4);
+    if (v < 128) {
+      e = v;
+      if (out) {
+	out[x >> 3] &= (Guchar)~(0x80 >> (x & 7));
+      }
+    } else {
+      e = v - 255;
+    }
+    right = 7 * e;
+    errOut[x - dx] = below0 + 3 * e;
+    below0 = below1 + 5 * e;
+    below1 = e;
+  }
+  errOut[x - dx] = below0;
+  errOut[x] = below1;
+}
+
+// Serpentine error diffusion of rows <y0> .. <y1>-1.  Rows <yStart>
+// .. <y0>-1 are processed only to build up the error.  <err> has room
+// for two rows of <width> + 2 entries.
+static void diffuseBand(SplashBitmap *src, SplashBitmap *dest,
+			int yStart, int y0, int y1, int *err) {
+  Guchar *out;
+  int *errCur, *errNext, *errTmp;
+  int w, y;
+
+  w = src->getWidth();
+  errCur = err + 1;
+  errNext = err + w + 3;
+  memset(errCur, 0, w * sizeof(int));
+  for (y = yStart; y < y1; ++y) {
+    out = NULL;
+    if (y >= y0) {
+      out = dest->getDataPtr() + y * dest->getRowSize();
+      memset(out, 0xff, (w + 7) >> 3);
+    }
+    // even rows go left to right, odd rows right to left
+    diffuseRow(src->getDataPtr() + y * src->getRowSize(), out,
+	       errCur, errNext, w, (y & 1) ? -1 : 1);
+    errTmp = errCur;
+    errCur = errNext;
+    errNext = errTmp;
+  }
+}
+
+static void runWorker(SplashHalftoneWorker *worker) {
+  int *err;
+  int h, band, y0, y1, yStart;
+
+  h = worker->src->getHeight();
+  err = NULL;
+  if (worker->method == splashHalftoneDiffusion) {
+    err = (int *)gmallocn(2 * (worker->src->getWidth() + 2), sizeof(int));
+  }
+  for (band = worker->firstBand;
+       band * splashHalftoneBandHeight < h;
+       band += worker->bandStep) {
+    y0 = band * splashHalftoneBandHeight;
+    y1 = y0 + splashHalftoneBandHeight;
+    if (y1 > h) {
+      y1 = h;
+    }
+    if (worker->method == splashHalftoneDiffusion) {
+      yStart = y0 - splashHalftoneDiffusionLeadIn;
+      if (yStart < 0) {
+	yStart = 0;
+      }
+      diffuseBand(worker->src, worker->dest, yStart, y0, y1, err);
+    } else {
+      screenBand(worker->screen, worker->src, worker->dest, y0, y1);
+    }
+  }
+  gfree(err);
+}
+
+#if MULTITHREADED
+static GOO_THREAD_FUNC(halftoneThread) {
+  runWorker((SplashHalftoneWorker *)arg);
+  GOO_THREAD_RETURN;
+}
+#endif
+
+//------------------------------------------------------------------------
+// SplashHalftone
+//------------------------------------------------------------------------
+
+SplashHalftone::SplashHalftone(SplashHalftoneMethod methodA,
+			       SplashScreenParams *screenParams,
+			       int nThreadsA) {
+  method = methodA;
+  screen = NULL;
+  if (method == splashHalftoneScreen) {
+    screen = new SplashScreen(screenParams);
+    // build the threshold matrix now, before any threads share it
+    screen->isStatic(0);
+  }
+  nThreads = nThreadsA < 1 ? 1 : nThreadsA;
+}
+
+SplashHalftone::~SplashHalftone() {
+  delete screen;
+}
+
+void SplashHalftone::halftone(SplashBitmap *src, SplashBitmap *dest) {
+  SplashHalftoneWorker *workers;
+#if MULTITHREADED
+  GooThread *threads;
+  GBool *started;
+#endif
+  int nBands, nWorkers, i;
+
+  if (src->getMode() != splashModeMono8 ||
+      dest->getMode() != splashModeMono1 ||
+      dest->getWidth() != src->getWidth() ||
+      dest->getHeight() != src->getHeight()) {
+    return;
+  }
+
+  nBands = (src->getHeight() + splashHalftoneBandHeight - 1) /
+           splashHalftoneBandHeight;
+  nWorkers = nThreads < nBands ? nThreads : nBands;
+  workers = (SplashHalftoneWorker *)gmallocn(nWorkers,
+					     sizeof(SplashHalftoneWorker));
+  for (i = 0; i < nWorkers; ++i) {
+    workers[i].method = method;
+    workers[i].screen = screen;
+    workers[i].src = src;
+    workers[i].dest = dest;
+    workers[i].firstBand = i;
+    workers[i].bandStep = nWorkers;
+  }
+#if MULTITHREADED
+  threads = (GooThread *)gmallocn(nWorkers, sizeof(GooThread));
+  started = (GBool *)gmallocn(nWorkers, sizeof(GBool));
+  for (i = 1; i < nWorkers; ++i) {
+    started[i] = gCreateThread(&threads[i], halftoneThread, &workers[i]);
+    if (!started[i]) {
+      runWorker(&workers[i]);
+    }
+  }
+  if (nWorkers > 0) {
+    runWorker(&workers[0]);
+  }
+  for (i = 1; i < nWorkers; ++i) {
+    if (started[i]) {
+      gJoinThread(threads[i]);
+    }
+  }
+  gfree(threads);
+  gfree(started);
+#else
+  for (i = 0; i < nWorkers; ++i) {
+    runWorker(&workers[i]);
+  }
+#endif
+  gfree(workers);
+}
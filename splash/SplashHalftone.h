@@ -0,0 +1,58 @@
+//========================================================================
+//
+// SplashHalftone.h
+//
+// This file is licensed under GPLv2 or later
+//
+//========================================================================
+
+#ifndef SPLASHHALFTONE_H
+#define SPLASHHALFTONE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "SplashTypes.h"
+
+class SplashBitmap;
+class SplashScreen;
+
+//------------------------------------------------------------------------
+// SplashHalftone
+//
+// Converts a page rendered in 8-bit gray (splashModeMono8) to 1 bit
+// per pixel (splashModeMono1), either with the threshold matrix of a
+// SplashScreen (the same result as rendering in splashModeMono1 for
+// opaque content) or with error diffusion.
+//
+// The page is processed in bands of fixed height, which can be split
+// between several threads.  Error diffusion starts each band a few
+// rows early, so that the error is already spread out at the first
+// row of the band.  The result does not depend on the number of
+// threads.
+//------------------------------------------------------------------------
+
+class SplashHalftone {
+public:
+
+  // Create a halftoner.  <screenParams> is used for
+  // splashHalftoneScreen; it must stay valid as long as the
+  // halftoner.
+  SplashHalftone(SplashHalftoneMethod methodA,
+		 SplashScreenParams *screenParams, int nThreadsA);
+
+  ~SplashHalftone();
+
+  // Halftone the splashModeMono8 bitmap <src> into the
+  // splashModeMono1 bitmap <dest>, which must have the same size.
+  void halftone(SplashBitmap *src, SplashBitmap *dest);
+
+private:
+
+  SplashHalftoneMethod method;
+  SplashScreen *screen;		// for splashHalftoneScreen
+  int nThreads;
+};
+
+#endif
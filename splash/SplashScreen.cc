@@ -30,6 +30,10 @@
 #include "SplashMath.h"
 #include "SplashScreen.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 static SplashScreenParams defaultParams = {
   splashScreenDispersed,	// type
   2,				// size
@@ -67,6 +71,7 @@ SplashScreen::SplashScreen(SplashScreenParams *params) {
   
   screenParams = params;
   mat = NULL;
+  rowMat = NULL;
   size = 0;
   maxVal = 0;
   minVal = 0;
@@ -138,6 +143,21 @@ void SplashScreen::createMatrix()
       maxVal = u;
     }
   }
+
+  buildRowMatrix();
+}
+
+// Row y of rowMat holds row y of mat, followed by enough of the same
+// row again that 16 thresholds can be read from any starting column.
+void SplashScreen::buildRowMatrix() {
+  int x, y;
+
+  rowMat = (Guchar *)gmallocn(size, size + 16);
+  for (y = 0; y < size; ++y) {
+    for (x = 0; x < size + 16; ++x) {
+      rowMat[y * (size + 16) + x] = mat[y * size + x % size];
+    }
+  }
 }
 
 void SplashScreen::buildDispersedMatrix(int i, int j, int val,
@@ -379,12 +399,17 @@ SplashScreen::SplashScreen(SplashScreen *screen) {
   size = screen->size;
   mat = (Guchar *)gmallocn(size * size, sizeof(Guchar));
   memcpy(mat, screen->mat, size * size * sizeof(Guchar));
+  rowMat = NULL;
+  if (screen->rowMat) {
+    buildRowMatrix();
+  }
   minVal = screen->minVal;
   maxVal = screen->maxVal;
 }
 
 SplashScreen::~SplashScreen() {
   gfree(mat);
+  gfree(rowMat);
 }
 
 int SplashScreen::test(int x, int y, Guchar value) {
@@ -412,3 +437,59 @@ GBool SplashScreen::isStatic(Guchar value) {
   
   return value < minVal || value >= maxVal;
 }
+
+void SplashScreen::testRow(int y, Guchar *in, Guchar *out, int n) {
+  Guchar *thresh;
+  int x, xx, yy, b, i;
+
+  if (mat == NULL) createMatrix();
+
+  // test() is (value >= threshold): values below minVal are below
+  // every threshold, and values at or above maxVal are at or above
+  // every threshold
+  if ((yy = y % size) < 0) {
+    yy = -yy;
+  }
+  thresh = rowMat + yy * (size + 16);
+  xx = 0;
+  x = 0;
+#if defined(__SSE2__)
+  __m128i v, t;
+  int m;
+
+  for (; x + 16 <= n; x += 16) {
+    v = _mm_loadu_si128((__m128i *)(in + x));
+    t = _mm_loadu_si128((__m128i *)(thresh + xx));
+    m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v));
+    // movemask puts the first pixel in the least significant bit, so
+    // reverse the bits of each byte
+    m = ((m & 0xf0f0) >> 4) | ((m & 0x0f0f) << 4);
+    m = ((m & 0xcccc) >> 2) | ((m & 0x3333) << 2);
+    m = ((m & 0xaaaa) >> 1) | ((m & 0x5555) << 1);
+    out[x >> 3] = (Guchar)m;
+    out[(x >> 3) + 1] = (Guchar)(m >> 8);
+    if ((xx += 16) >= size) {
+      xx %= size;
+    }
+  }
+#endif
+  for (; x + 8 <= n; x += 8) {
+    b = 0;
+    for (i = 0; i < 8; ++i) {
+      b = (b << 1) | (in[x + i] >= thresh[xx + i]);
+    }
+    out[x >> 3] = (Guchar)b;
+    if ((xx += 8) >= size) {
+      xx %= size;
+    }
+  }
+  if (x < n) {
+    b = 0xff;
+    for (i = 0; x + i < n; ++i) {
+      if (in[x + i] < thresh[xx + i]) {
+	b &= ~(0x80 >> i);
+      }
+    }
+    out[x >> 3] = (Guchar)b;
+  }
+}
@@ -44,6 +44,12 @@ public:
   // level <value> at (<x>, <y>).
   int test(int x, int y, Guchar value);
 
+  // Halftone the gray levels <in>[0 .. <n>-1] of the pixels (0, <y>)
+  // .. (<n>-1, <y>) into packed 1-bit pixels (most significant bit
+  // first) in <out>; this gives the same values as test().  Bits
+  // past the last pixel are set to 1.
+  void testRow(int y, Guchar *in, Guchar *out, int n);
+
   // Returns true if value is above the white threshold or below the
   // black threshold, i.e., if the corresponding halftone will be
   // solid white or black.
@@ -51,6 +57,7 @@ public:
 
 private:
   void createMatrix();
+  void buildRowMatrix();
 
   void buildDispersedMatrix(int i, int j, int val,
 			    int delta, int offset);
@@ -60,6 +67,8 @@ private:
 
   SplashScreenParams *screenParams;	// params to create the other members
   Guchar *mat;			// threshold matrix
+  Guchar *rowMat;		// threshold matrix with each row extended
+				//   by 16 wrapped-around entries
   int size;			// size of the threshold matrix
   Guchar minVal;		// any pixel value below minVal generates
 				//   solid black
@@ -148,6 +148,17 @@ struct SplashScreenParams {
   SplashCoord whiteThreshold;
 };
 
+//------------------------------------------------------------------------
+// halftoning of 8-bit gray pages to 1-bit pages
+//------------------------------------------------------------------------
+
+enum SplashHalftoneMethod {
+  splashHalftoneNone,		// none (splashModeMono1 thresholds each
+				//   pixel while painting)
+  splashHalftoneScreen,		// ordered dither with the screen matrix
+  splashHalftoneDiffusion	// Floyd-Steinberg error diffusion
+};
+
 //------------------------------------------------------------------------
 // error results
 //------------------------------------------------------------------------
@@ -0,0 +1,128 @@
+//========================================================================
+//
+// annot-test.cc
+//
+// Adds a text annotation to a page and renders it, checking that the
+// page keeps its own reference to the annot, that adding the same
+// annot twice does not add it again, and that the annot can outlive
+// the page list or be released before it.  Meant to be run under a
+// memory checker as well.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "Page.h"
+#include "Annot.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf.h"
+
+//------------------------------------------------------------------------
+
+static GooString *makeDoc() {
+  GooString *objs[4], *content, *pdf;
+  int i;
+
+  content = new GooString("0 0 1 rg 10 10 50 50 re f\n");
+  objs[0] = new GooString("<< /Type /Catalog /Pages 2 0 R >>");
+  objs[1] = new GooString("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  objs[2] = new GooString("<< /Type /Page /Parent 2 0 R "
+			  "/MediaBox [0 0 200 200] /Contents 4 0 R >>");
+  objs[3] = testPDFStream("", content);
+  pdf = testPDFFile(objs, 4);
+  for (i = 0; i < 4; ++i) {
+    delete objs[i];
+  }
+  delete content;
+  return pdf;
+}
+
+// Render page 1 and return the number of pixels that are neither
+// white nor the blue of the page content.
+static int render(PDFDoc *doc) {
+  SplashOutputDev *out;
+  SplashBitmap *bitmap;
+  SplashColor paper;
+  Guchar *p;
+  int x, y, n;
+
+  paper[0] = paper[1] = paper[2] = 0xff;
+  out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paper);
+  out->startDoc(doc->getXRef());
+  doc->displayPage(out, 1, 72, 72, 0, gFalse, gTrue, gFalse);
+  bitmap = out->getBitmap();
+  n = 0;
+  for (y = 0; y < bitmap->getHeight(); ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    for (x = 0; x < bitmap->getWidth(); ++x, p += 3) {
+      if (!(p[0] == 0xff && p[1] == 0xff && p[2] == 0xff) &&
+	  !(p[0] == 0 && p[1] == 0 && p[2] == 0xff)) {
+	++n;
+      }
+    }
+  }
+  delete out;
+  return n;
+}
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *pdf;
+  PDFDoc *doc;
+  Page *page;
+  Annot *annot;
+  PDFRectangle rect(100, 100, 140, 140);
+  int before, nAnnots, nFailed;
+
+  globalParams = new GlobalParams();
+  nFailed = 0;
+  pdf = makeDoc();
+
+  // the annot is released by its creator once it is on the page, and
+  // the page list is built before the annot is added
+  doc = testPDFOpen(pdf);
+  page = doc->getCatalog()->getPage(1);
+  before = render(doc);
+  nAnnots = page->getAnnots(doc->getCatalog())->getNumAnnots();
+  annot = new AnnotText(doc->getXRef(), &rect, doc->getCatalog());
+  page->addAnnot(annot);
+  page->addAnnot(annot);
+  nFailed += !check(page->getAnnots(doc->getCatalog())->getNumAnnots() ==
+		    nAnnots + 1, "annot added twice");
+  annot->decRefCnt();
+  nFailed += !check(render(doc) > before, "added annot is not drawn");
+  delete doc;
+
+  // the annot is added before the list is built, and outlives the page
+  doc = testPDFOpen(pdf);
+  page = doc->getCatalog()->getPage(1);
+  annot = new AnnotText(doc->getXRef(), &rect, doc->getCatalog());
+  page->addAnnot(annot);
+  page->addAnnot(annot);
+  nFailed += !check(page->getAnnots(doc->getCatalog())->getNumAnnots() ==
+		    nAnnots + 1, "annot added twice before the list is built");
+  nFailed += !check(render(doc) > before, "added annot is not drawn");
+  delete doc;
+  nFailed += !check(annot->getType() == Annot::typeText,
+		    "annot did not outlive the page");
+  annot->decRefCnt();
+
+  delete pdf;
+  delete globalParams;
+
+  printf("%d failed\n", nFailed);
+  return nFailed ? 1 : 0;
+}
@@ -0,0 +1,712 @@
+//========================================================================
+//
+// cachedfile-test.cc
+//
+// Reads documents through a CachedFile whose loader serves a file held
+// in memory, standing in for an HTTP server, and records the byte
+// ranges it is asked for.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <utime.h>
+#include <unistd.h>
+#include <vector>
+#include "goo/gmem.h"
+#include "goo/gfile.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "CachedFile.h"
+#include "PDFDoc.h"
+#include "Page.h"
+#include "SplashOutputDev.h"
+
+//------------------------------------------------------------------------
+// MemLoader
+//------------------------------------------------------------------------
+
+// Serves byte ranges of <data>, like an HTTP server answering range
+// requests, and keeps a log of the requests.
+class MemLoader: public CachedFileLoader {
+public:
+
+  MemLoader(GooString *dataA, std::vector<std::vector<ByteRange> > *logA,
+	    GooString *validatorA = NULL)
+    : data(dataA), log(logA), validator(validatorA), firstRangeDelta(0) {}
+
+  size_t init(GooString *uri, CachedFile *cachedFile)
+    { return data->getLength(); }
+
+  int load(const std::vector<ByteRange> &ranges, CachedFileWriter *writer) {
+    size_t offset, len;
+
+    log->push_back(ranges);
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      offset = ranges[i].offset;
+      len = ranges[i].length;
+      if (i == 0) {
+	len += firstRangeDelta;
+	firstRangeDelta = 0;
+      }
+      if (offset + len > (size_t)data->getLength()) {
+	len = data->getLength() - offset;
+      }
+      if (i > 0) {
+	writer->nextRange();
+      }
+      writer->write(data->getCString() + offset, len);
+    }
+    return 0;
+  }
+
+  GooString *getValidator() { return validator; }
+
+  // Send this many bytes more (or less) than asked for in the first
+  // range of the next request, like a misbehaving server or a dropped
+  // connection.
+  void setFirstRangeDelta(int delta) { firstRangeDelta = delta; }
+
+private:
+
+  GooString *data;
+  std::vector<std::vector<ByteRange> > *log;
+  GooString *validator;
+  int firstRangeDelta;
+};
+
+static PDFDoc *openDoc(GooString *pdf,
+		       std::vector<std::vector<ByteRange> > *log) {
+  CachedFile *cachedFile;
+  Object obj;
+
+  cachedFile = new CachedFile(new MemLoader(pdf, log),
+			      new GooString("http://localhost/test.pdf"));
+  obj.initNull();
+  return new PDFDoc(new CachedFileStream(cachedFile, 0, gFalse,
+					 cachedFile->getLength(), &obj),
+		    NULL, NULL);
+}
+
+// True if the requests in <log> cover [offset, offset + length).
+static GBool covers(const std::vector<std::vector<ByteRange> > &log,
+		    size_t offset, size_t length) {
+  size_t pos;
+  GBool found;
+
+  pos = offset;
+  while (pos < offset + length) {
+    found = gFalse;
+    for (size_t i = 0; i < log.size(); ++i) {
+      for (size_t j = 0; j < log[i].size(); ++j) {
+	if (log[i][j].offset <= pos &&
+	    pos < log[i][j].offset + log[i][j].length) {
+	  pos = log[i][j].offset + log[i][j].length;
+	  found = gTrue;
+	}
+      }
+    }
+    if (!found) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+//------------------------------------------------------------------------
+// linearized test document
+//------------------------------------------------------------------------
+
+// Packs the hint tables.
+class BitWriter {
+public:
+
+  BitWriter(): buf(0), nBits(0) {}
+
+  void put(int n, Guint x) {
+    while (n > 0) {
+      --n;
+      buf = (buf << 1) | ((x >> n) & 1);
+      if (++nBits == 8) {
+	data.append((char)buf);
+	buf = nBits = 0;
+      }
+    }
+  }
+
+  void align() {
+    if (nBits) {
+      put(8 - nBits, 0);
+    }
+  }
+
+  GooString data;
+
+private:
+
+  int buf, nBits;
+};
+
+// Byte positions in the linearized document.  Numbers in it are
+// written with a fixed width, so that it can be built once to find
+// them and a second time with the right values.
+struct LinLayout {
+  int objOffset[14];
+  int objEnd[14];
+  int fileLength;
+  int hintOffset, hintLength;
+  int firstXRef, mainXRef, mainXRefEntries;
+};
+
+#define linPadding 20000
+
+static void appendObj(GooString *pdf, LinLayout *out, int num,
+		      const char *body) {
+  char buf[32];
+
+  out->objOffset[num] = pdf->getLength();
+  sprintf(buf, "%d 0 obj\n", num);
+  pdf->append(buf);
+  pdf->append(body);
+  pdf->append("\nendobj\n");
+  out->objEnd[num] = pdf->getLength();
+}
+
+static void appendStreamObj(GooString *pdf, LinLayout *out, int num,
+			    const char *dict, const char *ops) {
+  GooString *body;
+  char buf[64];
+  int i;
+
+  // large enough for each page to span several chunks
+  body = new GooString("%");
+  for (i = 0; i < linPadding; ++i) {
+    body->append('x');
+  }
+  body->append('\n');
+  body->append(ops);
+  sprintf(buf, " /Length %d >>\nstream\n", body->getLength());
+  body->insert(0, buf);
+  body->insert(0, dict);
+  body->insert(0, "<< ");
+  body->append("\nendstream");
+  appendObj(pdf, out, num, body->getCString());
+  delete body;
+}
+
+// Build a linearized document with four pages.  Pages 2 to 4 are
+// objects 1 to 6, and pages 2 and 4 use a form (object 7), which is
+// a shared object group.  Page 1 is objects 8 and 9, the catalog and
+// the page tree are 10 and 11, and the linearization dictionary and
+// the hint stream 12 and 13.  Offsets come from <in> and are stored
+// in <out>.
+static GooString *makeLinearized(LinLayout *in, LinLayout *out) {
+  GooString *pdf;
+  BitWriter hints;
+  char buf[256];
+  int pageStart[4], pageEnd[4];
+  int i, s;
+
+  pdf = new GooString("%PDF-1.4\n");
+  sprintf(buf, "<< /Linearized 1 /L %010d /H [%010d %010d] /O 8 "
+	  "/E %010d /N 4 /T %010d /P 0 >>",
+	  in->fileLength, in->hintOffset, in->hintLength,
+	  in->objEnd[9], in->mainXRefEntries);
+  appendObj(pdf, out, 12, buf);
+
+  // first page xref section, which points to the main one
+  out->firstXRef = pdf->getLength();
+  pdf->append("xref\n8 6\n");
+  for (i = 8; i < 14; ++i) {
+    sprintf(buf, "%010d 00000 n \n", in->objOffset[i]);
+    pdf->append(buf);
+  }
+  sprintf(buf, "trailer\n<< /Size 14 /Root 10 0 R /Prev %010d >>\n"
+	  "startxref\n0\n%%%%EOF\n", in->mainXRef);
+  pdf->append(buf);
+
+  // page offset hint table: every page has two objects
+  pageStart[0] = in->objOffset[8];
+  pageEnd[0] = in->objEnd[9];
+  for (i = 1; i < 4; ++i) {
+    pageStart[i] = in->objOffset[2 * i - 1];
+    pageEnd[i] = in->objEnd[2 * i];
+  }
+  hints.put(32, 2);				// least number of objects
+  hints.put(32, pageStart[0] - in->hintLength);	// first page object
+  hints.put(16, 8);
+  hints.put(32, 0);				// least page length
+  hints.put(16, 24);
+  hints.put(32, 0);
+  hints.put(16, 0);
+  hints.put(32, 0);
+  hints.put(16, 0);
+  hints.put(16, 8);				// bits for shared refs
+  hints.put(16, 8);				// bits for shared ids
+  hints.put(16, 0);
+  hints.put(16, 1);
+  for (i = 0; i < 4; ++i) {
+    hints.put(8, 0);
+  }
+  hints.align();
+  for (i = 0; i < 4; ++i) {
+    hints.put(24, pageEnd[i] - pageStart[i]);
+  }
+  hints.align();
+  hints.put(8, 0);
+  hints.put(8, 1);
+  hints.put(8, 0);
+  hints.put(8, 1);
+  hints.align();
+  hints.put(8, 1);				// page 2 uses group 1
+  hints.put(8, 1);				// page 4 uses group 1
+  hints.align();
+
+  // shared object hint table: group 0 is the first page, group 1 the
+  // form
+  s = hints.data.getLength();
+  hints.put(32, 7);
+  hints.put(32, in->objOffset[7] - in->hintLength);
+  hints.put(32, 1);
+  hints.put(32, 2);
+  hints.put(16, 0);
+  hints.put(32, 0);
+  hints.put(16, 24);
+  hints.align();
+  hints.put(24, pageEnd[0] - pageStart[0]);
+  hints.put(24, in->objEnd[7] - in->objOffset[7]);
+  hints.align();
+  hints.put(2, 0);
+  hints.align();
+
+  out->hintOffset = pdf->getLength();
+  sprintf(buf, "13 0 obj\n<< /S %010d /Length %010d >>\nstream\n",
+	  s, hints.data.getLength());
+  pdf->append(buf);
+  pdf->append(&hints.data);
+  pdf->append("\nendstream\nendobj\n");
+  out->objOffset[13] = out->hintOffset;
+  out->hintLength = pdf->getLength() - out->hintOffset;
+
+  appendObj(pdf, out, 10, "<< /Type /Catalog /Pages 11 0 R >>");
+  appendObj(pdf, out, 11, "<< /Type /Pages /Kids [8 0 R 1 0 R 3 0 R 5 0 R] "
+	    "/Count 4 >>");
+  appendObj(pdf, out, 8, "<< /Type /Page /Parent 11 0 R "
+	    "/MediaBox [0 0 200 200] /Contents 9 0 R >>");
+  appendStreamObj(pdf, out, 9, "", "0 0 1 rg 10 10 50 50 re f");
+  for (i = 1; i < 4; ++i) {
+    sprintf(buf, "<< /Type /Page /Parent 11 0 R /MediaBox [0 0 200 200] "
+	    "/Resources << /XObject << /F 7 0 R >> >> /Contents %d 0 R >>",
+	    2 * i);
+    appendObj(pdf, out, 2 * i - 1, buf);
+    appendStreamObj(pdf, out, 2 * i, "", i == 2 ? "0 1 0 rg 0 0 9 9 re f"
+		                                : "/F Do");
+  }
+  appendStreamObj(pdf, out, 7, "/Type /XObject /Subtype /Form "
+		  "/BBox [0 0 200 200]", "1 0 0 rg 100 100 50 50 re f");
+
+  // main xref section
+  out->mainXRef = pdf->getLength();
+  pdf->append("xref\n0 8\n");
+  out->mainXRefEntries = pdf->getLength();
+  pdf->append("0000000000 65535 f \n");
+  for (i = 1; i < 8; ++i) {
+    sprintf(buf, "%010d 00000 n \n", in->objOffset[i]);
+    pdf->append(buf);
+  }
+  sprintf(buf, "trailer\n<< /Size 8 >>\nstartxref\n%d\n%%%%EOF\n",
+	  out->firstXRef);
+  pdf->append(buf);
+  out->fileLength = pdf->getLength();
+  return pdf;
+}
+
+// The byte range of page <page> (its objects and their main xref
+// entries) in the document built by makeLinearized.
+static void pageRange(LinLayout *layout, int page,
+		      size_t *offset, size_t *length) {
+  int first;
+
+  first = 2 * page - 3;
+  *offset = layout->objOffset[first];
+  *length = layout->objEnd[first + 1] - layout->objOffset[first];
+}
+
+static void renderPage(PDFDoc *doc, int page) {
+  SplashOutputDev *out;
+  SplashColor paper;
+
+  paper[0] = paper[1] = paper[2] = 0xff;
+  out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paper);
+  out->startDoc(doc->getXRef());
+  doc->displayPage(out, page, 72, 72, 0, gFalse, gTrue, gFalse);
+  delete out;
+}
+
+// The hint tables of a linearized document are used to request all the
+// data of a page before it is parsed: getPage makes a single request,
+// after which the page, its xref entries and the shared objects it
+// uses are loaded, and rendering the page needs nothing else.
+static int testPrefetch() {
+  std::vector<std::vector<ByteRange> > log;
+  LinLayout layout0, layout;
+  GooString *pdf;
+  PDFDoc *doc;
+  size_t offset, length, n;
+  int nFailed;
+
+  nFailed = 0;
+  memset(&layout0, 0, sizeof(layout0));
+  delete makeLinearized(&layout0, &layout);
+  pdf = makeLinearized(&layout, &layout0);
+
+  doc = openDoc(pdf, &log);
+  nFailed += !check(doc->isOk() && doc->isLinearized(),
+		    "linearized document is not recognized");
+  nFailed += !check(doc->getNumPages() == 4, "wrong page count");
+
+  n = log.size();
+  nFailed += !check(doc->getPage(2) != NULL, "no page 2");
+  nFailed += !check(log.size() == n + 1,
+		    "page 2 was not fetched with a single request");
+  if (log.size() > n) {
+    pageRange(&layout, 2, &offset, &length);
+    nFailed += !check(covers(log, offset, length),
+		      "page 2 objects were not requested");
+    nFailed += !check(covers(log, layout.mainXRefEntries + 20, 2 * 20),
+		      "page 2 xref entries were not requested");
+    nFailed += !check(covers(log, layout.objOffset[7],
+			     layout.objEnd[7] - layout.objOffset[7]),
+		      "shared form was not requested with page 2");
+  }
+  n = log.size();
+  renderPage(doc, 2);
+  nFailed += !check(log.size() == n, "rendering page 2 loaded more data");
+
+  // with a lookahead of one page, page 4 comes along with page 3
+  doc->setPrefetchLookahead(1);
+  n = log.size();
+  nFailed += !check(doc->getPage(3) != NULL, "no page 3");
+  nFailed += !check(log.size() == n + 1,
+		    "page 3 was not fetched with a single request");
+  if (log.size() > n) {
+    pageRange(&layout, 4, &offset, &length);
+    nFailed += !check(covers(log, offset, length),
+		      "page 4 was not prefetched with page 3");
+  }
+  n = log.size();
+  renderPage(doc, 3);
+  renderPage(doc, 4);
+  nFailed += !check(log.size() == n, "rendering pages 3 and 4 loaded more data");
+
+  delete doc;
+  delete pdf;
+  return nFailed;
+}
+
+//------------------------------------------------------------------------
+// ranges delivered short or long
+//------------------------------------------------------------------------
+
+static GooString *makeData(int length) {
+  GooString *data;
+  int i;
+
+  data = new GooString();
+  for (i = 0; i < length; ++i) {
+    data->append((char)(i * 7 + i / 251));
+  }
+  return data;
+}
+
+// Read <n> bytes at <pos> from <file> and compare them with <data>.
+static GBool readMatches(CachedFile *file, GooString *data, int pos, int n) {
+  char buf[64];
+
+  return file->seek(pos, SEEK_SET) == 0 &&
+         file->read(buf, 1, n) == (size_t)n &&
+         !memcmp(buf, data->getCString() + pos, n);
+}
+
+// When a request has two ranges and the first one is delivered with
+// <delta> bytes too many or too few, the second range is still stored
+// in the right place, and the chunks the first one didn't fill are
+// requested again when they are read.
+static int testRangeLength(int delta) {
+  std::vector<std::vector<ByteRange> > log;
+  std::vector<ByteRange> ranges;
+  ByteRange r;
+  GooString *data;
+  MemLoader *loader;
+  CachedFile *file;
+  size_t n;
+  int nFailed;
+
+  nFailed = 0;
+  data = makeData(12 * CachedFileChunkSize + 100);
+  loader = new MemLoader(data, &log);
+  file = new CachedFile(loader, new GooString("http://localhost/data"));
+
+  r.offset = 0;
+  r.length = 2 * CachedFileChunkSize;
+  ranges.push_back(r);
+  r.offset = 6 * CachedFileChunkSize;
+  r.length = 2 * CachedFileChunkSize;
+  ranges.push_back(r);
+  loader->setFirstRangeDelta(delta);
+  nFailed += !check((file->cache(ranges) != 0) == (delta < 0),
+		    "short range was not reported");
+  n = log.size();
+
+  nFailed += !check(readMatches(file, data, 6 * CachedFileChunkSize + 5, 40),
+		    "second range was shifted");
+  nFailed += !check(readMatches(file, data, 8 * CachedFileChunkSize - 40, 40),
+		    "end of the second range is wrong");
+  nFailed += !check(readMatches(file, data, 10, 40),
+		    "first range is wrong");
+  nFailed += !check(log.size() == n, "complete chunks were requested again");
+  nFailed += !check(readMatches(file, data, 2 * CachedFileChunkSize - 40, 40),
+		    "end of the first range is wrong");
+  nFailed += !check(log.size() == n + (delta < 0),
+		    "short chunk was not requested again");
+  nFailed += !check(readMatches(file, data, 2 * CachedFileChunkSize, 40),
+		    "data after the first range is wrong");
+
+  file->decRefCnt();
+  delete data;
+  return nFailed;
+}
+
+//------------------------------------------------------------------------
+// on-disk chunk store
+//------------------------------------------------------------------------
+
+// Open <uri> on <data>, read all of it, and check that it is right.
+// Returns the requests that were made in <log>.
+static GBool readAll(GooString *data, const char *uri, const char *validator,
+		     std::vector<std::vector<ByteRange> > *log) {
+  GooString *v;
+  CachedFile *file;
+  GBool ok;
+  int pos;
+
+  log->clear();
+  v = new GooString(validator);
+  file = new CachedFile(new MemLoader(data, log, v), new GooString(uri));
+  ok = gTrue;
+  for (pos = 0; pos + 40 <= data->getLength(); pos += 1000) {
+    ok = ok && readMatches(file, data, pos, 40);
+  }
+  file->decRefCnt();
+  delete v;
+  return ok;
+}
+
+// The store files in <dir>: their number, and the size of the one
+// for <uri>, or -1.
+static int listStore(const char *dir, int *nFiles) {
+  GDir gdir((char *)dir, gTrue);
+  GDirEntry *ent;
+  struct stat st;
+  int size;
+
+  size = -1;
+  *nFiles = 0;
+  while ((ent = gdir.getNextEntry())) {
+    if (!ent->isDir()) {
+      ++*nFiles;
+      if (strstr(ent->getName()->getCString(), ".chunks") &&
+	  stat(ent->getFullPath()->getCString(), &st) == 0) {
+	size = st.st_size;
+      }
+    }
+    delete ent;
+  }
+  return size;
+}
+
+static GooString *storePath(const char *dir) {
+  GDir gdir((char *)dir, gFalse);
+  GDirEntry *ent;
+  GooString *path;
+
+  path = NULL;
+  while ((ent = gdir.getNextEntry())) {
+    if (!path && strstr(ent->getName()->getCString(), ".chunks")) {
+      path = ent->getFullPath()->copy();
+    }
+    delete ent;
+  }
+  return path;
+}
+
+static void removeDir(const char *dir) {
+  GDir gdir((char *)dir, gFalse);
+  GDirEntry *ent;
+
+  while ((ent = gdir.getNextEntry())) {
+    remove(ent->getFullPath()->getCString());
+    delete ent;
+  }
+  rmdir(dir);
+}
+
+static int testStore() {
+  static const char *uri = "http://localhost/store.pdf";
+  std::vector<std::vector<ByteRange> > log;
+  char dir[] = "/tmp/cachedfile-test-XXXXXX";
+  GooString *data, *path, *tmpNew, *tmpOld, *dirStr, *uriStr, *validator;
+  CachedFileStore *store;
+  char buf[CachedFileChunkSize];
+  struct utimbuf times;
+  FILE *f;
+  int size, nFiles, c, nFailed;
+
+  nFailed = 0;
+  if (!mkdtemp(dir)) {
+    fprintf(stderr, "FAIL: can't create a temporary directory\n");
+    return 1;
+  }
+  globalParams->setChunkCacheDir(dir);
+  globalParams->setChunkCacheSize(1 << 20);
+  data = makeData(12 * CachedFileChunkSize + 100);
+
+  // a second reader gets everything from the store
+  nFailed += !check(readAll(data, uri, "v1", &log), "first read is wrong");
+  nFailed += !check(!log.empty(), "first read made no request");
+  nFailed += !check(readAll(data, uri, "v1", &log), "stored data is wrong");
+  nFailed += !check(log.empty(), "stored data was requested again");
+
+  // a damaged record, and everything after it, is dropped; the file is
+  // then repaired
+  path = storePath(dir);
+  size = listStore(dir, &nFiles);
+  if ((f = fopen(path->getCString(), "r+b"))) {
+    fseek(f, size / 2, SEEK_SET);
+    c = fgetc(f);
+    fseek(f, size / 2, SEEK_SET);
+    fputc(c ^ 0xff, f);
+    fclose(f);
+  }
+  nFailed += !check(readAll(data, uri, "v1", &log),
+		    "data after a damaged record is wrong");
+  nFailed += !check(!log.empty() && !covers(log, 0, CachedFileChunkSize) &&
+		    covers(log, data->getLength() - 100, 100),
+		    "only the records after the damaged one should be requested");
+  nFailed += !check(readAll(data, uri, "v1", &log) && log.empty(),
+		    "store was not repaired");
+
+  // a new version of the document replaces the file
+  nFailed += !check(readAll(data, uri, "v2", &log),
+		    "new version is wrong");
+  nFailed += !check(covers(log, 0, data->getLength()),
+		    "new version was not requested");
+  nFailed += !check(readAll(data, uri, "v2", &log) && log.empty(),
+		    "new version was not stored");
+  listStore(dir, &nFiles);
+  nFailed += !check(nFiles == 1, "temporary files were left behind");
+
+  // the size limit holds while the file grows: older files are removed
+  // first, then the file stops growing
+  globalParams->setChunkCacheSize(5 * CachedFileChunkSize);
+  if ((f = fopen(path->getCString(), "wb"))) {
+    for (c = 0; c < 3 * CachedFileChunkSize; ++c) {
+      fputc(0, f);
+    }
+    fclose(f);
+  }
+  times.actime = times.modtime = 1000;
+  utime(path->getCString(), &times);
+  nFailed += !check(readAll(data, "http://localhost/other.pdf", "v1", &log),
+		    "data is wrong with a small store");
+  size = listStore(dir, &nFiles);
+  nFailed += !check(nFiles == 1 && access(path->getCString(), F_OK) != 0,
+		    "older file was not removed");
+  nFailed += !check(size > 0 && size < 6 * CachedFileChunkSize,
+		    "store grew over its limit");
+
+  // temporary files of other processes don't count toward the limit,
+  // and are only removed once they are old
+  tmpNew = path->copy()->append(".AAAAAA");
+  tmpOld = path->copy()->append(".BBBBBB");
+  for (c = 0; c < 2; ++c) {
+    if ((f = fopen((c ? tmpOld : tmpNew)->getCString(), "wb"))) {
+      fwrite(data->getCString(), 1, 8 * CachedFileChunkSize, f);
+      fclose(f);
+    }
+  }
+  utime(tmpOld->getCString(), &times);
+  nFailed += !check(readAll(data, "http://localhost/other.pdf", "v1", &log),
+		    "data is wrong with temporary files");
+  nFailed += !check(access(tmpNew->getCString(), F_OK) == 0,
+		    "new temporary file was removed");
+  nFailed += !check(access(tmpOld->getCString(), F_OK) != 0,
+		    "old temporary file was not removed");
+  remove(tmpNew->getCString());
+  delete tmpNew;
+  delete tmpOld;
+
+  // chunks stored by this process can be read back
+  dirStr = new GooString(dir);
+  uriStr = new GooString(uri);
+  validator = new GooString("v3");
+  if ((store = CachedFileStore::open(dirStr, uriStr, validator,
+				     data->getLength(), 1 << 20))) {
+    store->writeChunk(1, data->getCString(), CachedFileChunkSize);
+    store->writeChunk(0, data->getCString() + CachedFileChunkSize,
+		      CachedFileChunkSize);
+    nFailed += !check(store->readChunk(0, buf) &&
+		      !memcmp(buf, data->getCString() + CachedFileChunkSize,
+			      CachedFileChunkSize) &&
+		      store->readChunk(1, buf) &&
+		      !memcmp(buf, data->getCString(), CachedFileChunkSize),
+		      "stored chunks read back wrong");
+    nFailed += !check(!store->readChunk(2, buf),
+		      "missing chunk was read");
+    delete store;
+  } else {
+    nFailed += !check(gFalse, "can't open the store");
+  }
+  delete dirStr;
+  delete uriStr;
+  delete validator;
+
+  globalParams->setChunkCacheDir(NULL);
+  removeDir(dir);
+  delete path;
+  delete data;
+  return nFailed;
+}
+
+//------------------------------------------------------------------------
+
+int main(int argc, char *argv[]) {
+  int nFailed;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  nFailed = 0;
+  nFailed += testPrefetch();
+  nFailed += testRangeLength(-100);
+  nFailed += testRangeLength(100);
+  nFailed += testStore();
+  delete globalParams;
+
+  printf("%d failed\n", nFailed);
+  return nFailed ? 1 : 0;
+}
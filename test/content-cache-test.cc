@@ -0,0 +1,161 @@
+//========================================================================
+//
+// content-cache-test.cc
+//
+// Renders a page that draws the same Form XObject many times, with
+// and without the compiled content cache, and checks that the output
+// is the same, including when the page is rendered a second time from
+// the cache.  With -bench, also times the renderings.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "splash/SplashBitmap.h"
+#include "test-pdf.h"
+
+//------------------------------------------------------------------------
+
+// A page that draws a form made of <nRects> small rectangles, <nCopies>
+// times.
+static GooString *makeDoc(int nRects, int nCopies) {
+  GooString *objs[5], *content, *form, *pdf;
+  char buf[128];
+  int i;
+
+  form = new GooString();
+  for (i = 0; i < nRects; ++i) {
+    sprintf(buf, "%g %g %g rg %d %d 3 2 re f\n",
+	    (i % 7) / 7.0, (i % 11) / 11.0, (i % 13) / 13.0,
+	    (i * 7) % 40, (i * 3) % 40);
+    form->append(buf);
+  }
+  content = new GooString();
+  for (i = 0; i < nCopies; ++i) {
+    sprintf(buf, "q 1 0 0 1 %d %d cm /F Do Q\n",
+	    (i % 10) * 45, (i / 10) * 45);
+    content->append(buf);
+  }
+  objs[0] = new GooString("<< /Type /Catalog /Pages 2 0 R >>");
+  objs[1] = new GooString("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  objs[2] = new GooString("<< /Type /Page /Parent 2 0 R "
+			  "/MediaBox [0 0 450 450] "
+			  "/Resources << /XObject << /F 5 0 R >> >> "
+			  "/Contents 4 0 R >>");
+  objs[3] = testPDFStream("", content);
+  objs[4] = testPDFStream("/Type /XObject /Subtype /Form "
+			  "/BBox [0 0 45 45]", form);
+  pdf = testPDFFile(objs, 5);
+  for (i = 0; i < 5; ++i) {
+    delete objs[i];
+  }
+  delete content;
+  delete form;
+  return pdf;
+}
+
+// Render page 1 of <doc> and return a copy of the bitmap.
+static SplashBitmap *render(PDFDoc *doc) {
+  SplashOutputDev *out;
+  SplashBitmap *bitmap;
+  SplashColor paper;
+
+  paper[0] = paper[1] = paper[2] = 0xff;
+  out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paper);
+  out->startDoc(doc->getXRef());
+  doc->displayPage(out, 1, 72, 72, 0, gFalse, gTrue, gFalse);
+  bitmap = out->takeBitmap();
+  delete out;
+  return bitmap;
+}
+
+static GBool sameBitmap(SplashBitmap *b1, SplashBitmap *b2) {
+  return b1->getWidth() == b2->getWidth() &&
+         b1->getHeight() == b2->getHeight() &&
+         b1->getRowSize() == b2->getRowSize() &&
+         !memcmp(b1->getDataPtr(), b2->getDataPtr(),
+		 b1->getRowSize() * b1->getHeight());
+}
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+// Best time, in milliseconds, of rendering the page <nRuns> times,
+// with the content cache on or off.
+static double benchmark(GooString *pdf, GBool cache, int nRuns) {
+  PDFDoc *doc;
+  GooTimer timer;
+  double t, best;
+  int run;
+
+  globalParams->setCacheContentStreams(cache);
+  doc = testPDFOpen(pdf);
+  best = 0;
+  for (run = 0; run < nRuns; ++run) {
+    timer.start();
+    delete render(doc);
+    timer.stop();
+    t = timer.getElapsed() * 1000;
+    if (run == 0 || t < best) {
+      best = t;
+    }
+  }
+  delete doc;
+  return best;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *pdf;
+  PDFDoc *doc;
+  SplashBitmap *ref, *first, *second;
+  double tOff, tOn;
+  int nFailed;
+
+  globalParams = new GlobalParams();
+  nFailed = 0;
+  pdf = makeDoc(200, 100);
+
+  globalParams->setCacheContentStreams(gFalse);
+  doc = testPDFOpen(pdf);
+  ref = render(doc);
+  delete doc;
+
+  globalParams->setCacheContentStreams(gTrue);
+  doc = testPDFOpen(pdf);
+  first = render(doc);
+  second = render(doc);
+  delete doc;
+
+  nFailed += !check(sameBitmap(ref, first),
+		    "first cached rendering differs");
+  nFailed += !check(sameBitmap(ref, second),
+		    "rendering from the cache differs");
+  delete ref;
+  delete first;
+  delete second;
+  printf("%d failed\n", nFailed);
+
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    tOff = benchmark(pdf, gFalse, 10);
+    tOn = benchmark(pdf, gTrue, 10);
+    printf("no cache: %7.1f ms\n", tOff);
+    printf("cache:    %7.1f ms (%.0f%% less)\n",
+	   tOn, 100 * (tOff - tOn) / tOff);
+  }
+
+  delete pdf;
+  delete globalParams;
+  return nFailed ? 1 : 0;
+}
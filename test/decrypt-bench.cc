@@ -0,0 +1,99 @@
+//========================================================================
+//
+// decrypt-bench.cc
+//
+// Measures the throughput of DecryptStream for RC4 and AES, reading
+// one character at a time and in bulk through getChars.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "goo/gmem.h"
+#include "goo/GooTimer.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Decrypt.h"
+
+static Guint checksum(Guint sum, Guchar *buf, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    sum = sum * 31 + buf[i];
+  }
+  return sum;
+}
+
+static double runBench(char *data, int len, CryptAlgorithm algo,
+		       GBool bulk, Guint *sum, int *nRead) {
+  Guchar fileKey[16], buf[8192];
+  DecryptStream *str;
+  GooTimer timer;
+  Object dict;
+  int c, n, i;
+
+  for (i = 0; i < 16; ++i) {
+    fileKey[i] = (Guchar)(i * 17 + 3);
+  }
+  dict.initNull();
+  str = new DecryptStream(new MemStream(data, 0, len, &dict),
+			  fileKey, algo, 16, 12, 0);
+  *sum = 0;
+  *nRead = 0;
+  timer.start();
+  str->reset();
+  if (bulk) {
+    while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+      *sum = checksum(*sum, buf, n);
+      *nRead += n;
+    }
+  } else {
+    while ((c = str->getChar()) != EOF) {
+      buf[0] = (Guchar)c;
+      *sum = checksum(*sum, buf, 1);
+      ++*nRead;
+    }
+  }
+  timer.stop();
+  delete str;
+  return timer.getElapsed();
+}
+
+int main(int argc, char *argv[]) {
+  static const char *algoNames[2] = { "RC4", "AES" };
+  static const CryptAlgorithm algos[2] = { cryptRC4, cryptAES };
+  char *data;
+  Guint seed, sum;
+  double secs;
+  int len, nRead, a, bulk, i;
+
+  len = (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+  if (len <= 0) {
+    fprintf(stderr, "usage: %s [MEGABYTES]\n", argv[0]);
+    return 1;
+  }
+
+  // fill the input with a fixed pseudo-random pattern, so that the
+  // checksums can be compared between builds
+  data = (char *)gmalloc(len);
+  seed = 1;
+  for (i = 0; i < len; ++i) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (char)(seed >> 16);
+  }
+
+  for (a = 0; a < 2; ++a) {
+    for (bulk = 0; bulk < 2; ++bulk) {
+      secs = runBench(data, len, algos[a], bulk, &sum, &nRead);
+      printf("%s %-8s %8d bytes  %8.1f MB/s  checksum %08x\n",
+	     algoNames[a], bulk ? "getChars" : "getChar", nRead,
+	     secs > 0 ? nRead / (secs * 1024 * 1024) : 0.0, sum);
+    }
+  }
+
+  gfree(data);
+  return 0;
+}
@@ -0,0 +1,277 @@
+//========================================================================
+//
+// halftone-test.cc
+//
+// Checks SplashScreen::testRow and SplashHalftone against
+// SplashScreen::test, checks that error diffusion does not depend on
+// the number of threads and keeps the average gray level, and
+// measures halftoning throughput.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooTimer.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashScreen.h"
+#include "splash/SplashHalftone.h"
+
+//------------------------------------------------------------------------
+
+static Guint seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (Guint)n);
+}
+
+static SplashScreenParams makeParams(SplashScreenType type, int size,
+				     int dotRadius) {
+  SplashScreenParams params;
+
+  params.type = type;
+  params.size = size;
+  params.dotRadius = dotRadius;
+  params.gamma = 1.0;
+  params.blackThreshold = 0.0;
+  params.whiteThreshold = 1.0;
+  return params;
+}
+
+// Fill <bitmap> with random gray levels, smooth gradients, or flat
+// gray.
+static void fillGray(SplashBitmap *bitmap, int pattern) {
+  Guchar *p;
+  int x, y;
+
+  for (y = 0; y < bitmap->getHeight(); ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    for (x = 0; x < bitmap->getWidth(); ++x) {
+      switch (pattern) {
+      case 0:
+	p[x] = (Guchar)rnd(256);
+	break;
+      case 1:
+	p[x] = (Guchar)((x + y) & 0xff);
+	break;
+      default:
+	p[x] = (Guchar)pattern;
+	break;
+      }
+    }
+  }
+}
+
+static GBool checkScreen(SplashScreenParams *params, int w, int h,
+			 GBool topDown, int nThreads) {
+  SplashBitmap *src, *dest;
+  SplashScreen *screen;
+  SplashHalftone *halftone;
+  Guchar *in, *out, *row;
+  int x, y, bit, pattern;
+  GBool ok;
+
+  screen = new SplashScreen(params);
+  src = new SplashBitmap(w, h, 1, splashModeMono8, gFalse, topDown);
+  dest = new SplashBitmap(w, h, 1, splashModeMono1, gFalse, topDown);
+  row = (Guchar *)gmalloc((w + 7) >> 3);
+  halftone = new SplashHalftone(splashHalftoneScreen, params, nThreads);
+  ok = gTrue;
+  for (pattern = 0; pattern < 3 && ok; ++pattern) {
+    fillGray(src, pattern == 2 ? rnd(256) : pattern);
+    halftone->halftone(src, dest);
+    for (y = 0; y < h && ok; ++y) {
+      in = src->getDataPtr() + y * src->getRowSize();
+      out = dest->getDataPtr() + y * dest->getRowSize();
+      screen->testRow(y, in, row, w);
+      for (x = 0; x < ((w + 7) & ~7); ++x) {
+	bit = x < w ? screen->test(x, y, in[x]) : 1;
+	if (((row[x >> 3] >> (7 - (x & 7))) & 1) != bit ||
+	    ((out[x >> 3] >> (7 - (x & 7))) & 1) != bit) {
+	  fprintf(stderr, "FAIL: screen type %d size %d, %dx%d, %d threads: "
+		  "pixel (%d, %d)\n",
+		  params->type, params->size, w, h, nThreads, x, y);
+	  ok = gFalse;
+	  break;
+	}
+      }
+    }
+  }
+  delete halftone;
+  gfree(row);
+  delete src;
+  delete dest;
+  delete screen;
+  return ok;
+}
+
+static GBool checkDiffusion(int w, int h, int pattern) {
+  SplashBitmap *src, *dest1, *dest2;
+  SplashHalftone *halftone;
+  Guchar *p;
+  double sum, white;
+  int x, y, rowBytes;
+  GBool ok;
+
+  src = new SplashBitmap(w, h, 1, splashModeMono8, gFalse, gTrue);
+  dest1 = new SplashBitmap(w, h, 1, splashModeMono1, gFalse, gTrue);
+  dest2 = new SplashBitmap(w, h, 1, splashModeMono1, gFalse, gTrue);
+  fillGray(src, pattern);
+  halftone = new SplashHalftone(splashHalftoneDiffusion, NULL, 1);
+  halftone->halftone(src, dest1);
+  delete halftone;
+  halftone = new SplashHalftone(splashHalftoneDiffusion, NULL, 3);
+  halftone->halftone(src, dest2);
+  delete halftone;
+
+  ok = gTrue;
+  rowBytes = (w + 7) >> 3;
+  for (y = 0; y < h; ++y) {
+    if (memcmp(dest1->getDataPtr() + y * dest1->getRowSize(),
+	       dest2->getDataPtr() + y * dest2->getRowSize(), rowBytes)) {
+      fprintf(stderr, "FAIL: diffusion %dx%d: row %d depends on the number "
+	      "of threads\n", w, h, y);
+      ok = gFalse;
+      break;
+    }
+  }
+
+  // the share of white pixels should match the average gray level
+  sum = white = 0;
+  for (y = 0; y < h; ++y) {
+    p = src->getDataPtr() + y * src->getRowSize();
+    for (x = 0; x < w; ++x) {
+      sum += p[x];
+    }
+    p = dest1->getDataPtr() + y * dest1->getRowSize();
+    for (x = 0; x < w; ++x) {
+      white += (p[x >> 3] >> (7 - (x & 7))) & 1;
+    }
+  }
+  if (white / (w * h) - sum / (255.0 * w * h) > 0.01 ||
+      white / (w * h) - sum / (255.0 * w * h) < -0.01) {
+    fprintf(stderr, "FAIL: diffusion %dx%d pattern %d: %.3f white, "
+	    "expected %.3f\n", w, h, pattern, white / (w * h),
+	    sum / (255.0 * w * h));
+    ok = gFalse;
+  }
+
+  delete src;
+  delete dest1;
+  delete dest2;
+  return ok;
+}
+
+// Halftone <src> into <dest> once, with <halftone>, or with
+// <screen> one pixel at a time, and return the time it took.
+static double timeHalftone(SplashHalftone *halftone, SplashScreen *screen,
+			   SplashBitmap *src, SplashBitmap *dest) {
+  GooTimer timer;
+  Guchar *in, *out;
+  int x, y;
+
+  timer.start();
+  if (screen) {
+    // what the splashModeMono1 pipe does for each pixel
+    for (y = 0; y < src->getHeight(); ++y) {
+      in = src->getDataPtr() + y * src->getRowSize();
+      out = dest->getDataPtr() + y * dest->getRowSize();
+      for (x = 0; x < src->getWidth(); ++x) {
+	if (screen->test(x, y, in[x])) {
+	  out[x >> 3] |= 0x80 >> (x & 7);
+	} else {
+	  out[x >> 3] &= ~(0x80 >> (x & 7));
+	}
+      }
+    }
+  } else {
+    halftone->halftone(src, dest);
+  }
+  timer.stop();
+  return timer.getElapsed();
+}
+
+// Throughput in megapixels per second for a letter page at 300 dpi,
+// best of three runs.
+static double benchmark(SplashHalftoneMethod method, GBool perPixel) {
+  SplashScreenParams params;
+  SplashBitmap *src, *dest;
+  SplashHalftone *halftone;
+  SplashScreen *screen;
+  double t, best;
+  int w, h, run;
+
+  w = 2550;
+  h = 3300;
+  params = makeParams(splashScreenStochasticClustered, 100, 2);
+  src = new SplashBitmap(w, h, 4, splashModeMono8, gFalse, gTrue);
+  dest = new SplashBitmap(w, h, 4, splashModeMono1, gFalse, gTrue);
+  fillGray(src, 1);
+  halftone = new SplashHalftone(method, &params, 1);
+  screen = NULL;
+  if (perPixel) {
+    screen = new SplashScreen(&params);
+    screen->isStatic(0);
+  }
+  best = 0;
+  for (run = 0; run < 3; ++run) {
+    t = timeHalftone(halftone, screen, src, dest);
+    if (run == 0 || t < best) {
+      best = t;
+    }
+  }
+  delete halftone;
+  delete screen;
+  delete src;
+  delete dest;
+  return (double)w * h / (best * 1000000);
+}
+
+int main(int argc, char *argv[]) {
+  static const int sizes[6] = { 2, 4, 6, 10, 16, 100 };
+  SplashScreenParams params;
+  int nCases, nFailed, type, i, w;
+
+  // correctness
+  nCases = nFailed = 0;
+  for (type = 0; type < 3; ++type) {
+    for (i = 0; i < 6; ++i) {
+      params = makeParams((SplashScreenType)type, sizes[i], 2);
+      for (w = 1; w <= 70; w += 1 + rnd(4)) {
+	++nCases;
+	if (!checkScreen(&params, w, 1 + rnd(20), rnd(2), 1)) {
+	  ++nFailed;
+	}
+      }
+      ++nCases;
+      if (!checkScreen(&params, 300 + rnd(100), 600 + rnd(100), rnd(2),
+		       3)) {
+	++nFailed;
+      }
+    }
+  }
+  for (i = 0; i < 4; ++i) {
+    ++nCases;
+    if (!checkDiffusion(200 + rnd(300), 700 + rnd(300),
+			i == 0 ? 0 : i == 1 ? 1 : 20 + rnd(200))) {
+      ++nFailed;
+    }
+  }
+  printf("%d cases, %d failed\n", nCases, nFailed);
+
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    printf("screen, per pixel: %7.1f Mpixels/s\n",
+	   benchmark(splashHalftoneScreen, gTrue));
+    printf("screen, by rows:   %7.1f Mpixels/s\n",
+	   benchmark(splashHalftoneScreen, gFalse));
+    printf("error diffusion:   %7.1f Mpixels/s\n",
+	   benchmark(splashHalftoneDiffusion, gFalse));
+  }
+
+  return nFailed ? 1 : 0;
+}
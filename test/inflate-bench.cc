@@ -0,0 +1,104 @@
+//========================================================================
+//
+// inflate-bench.cc
+//
+// Measures flate decoding throughput: decodes every stream of a
+// document whose outermost filter is FlateDecode, a number of times,
+// one character at a time and in bulk through getChars.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "XRef.h"
+#include "PDFDoc.h"
+
+static Guint checksum(Guint sum, Guchar *buf, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    sum = sum * 31 + buf[i];
+  }
+  return sum;
+}
+
+static double runBench(XRef *xref, int nRuns, GBool bulk,
+		       Guint *sum, double *nBytes, int *nStreams) {
+  Guchar buf[8192];
+  GooTimer timer;
+  Object obj;
+  Stream *str;
+  int run, c, n, i;
+
+  *sum = 0;
+  *nBytes = 0;
+  *nStreams = 0;
+  timer.start();
+  for (run = 0; run < nRuns; ++run) {
+    for (i = 0; i < xref->getNumObjects(); ++i) {
+      xref->fetch(i, 0, &obj);
+      if (obj.isStream() && obj.getStream()->getKind() == strFlate) {
+	str = obj.getStream();
+	str->reset();
+	if (bulk) {
+	  while ((n = str->doGetChars(sizeof(buf), buf)) > 0) {
+	    *sum = checksum(*sum, buf, n);
+	    *nBytes += n;
+	  }
+	} else {
+	  while ((c = str->getChar()) != EOF) {
+	    buf[0] = (Guchar)c;
+	    *sum = checksum(*sum, buf, 1);
+	    *nBytes += 1;
+	  }
+	}
+	str->close();
+	++*nStreams;
+      }
+      obj.free();
+    }
+  }
+  timer.stop();
+  return timer.getElapsed();
+}
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc;
+  Guint sum;
+  double secs, nBytes;
+  int nRuns, nStreams, bulk;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s PDF-FILE [RUNS]\n", argv[0]);
+    return 1;
+  }
+  nRuns = argc > 2 ? atoi(argv[2]) : 10;
+
+  globalParams = new GlobalParams();
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+
+  for (bulk = 0; bulk < 2; ++bulk) {
+    secs = runBench(doc->getXRef(), nRuns, bulk, &sum, &nBytes, &nStreams);
+    printf("%-8s %6d streams %12.0f bytes  %8.1f MB/s  checksum %08x\n",
+	   bulk ? "getChars" : "getChar", nStreams, nBytes,
+	   secs > 0 ? nBytes / (secs * 1024 * 1024) : 0.0, sum);
+  }
+
+  delete doc;
+  delete globalParams;
+  return 0;
+}
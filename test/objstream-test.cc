@@ -0,0 +1,216 @@
+//========================================================================
+//
+// objstream-test.cc
+//
+// Fetches the objects of documents written with many object streams,
+// in sequential, strided and scattered orders, and checks each of
+// them.  The cache of object streams has to evict and reload streams
+// along the way, both because there are more streams than it holds and
+// because they use more memory than it allows.  With -bench, also
+// times the fetches on a large document.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "XRef.h"
+#include "PDFDoc.h"
+#include "test-pdf.h"
+
+//------------------------------------------------------------------------
+
+// Objects 1 and 2 are the catalog and the page tree, objects 3 to
+// nStreams + 2 are the object streams, and the <perStream> objects of
+// each stream follow.  The xref stream comes last.  Each object is a
+// dictionary holding its number, padded with a string of <padding>
+// bytes.
+static int firstObj(int nStreams) {
+  return 3 + nStreams;
+}
+
+static GooString *makeDoc(int nStreams, int perStream, int padding) {
+  GooString *pdf, *header, *body, *xref, *pad;
+  char buf[128];
+  int *offsets;
+  int nObjs, xrefNum, s, k, num, i;
+
+  nObjs = firstObj(nStreams) + nStreams * perStream;
+  xrefNum = nObjs;
+  offsets = (int *)gmallocn(nObjs + 1, sizeof(int));
+  pad = new GooString();
+  for (i = 0; i < padding; ++i) {
+    pad->append('x');
+  }
+
+  pdf = new GooString("%PDF-1.5\n");
+  offsets[1] = pdf->getLength();
+  pdf->append("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+  offsets[2] = pdf->getLength();
+  pdf->append("2 0 obj\n<< /Type /Pages /Kids [] /Count 0 >>\nendobj\n");
+  for (s = 0; s < nStreams; ++s) {
+    header = new GooString();
+    body = new GooString();
+    for (k = 0; k < perStream; ++k) {
+      num = firstObj(nStreams) + s * perStream + k;
+      sprintf(buf, "%d %d ", num, body->getLength());
+      header->append(buf);
+      sprintf(buf, "<< /N %d /P (", num);
+      body->append(buf);
+      body->append(pad);
+      body->append(") >>\n");
+    }
+    offsets[3 + s] = pdf->getLength();
+    sprintf(buf, "%d 0 obj\n<< /Type /ObjStm /N %d /First %d /Length %d >>\n"
+	    "stream\n", 3 + s, perStream, header->getLength(),
+	    header->getLength() + body->getLength());
+    pdf->append(buf);
+    pdf->append(header);
+    pdf->append(body);
+    pdf->append("\nendstream\nendobj\n");
+    delete header;
+    delete body;
+  }
+
+  // xref stream, with /W [1 4 2]
+  xref = new GooString();
+  for (num = 0; num <= xrefNum; ++num) {
+    Guint f1, f2, f3;
+    if (num == 0) {
+      f1 = 0; f2 = 0; f3 = 0xffff;
+    } else if (num < firstObj(nStreams)) {
+      f1 = 1; f2 = offsets[num]; f3 = 0;
+    } else if (num < xrefNum) {
+      f1 = 2;
+      f2 = 3 + (num - firstObj(nStreams)) / perStream;
+      f3 = (num - firstObj(nStreams)) % perStream;
+    } else {
+      f1 = 1; f2 = pdf->getLength(); f3 = 0;
+    }
+    xref->append((char)f1);
+    for (i = 24; i >= 0; i -= 8) {
+      xref->append((char)(f2 >> i));
+    }
+    xref->append((char)(f3 >> 8));
+    xref->append((char)f3);
+  }
+  offsets[0] = pdf->getLength();
+  sprintf(buf, "%d 0 obj\n<< /Type /XRef /Size %d /W [1 4 2] /Root 1 0 R "
+	  "/Length %d >>\nstream\n", xrefNum, xrefNum + 1, xref->getLength());
+  pdf->append(buf);
+  pdf->append(xref);
+  sprintf(buf, "\nendstream\nendobj\nstartxref\n%d\n%%%%EOF\n", offsets[0]);
+  pdf->append(buf);
+
+  delete xref;
+  delete pad;
+  gfree(offsets);
+  return pdf;
+}
+
+// Fetch object <num> and check that it is the right one.
+static GBool fetchObj(XRef *xref, int num) {
+  Object obj, obj2;
+  GBool ok;
+
+  xref->fetch(num, 0, &obj);
+  ok = obj.isDict() && obj.dictLookup("N", &obj2)->isInt() &&
+       obj2.getInt() == num;
+  obj2.free();
+  obj.free();
+  return ok;
+}
+
+// Fetch every object in the streams of <doc>, in the given order:
+// 0 = sequential, 1 = strided (the k-th object of each stream in
+// turn), 2 = scattered.  Returns the number of wrong objects.
+static int fetchAll(PDFDoc *doc, int nStreams, int perStream, int order) {
+  XRef *xref;
+  int n, i, num, nBad;
+  Guint x;
+
+  xref = doc->getXRef();
+  n = nStreams * perStream;
+  nBad = 0;
+  x = 12345;
+  for (i = 0; i < n; ++i) {
+    if (order == 0) {
+      num = i;
+    } else if (order == 1) {
+      num = (i % nStreams) * perStream + i / nStreams;
+    } else {
+      x = x * 1103515245 + 12345;
+      num = (x >> 8) % n;
+    }
+    if (!fetchObj(xref, firstObj(nStreams) + num)) {
+      ++nBad;
+    }
+  }
+  return nBad;
+}
+
+static int checkDoc(int nStreams, int perStream, int padding,
+		    const char *what) {
+  GooString *pdf;
+  PDFDoc *doc;
+  int order, nFailed;
+
+  nFailed = 0;
+  pdf = makeDoc(nStreams, perStream, padding);
+  doc = testPDFOpen(pdf);
+  if (!doc->isOk()) {
+    fprintf(stderr, "FAIL: %s: document doesn't open\n", what);
+    ++nFailed;
+  } else {
+    for (order = 0; order < 3; ++order) {
+      if (fetchAll(doc, nStreams, perStream, order)) {
+	fprintf(stderr, "FAIL: %s: wrong objects in order %d\n", what, order);
+	++nFailed;
+      }
+    }
+  }
+  delete doc;
+  delete pdf;
+  return nFailed;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *pdf;
+  PDFDoc *doc;
+  GooTimer timer;
+  int order, nFailed;
+
+  globalParams = new GlobalParams();
+  nFailed = 0;
+
+  // more streams than the cache holds
+  nFailed += checkDoc(1100, 5, 0, "many streams");
+  // streams that use more memory than the cache allows
+  nFailed += checkDoc(40, 4, 60000, "large streams");
+  printf("%d failed\n", nFailed);
+
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    pdf = makeDoc(600, 100, 0);
+    doc = testPDFOpen(pdf);
+    for (order = 0; order < 3; ++order) {
+      timer.start();
+      fetchAll(doc, 600, 100, order);
+      timer.stop();
+      printf("%s: %7.1f ms\n",
+	     order == 0 ? "sequential" : order == 1 ? "strided   "
+	                                            : "scattered ",
+	     timer.getElapsed() * 1000);
+    }
+    delete doc;
+    delete pdf;
+  }
+
+  delete globalParams;
+  return nFailed ? 1 : 0;
+}
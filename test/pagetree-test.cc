@@ -0,0 +1,187 @@
+//========================================================================
+//
+// pagetree-test.cc
+//
+// Loads the pages of documents in reverse and scattered orders, which
+// makes Catalog descend the page tree with the /Count entries, and
+// checks that they are the same pages as in a sequential walk of the
+// tree.  One of the documents has an intermediate node with a wrong
+// /Count, which must not leave a wrong page behind once the sequential
+// walk has seen it.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "test-pdf.h"
+
+//------------------------------------------------------------------------
+
+// Each page is identified by the width of its MediaBox, which is
+// 100 + its page number.
+static GooString *makePage(int parent, int page) {
+  GooString *obj;
+  char buf[128];
+
+  sprintf(buf, "<< /Type /Page /Parent %d 0 R /MediaBox [0 0 %d 100] >>",
+	  parent, 100 + page);
+  obj = new GooString(buf);
+  return obj;
+}
+
+// A tree of <nNodes> Pages nodes below the root, each holding
+// <perNode> pages.
+static GooString *makeTree(int nNodes, int perNode) {
+  GooString **objs, *kids, *pdf;
+  char buf[64];
+  int nObjs, i, j, obj;
+
+  nObjs = 2 + nNodes * (1 + perNode);
+  objs = (GooString **)gmallocn(nObjs, sizeof(GooString *));
+  objs[0] = new GooString("<< /Type /Catalog /Pages 2 0 R >>");
+  kids = new GooString();
+  for (i = 0; i < nNodes; ++i) {
+    sprintf(buf, "%d 0 R ", 3 + i * (1 + perNode));
+    kids->append(buf);
+  }
+  sprintf(buf, "] /Count %d >>", nNodes * perNode);
+  objs[1] = new GooString("<< /Type /Pages /Kids [");
+  objs[1]->append(kids)->append(buf);
+  delete kids;
+  for (i = 0; i < nNodes; ++i) {
+    obj = 3 + i * (1 + perNode);
+    kids = new GooString();
+    for (j = 0; j < perNode; ++j) {
+      sprintf(buf, "%d 0 R ", obj + 1 + j);
+      kids->append(buf);
+      objs[obj + j] = makePage(obj, 1 + i * perNode + j);
+    }
+    sprintf(buf, "] /Count %d >>", perNode);
+    objs[obj - 1] = new GooString("<< /Type /Pages /Parent 2 0 R /Kids [");
+    objs[obj - 1]->append(kids)->append(buf);
+    delete kids;
+  }
+  pdf = testPDFFile(objs, nObjs);
+  for (i = 0; i < nObjs; ++i) {
+    delete objs[i];
+  }
+  gfree(objs);
+  return pdf;
+}
+
+// Three pages under two nodes; the first node holds pages 1 and 2 but
+// claims to hold only one, so that a lookup of page 2 through the
+// /Count entries lands on page 3.  The total count is right.
+static GooString *makeBadCount() {
+  GooString *objs[7], *pdf;
+  int i;
+
+  objs[0] = new GooString("<< /Type /Catalog /Pages 2 0 R >>");
+  objs[1] = new GooString("<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 3 >>");
+  objs[2] = new GooString("<< /Type /Pages /Parent 2 0 R "
+			  "/Kids [5 0 R 6 0 R] /Count 1 >>");
+  objs[3] = new GooString("<< /Type /Pages /Parent 2 0 R "
+			  "/Kids [7 0 R] /Count 1 >>");
+  objs[4] = makePage(3, 1);
+  objs[5] = makePage(3, 2);
+  objs[6] = makePage(4, 3);
+  pdf = testPDFFile(objs, 7);
+  for (i = 0; i < 7; ++i) {
+    delete objs[i];
+  }
+  return pdf;
+}
+
+// Check that page <page> of <doc> is the right one.
+static GBool checkPage(PDFDoc *doc, int page) {
+  Catalog *catalog;
+  Page *p;
+  Ref *ref;
+
+  catalog = doc->getCatalog();
+  p = catalog->getPage(page);
+  ref = catalog->getPageRef(page);
+  return p && ref && p->getNum() == page &&
+         (int)p->getMediaWidth() == 100 + page &&
+         catalog->findPage(ref->num, ref->gen) == page;
+}
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+// Load the pages of <pdf> in reverse order, then in scattered order,
+// then check them all in order.
+static int checkTree(GooString *pdf, const char *what) {
+  PDFDoc *doc;
+  GBool ok;
+  int n, page, nFailed;
+  char msg[128];
+
+  nFailed = 0;
+  doc = testPDFOpen(pdf);
+  n = doc->getNumPages();
+  ok = gTrue;
+  for (page = n; page >= 1; --page) {
+    ok = checkPage(doc, page) && ok;
+  }
+  sprintf(msg, "%s: reverse order", what);
+  nFailed += !check(ok, msg);
+  delete doc;
+
+  doc = testPDFOpen(pdf);
+  for (page = 1; page <= n; ++page) {
+    doc->getCatalog()->getPage(1 + (page * 37) % n);
+  }
+  ok = gTrue;
+  for (page = 1; page <= n; ++page) {
+    ok = checkPage(doc, page) && ok;
+  }
+  sprintf(msg, "%s: scattered order", what);
+  nFailed += !check(ok, msg);
+  delete doc;
+  return nFailed;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *pdf;
+  PDFDoc *doc;
+  int nFailed;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  nFailed = 0;
+
+  pdf = makeTree(10, 10);
+  nFailed += checkTree(pdf, "balanced tree");
+  delete pdf;
+
+  pdf = makeBadCount();
+  nFailed += checkTree(pdf, "wrong /Count");
+  // once page 3 has made the catalog walk the tree, page 2 must be
+  // the real one, even though it was looked up with /Count first
+  doc = testPDFOpen(pdf);
+  doc->getCatalog()->getPage(2);
+  doc->getCatalog()->getPage(3);
+  nFailed += !check(checkPage(doc, 2), "wrong /Count: page 2 not replaced");
+  nFailed += !check(checkPage(doc, 3), "wrong /Count: page 3");
+  nFailed += !check(checkPage(doc, 1), "wrong /Count: page 1");
+  delete doc;
+  delete pdf;
+
+  delete globalParams;
+
+  printf("%d failed\n", nFailed);
+  return nFailed ? 1 : 0;
+}
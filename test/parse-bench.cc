@@ -0,0 +1,97 @@
+//========================================================================
+//
+// parse-bench.cc
+//
+// Measures object parsing speed: fetches every object of a document
+// and tokenizes every page content stream, a number of times.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "XRef.h"
+#include "Catalog.h"
+#include "Page.h"
+#include "PDFDoc.h"
+#include "NameTable.h"
+
+int main(int argc, char *argv[]) {
+  PDFDoc *doc;
+  XRef *xref;
+  Parser *parser;
+  GooTimer timer;
+  Object obj, contents;
+  double objSecs, contentSecs;
+  int nRuns, nObjs, nTokens, run, i;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s PDF-FILE [RUNS]\n", argv[0]);
+    return 1;
+  }
+  nRuns = argc > 2 ? atoi(argv[2]) : 10;
+
+  globalParams = new GlobalParams();
+  doc = new PDFDoc(new GooString(argv[1]));
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading document\n");
+    delete doc;
+    delete globalParams;
+    return 1;
+  }
+  xref = doc->getXRef();
+
+  // fetch every object
+  nObjs = 0;
+  timer.start();
+  for (run = 0; run < nRuns; ++run) {
+    for (i = 0; i < xref->getNumObjects(); ++i) {
+      xref->fetch(i, 0, &obj);
+      if (!obj.isNull()) {
+	++nObjs;
+      }
+      obj.free();
+    }
+  }
+  timer.stop();
+  objSecs = timer.getElapsed();
+
+  // tokenize the page content streams
+  nTokens = 0;
+  timer.start();
+  for (run = 0; run < nRuns; ++run) {
+    for (i = 1; i <= doc->getNumPages(); ++i) {
+      doc->getCatalog()->getPage(i)->getContents(&contents);
+      if (contents.isArray() || contents.isStream()) {
+	parser = new Parser(xref, new Lexer(xref, &contents), gFalse);
+	for (parser->getObj(&obj); !obj.isEOF(); parser->getObj(&obj)) {
+	  ++nTokens;
+	  obj.free();
+	}
+	obj.free();
+	delete parser;
+      }
+      contents.free();
+    }
+  }
+  timer.stop();
+  contentSecs = timer.getElapsed();
+
+  printf("objects:  %d fetched in %.3f s\n", nObjs, objSecs);
+  printf("contents: %d objects parsed in %.3f s\n", nTokens, contentSecs);
+  printf("names:    %d interned, %lu bytes\n",
+	 NameTable::getNumNames(), (unsigned long)NameTable::getBytesUsed());
+
+  delete doc;
+  delete globalParams;
+  return 0;
+}
@@ -0,0 +1,364 @@
+//========================================================================
+//
+// predictor-test.cc
+//
+// Checks StreamPredictor against a straightforward byte-at-a-time
+// implementation of the PNG and TIFF predictors, for many image
+// shapes and row filters, and measures decoding throughput.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooTimer.h"
+#include "Object.h"
+#include "Stream.h"
+
+//------------------------------------------------------------------------
+
+// A memory stream that can feed a StreamPredictor.
+class RawMemStream: public MemStream {
+public:
+
+  RawMemStream(char *bufA, Guint lengthA, Object *dictA):
+    MemStream(bufA, 0, lengthA, dictA) {}
+  virtual int getRawChar() { return getChar(); }
+  virtual int getRawChars(int nChars, Guchar *buffer)
+    { return doGetChars(nChars, buffer); }
+};
+
+static Guint seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (Guint)n);
+}
+
+//------------------------------------------------------------------------
+// reference implementation
+//------------------------------------------------------------------------
+
+static int refDecode(Guchar *data, int len, int predictor, int width,
+		     int nComps, int nBits, Guchar *out) {
+  Guchar *line, *prev;
+  int pixBytes, rowBytes, pos, nOut, curPred, n, c;
+  int left, up, upLeft, pa, pb, pc, i, j, k, kk, v;
+  int inBits, outBits, comp[32];
+  Gulong inBuf, outBuf, bitMask;
+
+  pixBytes = (nComps * nBits + 7) >> 3;
+  rowBytes = ((width * nComps * nBits + 7) >> 3) + pixBytes;
+  line = (Guchar *)gmalloc(rowBytes);
+  memset(line, 0, rowBytes);
+  prev = (Guchar *)gmalloc(rowBytes);
+  pos = nOut = 0;
+  while (1) {
+    if (predictor >= 10) {
+      if (pos >= len) {
+	break;
+      }
+      curPred = data[pos++] + 10;
+    } else {
+      curPred = predictor;
+    }
+    if (pos >= len) {
+      break;
+    }
+    n = rowBytes - pixBytes;
+    if (n > len - pos) {
+      n = len - pos;
+    }
+
+    // PNG predictors; bytes past a truncated row keep the values
+    // from the previous row
+    memcpy(prev, line, rowBytes);
+    for (i = pixBytes; i < pixBytes + n; ++i) {
+      c = data[pos++];
+      left = line[i - pixBytes];
+      up = prev[i];
+      upLeft = prev[i - pixBytes];
+      switch (curPred) {
+      case 11:
+	line[i] = (Guchar)(left + c);
+	break;
+      case 12:
+	line[i] = (Guchar)(up + c);
+	break;
+      case 13:
+	line[i] = (Guchar)(((left + up) >> 1) + c);
+	break;
+      case 14:
+	v = left + up - upLeft;
+	pa = abs(v - left);
+	pb = abs(v - up);
+	pc = abs(v - upLeft);
+	if (pa <= pb && pa <= pc)
+	  line[i] = (Guchar)(left + c);
+	else if (pb <= pc)
+	  line[i] = (Guchar)(up + c);
+	else
+	  line[i] = (Guchar)(upLeft + c);
+	break;
+      default:
+	line[i] = (Guchar)c;
+	break;
+      }
+    }
+
+    // TIFF predictor
+    if (predictor == 2) {
+      if (nBits == 1) {
+	inBuf = line[pixBytes - 1];
+	for (i = pixBytes; i < rowBytes; i += 8) {
+	  inBuf = (inBuf << 8) | line[i];
+	  line[i] ^= inBuf >> nComps;
+	}
+      } else if (nBits == 8) {
+	for (i = pixBytes; i < rowBytes; ++i) {
+	  line[i] += line[i - nComps];
+	}
+      } else if (nBits == 16) {
+	for (i = pixBytes; i + 1 < rowBytes; i += 2) {
+	  v = ((line[i - pixBytes] << 8) | line[i - pixBytes + 1]) +
+	      ((line[i] << 8) | line[i + 1]);
+	  line[i] = (Guchar)(v >> 8);
+	  line[i + 1] = (Guchar)v;
+	}
+      } else {
+	memset(comp, 0, sizeof(comp));
+	bitMask = (1 << nBits) - 1;
+	inBuf = outBuf = 0;
+	inBits = outBits = 0;
+	j = k = pixBytes;
+	for (i = 0; i < width; ++i) {
+	  for (kk = 0; kk < nComps; ++kk) {
+	    if (inBits < nBits) {
+	      inBuf = (inBuf << 8) | line[j++];
+	      inBits += 8;
+	    }
+	    comp[kk] = (int)((comp[kk] + (inBuf >> (inBits - nBits))) &
+			     bitMask);
+	    inBits -= nBits;
+	    outBuf = (outBuf << nBits) | comp[kk];
+	    outBits += nBits;
+	    if (outBits >= 8) {
+	      line[k++] = (Guchar)(outBuf >> (outBits - 8));
+	      outBits -= 8;
+	    }
+	  }
+	}
+	if (outBits > 0) {
+	  line[k++] = (Guchar)((outBuf << (8 - outBits)) +
+			       (inBuf & ((1 << (8 - outBits)) - 1)));
+	}
+      }
+    }
+
+    memcpy(out + nOut, line + pixBytes, rowBytes - pixBytes);
+    nOut += rowBytes - pixBytes;
+  }
+  gfree(line);
+  gfree(prev);
+  return nOut;
+}
+
+//------------------------------------------------------------------------
+
+static StreamPredictor *makePredictor(Guchar *data, int len, Object *dict,
+				      int predictor, int width, int nComps,
+				      int nBits, Stream **str) {
+  StreamPredictor *pred;
+
+  *str = new RawMemStream((char *)data, len, dict);
+  (*str)->reset();
+  pred = new StreamPredictor(*str, predictor, width, nComps, nBits);
+  if (!pred->isOk()) {
+    delete pred;
+    delete *str;
+    return NULL;
+  }
+  return pred;
+}
+
+// Decode <data> with StreamPredictor, reading it with getChar
+// (mode 0), getChars in random chunks (mode 1), or lookChar followed
+// by getChar (mode 2).
+static int predDecode(Guchar *data, int len, int predictor, int width,
+		      int nComps, int nBits, int mode, Guchar *out) {
+  StreamPredictor *pred;
+  Stream *str;
+  Object dict;
+  int n, m, c;
+
+  dict.initNull();
+  if (!(pred = makePredictor(data, len, &dict, predictor, width, nComps,
+			     nBits, &str))) {
+    return -1;
+  }
+  n = 0;
+  if (mode == 0) {
+    while ((c = pred->getChar()) != EOF) {
+      out[n++] = (Guchar)c;
+    }
+  } else if (mode == 1) {
+    while ((m = pred->getChars(1 + rnd(300), out + n)) > 0) {
+      n += m;
+    }
+  } else {
+    while ((c = pred->lookChar()) != EOF) {
+      if (pred->getChar() != c) {
+	n = -1;
+	break;
+      }
+      out[n++] = (Guchar)c;
+    }
+  }
+  delete pred;
+  delete str;
+  return n;
+}
+
+static GBool runCase(int predictor, int width, int nComps, int nBits,
+		     int nRows, GBool truncate) {
+  Guchar *data, *out1, *out2;
+  int pixBytes, rowLen, len, nRef, n, mode, row, i;
+  GBool ok;
+
+  pixBytes = (nComps * nBits + 7) >> 3;
+  rowLen = (width * nComps * nBits + 7) >> 3;
+  if (predictor >= 10) {
+    ++rowLen;
+  }
+  len = rowLen * nRows;
+  data = (Guchar *)gmalloc(len + 1);
+  for (row = 0; row < nRows; ++row) {
+    for (i = 0; i < rowLen; ++i) {
+      // mostly small differences, like real image data
+      data[row * rowLen + i] = (Guchar)(rnd(4) ? rnd(8) : rnd(256));
+    }
+    if (predictor >= 10) {
+      // row filter 0-4, occasionally an invalid one
+      data[row * rowLen] = (Guchar)(rnd(20) ? rnd(5) : 5 + rnd(250));
+    }
+  }
+  if (truncate) {
+    len -= 1 + rnd(rowLen);
+  }
+  out1 = (Guchar *)gmalloc(len + 2 * (rowLen + pixBytes) + 1);
+  out2 = (Guchar *)gmalloc(len + 2 * (rowLen + pixBytes) + 1);
+  nRef = refDecode(data, len, predictor, width, nComps, nBits, out1);
+
+  ok = gTrue;
+  for (mode = 0; mode < 3; ++mode) {
+    n = predDecode(data, len, predictor, width, nComps, nBits, mode, out2);
+    if (n != nRef || memcmp(out1, out2, n)) {
+      fprintf(stderr, "FAIL: predictor %d width %d comps %d bits %d "
+	      "rows %d%s mode %d: %d bytes, expected %d\n",
+	      predictor, width, nComps, nBits, nRows,
+	      truncate ? " (truncated)" : "", mode, n, nRef);
+      ok = gFalse;
+    }
+  }
+
+  gfree(data);
+  gfree(out1);
+  gfree(out2);
+  return ok;
+}
+
+static double benchmark(int predictor, int width, int nComps, int nBits,
+			int nRows, int filter, GBool ref) {
+  Guchar *data, *out;
+  StreamPredictor *pred;
+  Stream *str;
+  Object dict;
+  GooTimer timer;
+  int rowLen, len, row, i;
+
+  rowLen = (width * nComps * nBits + 7) >> 3;
+  if (predictor >= 10) {
+    ++rowLen;
+  }
+  len = rowLen * nRows;
+  data = (Guchar *)gmalloc(len);
+  for (row = 0; row < nRows; ++row) {
+    for (i = 0; i < rowLen; ++i) {
+      data[row * rowLen + i] = (Guchar)rnd(16);
+    }
+    if (predictor >= 10) {
+      data[row * rowLen] = (Guchar)filter;
+    }
+  }
+  out = (Guchar *)gmalloc(len + rowLen + 8);
+  dict.initNull();
+  timer.start();
+  if (ref) {
+    refDecode(data, len, predictor, width, nComps, nBits, out);
+  } else {
+    pred = makePredictor(data, len, &dict, predictor, width, nComps, nBits,
+			 &str);
+    while (pred->getChars(65536, out) > 0) ;
+    delete pred;
+    delete str;
+  }
+  timer.stop();
+  gfree(data);
+  gfree(out);
+  return len / (timer.getElapsed() * 1024 * 1024);
+}
+
+int main(int argc, char *argv[]) {
+  static const int bits[5] = { 1, 2, 4, 8, 16 };
+  static const char *filterNames[5] = { "none", "sub", "up", "avg", "paeth" };
+  int nCases, nFailed, predictor, nComps, b, width, i;
+
+  // correctness
+  nCases = nFailed = 0;
+  for (predictor = 2; predictor <= 15; ++predictor) {
+    if (predictor > 2 && predictor < 10) {
+      continue;
+    }
+    for (nComps = 1; nComps <= 5; ++nComps) {
+      for (b = 0; b < 5; ++b) {
+	for (width = 1; width <= 40; ++width) {
+	  for (i = 0; i < 2; ++i) {
+	    ++nCases;
+	    if (!runCase(predictor, width, nComps, bits[b], 1 + rnd(12),
+			 i == 1)) {
+	      ++nFailed;
+	    }
+	  }
+	}
+	++nCases;
+	if (!runCase(predictor, 999 + rnd(100), nComps, bits[b],
+		     1 + rnd(20), rnd(2))) {
+	  ++nFailed;
+	}
+      }
+    }
+  }
+  printf("%d cases, %d failed\n", nCases, nFailed);
+
+  // throughput of 8-bit and 16-bit RGB images, in MB of input per
+  // second, for StreamPredictor and for the reference implementation
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    for (b = 8; b <= 16; b += 8) {
+      for (i = 0; i < 5; ++i) {
+	printf("PNG %-5s %2d-bit RGB: %7.1f MB/s (reference %7.1f MB/s)\n",
+	       filterNames[i], b,
+	       benchmark(15, 2000, 3, b, 1000, i, gFalse),
+	       benchmark(15, 2000, 3, b, 1000, i, gTrue));
+      }
+      printf("TIFF      %2d-bit RGB: %7.1f MB/s (reference %7.1f MB/s)\n",
+	     b, benchmark(2, 2000, 3, b, 1000, 0, gFalse),
+	     benchmark(2, 2000, 3, b, 1000, 0, gTrue));
+    }
+  }
+
+  return nFailed ? 1 : 0;
+}
@@ -0,0 +1,522 @@
+//========================================================================
+//
+// psfont-test.cc
+//
+// Converts a document with three embedded TrueType fonts to
+// PostScript, two of which carry identical copies of one font
+// program, and checks that this program is embedded only once.  With
+// font subsetting on, the fonts embedded in the PostScript output are
+// rebuilt from their sfnts arrays and rendered glyph by glyph: the
+// glyphs drawn on the page, and the components of the composite ones,
+// must come out the same as from the original program, and the
+// others must be empty.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "PDFDoc.h"
+#include "PSOutputDev.h"
+#include "splash/SplashTypes.h"
+#include "splash/SplashBitmap.h"
+#include "splash/SplashPattern.h"
+#include "splash/Splash.h"
+#include "splash/SplashFontEngine.h"
+#include "splash/SplashFontFile.h"
+#include "splash/SplashFontFileID.h"
+#include "test-pdf.h"
+
+//------------------------------------------------------------------------
+
+// Glyphs 1 to 6 of the test fonts are rectangles of different widths,
+// glyph 7 is a composite of glyph 2, and glyph 0 is a wide rectangle.
+// Char codes 'A' to 'G' map to glyphs 1 to 7.
+#define nTestGlyphs 8
+#define compositeGlyph 7
+
+static void appendU16(GooString *s, int x) {
+  s->append((char)(x >> 8));
+  s->append((char)x);
+}
+
+static void appendU32(GooString *s, Guint x) {
+  appendU16(s, (int)(x >> 16));
+  appendU16(s, (int)(x & 0xffff));
+}
+
+static void pad4(GooString *s) {
+  while (s->getLength() & 3) {
+    s->append((char)0);
+  }
+}
+
+static Guint checksum(GooString *s) {
+  Guint sum;
+  int i;
+
+  sum = 0;
+  for (i = 0; i + 3 < s->getLength(); i += 4) {
+    sum += ((Guint)(s->getChar(i) & 0xff) << 24) |
+           ((s->getChar(i + 1) & 0xff) << 16) |
+           ((s->getChar(i + 2) & 0xff) << 8) |
+           (s->getChar(i + 3) & 0xff);
+  }
+  return sum;
+}
+
+static int glyphWidth(int gid, int step) {
+  return gid == 0 ? 400 : 100 + step * gid;
+}
+
+// A TrueType font program with the glyphs described above, whose
+// rectangles grow by <step> units from one glyph to the next.
+static GooString *makeTrueType(int step) {
+  GooString *tabs[7], *ttf;
+  const char *tags[7] = { "cmap", "glyf", "head", "hhea",
+			  "hmtx", "loca", "maxp" };
+  GooString *glyf, *loca, *hmtx, *cmap;
+  int gid, w, off, i;
+
+  // glyf and loca
+  glyf = new GooString();
+  loca = new GooString();
+  for (gid = 0; gid < nTestGlyphs; ++gid) {
+    appendU32(loca, glyf->getLength());
+    if (gid == compositeGlyph) {
+      appendU16(glyf, 0xffff);		// numberOfContours = -1
+      appendU16(glyf, 50);
+      appendU16(glyf, 0);
+      appendU16(glyf, 50 + glyphWidth(2, step));
+      appendU16(glyf, 700);
+      appendU16(glyf, 0x0003);		// word args, x/y offsets
+      appendU16(glyf, 2);
+      appendU16(glyf, 0);
+      appendU16(glyf, 0);
+    } else {
+      w = glyphWidth(gid, step);
+      appendU16(glyf, 1);
+      appendU16(glyf, 50);
+      appendU16(glyf, 0);
+      appendU16(glyf, 50 + w);
+      appendU16(glyf, 700);
+      appendU16(glyf, 3);		// endPtsOfContours
+      appendU16(glyf, 0);		// instructionLength
+      for (i = 0; i < 4; ++i) {
+	glyf->append((char)0x01);	// on curve, 16-bit deltas
+      }
+      appendU16(glyf, 50);
+      appendU16(glyf, 0);
+      appendU16(glyf, w);
+      appendU16(glyf, 0);
+      appendU16(glyf, 0);
+      appendU16(glyf, 700);
+      appendU16(glyf, 0);
+      appendU16(glyf, -700 & 0xffff);
+    }
+    pad4(glyf);
+  }
+  appendU32(loca, glyf->getLength());
+
+  hmtx = new GooString();
+  for (gid = 0; gid < nTestGlyphs; ++gid) {
+    appendU16(hmtx, 1000);
+    appendU16(hmtx, 50);
+  }
+
+  // a Mac Roman cmap, which symbolic fonts use with the char codes
+  cmap = new GooString();
+  appendU16(cmap, 0);
+  appendU16(cmap, 1);
+  appendU16(cmap, 1);
+  appendU16(cmap, 0);
+  appendU32(cmap, 12);
+  appendU16(cmap, 0);
+  appendU16(cmap, 262);
+  appendU16(cmap, 0);
+  for (i = 0; i < 256; ++i) {
+    cmap->append((char)(i >= 'A' && i < 'A' + nTestGlyphs - 1 ? i - 'A' + 1
+			                                      : 0));
+  }
+
+  tabs[0] = cmap;
+  tabs[1] = glyf;
+  tabs[2] = new GooString();		// head
+  appendU32(tabs[2], 0x00010000);
+  appendU32(tabs[2], 0x00010000);
+  appendU32(tabs[2], 0);
+  appendU32(tabs[2], 0x5f0f3cf5);
+  appendU16(tabs[2], 0);
+  appendU16(tabs[2], 1000);		// unitsPerEm
+  for (i = 0; i < 16; ++i) {
+    tabs[2]->append((char)0);
+  }
+  appendU16(tabs[2], 0);
+  appendU16(tabs[2], 0);
+  appendU16(tabs[2], 1000);
+  appendU16(tabs[2], 700);
+  appendU16(tabs[2], 0);
+  appendU16(tabs[2], 8);
+  appendU16(tabs[2], 2);
+  appendU16(tabs[2], 1);		// long loca
+  appendU16(tabs[2], 0);
+  tabs[3] = new GooString();		// hhea
+  appendU32(tabs[3], 0x00010000);
+  appendU16(tabs[3], 800);
+  appendU16(tabs[3], -200 & 0xffff);
+  appendU16(tabs[3], 0);
+  appendU16(tabs[3], 1000);
+  appendU16(tabs[3], 0);
+  appendU16(tabs[3], 0);
+  appendU16(tabs[3], 1000);
+  appendU16(tabs[3], 1);
+  for (i = 0; i < 7; ++i) {
+    appendU16(tabs[3], 0);
+  }
+  appendU16(tabs[3], nTestGlyphs);
+  tabs[4] = hmtx;
+  tabs[5] = loca;
+  tabs[6] = new GooString();		// maxp
+  appendU32(tabs[6], 0x00010000);
+  appendU16(tabs[6], nTestGlyphs);
+  appendU16(tabs[6], 4);
+  appendU16(tabs[6], 1);
+  appendU16(tabs[6], 4);
+  appendU16(tabs[6], 1);
+  appendU16(tabs[6], 2);
+  for (i = 0; i < 6; ++i) {
+    appendU16(tabs[6], 0);
+  }
+  appendU16(tabs[6], 1);
+  appendU16(tabs[6], 1);
+
+  ttf = new GooString();
+  appendU32(ttf, 0x00010000);
+  appendU16(ttf, 7);
+  appendU16(ttf, 64);
+  appendU16(ttf, 2);
+  appendU16(ttf, 7 * 16 - 64);
+  off = 12 + 7 * 16;
+  for (i = 0; i < 7; ++i) {
+    ttf->append(tags[i], 4);
+    appendU32(ttf, checksum(tabs[i]));
+    appendU32(ttf, off);
+    appendU32(ttf, tabs[i]->getLength());
+    off += (tabs[i]->getLength() + 3) & ~3;
+  }
+  for (i = 0; i < 7; ++i) {
+    ttf->append(tabs[i]);
+    pad4(ttf);
+    delete tabs[i];
+  }
+  return ttf;
+}
+
+//------------------------------------------------------------------------
+
+// Fonts A1 and A2 embed separate, identical copies of program A, and
+// font B embeds program B.  The page draws glyphs 1, 3 and 5 with
+// fonts A1 and A2 and the composite glyph with font A1, so program A
+// keeps glyphs 0, 1, 2, 3, 5 and 7; it draws glyph 4 with font B, so
+// program B keeps glyphs 0 and 4.
+static const char *usedA = "\1\1\1\1\0\1\0\1";
+static const char *usedB = "\1\0\0\0\1\0\0\0";
+
+static GooString *makeFont(const char *name, int descriptor) {
+  GooString *obj;
+  char buf[256];
+  int i;
+
+  sprintf(buf, "<< /Type /Font /Subtype /TrueType /BaseFont /%s "
+	  "/FirstChar 65 /LastChar %d /FontDescriptor %d 0 R /Widths [",
+	  name, 'A' + nTestGlyphs - 2, descriptor);
+  obj = new GooString(buf);
+  for (i = 1; i < nTestGlyphs; ++i) {
+    obj->append(" 1000");
+  }
+  obj->append(" ] >>");
+  return obj;
+}
+
+static GooString *makeDescriptor(const char *name, int fontFile) {
+  char buf[256];
+
+  sprintf(buf, "<< /Type /FontDescriptor /FontName /%s /Flags 4 "
+	  "/FontBBox [0 0 1000 700] /ItalicAngle 0 /Ascent 800 "
+	  "/Descent -200 /CapHeight 700 /StemV 80 /FontFile2 %d 0 R >>",
+	  name, fontFile);
+  return new GooString(buf);
+}
+
+static GooString *makeFontFile(GooString *ttf) {
+  char buf[32];
+
+  sprintf(buf, "/Length1 %d", ttf->getLength());
+  return testPDFStream(buf, ttf);
+}
+
+static GooString *makeDoc(GooString *ttfA, GooString *ttfB) {
+  GooString *objs[15], *content, *pdf;
+  int i;
+
+  objs[0] = new GooString("<< /Type /Catalog /Pages 2 0 R >>");
+  objs[1] = new GooString("<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+  objs[2] = new GooString("<< /Type /Page /Parent 2 0 R "
+			  "/MediaBox [0 0 300 100] "
+			  "/Resources << /Font << /F1 4 0 R /F2 5 0 R "
+			  "/F3 6 0 R >> >> /Contents 7 0 R >>");
+  objs[3] = makeFont("PSFontTestA", 8);
+  objs[4] = makeFont("PSFontTestA", 9);
+  objs[5] = makeFont("PSFontTestB", 10);
+  content = new GooString("BT /F1 20 Tf 10 10 Td (AG) Tj "
+			  "/F2 20 Tf (CE) Tj /F3 20 Tf (D) Tj ET");
+  objs[6] = testPDFStream("", content);
+  delete content;
+  objs[7] = makeDescriptor("PSFontTestA", 11);
+  objs[8] = makeDescriptor("PSFontTestA", 12);
+  objs[9] = makeDescriptor("PSFontTestB", 13);
+  objs[10] = makeFontFile(ttfA);
+  objs[11] = makeFontFile(ttfA);
+  objs[12] = makeFontFile(ttfB);
+  pdf = testPDFFile(objs, 13);
+  for (i = 0; i < 13; ++i) {
+    delete objs[i];
+  }
+  return pdf;
+}
+
+//------------------------------------------------------------------------
+
+static void outputToGooString(void *stream, char *data, int len) {
+  ((GooString *)stream)->append(data, len);
+}
+
+static GooString *convert(GooString *pdf, GBool subset) {
+  PDFDoc *doc;
+  PSOutputDev *psOut;
+  GooString *ps;
+
+  globalParams->setPSSubsetFonts(subset);
+  doc = testPDFOpen(pdf);
+  ps = new GooString();
+  psOut = new PSOutputDev(&outputToGooString, ps, NULL, doc,
+			  doc->getXRef(), doc->getCatalog(), 1, 1, psModePS);
+  if (psOut->isOk()) {
+    doc->displayPages(psOut, 1, 1, 72, 72, 0, gTrue, gFalse, gTrue);
+  }
+  delete psOut;
+  delete doc;
+  return ps;
+}
+
+// The number of font resources in <ps> whose name starts with
+// <name>.
+static int countFonts(GooString *ps, const char *name) {
+  char prefix[128];
+  char *p;
+  int n;
+
+  sprintf(prefix, "%%%%BeginResource: font %s", name);
+  n = 0;
+  for (p = strstr(ps->getCString(), prefix); p;
+       p = strstr(p + 1, prefix)) {
+    ++n;
+  }
+  return n;
+}
+
+static int hexDigit(char c) {
+  return c >= 'a' ? c - 'a' + 10 : c >= 'A' ? c - 'A' + 10 : c - '0';
+}
+
+// Rebuild the TrueType program of font <name> from its sfnts array
+// in <ps>.  Each string in the array carries an extra zero byte.
+static GooString *extractFont(GooString *ps, const char *name) {
+  GooString *ttf, *str;
+  char prefix[128];
+  char *p, *end;
+
+  sprintf(prefix, "%%%%BeginResource: font %s", name);
+  if (!(p = strstr(ps->getCString(), prefix)) ||
+      !(p = strstr(p, "/sfnts [")) ||
+      !(end = strstr(p, "] def"))) {
+    return NULL;
+  }
+  ttf = new GooString();
+  while ((p = strchr(p, '<')) && p < end) {
+    str = new GooString();
+    for (++p; *p != '>'; ++p) {
+      if (*p != '\n') {
+	str->append((char)((hexDigit(p[0]) << 4) | hexDigit(p[1])));
+	++p;
+      }
+    }
+    if ((str->getLength() & 3) == 1) {
+      str->del(str->getLength() - 1);
+    }
+    ttf->append(str);
+    delete str;
+  }
+  return ttf;
+}
+
+//------------------------------------------------------------------------
+
+class TestFontFileID: public SplashFontFileID {
+public:
+
+  virtual GBool matches(SplashFontFileID *id) { return id == this; }
+};
+
+#define glyphBitmapSize 64
+
+static SplashFont *loadFont(SplashFontEngine *engine, GooString *ttf) {
+  SplashCoord textMat[6] = { 40, 0, 0, 40, 0, 0 };
+  SplashCoord ctm[6] = { 1, 0, 0, 1, 0, 0 };
+  SplashFontSrc *src;
+  SplashFontFile *fontFile;
+  char *buf;
+
+  buf = (char *)gmalloc(ttf->getLength());
+  memcpy(buf, ttf->getCString(), ttf->getLength());
+  src = new SplashFontSrc();
+  src->setBuf(buf, ttf->getLength(), gTrue);
+  fontFile = engine->loadTrueTypeFont(new TestFontFileID(), src, NULL, 0);
+  src->unref();
+  return fontFile ? engine->getFont(fontFile, textMat, ctm) : NULL;
+}
+
+// Render glyph <gid> of <font> into <bitmap>.
+static void renderGlyph(SplashFont *font, int gid, SplashBitmap *bitmap) {
+  SplashColor black, white;
+  Splash *splash;
+
+  black[0] = 0;
+  white[0] = 0xff;
+  splash = new Splash(bitmap, gFalse);
+  splash->clear(black);
+  splash->setFillPattern(new SplashSolidColor(white));
+  splash->fillChar(8, glyphBitmapSize / 2, gid, font);
+  delete splash;
+}
+
+static GBool isEmpty(SplashBitmap *bitmap) {
+  int i;
+
+  for (i = 0; i < bitmap->getRowSize() * bitmap->getHeight(); ++i) {
+    if (bitmap->getDataPtr()[i]) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// Render every glyph of the font <name> embedded in <ps> and compare
+// it with the same glyph of <ttf>: the glyphs marked in <used> must be
+// the same, and the others empty (if <subset>) or the same.
+static GBool checkGlyphs(SplashFontEngine *engine, GooString *ps,
+			 const char *name, GooString *ttf,
+			 const char *used, GBool subset) {
+  GooString *embedded;
+  SplashFont *origFont, *embFont;
+  SplashBitmap *orig, *emb;
+  GBool ok;
+  int gid, size;
+
+  if (!(embedded = extractFont(ps, name))) {
+    return gFalse;
+  }
+  origFont = loadFont(engine, ttf);
+  embFont = loadFont(engine, embedded);
+  delete embedded;
+  if (!origFont || !embFont) {
+    return gFalse;
+  }
+  orig = new SplashBitmap(glyphBitmapSize, glyphBitmapSize, 1,
+			  splashModeMono8, gFalse);
+  emb = new SplashBitmap(glyphBitmapSize, glyphBitmapSize, 1,
+			 splashModeMono8, gFalse);
+  size = orig->getRowSize() * orig->getHeight();
+  ok = gTrue;
+  for (gid = 0; ok && gid < nTestGlyphs; ++gid) {
+    renderGlyph(origFont, gid, orig);
+    renderGlyph(embFont, gid, emb);
+    if (used[gid] || !subset) {
+      ok = !isEmpty(orig) &&
+	   !memcmp(orig->getDataPtr(), emb->getDataPtr(), size);
+    } else {
+      ok = isEmpty(emb);
+    }
+    if (!ok) {
+      fprintf(stderr, "%s: glyph %d is wrong\n", name, gid);
+    }
+  }
+  delete orig;
+  delete emb;
+  return ok;
+}
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *ttfA, *ttfB, *pdf, *ps;
+  SplashFontEngine *engine;
+  GBool subset;
+  char msg[128];
+  int pass, nFailed;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  globalParams->setPSLevel(psLevel2);
+  engine = new SplashFontEngine(
+#if HAVE_T1LIB_H
+				gFalse,
+#endif
+#if HAVE_FREETYPE_FREETYPE_H || HAVE_FREETYPE_H
+				gTrue, gFalse, gFalse,
+#endif
+				gFalse);
+  nFailed = 0;
+
+  ttfA = makeTrueType(60);
+  ttfB = makeTrueType(90);
+  pdf = makeDoc(ttfA, ttfB);
+  for (pass = 0; pass < 2; ++pass) {
+    subset = pass == 1;
+    ps = convert(pdf, subset);
+    sprintf(msg, "%s: identical font programs embedded more than once",
+	    subset ? "subset" : "full");
+    nFailed += !check(countFonts(ps, "PSFontTestA") == 1, msg);
+    sprintf(msg, "%s: different font programs not embedded separately",
+	    subset ? "subset" : "full");
+    nFailed += !check(countFonts(ps, "PSFontTestB") == 1, msg);
+    sprintf(msg, "%s: wrong glyphs in the shared font program",
+	    subset ? "subset" : "full");
+    nFailed += !check(checkGlyphs(engine, ps, "PSFontTestA", ttfA, usedA,
+				  subset), msg);
+    sprintf(msg, "%s: wrong glyphs in the other font program",
+	    subset ? "subset" : "full");
+    nFailed += !check(checkGlyphs(engine, ps, "PSFontTestB", ttfB, usedB,
+				  subset), msg);
+    delete ps;
+  }
+  delete pdf;
+  delete ttfA;
+  delete ttfB;
+
+  delete engine;
+  delete globalParams;
+
+  printf("%d failed\n", nFailed);
+  return nFailed ? 1 : 0;
+}
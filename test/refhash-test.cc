@@ -0,0 +1,165 @@
+//========================================================================
+//
+// refhash-test.cc
+//
+// Fills RefHash tables with many references, including references
+// that differ only in their generation and references that land in
+// the same bucket, and checks add, replace, lookup and removeInt
+// against a plain array, while the table grows and after entries are
+// removed.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "Object.h"
+#include "RefHash.h"
+
+//------------------------------------------------------------------------
+
+#define nNums 3000
+#define nGens 3
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+static Ref makeRef(int num, int gen) {
+  Ref ref;
+
+  ref.num = num;
+  ref.gen = gen;
+  return ref;
+}
+
+// Check every reference in <hash> against <vals>, where 0 means "not
+// in the table".
+static GBool checkInts(RefHash *hash, int *vals) {
+  Ref ref;
+  int num, gen, n;
+
+  n = 0;
+  for (num = 0; num < nNums; ++num) {
+    for (gen = 0; gen < nGens; ++gen) {
+      ref = makeRef(num, gen);
+      if (hash->lookupInt(ref) != vals[num * nGens + gen] ||
+	  hash->contains(ref) != (vals[num * nGens + gen] != 0)) {
+	return gFalse;
+      }
+      if (vals[num * nGens + gen]) {
+	++n;
+      }
+    }
+  }
+  return hash->getLength() == n;
+}
+
+static int checkIntValues() {
+  RefHash *hash;
+  int *vals;
+  int num, gen, i, nFailed;
+  GBool ok;
+
+  nFailed = 0;
+  hash = new RefHash();
+  vals = (int *)gmallocn(nNums * nGens, sizeof(int));
+  memset(vals, 0, nNums * nGens * sizeof(int));
+
+  // the table grows from its initial size
+  for (num = 0; num < nNums; ++num) {
+    for (gen = 0; gen < nGens; ++gen) {
+      if ((num + gen) % 2 == 0) {
+	vals[num * nGens + gen] = 1 + num * nGens + gen;
+	hash->add(makeRef(num, gen), vals[num * nGens + gen]);
+      }
+    }
+  }
+  nFailed += !check(checkInts(hash, vals), "add");
+
+  // replacing both updates entries and adds missing ones
+  for (num = 0; num < nNums; num += 3) {
+    for (gen = 0; gen < nGens; ++gen) {
+      vals[num * nGens + gen] = -(1 + num * nGens + gen);
+      hash->replace(makeRef(num, gen), vals[num * nGens + gen]);
+    }
+  }
+  nFailed += !check(checkInts(hash, vals), "replace");
+
+  // removing entries leaves the others, including the other
+  // generations of the same object
+  ok = gTrue;
+  for (num = 0; num < nNums; num += 2) {
+    i = num * nGens + num % nGens;
+    ok = hash->removeInt(makeRef(num, num % nGens)) == vals[i] && ok;
+    vals[i] = 0;
+  }
+  nFailed += !check(ok, "removeInt return value");
+  nFailed += !check(hash->removeInt(makeRef(0, 0)) == 0,
+		    "removeInt of a missing entry");
+  nFailed += !check(checkInts(hash, vals), "removeInt");
+
+  // and the removed entries can be added again
+  for (num = 0; num < nNums; num += 2) {
+    i = num * nGens + num % nGens;
+    vals[i] = 7;
+    hash->add(makeRef(num, num % nGens), vals[i]);
+  }
+  nFailed += !check(checkInts(hash, vals), "add after removeInt");
+
+  gfree(vals);
+  delete hash;
+  return nFailed;
+}
+
+static int checkPtrValues() {
+  RefHash *hash;
+  int *objs;
+  int num, nFailed;
+  GBool ok;
+
+  nFailed = 0;
+  hash = new RefHash();
+  objs = (int *)gmallocn(nNums, sizeof(int));
+  nFailed += !check(hash->lookup(makeRef(1, 0)) == NULL, "lookup in empty table");
+
+  // references far apart, as in large documents
+  for (num = 0; num < nNums; ++num) {
+    hash->add(makeRef(num * 7919, num % 5), &objs[num]);
+  }
+  ok = gTrue;
+  for (num = 0; num < nNums; ++num) {
+    ok = ok && hash->lookup(makeRef(num * 7919, num % 5)) == &objs[num] &&
+	 hash->lookup(makeRef(num * 7919, num % 5 + 1)) == NULL;
+  }
+  nFailed += !check(ok, "lookup");
+
+  for (num = 0; num < nNums; num += 2) {
+    hash->replace(makeRef(num * 7919, num % 5), &objs[nNums - 1 - num]);
+  }
+  ok = hash->getLength() == nNums;
+  for (num = 0; num < nNums; ++num) {
+    ok = ok && hash->lookup(makeRef(num * 7919, num % 5)) ==
+	       &objs[num % 2 ? num : nNums - 1 - num];
+  }
+  nFailed += !check(ok, "replace pointers");
+
+  gfree(objs);
+  delete hash;
+  return nFailed;
+}
+
+int main(int argc, char *argv[]) {
+  int nFailed;
+
+  nFailed = checkIntValues();
+  nFailed += checkPtrValues();
+  printf("%d failed\n", nFailed);
+  return nFailed ? 1 : 0;
+}
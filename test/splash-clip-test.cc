@@ -0,0 +1,291 @@
+//========================================================================
+//
+// splash-clip-test.cc
+//
+// Checks SplashClip::test, testSpan and clipAALine, with random nested
+// clip paths, saved and restored states and clip rectangles, against
+// the intersection of the paths computed directly, point by point,
+// with one SplashXPathScanner per path.  Anti-aliased lines must be
+// clipped exactly, down to the subpixel.  With -bench, also times
+// fills through a deep stack of clip paths.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "goo/gmem.h"
+#include "goo/GooTimer.h"
+#include "splash/SplashMath.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashXPath.h"
+#include "splash/SplashXPathScanner.h"
+#include "splash/SplashClip.h"
+#include "splash/SplashBitmap.h"
+
+//------------------------------------------------------------------------
+
+static Guint seed = 1;
+
+static int rnd(int n) {
+  seed = seed * 1103515245 + 12345;
+  return (int)((seed >> 8) % (Guint)n);
+}
+
+// The clip paths in effect, each with its own scanner, in the
+// scanner's coordinates (scaled by splashAASize when anti-aliasing).
+typedef std::vector<SplashXPathScanner *> ScannerList;
+
+// A random polygon with some curves, sometimes with a second,
+// overlapping subpath, within a <w> x <h> area.
+static void makePath(SplashPath *path, int w, int h) {
+  SplashCoord x, y;
+  int n, k;
+
+  n = 3 + rnd(6);
+  for (k = 0; k < n; ++k) {
+    x = rnd(w * 12) / 10.0 - w * 0.1;
+    y = rnd(h * 12) / 10.0 - h * 0.1;
+    if (k == 0) {
+      path->moveTo(x, y);
+    } else if (rnd(5)) {
+      path->lineTo(x, y);
+    } else {
+      path->curveTo(x + 5, y, x, y + 7, x + rnd(20), y - rnd(20));
+    }
+  }
+  if (rnd(3) == 0) {
+    path->moveTo(rnd(w), rnd(h));
+    path->lineTo(rnd(w), rnd(h));
+    path->lineTo(rnd(w), rnd(h));
+  }
+  path->close();
+}
+
+// A scanner for <path>, set up the way SplashClip::clipToPath sets up
+// its own.
+static SplashXPathScanner *makeScanner(SplashPath *path, SplashCoord *matrix,
+				       GBool eo, GBool aa,
+				       std::vector<SplashXPath *> *xPaths) {
+  SplashXPath *xPath;
+
+  xPath = new SplashXPath(path, matrix, 1, gTrue);
+  if (aa) {
+    xPath->aaScale();
+  }
+  xPath->sort();
+  xPaths->push_back(xPath);
+  return new SplashXPathScanner(xPath, eo);
+}
+
+static GBool inPaths(ScannerList *paths, int x, int y) {
+  size_t i;
+
+  for (i = 0; i < paths->size(); ++i) {
+    if (!(*paths)[i]->test(x, y)) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// Run queries on <clip>, whose paths are <paths>, and return the
+// number of wrong answers.  Only pixels strictly inside the clip
+// rectangle are checked against the paths, so that the results don't
+// depend on how the rectangle's edges are rounded.
+static int query(SplashClip *clip, ScannerList *paths, GBool aa, int w,
+		 int h, SplashBitmap *aaBuf) {
+  int nBad, q, x, y, x0, x1, xx, yy, xx0, xx1;
+  GBool inside;
+  Guchar *row;
+
+  nBad = 0;
+  for (q = 0; q < 200; ++q) {
+    x = rnd(w + 10) - 5;
+    y = rnd(h + 10) - 5;
+
+    // a point
+    if (x < clip->getXMinI() || x > clip->getXMaxI() ||
+	y < clip->getYMinI() || y > clip->getYMaxI()) {
+      inside = gFalse;
+    } else if (aa) {
+      inside = inPaths(paths, x * splashAASize, y * splashAASize);
+    } else {
+      inside = inPaths(paths, x, y);
+    }
+    if (clip->test(x, y) != inside) {
+      ++nBad;
+    }
+
+    // a span
+    x1 = x + rnd(30);
+    if (x > clip->getXMinI() && x1 < clip->getXMaxI() &&
+	y > clip->getYMinI() && y < clip->getYMaxI()) {
+      inside = gTrue;
+      if (aa) {
+	for (xx = x * splashAASize;
+	     inside && xx < (x1 + 1) * splashAASize; ++xx) {
+	  inside = inPaths(paths, xx, y * splashAASize);
+	}
+      } else {
+	for (xx = x; inside && xx <= x1; ++xx) {
+	  inside = inPaths(paths, xx, y);
+	}
+      }
+      if ((clip->testSpan(x, x1, y) == splashClipAllInside) != inside) {
+	++nBad;
+      }
+    }
+  }
+
+  // anti-aliased lines, with every subpixel set
+  for (y = clip->getYMinI() + 1; aa && y < clip->getYMaxI() && y < h;
+       y += 1 + rnd(3)) {
+    memset(aaBuf->getDataPtr(), 0xff, aaBuf->getRowSize() * splashAASize);
+    x0 = rnd(w / 2);
+    x1 = w / 2 + rnd(w / 2);
+    xx0 = (x0 > clip->getXMinI() ? x0 : clip->getXMinI() + 1) * splashAASize;
+    xx1 = (x1 < clip->getXMaxI() ? x1 + 1 : clip->getXMaxI()) * splashAASize;
+    clip->clipAALine(aaBuf, &x0, &x1, y);
+    for (yy = 0; yy < splashAASize; ++yy) {
+      row = aaBuf->getDataPtr() + yy * aaBuf->getRowSize();
+      for (xx = xx0; xx < xx1; ++xx) {
+	inside = inPaths(paths, xx, y * splashAASize + yy);
+	if (((row[xx >> 3] & (0x80 >> (xx & 7))) != 0) != inside) {
+	  ++nBad;
+	}
+      }
+    }
+  }
+  return nBad;
+}
+
+// Random sequences of clip operations, with a query after each one.
+static int checkRandom(int nIters, int nSteps) {
+  SplashCoord matrix[6] = { 1, 0, 0, 1, 0, 0 };
+  std::vector<SplashXPath *> xPaths;
+  std::vector<SplashXPathScanner *> scanners;
+  SplashClip *clip, *stack[20];
+  ScannerList paths, pathStack[20];
+  SplashBitmap *aaBuf;
+  SplashPath *path;
+  GBool aa, eo;
+  int nBad, iter, step, sp, w, h, op;
+  size_t i;
+
+  nBad = 0;
+  for (iter = 0; iter < nIters; ++iter) {
+    aa = iter & 1;
+    w = 60 + rnd(80);
+    h = 60 + rnd(80);
+    clip = new SplashClip(0, 0, w, h, aa);
+    paths.clear();
+    sp = 0;
+    aaBuf = new SplashBitmap(w * splashAASize, splashAASize, 1,
+			     splashModeMono1, gFalse);
+    for (step = 0; step < nSteps; ++step) {
+      op = rnd(10);
+      if (op < 5) {
+	path = new SplashPath();
+	makePath(path, w, h);
+	eo = rnd(2);
+	clip->clipToPath(path, matrix, 1, eo);
+	scanners.push_back(makeScanner(path, matrix, eo, aa, &xPaths));
+	paths.push_back(scanners.back());
+	delete path;
+      } else if (op < 6) {
+	clip->clipToRect(rnd(w) - 5, rnd(h) - 5, rnd(w) + 5, rnd(h) + 5);
+      } else if (op < 8 && sp < 20) {
+	// save
+	stack[sp] = clip;
+	pathStack[sp] = paths;
+	++sp;
+	clip = clip->copy();
+      } else if (op < 9 && sp > 0) {
+	// restore
+	delete clip;
+	--sp;
+	clip = stack[sp];
+	paths = pathStack[sp];
+      } else if (rnd(4) == 0) {
+	clip->resetToRect(0, 0, w, h);
+	paths.clear();
+      }
+      nBad += query(clip, &paths, aa, w, h, aaBuf);
+    }
+    delete aaBuf;
+    delete clip;
+    while (sp > 0) {
+      delete stack[--sp];
+    }
+    for (i = 0; i < scanners.size(); ++i) {
+      delete scanners[i];
+      delete xPaths[i];
+    }
+    scanners.clear();
+    xPaths.clear();
+  }
+  return nBad;
+}
+
+// Time <nFills> anti-aliased fills of the whole area through <depth>
+// nested circles.
+static double benchmark(int depth, int nFills) {
+  SplashCoord matrix[6] = { 1, 0, 0, 1, 0, 0 };
+  SplashClip *clip;
+  SplashBitmap *aaBuf;
+  SplashPath *path;
+  GooTimer timer;
+  int fill, d, y, x0, x1;
+
+  clip = new SplashClip(0, 0, 600, 600, gTrue);
+  for (d = 0; d < depth; ++d) {
+    path = new SplashPath();
+    path->moveTo(300 - 290 + d, 300);
+    path->curveTo(300 - 290 + d, 500, 300 + 290 - d, 500, 300 + 290 - d, 300);
+    path->curveTo(300 + 290 - d, 100, 300 - 290 + d, 100, 300 - 290 + d, 300);
+    path->close();
+    clip->clipToPath(path, matrix, 1, gFalse);
+    delete path;
+  }
+  aaBuf = new SplashBitmap(600 * splashAASize, splashAASize, 1,
+			   splashModeMono1, gFalse);
+  timer.start();
+  for (fill = 0; fill < nFills; ++fill) {
+    for (y = 0; y < 600; ++y) {
+      memset(aaBuf->getDataPtr(), 0xff, aaBuf->getRowSize() * splashAASize);
+      x0 = 0;
+      x1 = 599;
+      clip->testSpan(x0, x1, y);
+      clip->clipAALine(aaBuf, &x0, &x1, y);
+    }
+  }
+  timer.stop();
+  delete aaBuf;
+  delete clip;
+  return timer.getElapsed() * 1000;
+}
+
+int main(int argc, char *argv[]) {
+  int nBad;
+
+  nBad = checkRandom(200, 12);
+  // deep nesting
+  nBad += checkRandom(20, 60);
+  if (nBad) {
+    fprintf(stderr, "FAIL: %d wrong answers\n", nBad);
+  }
+  printf("%d failed\n", nBad ? 1 : 0);
+
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    printf("depth  1: %7.1f ms\n", benchmark(1, 20));
+    printf("depth 40: %7.1f ms\n", benchmark(40, 20));
+    printf("depth 400: %6.1f ms\n", benchmark(400, 20));
+  }
+
+  return nBad ? 1 : 0;
+}
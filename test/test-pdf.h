@@ -0,0 +1,91 @@
+//========================================================================
+//
+// test-pdf.h
+//
+// Builds small PDF files in memory for the test programs.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef TEST_PDF_H
+#define TEST_PDF_H
+
+#include <stdio.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "Object.h"
+#include "Stream.h"
+#include "PDFDoc.h"
+
+// The body of a stream object with <dict> (without the << >>) and
+// <data>, with the right /Length.
+static inline GooString *testPDFStream(const char *dict, GooString *data) {
+  GooString *s;
+  char buf[32];
+
+  s = new GooString("<< ");
+  s->append(dict);
+  sprintf(buf, " /Length %d >>\nstream\n", data->getLength());
+  s->append(buf);
+  s->append(data);
+  s->append("\nendstream");
+  return s;
+}
+
+// A PDF file with objects 1 .. <nObjs>, whose bodies are <objs>, and
+// object 1 as the root.  If <xref> is false, the file has no xref
+// table, so that it has to be reconstructed.
+static inline GooString *testPDFFile(GooString **objs, int nObjs,
+				     GBool xref = gTrue) {
+  GooString *pdf;
+  char buf[64];
+  int *offsets;
+  int xrefOffset, i;
+
+  offsets = (int *)gmallocn(nObjs, sizeof(int));
+  pdf = new GooString("%PDF-1.4\n");
+  // MemStream can't seek back from the end further than its length,
+  // and PDFDoc looks for startxref in the last 1024 bytes
+  pdf->append('%');
+  for (i = 0; i < 1024; ++i) {
+    pdf->append(' ');
+  }
+  pdf->append('\n');
+  for (i = 0; i < nObjs; ++i) {
+    offsets[i] = pdf->getLength();
+    sprintf(buf, "%d 0 obj\n", i + 1);
+    pdf->append(buf);
+    pdf->append(objs[i]);
+    pdf->append("\nendobj\n");
+  }
+  if (xref) {
+    xrefOffset = pdf->getLength();
+    sprintf(buf, "xref\n0 %d\n0000000000 65535 f \n", nObjs + 1);
+    pdf->append(buf);
+    for (i = 0; i < nObjs; ++i) {
+      sprintf(buf, "%010d 00000 n \n", offsets[i]);
+      pdf->append(buf);
+    }
+  }
+  sprintf(buf, "trailer\n<< /Size %d /Root 1 0 R >>\n", nObjs + 1);
+  pdf->append(buf);
+  if (xref) {
+    sprintf(buf, "startxref\n%d\n", xrefOffset);
+    pdf->append(buf);
+  }
+  pdf->append("%EOF\n");
+  gfree(offsets);
+  return pdf;
+}
+
+// Open <pdf>, which must stay alive as long as the document.
+static inline PDFDoc *testPDFOpen(GooString *pdf) {
+  Object obj;
+
+  obj.initNull();
+  return new PDFDoc(new MemStream(pdf->getCString(), 0, pdf->getLength(),
+				  &obj), NULL, NULL);
+}
+
+#endif
@@ -0,0 +1,299 @@
+//========================================================================
+//
+// xref-reconstruct-test.cc
+//
+// Reconstructs the xref table of damaged documents by scanning them,
+// and checks the result against a plain sequential scan done line by
+// line with Stream::getLine(), the way the xref table used to be
+// reconstructed: same object offsets and
+// generations, same root, and same stream ends.  The documents mix
+// line ends, long lines and several objects per line, and one of them
+// is large enough to be read in several blocks.  With -bench, also
+// times the reconstruction of the large document.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <vector>
+#include "goo/GooString.h"
+#include "goo/GooTimer.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "XRef.h"
+
+//------------------------------------------------------------------------
+
+static Guint rand32(Guint *seed) {
+  *seed = *seed * 1103515245 + 12345;
+  return *seed >> 8;
+}
+
+static const char *lineEnds[3] = { "\n", "\r", "\r\n" };
+
+// A document with <nObjs> objects whose streams hold <dataLen> bytes
+// on average, with a mix of line ends, lines longer than the 255 bytes
+// that the scan handles at once, objects that start on the line where
+// the previous one ends, and wrong stream lengths.  If <xrefMode> is
+// 0, there's no xref table; if it is 1, the xref table is cut off
+// before the trailer.
+static GooString *makeDoc(int nObjs, int dataLen, int xrefMode) {
+  GooString *pdf;
+  char buf[256];
+  const char *eol;
+  Guint seed, x;
+  int xrefPos, num, n, i, k;
+
+  seed = 1;
+  pdf = new GooString("%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+  sprintf(buf, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n"
+	  "2 0 obj\n<< /Type /Pages /Kids [] /Count 0 >>\nendobj\n");
+  pdf->append(buf);
+  for (num = 3; num < nObjs; ++num) {
+    eol = lineEnds[rand32(&seed) % 3];
+    n = dataLen / 2 + (int)(rand32(&seed) % (dataLen + 1));
+    sprintf(buf, "%d %d obj%s<< /Length %d >>%sstream%s",
+	    num, (int)(rand32(&seed) % 3), eol,
+	    rand32(&seed) % 4 ? n : n / 2, eol, eol);
+    pdf->append(buf);
+    for (i = 0; i < n; ++i) {
+      x = rand32(&seed);
+      if (x % 97 == 0) {
+	pdf->append(lineEnds[x % 3]);
+      } else if (x % 89 == 0) {
+	// text that looks like markers, inside a long line
+	pdf->append("0 0 obj trailer endobj");
+	i += 21;
+      } else {
+	pdf->append((char)('a' + x % 26));
+      }
+    }
+    sprintf(buf, "%sendstream%sendobj", eol, eol);
+    pdf->append(buf);
+    // sometimes start the next object on the same line
+    pdf->append(rand32(&seed) % 5 ? eol : " ");
+  }
+  if (xrefMode == 1) {
+    xrefPos = pdf->getLength();
+    sprintf(buf, "xref\n0 %d\n0000000000 65535 f \n", nObjs);
+    pdf->append(buf);
+    for (k = 1; k < nObjs / 2; ++k) {
+      pdf->append("0000000009 00000 n \n");
+    }
+  } else {
+    xrefPos = 0;
+  }
+  sprintf(buf, "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n%d\n%%%%EOF\n",
+	  nObjs, xrefPos);
+  pdf->append(buf);
+  return pdf;
+}
+
+//------------------------------------------------------------------------
+
+// What a sequential scan finds.
+struct ScanResult {
+  std::vector<Guint> offsets;
+  std::vector<int> gens;
+  std::vector<Guint> streamEnds;
+  int rootNum;
+};
+
+// Scan <pdf> line by line, applying the same rules as XRef's
+// reconstruction.
+static void sequentialScan(GooString *pdf, ScanResult *res) {
+  MemStream *str;
+  Object obj, dict, root;
+  char line[256];
+  char *p, *token;
+  Guint pos;
+  GBool oneCycle;
+  int num, gen, offset;
+
+  obj.initNull();
+  str = new MemStream(pdf->getCString(), 0, pdf->getLength(), &obj);
+  res->rootNum = -1;
+  str->reset();
+  while (1) {
+    pos = str->getPos();
+    if (!str->getLine(line, 256)) {
+      break;
+    }
+    p = line;
+    while (*p && Lexer::isSpace(*p & 0xff)) ++p;
+    oneCycle = gTrue;
+    offset = 0;
+    while ((token = strstr(p, "endobj")) || oneCycle) {
+      oneCycle = gFalse;
+      if (token) {
+	oneCycle = gTrue;
+	token[0] = '\0';
+	offset = token - p;
+      }
+      if (!strncmp(p, "trailer", 7)) {
+	// only the real trailer is followed by a dictionary
+	if (!strncmp(pdf->getCString() + pos + 7, "\n<< /Size", 9)) {
+	  res->rootNum = 1;
+	}
+      } else if (isdigit(*p)) {
+	num = atoi(p);
+	if (num > 0) {
+	  do { ++p; } while (*p && isdigit(*p));
+	  if (isspace(*p)) {
+	    do { ++p; } while (*p && isspace(*p));
+	    if (isdigit(*p)) {
+	      gen = atoi(p);
+	      do { ++p; } while (*p && isdigit(*p));
+	      if (isspace(*p)) {
+		do { ++p; } while (*p && isspace(*p));
+		if (!strncmp(p, "obj", 3)) {
+		  if (num >= (int)res->offsets.size()) {
+		    res->offsets.resize(num + 1, 0);
+		    res->gens.resize(num + 1, -1);
+		  }
+		  if (gen >= res->gens[num]) {
+		    res->offsets[num] = pos;
+		    res->gens[num] = gen;
+		  }
+		}
+	      }
+	    }
+	  }
+	}
+      } else if (!strncmp(p, "endstream", 9)) {
+	res->streamEnds.push_back(pos);
+      }
+      if (token) {
+	p = token + 6;
+	pos += offset + 6;
+	while (*p && Lexer::isSpace(*p & 0xff)) {
+	  ++p;
+	  ++pos;
+	}
+      }
+    }
+  }
+  delete str;
+}
+
+static GBool check(GBool cond, const char *msg) {
+  if (!cond) {
+    fprintf(stderr, "FAIL: %s\n", msg);
+  }
+  return cond;
+}
+
+// Open the xref table of <pdf>, which has to be reconstructed.
+static XRef *openXRef(GooString *pdf, MemStream **str, GBool *reconstructed) {
+  Object obj;
+  char *p;
+
+  p = strstr(pdf->getCString(), "startxref\n");
+  obj.initNull();
+  *str = new MemStream(pdf->getCString(), 0, pdf->getLength(), &obj);
+  *reconstructed = gFalse;
+  return new XRef(*str, p ? atoi(p + 10) : 0, 0, reconstructed);
+}
+
+// Reconstruct the xref table of <pdf> and compare it with a sequential
+// scan.
+static int checkDoc(GooString *pdf, const char *what) {
+  ScanResult res;
+  MemStream *str;
+  XRef *xref;
+  XRefEntry *e;
+  Guint end;
+  GBool reconstructed, ok;
+  char msg[128];
+  int nFailed, num;
+  size_t i;
+
+  nFailed = 0;
+  sequentialScan(pdf, &res);
+  xref = openXRef(pdf, &str, &reconstructed);
+  sprintf(msg, "%s: xref table not reconstructed", what);
+  if (!check(xref->isOk() && reconstructed, msg)) {
+    delete xref;
+    delete str;
+    return 1;
+  }
+
+  sprintf(msg, "%s: wrong root", what);
+  nFailed += !check(xref->getRootNum() == res.rootNum, msg);
+
+  ok = xref->getNumObjects() >= (int)res.offsets.size();
+  for (num = 1; ok && num < xref->getNumObjects(); ++num) {
+    e = xref->getEntry(num);
+    if (num < (int)res.offsets.size() && res.gens[num] >= 0) {
+      ok = e->type == xrefEntryUncompressed &&
+	   e->offset == res.offsets[num] && e->gen == res.gens[num];
+    } else {
+      ok = e->type == xrefEntryFree;
+    }
+  }
+  sprintf(msg, "%s: object offsets differ", what);
+  nFailed += !check(ok, msg);
+
+  ok = gTrue;
+  for (i = 0; ok && i < res.streamEnds.size(); ++i) {
+    ok = xref->getStreamEnd(res.streamEnds[i], &end) &&
+	 end == res.streamEnds[i] &&
+	 (i == 0 || (xref->getStreamEnd(res.streamEnds[i - 1] + 1, &end) &&
+		     end == res.streamEnds[i]));
+  }
+  ok = ok && !xref->getStreamEnd(res.streamEnds.back() + 1, &end);
+  sprintf(msg, "%s: stream ends differ", what);
+  nFailed += !check(ok, msg);
+
+  delete xref;
+  delete str;
+  return nFailed;
+}
+
+int main(int argc, char *argv[]) {
+  GooString *pdf;
+  MemStream *str;
+  XRef *xref;
+  GooTimer timer;
+  GBool reconstructed;
+  int nFailed;
+
+  globalParams = new GlobalParams();
+  globalParams->setErrQuiet(gTrue);
+  nFailed = 0;
+
+  // smaller than a block, and smaller than a thread's share
+  pdf = makeDoc(50, 200, 0);
+  nFailed += checkDoc(pdf, "small, no xref");
+  delete pdf;
+  pdf = makeDoc(50, 200, 1);
+  nFailed += checkDoc(pdf, "small, truncated xref");
+  delete pdf;
+
+  // read in several blocks, and split between threads
+  pdf = makeDoc(3000, 4000, 1);
+  nFailed += checkDoc(pdf, "large, truncated xref");
+
+  printf("%d failed\n", nFailed);
+
+  if (argc > 1 && !strcmp(argv[1], "-bench")) {
+    timer.start();
+    xref = openXRef(pdf, &str, &reconstructed);
+    timer.stop();
+    printf("%d MB reconstructed in %.1f ms\n", pdf->getLength() >> 20,
+	   timer.getElapsed() * 1000);
+    delete xref;
+    delete str;
+  }
+
+  delete pdf;
+  delete globalParams;
+  return nFailed ? 1 : 0;
+}
@@ -61,8 +61,6 @@
 #include "HtmlFonts.h"
 
 int HtmlPage::pgNum=0;
-int HtmlOutputDev::imgNum=1;
-GooList *HtmlOutputDev::imgList=new GooList();
 
 extern GBool complexMode;
 extern GBool singleHtml;
@@ -203,6 +201,7 @@ HtmlPage::HtmlPage(GBool rawOrder, char *imgExtVal) {
   yxCur1 = yxCur2 = NULL;
   fonts=new HtmlFontAccu();
   links=new HtmlLinks();
+  imgList=new GooList();
   pageWidth=0;
   pageHeight=0;
   fontsPageMarker = 0;
@@ -216,6 +215,7 @@ HtmlPage::~HtmlPage() {
   if (DocName) delete DocName;
   if (fonts) delete fonts;
   if (links) delete links;
+  deleteGooList(imgList, GooString);
   if (imgExt) delete imgExt;  
 }
 
@@ -642,17 +642,13 @@ void HtmlPage::dumpAsXML(FILE* f,int page){
     delete fontCSStyle;
   }
   
-  GooString *str, *str1 = NULL;
   for(HtmlString *tmp=yxStrings;tmp;tmp=tmp->yxNext){
     if (tmp->htext){
-      str=new GooString(tmp->htext);
       fprintf(f,"<text top=\"%d\" left=\"%d\" ",xoutRound(tmp->yMin),xoutRound(tmp->xMin));
       fprintf(f,"width=\"%d\" height=\"%d\" ",xoutRound(tmp->xMax-tmp->xMin),xoutRound(tmp->yMax-tmp->yMin));
       fprintf(f,"font=\"%d\">", tmp->fontpos);
-      str1=fonts->getCSStyle(tmp->fontpos, str);
-      fputs(str1->getCString(),f);
-      delete str;
-      delete str1;
+      // in xml mode the CSS style is the bare text, so write it directly
+      fwrite(tmp->htext->getCString(),1,tmp->htext->getLength(),f);
       fputs("</text>\n",f);
     }
   }
@@ -780,13 +776,10 @@ void HtmlPage::dump(FILE *f, int pageNum)
   {
     fprintf(f,"<A name=%d></a>",pageNum);
     // Loop over the list of image names on this page
-    int listlen=HtmlOutputDev::imgList->getLength();
-    for (int i = 0; i < listlen; i++) {
-      GooString *fName= (GooString *)HtmlOutputDev::imgList->del(0);
+    for (int i = 0; i < imgList->getLength(); i++) {
+      GooString *fName= (GooString *)imgList->get(i);
       fprintf(f,"<IMG src=\"%s\"><br>\n",fName->getCString());
-      delete fName;
     }
-    HtmlOutputDev::imgNum=1;
 
     GooString* str;
     for(HtmlString *tmp=yxStrings;tmp;tmp=tmp->yxNext){
@@ -831,7 +824,9 @@ void HtmlPage::clear() {
 
   delete links;
   links=new HtmlLinks();
- 
+
+  deleteGooList(imgList, GooString);
+  imgList=new GooList();
 
 }
 
@@ -932,6 +927,7 @@ HtmlOutputDev::HtmlOutputDev(char *fileName, char *title,
   char *htmlEncoding;
   
   fContentsFrame = NULL;
+  page = NULL;
   docTitle = new GooString(title);
   pages = NULL;
   dumpJPEG=gTrue;
@@ -1117,7 +1113,17 @@ void HtmlOutputDev::endPage() {
   pages->conv();
   pages->coalesce();
   pages->dump(page, pageNum);
-  
+  // image names are numbered per page in simple mode, and through the
+  // whole document otherwise (X-2_5.png is the fifth image overall)
+  if (!complexMode && !singleHtml)
+    imgNum = 1;
+
+  // every page is written out as soon as it is done, so that nothing
+  // but the font list is kept from one page to the next
+  if (page)
+    fflush(page);
+  pages->clear();
+
   // I don't yet know what to do in the case when there are pages of different
   // sizes and we want complex output: running ghostscript many times 
   // seems very inefficient. So for now I'll just use last page's size
@@ -1227,7 +1233,7 @@ void HtmlOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 
     fclose(f1);
    
-  if (fName) imgList->append(fName);
+  if (fName) pages->imgList->append(fName);
   }
   else {
     OutputDev::drawImageMask(state, ref, str, width, height, invert, interpolate, inlineImg);
@@ -1316,7 +1322,7 @@ void HtmlOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
     
     fclose(f1);
   
-    if (fName) imgList->append(fName);
+    if (fName) pages->imgList->append(fName);
   }
   else {
 #ifdef ENABLE_LIBPNG
@@ -1382,7 +1388,7 @@ void HtmlOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
     fclose(f1);
 
     free(row);
-    imgList->append(fName);
+    pages->imgList->append(fName);
     ++imgNum;
     imgStr->close();
     delete imgStr;
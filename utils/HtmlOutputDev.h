@@ -176,6 +176,8 @@ private:
   int fontsPageMarker; 
   HtmlFontAccu *fonts;
   HtmlLinks *links; 
+  GooList *imgList;		// image files written for this page
+				//   [GooString]
   
   GooString *DocName;
   GooString *imgExt;
@@ -319,8 +321,7 @@ private:
   int pageNum;
   int maxPageWidth;
   int maxPageHeight;
-  static int imgNum;
-  static GooList *imgList;
+  int imgNum;			// number of the next image
   GooString *Docname;
   GooString *docTitle;
   GooList *glMetaVars;
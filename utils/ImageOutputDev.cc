@@ -42,15 +42,73 @@
 #include "GfxState.h"
 #include "Object.h"
 #include "Stream.h"
-#ifdef ENABLE_LIBJPEG
-#include "DCTStream.h"
+#ifdef ENABLE_ZLIB
+#include "FlateStream.h"
 #endif
+#include "JBIG2Stream.h"
 #include "ImageOutputDev.h"
 
+// size of the buffer used to copy raw image data (and of the IDAT
+// chunks in PNG files)
+#define rawImageBufSize 65536
+
+//------------------------------------------------------------------------
+// PNG chunk writing
+//------------------------------------------------------------------------
+
+static Guint pngCRCTable[256];
+static GBool pngCRCTableInit = gFalse;
+
+static Guint pngCRC(Guint crc, Guchar *buf, int len) {
+  Guint c;
+  int i, k;
+
+  if (!pngCRCTableInit) {
+    for (i = 0; i < 256; ++i) {
+      c = (Guint)i;
+      for (k = 0; k < 8; ++k) {
+	c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      }
+      pngCRCTable[i] = c;
+    }
+    pngCRCTableInit = gTrue;
+  }
+  for (i = 0; i < len; ++i) {
+    crc = pngCRCTable[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+static void pngWriteInt(FILE *f, Guint x) {
+  fputc((x >> 24) & 0xff, f);
+  fputc((x >> 16) & 0xff, f);
+  fputc((x >> 8) & 0xff, f);
+  fputc(x & 0xff, f);
+}
+
+static void pngWriteChunk(FILE *f, const char *type, Guchar *data, int len) {
+  Guint crc;
+
+  pngWriteInt(f, len);
+  fwrite(type, 1, 4, f);
+  fwrite(data, 1, len, f);
+  crc = pngCRC(0xffffffff, (Guchar *)type, 4);
+  crc = pngCRC(crc, data, len);
+  pngWriteInt(f, crc ^ 0xffffffff);
+}
+
+//------------------------------------------------------------------------
+// ImageOutputDev
+//------------------------------------------------------------------------
+
 ImageOutputDev::ImageOutputDev(char *fileRootA, GBool pageNamesA, GBool dumpJPEGA) {
   fileRoot = copyString(fileRootA);
   fileName = (char *)gmalloc(strlen(fileRoot) + 45);
   dumpJPEG = dumpJPEGA;
+  dumpJP2 = gFalse;
+  dumpJBIG2 = gFalse;
+  dumpCCITT = gFalse;
+  dumpFlate = gFalse;
   pageNames = pageNamesA;
   imgNum = 0;
   pageNum = 0;
@@ -70,34 +128,215 @@ void ImageOutputDev::setFilename(const char *fileExt) {
   }
 }
 
-void ImageOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
-				   int width, int height, GBool invert,
-				   GBool interpolate, GBool inlineImg) {
+GBool ImageOutputDev::writeNativeImage(Stream *str, int width, int height,
+					GfxImageColorMap *colorMap,
+					GBool inlineImg) {
   FILE *f;
-  int c;
-  int size, i;
+  Object *globals;
+  StreamPredictor *pred;
+  GfxColorSpaceMode csMode;
+  CCITTFaxStream *ccittStr;
+  int nComps, bits, colorType, i;
+
+  // the encoded data of inline images isn't worth the trouble
+  if (inlineImg) {
+    return gFalse;
+  }
 
-  // dump JPEG file
-  if (dumpJPEG && str->getKind() == strDCT && !inlineImg) {
+  switch (str->getKind()) {
 
-    // open the image file
+  case strDCT:
+    if (!dumpJPEG ||
+	(colorMap && colorMap->getNumPixelComps() != 1 &&
+	 colorMap->getNumPixelComps() != 3)) {
+      return gFalse;
+    }
     setFilename("jpg");
     ++imgNum;
+    writeRawImage(str);
+    return gTrue;
+
+  case strJPX:
+    if (!dumpJP2) {
+      return gFalse;
+    }
+    setFilename("jp2");
+    ++imgNum;
+    writeRawImage(str);
+    return gTrue;
+
+  case strJBIG2:
+    if (!dumpJBIG2) {
+      return gFalse;
+    }
+    globals = ((JBIG2Stream *)str)->getGlobalsStream();
+    if (globals->isStream()) {
+      setFilename("jb2g");
+      if (!(f = fopen(fileName, "wb"))) {
+	error(-1, "Couldn't open image file '%s'", fileName);
+      } else {
+	Guchar *buf = (Guchar *)gmalloc(rawImageBufSize);
+	globals->streamReset();
+	while ((i = globals->getStream()->doGetChars(rawImageBufSize, buf)) > 0) {
+	  fwrite(buf, 1, i, f);
+	}
+	globals->streamClose();
+	gfree(buf);
+	fclose(f);
+      }
+    }
+    setFilename("jb2e");
+    ++imgNum;
+    writeRawImage(str);
+    return gTrue;
+
+  case strCCITTFax:
+    if (!dumpCCITT) {
+      return gFalse;
+    }
+    ccittStr = (CCITTFaxStream *)str;
+    setFilename("params");
     if (!(f = fopen(fileName, "wb"))) {
       error(-1, "Couldn't open image file '%s'", fileName);
-      return;
+    } else {
+      if (ccittStr->getEncoding() < 0) {
+	fprintf(f, "-4 ");
+      } else if (ccittStr->getEncoding() == 0) {
+	fprintf(f, "-1 ");
+      } else {
+	fprintf(f, "-2 ");
+      }
+      fprintf(f, ccittStr->getEncodedByteAlign() ? "-A " : "-P ");
+      fprintf(f, "-X %d ", ccittStr->getColumns());
+      fprintf(f, ccittStr->getBlackIs1() ? "-W " : "-B ");
+      // PDF fax data is always MSB first
+      fprintf(f, "-M\n");
+      fclose(f);
+    }
+    setFilename("ccitt");
+    ++imgNum;
+    writeRawImage(str);
+    return gTrue;
+
+  case strFlate:
+    // PNG predictors produce exactly the filtered scanlines that go
+    // into a PNG IDAT, so the compressed data can be used as is
+    if (!dumpFlate || !colorMap) {
+      return gFalse;
+    }
+    pred = ((FlateStream *)str)->getStreamPredictor();
+    nComps = colorMap->getNumPixelComps();
+    bits = colorMap->getBits();
+    if (!pred || pred->getPredictor() < 10 ||
+	pred->getWidth() != width || pred->getNComps() != nComps ||
+	pred->getNBits() != bits) {
+      return gFalse;
+    }
+    csMode = colorMap->getColorSpace()->getMode();
+    if (nComps == 1 &&
+	(csMode == csDeviceGray || csMode == csCalGray ||
+	 csMode == csICCBased) &&
+	(bits == 1 || bits == 2 || bits == 4 || bits == 8 || bits == 16)) {
+      colorType = 0;
+    } else if (nComps == 3 &&
+	       (csMode == csDeviceRGB || csMode == csCalRGB ||
+		csMode == csICCBased) &&
+	       (bits == 8 || bits == 16)) {
+      colorType = 2;
+    } else {
+      return gFalse;
     }
+    for (i = 0; i < nComps; ++i) {
+      if (colorMap->getDecodeLow(i) != 0 || colorMap->getDecodeHigh(i) != 1) {
+	return gFalse;
+      }
+    }
+    setFilename("png");
+    ++imgNum;
+    writeFlatePNG(str, width, height, colorType, bits);
+    return gTrue;
 
-    // initialize stream
-    str = ((DCTStream *)str)->getRawStream();
-    str->reset();
+  default:
+    return gFalse;
+  }
+}
 
-    // copy the stream
-    while ((c = str->getChar()) != EOF)
-      fputc(c, f);
+void ImageOutputDev::writeRawImage(Stream *str) {
+  FILE *f;
+  Guchar *buf;
+  int n;
 
-    str->close();
-    fclose(f);
+  if (!(f = fopen(fileName, "wb"))) {
+    error(-1, "Couldn't open image file '%s'", fileName);
+    return;
+  }
+
+  // the stream below the top-most filter delivers that filter's
+  // encoded data
+  str = str->getNextStream();
+  str->reset();
+
+  buf = (Guchar *)gmalloc(rawImageBufSize);
+  while ((n = str->doGetChars(rawImageBufSize, buf)) > 0) {
+    fwrite(buf, 1, n, f);
+  }
+  gfree(buf);
+
+  str->close();
+  fclose(f);
+}
+
+void ImageOutputDev::writeFlatePNG(Stream *str, int width, int height,
+				   int colorType, int bits) {
+  static Guchar pngSig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  FILE *f;
+  Guchar ihdr[13];
+  Guchar *buf;
+  int n;
+
+  if (!(f = fopen(fileName, "wb"))) {
+    error(-1, "Couldn't open image file '%s'", fileName);
+    return;
+  }
+
+  fwrite(pngSig, 1, 8, f);
+  ihdr[0] = (width >> 24) & 0xff;
+  ihdr[1] = (width >> 16) & 0xff;
+  ihdr[2] = (width >> 8) & 0xff;
+  ihdr[3] = width & 0xff;
+  ihdr[4] = (height >> 24) & 0xff;
+  ihdr[5] = (height >> 16) & 0xff;
+  ihdr[6] = (height >> 8) & 0xff;
+  ihdr[7] = height & 0xff;
+  ihdr[8] = bits;
+  ihdr[9] = colorType;
+  ihdr[10] = 0;			// deflate
+  ihdr[11] = 0;			// adaptive filtering
+  ihdr[12] = 0;			// no interlace
+  pngWriteChunk(f, "IHDR", ihdr, 13);
+
+  str = str->getNextStream();
+  str->reset();
+  buf = (Guchar *)gmalloc(rawImageBufSize);
+  while ((n = str->doGetChars(rawImageBufSize, buf)) > 0) {
+    pngWriteChunk(f, "IDAT", buf, n);
+  }
+  gfree(buf);
+  str->close();
+
+  pngWriteChunk(f, "IEND", NULL, 0);
+  fclose(f);
+}
+
+void ImageOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
+				   int width, int height, GBool invert,
+				   GBool interpolate, GBool inlineImg) {
+  FILE *f;
+  int size, i;
+
+  // dump the image in its native format
+  if (writeNativeImage(str, width, height, NULL, inlineImg)) {
+    return;
 
   // dump PBM file
   } else {
@@ -137,34 +376,12 @@ void ImageOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   GfxGray gray;
   GfxRGB rgb;
   int x, y;
-  int c;
   int size, i;
   int pbm_mask = 0xff;
 
-  // dump JPEG file
-  if (dumpJPEG && str->getKind() == strDCT &&
-      (colorMap->getNumPixelComps() == 1 ||
-       colorMap->getNumPixelComps() == 3) &&
-      !inlineImg) {
-
-    // open the image file
-    setFilename("jpg");
-    ++imgNum;
-    if (!(f = fopen(fileName, "wb"))) {
-      error(-1, "Couldn't open image file '%s'", fileName);
-      return;
-    }
-
-    // initialize stream
-    str = ((DCTStream *)str)->getRawStream();
-    str->reset();
-
-    // copy the stream
-    while ((c = str->getChar()) != EOF)
-      fputc(c, f);
-
-    str->close();
-    fclose(f);
+  // dump the image in its native format
+  if (writeNativeImage(str, width, height, colorMap, inlineImg)) {
+    return;
 
   // dump PBM file
   } else if (colorMap->getNumPixelComps() == 1 &&
@@ -37,6 +37,7 @@
 #include "OutputDev.h"
 
 class GfxState;
+class GfxImageColorMap;
 
 //------------------------------------------------------------------------
 // ImageOutputDev
@@ -55,6 +56,21 @@ public:
   // Destructor.
   virtual ~ImageOutputDev();
 
+  // The following write the encoded image data as it is stored in
+  // the PDF file, without decoding it.
+  // JPX images are written as JPEG 2000 (.jp2) files.
+  void enableJpeg2000(GBool jp2) { dumpJP2 = jp2; }
+  // JBIG2 images are written as JBIG2 embedded streams (.jb2e), with
+  // the global segments, if any, in a separate file (.jb2g).
+  void enableJBig2(GBool jbig2) { dumpJBIG2 = jbig2; }
+  // CCITT images are written as raw fax data (.ccitt), with the
+  // decoding parameters in fax2tiff syntax in a separate file
+  // (.params).
+  void enableCCITT(GBool ccitt) { dumpCCITT = ccitt; }
+  // Gray and RGB Flate images using PNG predictors are written as PNG
+  // (.png) files; the compressed data is copied into the PNG as is.
+  void enableFlate(GBool flate) { dumpFlate = flate; }
+
   // Check if file was successfully created.
   virtual GBool isOk() { return ok; }
 
@@ -104,10 +120,28 @@ private:
   // Sets the output filename with a given file extension
   void setFilename(const char *fileExt);
 
+  // Write the image in its native encoding, if it is enabled and
+  // possible for this image.  <colorMap> is NULL for image masks.
+  // Returns false if the image has to be decoded.
+  GBool writeNativeImage(Stream *str, int width, int height,
+			 GfxImageColorMap *colorMap, GBool inlineImg);
+
+  // Copy the encoded data of the top-most filter of <str> to the
+  // file <fileName>.
+  void writeRawImage(Stream *str);
+
+  // Wrap the compressed data of the Flate stream <str> in a PNG file.
+  void writeFlatePNG(Stream *str, int width, int height,
+		     int colorType, int bits);
+
 
   char *fileRoot;		// root of output file names
   char *fileName;		// buffer for output file names
   GBool dumpJPEG;		// set to dump native JPEG files
+  GBool dumpJP2;		// set to dump native JPEG 2000 files
+  GBool dumpJBIG2;		// set to dump native JBIG2 files
+  GBool dumpCCITT;		// set to dump native CCITT files
+  GBool dumpFlate;		// set to dump Flate images as PNG files
   GBool pageNames;		// set to include page number in file names
   int pageNum;			// current page number
   int imgNum;			// current image number
@@ -49,6 +49,11 @@
 static int firstPage = 1;
 static int lastPage = 0;
 static GBool dumpJPEG = gFalse;
+static GBool dumpJP2 = gFalse;
+static GBool dumpJBIG2 = gFalse;
+static GBool dumpCCITT = gFalse;
+static GBool dumpFlate = gFalse;
+static GBool dumpAll = gFalse;
 static GBool pageNames = gFalse;
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
@@ -63,6 +68,16 @@ static const ArgDesc argDesc[] = {
    "last page to convert"},
   {"-j",      argFlag,     &dumpJPEG,      0,
    "write JPEG images as JPEG files"},
+  {"-jp2",    argFlag,     &dumpJP2,       0,
+   "write JPEG 2000 images as JP2 files"},
+  {"-jbig2",  argFlag,     &dumpJBIG2,     0,
+   "write JBIG2 images as JBIG2 files"},
+  {"-ccitt",  argFlag,     &dumpCCITT,     0,
+   "write CCITT images as CCITT files"},
+  {"-flate",  argFlag,     &dumpFlate,     0,
+   "write Flate images with PNG predictors as PNG files"},
+  {"-all",    argFlag,     &dumpAll,       0,
+   "equivalent to -j -jp2 -jbig2 -ccitt -flate"},
   {"-opw",    argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
   {"-upw",    argString,   userPassword,   sizeof(userPassword),
@@ -163,7 +178,11 @@ int main(int argc, char *argv[]) {
     lastPage = doc->getNumPages();
 
   // write image files
-  imgOut = new ImageOutputDev(imgRoot, pageNames, dumpJPEG);
+  imgOut = new ImageOutputDev(imgRoot, pageNames, dumpJPEG || dumpAll);
+  imgOut->enableJpeg2000(dumpJP2 || dumpAll);
+  imgOut->enableJBig2(dumpJBIG2 || dumpAll);
+  imgOut->enableCCITT(dumpCCITT || dumpAll);
+  imgOut->enableFlate(dumpFlate || dumpAll);
   if (imgOut->isOk()) {
       doc->displayPages(imgOut, firstPage, lastPage, 72, 72, 0,
 			gTrue, gFalse, gFalse);
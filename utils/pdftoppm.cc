@@ -36,6 +36,7 @@
 #include <io.h>    // for setmode
 #endif
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include "parseargs.h"
 #include "goo/gmem.h"
@@ -44,9 +45,16 @@
 #include "Object.h"
 #include "PDFDoc.h"
 #include "PDFDocFactory.h"
+#include "splash/SplashErrorCodes.h"
 #include "splash/SplashBitmap.h"
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
+#ifdef ENABLE_LIBPNG
+#include "goo/PNGWriter.h"
+#endif
+#if MULTITHREADED
+#include "goo/GooThread.h"
+#endif
 
 #define PPM_FILE_SZ 512
 
@@ -69,15 +77,20 @@ static int sz = 0;
 static GBool useCropBox = gFalse;
 static GBool mono = gFalse;
 static GBool gray = gFalse;
+static char halftoneStr[16] = "";
+static int halftoneThreads = 1;
 static GBool png = gFalse;
 static GBool jpeg = gFalse;
 static GBool tiff = gFalse;
 static char enableFreeTypeStr[16] = "";
 static char antialiasStr[16] = "";
 static char vectorAntialiasStr[16] = "";
+static char cacheContentStr[16] = "";
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static char TiffCompressionStr[16] = "";
+static int pngLevel = -1;
+static int pngThreads = 1;
 static GBool quiet = gFalse;
 static GBool printVersion = gFalse;
 static GBool printHelp = gFalse;
@@ -122,11 +135,19 @@ static const ArgDesc argDesc[] = {
 
   {"-mono",   argFlag,     &mono,          0,
    "generate a monochrome PBM file"},
+  {"-halftone", argString, halftoneStr,    sizeof(halftoneStr),
+   "render -mono pages in gray and halftone them: screen, diffusion"},
+  {"-halftonethreads", argInt, &halftoneThreads, 0,
+   "number of threads used to halftone each page (default is 1)"},
   {"-gray",   argFlag,     &gray,          0,
    "generate a grayscale PGM file"},
 #if ENABLE_LIBPNG
   {"-png",    argFlag,     &png,           0,
    "generate a PNG file"},
+  {"-pnglevel", argInt,    &pngLevel,      0,
+   "set PNG compression level: 0 (fastest) to 9 (smallest, default)"},
+  {"-pngthreads", argInt,  &pngThreads,    0,
+   "number of threads used to compress each PNG file (default is 1)"},
 #endif
 #if ENABLE_LIBJPEG
   {"-jpeg",    argFlag,     &jpeg,           0,
@@ -147,6 +168,8 @@ static const ArgDesc argDesc[] = {
    "enable font anti-aliasing: yes, no"},
   {"-aaVector",   argString,      vectorAntialiasStr, sizeof(vectorAntialiasStr),
    "enable vector anti-aliasing: yes, no"},
+  {"-cachecontent", argString,    cacheContentStr, sizeof(cacheContentStr),
+   "keep parsed content streams for reuse: yes, no"},
   
   {"-opw",    argString,   ownerPassword,  sizeof(ownerPassword),
    "owner password (for encrypted files)"},
@@ -168,11 +191,125 @@ static const ArgDesc argDesc[] = {
   {NULL}
 };
 
+// A rendered page that is waiting to be written.
+struct PageImage {
+  SplashBitmap *bitmap;
+  char *fileName;		// NULL for stdout
+  double hDPI, vDPI;
+};
+
+// Set when a page image could not be written.  Only one page is
+// written at a time, and the writer thread is joined before this is
+// read.
+static GBool writeFailed = gFalse;
+
+static void writePageImage(PageImage *img) {
+  SplashBitmap *bitmap = img->bitmap;
+  SplashError err;
+  FILE *f;
+
+  if (img->fileName != NULL) {
+    if (!(f = fopen(img->fileName, "wb"))) {
+      error(-1, "Couldn't open image file '%s'", img->fileName);
+      writeFailed = gTrue;
+      return;
+    }
+  } else {
+#ifdef _WIN32
+    setmode(fileno(stdout), O_BINARY);
+#endif
+    f = stdout;
+  }
+
+  if (png) {
+#ifdef ENABLE_LIBPNG
+    PNGWriter *writer = new PNGWriter();
+    if (pngLevel >= 0) {
+      writer->setCompressionLevel(pngLevel);
+    }
+    writer->setNumThreads(pngThreads);
+    err = bitmap->writeImgFile(writer, f, (int)img->hDPI, (int)img->vDPI);
+    delete writer;
+#else
+    err = splashErrGeneric;
+#endif
+  } else if (jpeg) {
+    err = bitmap->writeImgFile(splashFormatJpeg, f, img->hDPI, img->vDPI);
+  } else if (tiff) {
+    err = bitmap->writeImgFile(splashFormatTiff, f, img->hDPI, img->vDPI, TiffCompressionStr);
+  } else {
+    err = bitmap->writePNMFile(f);
+  }
+  if (err != splashOk) {
+    if (img->fileName != NULL) {
+      error(-1, "Couldn't write image file '%s'", img->fileName);
+    } else {
+      error(-1, "Couldn't write image");
+    }
+    writeFailed = gTrue;
+  }
+
+  if (f != stdout) {
+    fclose(f);
+  }
+}
+
+static void freePageImage(PageImage *img) {
+  delete img->bitmap;
+  gfree(img->fileName);
+  delete img;
+}
+
+#if MULTITHREADED
+
+// Pages are written by a separate thread, so that the next page can
+// be rendered while the previous one is being compressed.  At most
+// one page is waiting at any time.
+static GooThread writerThread;
+static GBool writerRunning = gFalse;
+
+static GOO_THREAD_FUNC(pageWriterThread) {
+  writePageImage((PageImage *)arg);
+  freePageImage((PageImage *)arg);
+  GOO_THREAD_RETURN;
+}
+
+static void finishPageImage() {
+  if (writerRunning) {
+    gJoinThread(writerThread);
+    writerRunning = gFalse;
+  }
+}
+
+static void queuePageImage(PageImage *img) {
+  finishPageImage();
+  if (gCreateThread(&writerThread, pageWriterThread, img)) {
+    writerRunning = gTrue;
+  } else {
+    writePageImage(img);
+    freePageImage(img);
+  }
+}
+
+#else
+
+static void finishPageImage() {
+}
+
+static void queuePageImage(PageImage *img) {
+  writePageImage(img);
+  freePageImage(img);
+}
+
+#endif
+
 static void savePageSlice(PDFDoc *doc,
                    SplashOutputDev *splashOut, 
                    int pg, int x, int y, int w, int h, 
                    double pg_w, double pg_h, 
                    char *ppmFile) {
+  PageImage *img;
+
   if (w == 0) w = (int)ceil(pg_w);
   if (h == 0) h = (int)ceil(pg_h);
   w = (x+w > pg_w ? (int)ceil(pg_w-x) : w);
@@ -184,33 +321,12 @@ static void savePageSlice(PDFDoc *doc,
     x, y, w, h
   );
 
-  SplashBitmap *bitmap = splashOut->getBitmap();
-  
-  if (ppmFile != NULL) {
-    if (png) {
-      bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
-    } else if (jpeg) {
-      bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_resolution, y_resolution);
-    } else if (tiff) {
-      bitmap->writeImgFile(splashFormatTiff, ppmFile, x_resolution, y_resolution, TiffCompressionStr);
-    } else {
-      bitmap->writePNMFile(ppmFile);
-    }
-  } else {
-#ifdef _WIN32
-    setmode(fileno(stdout), O_BINARY);
-#endif
-
-    if (png) {
-      bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution);
-    } else if (jpeg) {
-      bitmap->writeImgFile(splashFormatJpeg, stdout, x_resolution, y_resolution);
-    } else if (tiff) {
-      bitmap->writeImgFile(splashFormatTiff, stdout, x_resolution, y_resolution, TiffCompressionStr);
-    } else {
-      bitmap->writePNMFile(stdout);
-    }
-  }
+  img = new PageImage;
+  img->bitmap = splashOut->takeBitmap();
+  img->fileName = ppmFile != NULL ? copyString(ppmFile) : (char *)NULL;
+  img->hDPI = x_resolution;
+  img->vDPI = y_resolution;
+  queuePageImage(img);
 }
 
 static int numberOfCharacters(unsigned int n)
@@ -233,6 +349,8 @@ int main(int argc, char *argv[]) {
   GooString *ownerPW, *userPW;
   SplashColor paperColor;
   SplashOutputDev *splashOut;
+  SplashColorMode colorMode;
+  SplashHalftoneMethod halftoneMethod;
   GBool ok;
   int exitCode;
   int pg, pg_num_len;
@@ -245,6 +363,26 @@ int main(int argc, char *argv[]) {
   if (mono && gray) {
     ok = gFalse;
   }
+  halftoneMethod = splashHalftoneNone;
+  if (halftoneStr[0]) {
+    if (!strcmp(halftoneStr, "screen")) {
+      halftoneMethod = splashHalftoneScreen;
+    } else if (!strcmp(halftoneStr, "diffusion")) {
+      halftoneMethod = splashHalftoneDiffusion;
+    } else {
+      fprintf(stderr, "Bad '-halftone' value on command line\n");
+      ok = gFalse;
+    }
+    if (!mono) {
+      ok = gFalse;
+    }
+  }
+#if ENABLE_LIBPNG
+  if (pngLevel < -1 || pngLevel > 9) {
+    fprintf(stderr, "Bad '-pnglevel' value on command line\n");
+    ok = gFalse;
+  }
+#endif
   if ( resolution != 0.0 &&
        (x_resolution == 150.0 ||
         y_resolution == 150.0)) {
@@ -282,6 +420,11 @@ int main(int argc, char *argv[]) {
       fprintf(stderr, "Bad '-aaVector' value on command line\n");
     }
   }
+  if (cacheContentStr[0]) {
+    if (!globalParams->setCacheContentStreams(cacheContentStr)) {
+      fprintf(stderr, "Bad '-cachecontent' value on command line\n");
+    }
+  }
   if (quiet) {
     globalParams->setErrQuiet(quiet);
   }
@@ -340,10 +483,17 @@ int main(int argc, char *argv[]) {
   paperColor[0] = 255;
   paperColor[1] = 255;
   paperColor[2] = 255;
-  splashOut = new SplashOutputDev(mono ? splashModeMono1 :
-				    gray ? splashModeMono8 :
-				             splashModeRGB8, 4,
-				  gFalse, paperColor);
+  if (mono && halftoneMethod == splashHalftoneNone) {
+    colorMode = splashModeMono1;
+  } else if (mono || gray) {
+    // with -halftone, pages are rendered in gray, and SplashOutputDev
+    // turns them into 1-bit bitmaps at the end of each page
+    colorMode = splashModeMono8;
+  } else {
+    colorMode = splashModeRGB8;
+  }
+  splashOut = new SplashOutputDev(colorMode, 4, gFalse, paperColor);
+  splashOut->setMonoHalftone(halftoneMethod, halftoneThreads);
   splashOut->startDoc(doc->getXRef());
   if (sz != 0) w = h = sz;
   pg_num_len = numberOfCharacters(doc->getNumPages());
@@ -390,9 +540,10 @@ int main(int argc, char *argv[]) {
       savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, NULL);
     }
   }
+  finishPageImage();
   delete splashOut;
 
-  exitCode = 0;
+  exitCode = writeFailed ? 2 : 0;
 
   // clean up
  err1:
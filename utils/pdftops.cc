@@ -90,6 +90,7 @@ static GBool noEmbedTTFonts = gFalse;
 static GBool noEmbedCIDPSFonts = gFalse;
 static GBool noEmbedCIDTTFonts = gFalse;
 static GBool noSubstFonts = gFalse;
+static GBool subsetFonts = gFalse;
 static GBool preload = gFalse;
 static char paperSize[15] = "";
 static int paperWidth = -1;
@@ -99,6 +100,7 @@ static GBool expand = gFalse;
 static GBool noShrink = gFalse;
 static GBool noCenter = gFalse;
 static GBool duplex = gFalse;
+static int nThreads = 1;
 static char ownerPassword[33] = "\001";
 static char userPassword[33] = "\001";
 static GBool quiet = gFalse;
@@ -142,6 +144,8 @@ static const ArgDesc argDesc[] = {
    "don't embed CID TrueType fonts"},
   {"-passfonts",  argFlag,        &noSubstFonts,0,
    "don't substitute missing fonts"},
+  {"-subsetfonts", argFlag,    &subsetFonts,    0,
+   "embed only the TrueType glyphs that are used"},
   {"-preload",    argFlag,     &preload,        0,
    "preload images and forms"},
   {"-paper",      argString,   paperSize,       sizeof(paperSize),
@@ -160,6 +164,8 @@ static const ArgDesc argDesc[] = {
    "don't center pages smaller than the paper size"},
   {"-duplex",     argFlag,     &duplex,         0,
    "enable duplex printing"},
+  {"-threads",    argInt,      &nThreads,       0,
+   "number of threads used to generate pages (default is 1)"},
   {"-opw",        argString,   ownerPassword,   sizeof(ownerPassword),
    "owner password (for encrypted files)"},
   {"-upw",        argString,   userPassword,    sizeof(userPassword),
@@ -187,9 +193,11 @@ int main(int argc, char *argv[]) {
   PSOutMode mode;
   GooString *ownerPW, *userPW;
   PSOutputDev *psOut;
+  PDFDoc **docs;
+  int nDocs;
   GBool ok;
   char *p;
-  int exitCode;
+  int exitCode, i;
 
   exitCode = 99;
 
@@ -281,6 +289,9 @@ int main(int argc, char *argv[]) {
   if (noSubstFonts) {
     globalParams->setPSSubstFonts(!noSubstFonts);
   }
+  if (subsetFonts) {
+    globalParams->setPSSubsetFonts(subsetFonts);
+  }
   if (preload) {
     globalParams->setPSPreload(preload);
   }
@@ -311,12 +322,6 @@ int main(int argc, char *argv[]) {
 
   doc = PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW);
 
-  if (userPW) {
-    delete userPW;
-  }
-  if (ownerPW) {
-    delete ownerPW;
-  }
   if (!doc->isOk()) {
     exitCode = 1;
     goto err1;
@@ -369,8 +374,27 @@ int main(int argc, char *argv[]) {
 			  paperHeight,
 			  duplex);
   if (psOut->isOk()) {
-    doc->displayPages(psOut, firstPage, lastPage, 72, 72,
-		      0, noCrop, !noCrop, gTrue);
+    // each thread needs its own copy of the document; stdin can only
+    // be read once
+    docs = (PDFDoc **)gmallocn(nThreads > 1 ? nThreads : 1, sizeof(PDFDoc *));
+    docs[0] = doc;
+    nDocs = 1;
+    if (fileName->cmp("fd://0") != 0) {
+      while (nDocs < nThreads) {
+	docs[nDocs] = PDFDocFactory().createPDFDoc(*fileName, ownerPW, userPW);
+	if (!docs[nDocs]->isOk()) {
+	  delete docs[nDocs];
+	  break;
+	}
+	++nDocs;
+      }
+    }
+    psOut->displayPagesParallel(docs, nDocs, firstPage, lastPage, 72, 72,
+				0, noCrop, !noCrop, gTrue);
+    for (i = 1; i < nDocs; ++i) {
+      delete docs[i];
+    }
+    gfree(docs);
   } else {
     delete psOut;
     exitCode = 2;
@@ -386,6 +410,12 @@ int main(int argc, char *argv[]) {
  err1:
   delete doc;
   delete fileName;
+  if (userPW) {
+    delete userPW;
+  }
+  if (ownerPW) {
+    delete ownerPW;
+  }
  err0:
   delete globalParams;
 